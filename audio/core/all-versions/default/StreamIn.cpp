@@ -56,12 +56,7 @@ class ReadThread : public Thread {
           mCommandMQ(commandMQ),
           mDataMQ(dataMQ),
           mStatusMQ(statusMQ),
-          mEfGroup(efGroup),
-          mBuffer(nullptr) {}
-    bool init() {
-        mBuffer.reset(new (std::nothrow) uint8_t[mDataMQ->getQuantumCount()]);
-        return mBuffer != nullptr;
-    }
+          mEfGroup(efGroup) {}
     virtual ~ReadThread() {}
 
    private:
@@ -71,7 +66,6 @@ class ReadThread : public Thread {
     StreamIn::DataMQ* mDataMQ;
     StreamIn::StatusMQ* mStatusMQ;
     EventFlag* mEfGroup;
-    std::unique_ptr<uint8_t[]> mBuffer;
     IStreamIn::ReadParameters mParameters;
     IStreamIn::ReadStatus mStatus;
 
@@ -91,11 +85,30 @@ void ReadThread::doRead() {
             (int32_t)requestedToRead, (int32_t)availableToWrite);
         requestedToRead = availableToWrite;
     }
-    ssize_t readResult = mStream->read(mStream, &mBuffer[0], requestedToRead);
+    // Read from the HAL straight into the data MQ memory. Space wrapping around the end of the
+    // queue takes a second read.
+    StreamIn::DataMQ::MemTransaction tx;
+    if (!mDataMQ->beginWrite(requestedToRead, &tx)) {
+        ALOGW("data message queue write failed");
+        mStatus.retval = Result::OK;
+        mStatus.reply.read = 0;
+        return;
+    }
+    const auto& firstRegion = tx.getFirstRegion();
+    const auto& secondRegion = tx.getSecondRegion();
+    ssize_t readResult = mStream->read(mStream, firstRegion.getAddress(), firstRegion.getLength());
     mStatus.retval = Result::OK;
     if (readResult >= 0) {
+        if (static_cast<size_t>(readResult) == firstRegion.getLength() &&
+            secondRegion.getLength() != 0) {
+            ssize_t secondReadResult =
+                    mStream->read(mStream, secondRegion.getAddress(), secondRegion.getLength());
+            if (secondReadResult > 0) {
+                readResult += secondReadResult;
+            }
+        }
         mStatus.reply.read = readResult;
-        if (!mDataMQ->write(&mBuffer[0], readResult)) {
+        if (!mDataMQ->commitWrite(readResult)) {
             ALOGW("data message queue write failed");
         }
     } else {
@@ -419,11 +432,6 @@ Return<void> StreamIn::prepareForReading(uint32_t frameSize, uint32_t framesCoun
     auto tempReadThread =
             sp<ReadThread>::make(&mStopReadThread, mStream, tempCommandMQ.get(), tempDataMQ.get(),
                                  tempStatusMQ.get(), tempElfGroup.get());
-    if (!tempReadThread->init()) {
-        ALOGW("failed to start reader thread: %s", strerror(-status));
-        sendError(Result::INVALID_ARGUMENTS);
-        return Void();
-    }
     status = tempReadThread->run("reader", PRIORITY_URGENT_AUDIO);
     if (status != OK) {
         ALOGW("failed to start reader thread: %s", strerror(-status));
@@ -59,12 +59,7 @@ class WriteThread : public Thread {
           mCommandMQ(commandMQ),
           mDataMQ(dataMQ),
           mStatusMQ(statusMQ),
-          mEfGroup(efGroup),
-          mBuffer(nullptr) {}
-    bool init() {
-        mBuffer.reset(new (std::nothrow) uint8_t[mDataMQ->getQuantumCount()]);
-        return mBuffer != nullptr;
-    }
+          mEfGroup(efGroup) {}
     virtual ~WriteThread() {}
 
    private:
@@ -74,7 +69,6 @@ class WriteThread : public Thread {
     StreamOut::DataMQ* mDataMQ;
     StreamOut::StatusMQ* mStatusMQ;
     EventFlag* mEfGroup;
-    std::unique_ptr<uint8_t[]> mBuffer;
     IStreamOut::WriteStatus mStatus;
 
     bool threadLoop() override;
@@ -88,13 +82,39 @@ void WriteThread::doWrite() {
     const size_t availToRead = mDataMQ->availableToRead();
     mStatus.retval = Result::OK;
     mStatus.reply.written = 0;
-    if (mDataMQ->read(&mBuffer[0], availToRead)) {
-        ssize_t writeResult = mStream->write(mStream, &mBuffer[0], availToRead);
-        if (writeResult >= 0) {
-            mStatus.reply.written = writeResult;
-        } else {
-            mStatus.retval = Stream::analyzeStatus("write", writeResult);
+    // Write to the HAL straight from the data MQ memory. Data wrapping around the end of the
+    // queue takes a second write.
+    StreamOut::DataMQ::MemTransaction tx;
+    if (!mDataMQ->beginRead(availToRead, &tx)) {
+        return;
+    }
+    const auto& firstRegion = tx.getFirstRegion();
+    const auto& secondRegion = tx.getSecondRegion();
+    ssize_t writeResult =
+            mStream->write(mStream, firstRegion.getAddress(), firstRegion.getLength());
+    if (writeResult >= 0) {
+        mStatus.reply.written = writeResult;
+        if (static_cast<size_t>(writeResult) == firstRegion.getLength() &&
+            secondRegion.getLength() != 0) {
+            writeResult =
+                    mStream->write(mStream, secondRegion.getAddress(), secondRegion.getLength());
+            if (writeResult >= 0) {
+                mStatus.reply.written += writeResult;
+            } else {
+                // What the first write consumed is still reported, the error only if nothing was
+                // written at all.
+                Result result = Stream::analyzeStatus("write", writeResult);
+                if (mStatus.reply.written == 0) {
+                    mStatus.retval = result;
+                }
+            }
         }
+    } else {
+        mStatus.retval = Stream::analyzeStatus("write", writeResult);
+    }
+    // The whole queue content is consumed, as with a copying read.
+    if (!mDataMQ->commitRead(availToRead)) {
+        ALOGW("data message queue commit read failed");
     }
 }
 
@@ -405,11 +425,6 @@ Return<void> StreamOut::prepareForWriting(uint32_t frameSize, uint32_t framesCou
     auto tempWriteThread =
             sp<WriteThread>::make(&mStopWriteThread, mStream, tempCommandMQ.get(), tempDataMQ.get(),
                                   tempStatusMQ.get(), tempElfGroup.get());
-    if (!tempWriteThread->init()) {
-        ALOGW("failed to start writer thread: %s", strerror(-status));
-        sendError(Result::INVALID_ARGUMENTS);
-        return Void();
-    }
     status = tempWriteThread->run("writer", PRIORITY_URGENT_AUDIO);
     if (status != OK) {
         ALOGW("failed to start writer thread: %s", strerror(-status));
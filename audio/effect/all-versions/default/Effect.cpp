@@ -14,6 +14,7 @@
  * limitations under the License.
  */
 
+#include <inttypes.h>
 #include <memory.h>
 
 #define LOG_TAG "EffectHAL"
@@ -57,7 +58,8 @@ class ProcessThread : public Thread {
     // ProcessThread's lifespan never exceeds Effect's lifespan.
      ProcessThread(std::atomic<bool>* stop, effect_handle_t effect,
                    std::atomic<audio_buffer_t*>* inBuffer, std::atomic<audio_buffer_t*>* outBuffer,
-                   Effect::StatusMQ* statusMQ, EventFlag* efGroup, Effect* effectHal)
+                   Effect::StatusMQ* statusMQ, EventFlag* efGroup, EffectChain* chain,
+                   Effect* effectHal)
          : Thread(false /*canCallJava*/),
            mStop(stop),
            mEffect(effect),
@@ -66,6 +68,7 @@ class ProcessThread : public Thread {
            mOutBuffer(outBuffer),
            mStatusMQ(statusMQ),
            mEfGroup(efGroup),
+           mChain(chain),
            mEffectHal(effectHal) {}
      virtual ~ProcessThread() {}
 
@@ -77,6 +80,7 @@ class ProcessThread : public Thread {
     std::atomic<audio_buffer_t*>* mOutBuffer;
     Effect::StatusMQ* mStatusMQ;
     EventFlag* mEfGroup;
+    EffectChain* mChain;
     Effect* const mEffectHal;
 
     bool threadLoop() override;
@@ -110,11 +114,18 @@ bool ProcessThread::threadLoop() {
                 // Time this effect process
                 SCOPED_STATS();
 
-                if (efState & static_cast<uint32_t>(MessageQueueFlagBits::REQUEST_PROCESS)) {
+                const bool reverse =
+                        !(efState & static_cast<uint32_t>(MessageQueueFlagBits::REQUEST_PROCESS));
+                if (!reverse) {
                     processResult = (*mEffect)->process(mEffect, inBuffer, outBuffer);
                 } else {
                     processResult = (*mEffect)->process_reverse(mEffect, inBuffer, outBuffer);
                 }
+                // Then the effects that have joined the chain of this one.
+                const int32_t chainResult = mChain->process(reverse);
+                if (processResult == 0) {
+                    processResult = chainResult;
+                }
                 std::atomic_thread_fence(std::memory_order_release);
             } else {
                 ALOGE("processing buffers were not set before calling 'process'");
@@ -152,7 +163,11 @@ const char* Effect::sContextCallFunction = sContextCallToCommand;
 const char* Effect::sContextConversion = "conversion";
 
 Effect::Effect(bool isInput, effect_handle_t handle)
-    : mIsInput(isInput), mHandle(handle), mEfGroup(nullptr), mStopProcessThread(false) {
+    : mIsInput(isInput),
+      mHandle(handle),
+      mEfGroup(nullptr),
+      mStopProcessThread(false),
+      mChain(EffectChain::create(handle)) {
     (void)mIsInput;  // prevent 'unused field' warnings in pre-V7 versions.
 }
 
@@ -178,6 +193,45 @@ Effect::~Effect() {
     mHandle = 0;
 }
 
+uint8_t* Effect::ScratchBuffer::get(size_t size) {
+    uint8_t* data = mInline;
+    if (size > kInlineSize) {
+        if (size > mHeapSize) {
+            mHeap.reset(new uint8_t[size]);
+            mHeapSize = size;
+        }
+        data = mHeap.get();
+    }
+    memset(data, 0, size);
+    return data;
+}
+
+void Effect::ScratchBuffer::trim() {
+    if (mHeapSize > kMaxRetainedSize) {
+        mHeap.reset();
+        mHeapSize = 0;
+    }
+}
+
+Effect::ScratchLease::ScratchLease(Effect* effect) : mEffect(effect) {
+    {
+        std::lock_guard<std::mutex> lock(mEffect->mScratchLock);
+        if (!mEffect->mFreeScratchBuffers.empty()) {
+            mBuffer = std::move(mEffect->mFreeScratchBuffers.back());
+            mEffect->mFreeScratchBuffers.pop_back();
+        }
+    }
+    if (mBuffer == nullptr) {
+        mBuffer.reset(new ScratchBuffer());
+    }
+}
+
+Effect::ScratchLease::~ScratchLease() {
+    mBuffer->trim();
+    std::lock_guard<std::mutex> lock(mEffect->mScratchLock);
+    mEffect->mFreeScratchBuffers.push_back(std::move(mBuffer));
+}
+
 // static
 template <typename T>
 size_t Effect::alignedSizeIn(size_t s) {
@@ -186,13 +240,14 @@ size_t Effect::alignedSizeIn(size_t s) {
 
 // static
 template <typename T>
-std::unique_ptr<uint8_t[]> Effect::hidlVecToHal(const hidl_vec<T>& vec, uint32_t* halDataSize) {
+uint8_t* Effect::hidlVecToHal(const hidl_vec<T>& vec, ScratchLease* scratch,
+                              uint32_t* halDataSize) {
     // Due to bugs in HAL, they may attempt to write into the provided
     // input buffer. The original binder buffer is r/o, thus it is needed
     // to create a r/w version.
     *halDataSize = vec.size() * sizeof(T);
-    std::unique_ptr<uint8_t[]> halData(new uint8_t[*halDataSize]);
-    memcpy(&halData[0], &vec[0], *halDataSize);
+    uint8_t* halData = scratch->get(*halDataSize);
+    memcpy(halData, vec.data(), *halDataSize);
     return halData;
 }
 
@@ -238,12 +293,13 @@ void Effect::effectOffloadParamToHal(const EffectOffloadParameter& offload,
 }
 
 // static
-std::vector<uint8_t> Effect::parameterToHal(uint32_t paramSize, const void* paramData,
-                                            uint32_t valueSize, const void** valueData) {
+uint8_t* Effect::parameterToHal(uint32_t paramSize, const void* paramData, uint32_t valueSize,
+                                const void** valueData, ScratchLease* scratch,
+                                uint32_t* halParamBufferSize) {
     size_t valueOffsetFromData = alignedSizeIn<uint32_t>(paramSize) * sizeof(uint32_t);
-    size_t halParamBufferSize = sizeof(effect_param_t) + valueOffsetFromData + valueSize;
-    std::vector<uint8_t> halParamBuffer(halParamBufferSize, 0);
-    effect_param_t* halParam = reinterpret_cast<effect_param_t*>(&halParamBuffer[0]);
+    *halParamBufferSize = sizeof(effect_param_t) + valueOffsetFromData + valueSize;
+    uint8_t* halParamBuffer = scratch->get(*halParamBufferSize);
+    effect_param_t* halParam = reinterpret_cast<effect_param_t*>(halParamBuffer);
     halParam->psize = paramSize;
     halParam->vsize = valueSize;
     memcpy(halParam->data, paramData, paramSize);
@@ -314,17 +370,20 @@ Result Effect::getParameterImpl(uint32_t paramSize, const void* paramData,
                                 GetParameterSuccessCallback onSuccess) {
     // As it is unknown what method HAL uses for copying the provided parameter data,
     // it is safer to make sure that input and output buffers do not overlap.
-    std::vector<uint8_t> halCmdBuffer =
-        parameterToHal(paramSize, paramData, requestValueSize, nullptr);
+    ScratchLease cmdScratch(this);
+    uint32_t halCmdBufferSize;
+    uint8_t* halCmdBuffer = parameterToHal(paramSize, paramData, requestValueSize, nullptr,
+                                           &cmdScratch, &halCmdBufferSize);
+    ScratchLease paramScratch(this);
     const void* valueData = nullptr;
-    std::vector<uint8_t> halParamBuffer =
-        parameterToHal(paramSize, paramData, replyValueSize, &valueData);
-    uint32_t halParamBufferSize = halParamBuffer.size();
+    uint32_t halParamBufferSize;
+    uint8_t* halParamBuffer = parameterToHal(paramSize, paramData, replyValueSize, &valueData,
+                                             &paramScratch, &halParamBufferSize);
 
     return sendCommandReturningStatusAndData(
-        EFFECT_CMD_GET_PARAM, "GET_PARAM", halCmdBuffer.size(), &halCmdBuffer[0],
-        &halParamBufferSize, &halParamBuffer[0], sizeof(effect_param_t), [&] {
-            effect_param_t* halParam = reinterpret_cast<effect_param_t*>(&halParamBuffer[0]);
+        EFFECT_CMD_GET_PARAM, "GET_PARAM", halCmdBufferSize, halCmdBuffer,
+        &halParamBufferSize, halParamBuffer, sizeof(effect_param_t), [&] {
+            effect_param_t* halParam = reinterpret_cast<effect_param_t*>(halParamBuffer);
             onSuccess(halParam->vsize, valueData);
         });
 }
@@ -367,7 +426,8 @@ Return<void> Effect::prepareForProcessing(prepareForProcessing_cb _hidl_cb) {
 
     // Create and launch the thread.
     mProcessThread = new ProcessThread(&mStopProcessThread, mHandle, &mHalInBufferPtr,
-                                       &mHalOutBufferPtr, tempStatusMQ.get(), mEfGroup, this);
+                                       &mHalOutBufferPtr, tempStatusMQ.get(), mEfGroup,
+                                       mChain.get(), this);
     status = mProcessThread->run("effect", PRIORITY_URGENT_AUDIO);
     if (status != OK) {
         ALOGW("failed to start effect processing thread: %s", strerror(-status));
@@ -401,6 +461,39 @@ Return<Result> Effect::setProcessBuffers(const AudioBuffer& inBuffer,
     return Result::OK;
 }
 
+Result Effect::joinChain(const hidl_vec<uint8_t>& data) {
+    uint64_t headId;
+    if (data.size() != sizeof(headId)) {
+        ALOGE("Effect %p: invalid chain command data size %zu", mHandle, data.size());
+        return Result::INVALID_ARGUMENTS;
+    }
+    memcpy(&headId, &data[0], sizeof(headId));
+    std::lock_guard<std::mutex> lock(mJoinedChainLock);
+    leaveChainLocked();
+    if (headId == EffectMap::INVALID_ID) {
+        return Result::OK;
+    }
+    sp<EffectChain> chain = EffectChain::find(EffectMap::getInstance().get(headId));
+    if (chain != nullptr && !chain->isPlacedWith(*mChain)) {
+        ALOGE("Effect %p was not created for the same session and I/O handle as effect %" PRIu64,
+              mHandle, headId);
+        return Result::INVALID_ARGUMENTS;
+    }
+    if (chain == nullptr || !chain->add({mHandle, &mHalInBufferPtr, &mHalOutBufferPtr})) {
+        ALOGE("Effect %p could not join the chain of effect %" PRIu64, mHandle, headId);
+        return Result::INVALID_ARGUMENTS;
+    }
+    mJoinedChain = chain;
+    return Result::OK;
+}
+
+void Effect::leaveChainLocked() {
+    if (mJoinedChain != nullptr) {
+        mJoinedChain->remove(mHandle);
+        mJoinedChain.clear();
+    }
+}
+
 Result Effect::sendCommand(int commandCode, const char* commandName) {
     return sendCommand(commandCode, commandName, 0, NULL);
 }
@@ -472,10 +565,12 @@ Result Effect::setConfigImpl(int commandCode, const char* commandName, const Eff
 
 Result Effect::setParameterImpl(uint32_t paramSize, const void* paramData, uint32_t valueSize,
                                 const void* valueData) {
-    std::vector<uint8_t> halParamBuffer =
-        parameterToHal(paramSize, paramData, valueSize, &valueData);
-    return sendCommandReturningStatus(EFFECT_CMD_SET_PARAM, "SET_PARAM", halParamBuffer.size(),
-                                      &halParamBuffer[0]);
+    ScratchLease scratch(this);
+    uint32_t halParamBufferSize;
+    uint8_t* halParamBuffer = parameterToHal(paramSize, paramData, valueSize, &valueData,
+                                             &scratch, &halParamBufferSize);
+    return sendCommandReturningStatus(EFFECT_CMD_SET_PARAM, "SET_PARAM", halParamBufferSize,
+                                      halParamBuffer);
 }
 
 // Methods from ::android::hardware::audio::effect::CPP_VERSION::IEffect follow.
@@ -563,24 +658,27 @@ Return<Result> Effect::setInputDevice(const DeviceAddress& device) {
 
 Return<void> Effect::setAndGetVolume(const hidl_vec<uint32_t>& volumes,
                                      setAndGetVolume_cb _hidl_cb) {
+    ScratchLease dataScratch(this);
     uint32_t halDataSize;
-    std::unique_ptr<uint8_t[]> halData = hidlVecToHal(volumes, &halDataSize);
+    uint8_t* halData = hidlVecToHal(volumes, &dataScratch, &halDataSize);
+    ScratchLease resultScratch(this);
     uint32_t halResultSize = halDataSize;
-    std::vector<uint32_t> halResult(volumes.size(), 0);
+    uint32_t* halResult = reinterpret_cast<uint32_t*>(resultScratch.get(halResultSize));
     Result retval = sendCommandReturningData(EFFECT_CMD_SET_VOLUME, "SET_VOLUME", halDataSize,
-                                             &halData[0], &halResultSize, &halResult[0]);
+                                             halData, &halResultSize, halResult);
     hidl_vec<uint32_t> result;
     if (retval == Result::OK) {
-        result.setToExternal(&halResult[0], halResultSize);
+        result.setToExternal(halResult, halResultSize);
     }
     _hidl_cb(retval, result);
     return Void();
 }
 
 Return<Result> Effect::volumeChangeNotification(const hidl_vec<uint32_t>& volumes) {
+    ScratchLease scratch(this);
     uint32_t halDataSize;
-    std::unique_ptr<uint8_t[]> halData = hidlVecToHal(volumes, &halDataSize);
-    return sendCommand(EFFECT_CMD_SET_VOLUME, "SET_VOLUME", halDataSize, &halData[0]);
+    uint8_t* halData = hidlVecToHal(volumes, &scratch, &halDataSize);
+    return sendCommand(EFFECT_CMD_SET_VOLUME, "SET_VOLUME", halDataSize, halData);
 }
 
 Return<Result> Effect::setAudioMode(AudioMode mode) {
@@ -662,19 +760,24 @@ Return<void> Effect::getDescriptor(getDescriptor_cb _hidl_cb) {
 
 Return<void> Effect::command(uint32_t commandId, const hidl_vec<uint8_t>& data,
                              uint32_t resultMaxSize, command_cb _hidl_cb) {
+    if (commandId == EffectChain::kCommandJoin) {
+        _hidl_cb(joinChain(data) == Result::OK ? OK : -EINVAL, hidl_vec<uint8_t>());
+        return Void();
+    }
+    ScratchLease dataScratch(this);
     uint32_t halDataSize;
-    std::unique_ptr<uint8_t[]> halData = hidlVecToHal(data, &halDataSize);
+    uint8_t* halData = hidlVecToHal(data, &dataScratch, &halDataSize);
+    ScratchLease resultScratch(this);
     uint32_t halResultSize = resultMaxSize;
-    std::unique_ptr<uint8_t[]> halResult(new uint8_t[halResultSize]);
-    memset(&halResult[0], 0, halResultSize);
+    uint8_t* halResult = resultScratch.get(halResultSize);
 
-    void* dataPtr = halDataSize > 0 ? &halData[0] : NULL;
-    void* resultPtr = halResultSize > 0 ? &halResult[0] : NULL;
+    void* dataPtr = halDataSize > 0 ? halData : NULL;
+    void* resultPtr = halResultSize > 0 ? halResult : NULL;
     status_t status =
         (*mHandle)->command(mHandle, commandId, halDataSize, dataPtr, &halResultSize, resultPtr);
     hidl_vec<uint8_t> result;
     if (status == OK && resultPtr != NULL) {
-        result.setToExternal(&halResult[0], halResultSize);
+        result.setToExternal(halResult, halResultSize);
     }
     _hidl_cb(status, result);
     return Void();
@@ -687,14 +790,20 @@ Return<Result> Effect::setParameter(const hidl_vec<uint8_t>& parameter,
 
 Return<void> Effect::getParameter(const hidl_vec<uint8_t>& parameter, uint32_t valueMaxSize,
                                   getParameter_cb _hidl_cb) {
-    hidl_vec<uint8_t> value;
+    // The value is only valid during the callback, as its storage is reused by other calls.
+    bool replied = false;
     Result retval = getParameterImpl(
         parameter.size(), &parameter[0], valueMaxSize,
         [&](uint32_t valueSize, const void* valueData) {
+            hidl_vec<uint8_t> value;
             value.setToExternal(reinterpret_cast<uint8_t*>(const_cast<void*>(valueData)),
                                 valueSize);
+            _hidl_cb(Result::OK, value);
+            replied = true;
         });
-    _hidl_cb(retval, value);
+    if (!replied) {
+        _hidl_cb(retval, hidl_vec<uint8_t>());
+    }
     return Void();
 }
 
@@ -741,6 +850,12 @@ Return<Result> Effect::close() {
     if (mEfGroup) {
         mEfGroup->wake(static_cast<uint32_t>(MessageQueueFlagBits::REQUEST_QUIT));
     }
+    {
+        // The head may be processing this effect, which must finish before it gets released.
+        std::lock_guard<std::mutex> lock(mJoinedChainLock);
+        leaveChainLocked();
+    }
+    EffectChain::unregisterHead(mHandle);
 #if MAJOR_VERSION <= 5
     return Result::OK;
 #elif MAJOR_VERSION >= 6
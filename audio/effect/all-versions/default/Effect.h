@@ -20,9 +20,12 @@
 #include PATH(android/hardware/audio/effect/FILE_VERSION/IEffect.h)
 
 #include "AudioBufferManager.h"
+#include "EffectChain.h"
 
 #include <atomic>
+#include <cstddef>
 #include <memory>
+#include <mutex>
 #include <vector>
 
 #include <fmq/EventFlag.h>
@@ -184,6 +187,39 @@ struct Effect : public IEffect {
     using GetSupportedConfigsSuccessCallback =
         std::function<void(uint32_t supportedConfigs, void* configsData)>;
 
+    // Storage for marshalling the data of a command or its reply, kept by an effect across calls
+    // so that parameter polling does not allocate. Sizes up to kInlineSize, which fits an
+    // effect_param_t with the fixed-size parameters and values of the common effects, need no
+    // heap storage at all.
+    class ScratchBuffer {
+      public:
+        static constexpr size_t kInlineSize = 64;
+        // Larger heap storage is freed when the buffer is returned to the effect.
+        static constexpr size_t kMaxRetainedSize = 4096;
+
+        // Returns zero-filled storage for 'size' bytes, valid until the next call.
+        uint8_t* get(size_t size);
+        void trim();
+
+      private:
+        alignas(std::max_align_t) uint8_t mInline[kInlineSize];
+        std::unique_ptr<uint8_t[]> mHeap;
+        size_t mHeapSize = 0;
+    };
+
+    // Lends a ScratchBuffer of the effect for the duration of a call. Concurrent calls, and the
+    // calls made from the callbacks of another, get different buffers.
+    class ScratchLease {
+      public:
+        explicit ScratchLease(Effect* effect);
+        ~ScratchLease();
+        uint8_t* get(size_t size) { return mBuffer->get(size); }
+
+      private:
+        Effect* const mEffect;
+        std::unique_ptr<ScratchBuffer> mBuffer;
+    };
+
     static const char* sContextResultOfCommand;
     static const char* sContextCallToCommand;
     static const char* sContextCallFunction;
@@ -198,21 +234,29 @@ struct Effect : public IEffect {
     EventFlag* mEfGroup;
     std::atomic<bool> mStopProcessThread;
     sp<Thread> mProcessThread;
+    // The chain processed after this effect, and the chain this effect has joined, if any.
+    const sp<EffectChain> mChain;
+    std::mutex mJoinedChainLock;
+    sp<EffectChain> mJoinedChain;
+    std::mutex mScratchLock;
+    std::vector<std::unique_ptr<ScratchBuffer>> mFreeScratchBuffers;
 
     virtual ~Effect();
 
     template <typename T>
     static size_t alignedSizeIn(size_t s);
     template <typename T>
-    std::unique_ptr<uint8_t[]> hidlVecToHal(const hidl_vec<T>& vec, uint32_t* halDataSize);
+    static uint8_t* hidlVecToHal(const hidl_vec<T>& vec, ScratchLease* scratch,
+                                 uint32_t* halDataSize);
     void effectAuxChannelsConfigFromHal(const channel_config_t& halConfig,
                                         EffectAuxChannelsConfig* config);
     static void effectAuxChannelsConfigToHal(const EffectAuxChannelsConfig& config,
                                              channel_config_t* halConfig);
     static void effectOffloadParamToHal(const EffectOffloadParameter& offload,
                                         effect_offload_param_t* halOffload);
-    static std::vector<uint8_t> parameterToHal(uint32_t paramSize, const void* paramData,
-                                               uint32_t valueSize, const void** valueData);
+    static uint8_t* parameterToHal(uint32_t paramSize, const void* paramData, uint32_t valueSize,
+                                   const void** valueData, ScratchLease* scratch,
+                                   uint32_t* halParamBufferSize);
 
     Result analyzeCommandStatus(const char* commandName, const char* context, status_t status);
     void getConfigImpl(int commandCode, const char* commandName, GetConfigCallback cb);
@@ -220,6 +264,8 @@ struct Effect : public IEffect {
                                 GetCurrentConfigSuccessCallback onSuccess);
     Result getSupportedConfigsImpl(uint32_t featureId, uint32_t maxConfigs, uint32_t configSize,
                                    GetSupportedConfigsSuccessCallback onSuccess);
+    Result joinChain(const hidl_vec<uint8_t>& data);
+    void leaveChainLocked();
     Result sendCommand(int commandCode, const char* commandName);
     Result sendCommand(int commandCode, const char* commandName, uint32_t size, void* data);
     Result sendCommandReturningData(int commandCode, const char* commandName, uint32_t* replySize,
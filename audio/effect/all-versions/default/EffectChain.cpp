@@ -0,0 +1,157 @@
+/*
+ * Copyright (C) 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "EffectChainHAL"
+
+#include "EffectChain.h"
+
+#include <algorithm>
+#include <thread>
+
+#include <android/log.h>
+#include <utils/KeyedVector.h>
+
+namespace android {
+namespace hardware {
+namespace audio {
+namespace effect {
+namespace CPP_VERSION {
+namespace implementation {
+
+namespace {
+
+std::mutex gHeadsLock;
+
+KeyedVector<effect_handle_t, wp<EffectChain>>& heads() {
+    static KeyedVector<effect_handle_t, wp<EffectChain>> sHeads;
+    return sHeads;
+}
+
+}  // namespace
+
+// static
+sp<EffectChain> EffectChain::create(effect_handle_t head) {
+    sp<EffectChain> chain = new EffectChain(head);
+    std::lock_guard<std::mutex> lock(gHeadsLock);
+    heads().replaceValueFor(head, chain);
+    return chain;
+}
+
+// static
+sp<EffectChain> EffectChain::find(effect_handle_t head) {
+    std::lock_guard<std::mutex> lock(gHeadsLock);
+    ssize_t idx = heads().indexOfKey(head);
+    return idx >= 0 ? heads().valueAt(idx).promote() : nullptr;
+}
+
+// static
+void EffectChain::unregisterHead(effect_handle_t head) {
+    std::lock_guard<std::mutex> lock(gHeadsLock);
+    heads().removeItem(head);
+}
+
+EffectChain::EffectChain(effect_handle_t head)
+    : mHead(head),
+      mSession(AUDIO_SESSION_NONE),
+      mIoHandle(AUDIO_IO_HANDLE_NONE),
+      mDevice(AUDIO_PORT_HANDLE_NONE),
+      mLength(0),
+      mActive(0),
+      mPassesInProgress(0) {
+    // Adding a member never allocates.
+    mMembers[0].reserve(kMaxLength);
+    mMembers[1].reserve(kMaxLength);
+}
+
+void EffectChain::setPlacement(int32_t session, int32_t ioHandle, int32_t device) {
+    mSession.store(session);
+    mIoHandle.store(ioHandle);
+    mDevice.store(device);
+}
+
+bool EffectChain::isPlacedWith(const EffectChain& other) const {
+    return mSession.load() == other.mSession.load() && mIoHandle.load() == other.mIoHandle.load() &&
+           mDevice.load() == other.mDevice.load();
+}
+
+bool EffectChain::add(const Member& member) {
+    std::lock_guard<std::mutex> lock(mLock);
+    const int active = mActive.load();
+    if (member.handle == mHead || mMembers[active].size() == kMaxLength) {
+        return false;
+    }
+    mMembers[1 - active] = mMembers[active];
+    mMembers[1 - active].push_back(member);
+    publishLocked();
+    return true;
+}
+
+void EffectChain::remove(effect_handle_t handle) {
+    std::lock_guard<std::mutex> lock(mLock);
+    const int active = mActive.load();
+    std::vector<Member>& members = mMembers[1 - active];
+    members = mMembers[active];
+    members.erase(std::remove_if(members.begin(), members.end(),
+                                 [&](const Member& member) { return member.handle == handle; }),
+                  members.end());
+    publishLocked();
+}
+
+void EffectChain::publishLocked() {
+    const int active = 1 - mActive.load();
+    mLength.store(mMembers[active].size());
+    mActive.store(active);
+    // A pass that starts from now on reads the new copy.
+    while (mPassesInProgress.load() != 0) {
+        std::this_thread::yield();
+    }
+}
+
+int32_t EffectChain::process(bool reverse) {
+    if (mLength.load(std::memory_order_relaxed) == 0) {
+        return 0;
+    }
+    mPassesInProgress.fetch_add(1);
+    int32_t result = 0;
+    for (const Member& member : mMembers[mActive.load()]) {
+        audio_buffer_t* inBuffer = member.inBuffer->load(std::memory_order_relaxed);
+        audio_buffer_t* outBuffer = member.outBuffer->load(std::memory_order_relaxed);
+        const effect_handle_t effect = member.handle;
+        int32_t processResult;
+        if (inBuffer == nullptr || outBuffer == nullptr) {
+            ALOGE("processing buffers of chained effect %p were not set", effect);
+            processResult = -ENODEV;
+        } else if (!reverse) {
+            processResult = (*effect)->process(effect, inBuffer, outBuffer);
+        } else if ((*effect)->process_reverse != NULL) {
+            processResult = (*effect)->process_reverse(effect, inBuffer, outBuffer);
+        } else {
+            processResult = -ENOSYS;
+        }
+        if (result == 0) {
+            result = processResult;
+        }
+    }
+    mPassesInProgress.fetch_sub(1, std::memory_order_release);
+    return result;
+}
+
+}  // namespace implementation
+}  // namespace CPP_VERSION
+}  // namespace effect
+}  // namespace audio
+}  // namespace hardware
+}  // namespace android
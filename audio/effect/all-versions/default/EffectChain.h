@@ -0,0 +1,117 @@
+/*
+ * Copyright (C) 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_HARDWARE_AUDIO_EFFECT_EFFECT_CHAIN_H_
+#define ANDROID_HARDWARE_AUDIO_EFFECT_EFFECT_CHAIN_H_
+
+#include <atomic>
+#include <mutex>
+#include <vector>
+
+#include <hardware/audio_effect.h>
+#include <utils/RefBase.h>
+
+namespace android {
+namespace hardware {
+namespace audio {
+namespace effect {
+namespace CPP_VERSION {
+namespace implementation {
+
+// Effects processed one after another on the processing thread of the effect heading the chain.
+//
+// Every effect heads its own chain, which is empty until other effects join it. An effect joins
+// the chain of another effect when the client sends it the kCommandJoin command. From then on the
+// client only requests processing from the head effect, which processes its own buffers and then
+// the buffers of every member in the order they joined, so a chain of N effects costs one thread
+// wakeup per buffer instead of N. The client links the effects by passing the output buffer of an
+// effect as the input buffer of the next one; AudioBufferManager maps such a shared buffer once.
+//
+// Chains do not nest: the members of an effect that joins a chain are not processed by the head.
+class EffectChain : public RefBase {
+  public:
+    // What the processing thread of the head needs to process a member.
+    struct Member {
+        effect_handle_t handle;
+        std::atomic<audio_buffer_t*>* inBuffer;
+        std::atomic<audio_buffer_t*>* outBuffer;
+    };
+
+    // Command handled by the effect HAL rather than passed to the effect library. Its data is the
+    // uint64_t id of the head effect, as returned by IEffectsFactory::createEffect, or
+    // EffectMap::INVALID_ID to leave the chain. IEffect has no method for it since the interface
+    // is frozen, so it uses the last code below EFFECT_CMD_FIRST_PROPRIETARY (0x10000). That code
+    // is in the standard range but cannot collide in practice: effect libraries only define
+    // commands from EFFECT_CMD_FIRST_PROPRIETARY on, and the standard commands are numbered up
+    // from 0, with a new one only ever appended after the last of the few dozen defined.
+    static constexpr uint32_t kCommandJoin = EFFECT_CMD_FIRST_PROPRIETARY - 1;
+    static constexpr size_t kMaxLength = 8;
+
+    // Creates the chain headed by the effect and makes it findable from the handle of the effect.
+    static sp<EffectChain> create(effect_handle_t head);
+    // Returns nullptr if the effect does not head a chain.
+    static sp<EffectChain> find(effect_handle_t head);
+    // Called when the head effect closes. Its members stay in the chain until they leave it.
+    static void unregisterHead(effect_handle_t head);
+
+    // Records what the head effect was created for. Effects are only chained with effects created
+    // for the same session, I/O handle and device, see isPlacedWith.
+    void setPlacement(int32_t session, int32_t ioHandle, int32_t device);
+    // Returns true if the heads of both chains were created for the same session, I/O handle and
+    // device.
+    bool isPlacedWith(const EffectChain& other) const;
+
+    // Returns false if the chain is full or the member is its head.
+    bool add(const Member& member);
+    void remove(effect_handle_t handle);
+
+    // Processes the members, called by the processing thread of the head after processing the
+    // head. Every member is processed even if a previous one fails. Returns 0 or the first error.
+    int32_t process(bool reverse);
+
+  private:
+    explicit EffectChain(effect_handle_t head);
+
+    // Makes the other copy of the members the one processed, then waits until no pass uses the
+    // previous one.
+    void publishLocked();
+
+    const effect_handle_t mHead;
+    // Set by the effects factory before the head effect is handed to the client.
+    std::atomic<int32_t> mSession;
+    std::atomic<int32_t> mIoHandle;
+    std::atomic<int32_t> mDevice;
+    // Lets the processing thread skip the chain while it is empty.
+    std::atomic<size_t> mLength;
+    // Two copies of the members. The processing thread only reads mMembers[mActive], without
+    // locking. Adding or removing a member updates the other copy and then publishes it, so
+    // removing a member waits for the pass in progress, after which the effect library of the
+    // member may be released.
+    std::vector<Member> mMembers[2];
+    std::atomic<int> mActive;
+    std::atomic<int> mPassesInProgress;
+    // Serializes adding and removing members. Never taken by the processing thread.
+    std::mutex mLock;
+};
+
+}  // namespace implementation
+}  // namespace CPP_VERSION
+}  // namespace effect
+}  // namespace audio
+}  // namespace hardware
+}  // namespace android
+
+#endif  // ANDROID_HARDWARE_AUDIO_EFFECT_EFFECT_CHAIN_H_
@@ -189,6 +189,11 @@ Return<void> EffectsFactory::createEffectImpl(const Uuid& uuid, int32_t session,
         status = (*handle)->get_descriptor(handle, &halDescriptor);
         if (status == OK) {
             effect = dispatchEffectInstanceCreation(halDescriptor, handle);
+            // Done before the effect can be found from its id, so that every effect a chain
+            // command could name has its placement set.
+            if (sp<EffectChain> chain = EffectChain::find(handle); chain != nullptr) {
+                chain->setPlacement(session, ioHandle, device);
+            }
             effectId = EffectMap::getInstance().add(handle);
         } else {
             ALOGE("Error querying effect descriptor for %s: %s",
@@ -0,0 +1,270 @@
+/*
+ * Copyright (C) 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Benchmarks for the effect HAL wrapper around an effect library that does no work of its own:
+// - the per-buffer latency of a chain of effects, either processed by waking the processing
+//   thread of every effect in turn, as clients do without an EffectChain, or by waking the
+//   processing thread of the head of an EffectChain only;
+// - the round trip of the setParameter and getParameter calls that effect UIs poll.
+
+#define LOG_TAG "EffectBenchmark"
+
+#include "Effect.h"
+#include "common/all-versions/default/EffectMap.h"
+
+#include <algorithm>
+#include <array>
+#include <memory>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+#include <cutils/ashmem.h>
+#include <cutils/native_handle.h>
+
+namespace android {
+namespace hardware {
+namespace audio {
+namespace effect {
+namespace CPP_VERSION {
+namespace implementation {
+namespace {
+
+using ::benchmark::State;
+
+// 5 ms of 16 bit stereo audio at 48 kHz.
+constexpr uint32_t kFrameCount = 240;
+constexpr size_t kFrameSize = 2 * sizeof(int16_t);
+constexpr size_t kBufferSize = kFrameCount * kFrameSize;
+
+constexpr size_t kMaxValueSize = 256;
+
+// Stands in for an effect library by copying its input to its output, and by storing the value of
+// a single parameter.
+struct FakeEffect {
+    effect_interface_s* itfe;
+    uint8_t value[kMaxValueSize];
+};
+
+int32_t copyProcess(effect_handle_t /*self*/, audio_buffer_t* inBuffer,
+                    audio_buffer_t* outBuffer) {
+    memcpy(outBuffer->raw, inBuffer->raw, inBuffer->frameCount * kFrameSize);
+    return 0;
+}
+
+int32_t parameterCommand(effect_handle_t self, uint32_t cmdCode, uint32_t cmdSize, void* pCmdData,
+                         uint32_t* replySize, void* pReplyData) {
+    FakeEffect* effect = reinterpret_cast<FakeEffect*>(self);
+    if ((cmdCode != EFFECT_CMD_SET_PARAM && cmdCode != EFFECT_CMD_GET_PARAM) ||
+        cmdSize < sizeof(effect_param_t) || replySize == nullptr || pReplyData == nullptr) {
+        return -ENOSYS;
+    }
+    const effect_param_t* cmdParam = static_cast<const effect_param_t*>(pCmdData);
+    const size_t valueOffset = (cmdParam->psize + sizeof(int32_t) - 1) & ~(sizeof(int32_t) - 1);
+    const size_t valueSize = std::min<size_t>(cmdParam->vsize, kMaxValueSize);
+    if (cmdCode == EFFECT_CMD_SET_PARAM) {
+        memcpy(effect->value, cmdParam->data + valueOffset, valueSize);
+        *static_cast<int32_t*>(pReplyData) = 0;
+        return 0;
+    }
+    effect_param_t* replyParam = static_cast<effect_param_t*>(pReplyData);
+    memcpy(replyParam, cmdParam, sizeof(effect_param_t) + cmdParam->psize);
+    memcpy(replyParam->data + valueOffset, effect->value, valueSize);
+    replyParam->status = 0;
+    replyParam->vsize = valueSize;
+    *replySize = sizeof(effect_param_t) + valueOffset + valueSize;
+    return 0;
+}
+
+int32_t unsupportedGetDescriptor(effect_handle_t /*self*/, effect_descriptor_t* /*pDescriptor*/) {
+    return -ENOSYS;
+}
+
+effect_interface_s gFakeEffectInterface = {copyProcess, parameterCommand,
+                                           unsupportedGetDescriptor, nullptr};
+
+bool makeBuffer(uint64_t id, AudioBuffer* buffer) {
+    int fd = ashmem_create_region("EffectBenchmark", kBufferSize);
+    if (fd < 0) {
+        return false;
+    }
+    native_handle_t* handle = native_handle_create(1 /*numFds*/, 0 /*numInts*/);
+    handle->data[0] = fd;
+    hidl_handle hidlHandle;
+    hidlHandle.setTo(handle, true /*shouldOwn*/);
+    buffer->id = id;
+    buffer->frameCount = kFrameCount;
+    buffer->data = hidl_memory("ashmem", std::move(hidlHandle), kBufferSize);
+    return true;
+}
+
+// The client side of an effect, as held by the audio framework.
+struct EffectClient {
+    sp<Effect> effect;
+    std::unique_ptr<Effect::StatusMQ> statusMQ;
+    EventFlag* efGroup = nullptr;
+
+    ~EffectClient() {
+        if (efGroup != nullptr) {
+            EventFlag::deleteEventFlag(&efGroup);
+        }
+        if (effect != nullptr) {
+            // The effect library is unknown to libeffects, which only logs a warning when
+            // releasing it.
+            (void)effect->close();
+        }
+    }
+
+    bool init(effect_handle_t handle, const AudioBuffer& inBuffer, const AudioBuffer& outBuffer) {
+        effect = new Effect(false /*isInput*/, handle);
+        Result retval = Result::NOT_INITIALIZED;
+        effect->prepareForProcessing(
+                [&](Result r, const Effect::StatusMQ::Descriptor& statusMQDesc) {
+                    retval = r;
+                    if (retval == Result::OK) {
+                        statusMQ = std::make_unique<Effect::StatusMQ>(statusMQDesc);
+                    }
+                });
+        return retval == Result::OK && statusMQ->isValid() &&
+               EventFlag::createEventFlag(statusMQ->getEventFlagWord(), &efGroup) == OK &&
+               effect->setProcessBuffers(inBuffer, outBuffer) == Result::OK;
+    }
+
+    bool joinChain(uint64_t headId) {
+        hidl_vec<uint8_t> data(sizeof(headId));
+        memcpy(&data[0], &headId, sizeof(headId));
+        int32_t status = -ENODEV;
+        effect->command(EffectChain::kCommandJoin, data, 0 /*resultMaxSize*/,
+                        [&](int32_t s, const hidl_vec<uint8_t>& /*result*/) { status = s; });
+        return status == OK;
+    }
+
+    // Requests the processing of a buffer and waits for its status.
+    bool process() {
+        efGroup->wake(static_cast<uint32_t>(MessageQueueFlagBits::REQUEST_PROCESS));
+        uint32_t efState = 0;
+        while (!(efState & static_cast<uint32_t>(MessageQueueFlagBits::DONE_PROCESSING))) {
+            efGroup->wait(static_cast<uint32_t>(MessageQueueFlagBits::DONE_PROCESSING), &efState);
+        }
+        Result retval = Result::NOT_INITIALIZED;
+        return statusMQ->read(&retval) && retval == Result::OK;
+    }
+};
+
+// Processes a buffer through 'state.range(0)' effects, joined in the EffectChain of the first one
+// if 'state.range(1)' is non-zero. Every effect outputs to the input buffer of the next one.
+void BM_ProcessEffects(State& state) {
+    const size_t effectCount = state.range(0);
+    const bool chained = state.range(1) != 0;
+
+    std::array<FakeEffect, EffectChain::kMaxLength> fakeEffects;
+    for (FakeEffect& fakeEffect : fakeEffects) {
+        fakeEffect.itfe = &gFakeEffectInterface;
+    }
+    std::vector<AudioBuffer> buffers(effectCount + 1);
+    for (size_t i = 0; i < buffers.size(); ++i) {
+        if (!makeBuffer(i + 1, &buffers[i])) {
+            state.SkipWithError("failed to create the audio buffers");
+            return;
+        }
+    }
+    std::array<EffectClient, EffectChain::kMaxLength> clients;
+    for (size_t i = 0; i < effectCount; ++i) {
+        if (!clients[i].init(&fakeEffects[i].itfe, buffers[i], buffers[i + 1])) {
+            state.SkipWithError("failed to prepare the effects for processing");
+            return;
+        }
+    }
+    if (chained) {
+        const uint64_t headId = EffectMap::getInstance().add(&fakeEffects[0].itfe);
+        for (size_t i = 1; i < effectCount; ++i) {
+            if (!clients[i].joinChain(headId)) {
+                state.SkipWithError("failed to join the effect chain");
+                return;
+            }
+        }
+    }
+
+    const size_t wakeupCount = chained ? 1 : effectCount;
+    for (auto _ : state) {
+        for (size_t i = 0; i < wakeupCount; ++i) {
+            if (!clients[i].process()) {
+                state.SkipWithError("failed to process a buffer");
+                return;
+            }
+        }
+    }
+    state.counters["wakeups_per_buffer"] = wakeupCount;
+}
+
+BENCHMARK(BM_ProcessEffects)
+        ->ArgsProduct({{1, 2, 4, 8}, {0, 1}})
+        ->ArgNames({"effects", "chained"})
+        ->UseRealTime();
+
+// Sets a 'state.range(0)' byte value of a parameter identified by a uint32_t.
+void BM_SetParameter(State& state) {
+    FakeEffect fakeEffect = {.itfe = &gFakeEffectInterface};
+    sp<Effect> effect = new Effect(false /*isInput*/, &fakeEffect.itfe);
+    const uint32_t paramId = 1;
+    hidl_vec<uint8_t> parameter(sizeof(paramId));
+    memcpy(&parameter[0], &paramId, sizeof(paramId));
+    const hidl_vec<uint8_t> value(state.range(0));
+
+    for (auto _ : state) {
+        if (effect->setParameter(parameter, value) != Result::OK) {
+            state.SkipWithError("failed to set the parameter");
+            break;
+        }
+    }
+    (void)effect->close();
+}
+
+// Gets a 'state.range(0)' byte value of a parameter identified by a uint32_t.
+void BM_GetParameter(State& state) {
+    FakeEffect fakeEffect = {.itfe = &gFakeEffectInterface};
+    sp<Effect> effect = new Effect(false /*isInput*/, &fakeEffect.itfe);
+    const uint32_t paramId = 1;
+    hidl_vec<uint8_t> parameter(sizeof(paramId));
+    memcpy(&parameter[0], &paramId, sizeof(paramId));
+    const uint32_t valueSize = state.range(0);
+
+    for (auto _ : state) {
+        Result retval = Result::NOT_INITIALIZED;
+        effect->getParameter(parameter, valueSize,
+                             [&](Result r, const hidl_vec<uint8_t>& value) {
+                                 retval = r;
+                                 ::benchmark::DoNotOptimize(value.data());
+                             });
+        if (retval != Result::OK) {
+            state.SkipWithError("failed to get the parameter");
+            break;
+        }
+    }
+    (void)effect->close();
+}
+
+BENCHMARK(BM_SetParameter)->Arg(sizeof(int32_t))->Arg(kMaxValueSize);
+BENCHMARK(BM_GetParameter)->Arg(sizeof(int32_t))->Arg(kMaxValueSize);
+
+}  // namespace
+}  // namespace implementation
+}  // namespace CPP_VERSION
+}  // namespace effect
+}  // namespace audio
+}  // namespace hardware
+}  // namespace android
+
+BENCHMARK_MAIN();
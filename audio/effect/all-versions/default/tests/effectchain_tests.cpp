@@ -0,0 +1,162 @@
+/*
+ * Copyright (C) 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#define LOG_TAG "EffectChain_Test"
+#include <log/log.h>
+
+#include "EffectChain.h"
+
+using ::android::sp;
+using ::android::hardware::audio::effect::CPP_VERSION::implementation::EffectChain;
+
+namespace {
+
+std::vector<effect_handle_t> gProcessed;
+std::atomic<bool> gBlockProcessing{false};
+std::atomic<bool> gProcessing{false};
+
+int32_t recordProcess(effect_handle_t self, audio_buffer_t*, audio_buffer_t*) {
+    gProcessing = true;
+    while (gBlockProcessing) {
+        std::this_thread::yield();
+    }
+    gProcessed.push_back(self);
+    gProcessing = false;
+    return 0;
+}
+
+// An effect library effect that records when it is processed. It has no process_reverse.
+struct FakeEffect {
+    FakeEffect() {
+        interface.process = recordProcess;
+        itfe = &interface;
+        inBuffer = &buffer;
+        outBuffer = &buffer;
+    }
+
+    effect_handle_t handle() { return &itfe; }
+    EffectChain::Member member() { return {handle(), &inBuffer, &outBuffer}; }
+
+    effect_interface_s interface = {};
+    effect_interface_s* itfe;
+    audio_buffer_t buffer = {};
+    std::atomic<audio_buffer_t*> inBuffer;
+    std::atomic<audio_buffer_t*> outBuffer;
+};
+
+class EffectChainTest : public ::testing::Test {
+  protected:
+    void SetUp() override {
+        gProcessed.clear();
+        mChain = EffectChain::create(mHead.handle());
+    }
+
+    void TearDown() override { EffectChain::unregisterHead(mHead.handle()); }
+
+    FakeEffect mHead;
+    FakeEffect mFirst;
+    FakeEffect mSecond;
+    sp<EffectChain> mChain;
+};
+
+}  // namespace
+
+TEST_F(EffectChainTest, MembersAreProcessedInJoinOrder) {
+    ASSERT_TRUE(mChain->add(mSecond.member()));
+    ASSERT_TRUE(mChain->add(mFirst.member()));
+
+    EXPECT_EQ(0, mChain->process(false /*reverse*/));
+    EXPECT_EQ((std::vector<effect_handle_t>{mSecond.handle(), mFirst.handle()}), gProcessed);
+}
+
+TEST_F(EffectChainTest, HeadCannotJoinItsOwnChain) {
+    EXPECT_FALSE(mChain->add(mHead.member()));
+}
+
+TEST_F(EffectChainTest, ChainIsFoundFromItsHeadUntilUnregistered) {
+    EXPECT_EQ(mChain, EffectChain::find(mHead.handle()));
+    EXPECT_EQ(nullptr, EffectChain::find(mFirst.handle()));
+
+    EffectChain::unregisterHead(mHead.handle());
+    EXPECT_EQ(nullptr, EffectChain::find(mHead.handle()));
+}
+
+TEST_F(EffectChainTest, OnlyChainsWithSamePlacementArePlacedTogether) {
+    sp<EffectChain> sameChain = EffectChain::create(mFirst.handle());
+    sp<EffectChain> otherSessionChain = EffectChain::create(mSecond.handle());
+    mChain->setPlacement(1 /*session*/, 2 /*ioHandle*/, AUDIO_PORT_HANDLE_NONE);
+    sameChain->setPlacement(1 /*session*/, 2 /*ioHandle*/, AUDIO_PORT_HANDLE_NONE);
+    otherSessionChain->setPlacement(3 /*session*/, 2 /*ioHandle*/, AUDIO_PORT_HANDLE_NONE);
+
+    EXPECT_TRUE(mChain->isPlacedWith(*sameChain));
+    EXPECT_FALSE(mChain->isPlacedWith(*otherSessionChain));
+
+    otherSessionChain->setPlacement(1 /*session*/, 4 /*ioHandle*/, AUDIO_PORT_HANDLE_NONE);
+    EXPECT_FALSE(mChain->isPlacedWith(*otherSessionChain));
+
+    EffectChain::unregisterHead(mFirst.handle());
+    EffectChain::unregisterHead(mSecond.handle());
+}
+
+TEST_F(EffectChainTest, ReverseProcessingFailsWithoutProcessReverse) {
+    ASSERT_TRUE(mChain->add(mFirst.member()));
+
+    EXPECT_EQ(-ENOSYS, mChain->process(true /*reverse*/));
+    EXPECT_TRUE(gProcessed.empty());
+}
+
+TEST_F(EffectChainTest, RemovedMemberIsNoLongerProcessed) {
+    ASSERT_TRUE(mChain->add(mFirst.member()));
+    ASSERT_TRUE(mChain->add(mSecond.member()));
+
+    mChain->remove(mFirst.handle());
+    EXPECT_EQ(0, mChain->process(false /*reverse*/));
+    EXPECT_EQ(std::vector<effect_handle_t>{mSecond.handle()}, gProcessed);
+}
+
+TEST_F(EffectChainTest, RemoveWaitsForPassInProgress) {
+    ASSERT_TRUE(mChain->add(mFirst.member()));
+    gBlockProcessing = true;
+    std::thread processThread([this] { mChain->process(false /*reverse*/); });
+    while (!gProcessing) {
+        std::this_thread::yield();
+    }
+
+    std::atomic<bool> removed{false};
+    std::thread removeThread([&] {
+        mChain->remove(mFirst.handle());
+        removed = true;
+    });
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    EXPECT_FALSE(removed);
+
+    gBlockProcessing = false;
+    processThread.join();
+    removeThread.join();
+    EXPECT_TRUE(removed);
+    EXPECT_EQ(std::vector<effect_handle_t>{mFirst.handle()}, gProcessed);
+
+    gProcessed.clear();
+    EXPECT_EQ(0, mChain->process(false /*reverse*/));
+    EXPECT_TRUE(gProcessed.empty());
+}
@@ -0,0 +1,191 @@
+/*
+ * Copyright (C) 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <ConcurrentQueue.h>
+#include <benchmark/benchmark.h>
+#include <utils/SystemClock.h>
+
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <vector>
+
+namespace android {
+namespace hardware {
+namespace automotive {
+namespace vehicle {
+
+namespace {
+
+using ::benchmark::Counter;
+using ::benchmark::State;
+
+constexpr size_t QUEUE_CAPACITY = 4096;
+constexpr size_t BATCH_SIZE = 16;
+
+// Adapts ConcurrentQueue to the BoundedMpscQueue interface so that the same benchmark body could
+// be used for both.
+template <typename T>
+class UnboundedQueue {
+  public:
+    explicit UnboundedQueue(size_t) {}
+
+    bool waitForItems() { return mQueue.waitForItems(); }
+    std::vector<T> flush() { return mQueue.flush(); }
+    void deactivate() { mQueue.deactivate(); }
+
+    bool push(T&& item) {
+        mQueue.push(std::move(item));
+        return true;
+    }
+
+    size_t push(std::vector<T>&& items) {
+        for (T& item : items) {
+            mQueue.push(std::move(item));
+        }
+        return items.size();
+    }
+
+  private:
+    ConcurrentQueue<T> mQueue;
+};
+
+// Runs a consumer thread that drains the queue until it is deactivated, records the time between
+// an item being pushed (the item value) and it being flushed.
+template <class Queue>
+class Consumer {
+  public:
+    explicit Consumer(Queue* queue) : mQueue(queue) {
+        mThread = std::thread([this] {
+            while (mQueue->waitForItems()) {
+                drain();
+            }
+            drain();
+        });
+    }
+
+    ~Consumer() { stop(); }
+
+    // Deactivates the queue and waits until the remaining items are drained.
+    void stop() {
+        mQueue->deactivate();
+        if (mThread.joinable()) {
+            mThread.join();
+        }
+    }
+
+    int64_t getConsumedCount() { return mConsumedCount.load(); }
+    int64_t getTotalLatencyInNano() { return mTotalLatencyInNano.load(); }
+
+  private:
+    Queue* mQueue;
+    std::thread mThread;
+    std::atomic<int64_t> mConsumedCount = 0;
+    std::atomic<int64_t> mTotalLatencyInNano = 0;
+
+    void drain() {
+        std::vector<int64_t> items = mQueue->flush();
+        int64_t now = elapsedRealtimeNano();
+        int64_t totalLatency = 0;
+        for (int64_t pushTime : items) {
+            totalLatency += now - pushTime;
+        }
+        mConsumedCount += items.size();
+        mTotalLatencyInNano += totalLatency;
+    }
+};
+
+// Each benchmark thread is a producer, all of them sharing one queue and one consumer.
+template <class Queue>
+class ContendedQueueFixture {
+  public:
+    static void setUp(const State& state) {
+        if (state.thread_index() == 0) {
+            sQueue = std::make_unique<Queue>(QUEUE_CAPACITY);
+            sConsumer = std::make_unique<Consumer<Queue>>(sQueue.get());
+        }
+    }
+
+    static void tearDown(State& state) {
+        if (state.thread_index() == 0) {
+            sConsumer->stop();
+            int64_t consumed = sConsumer->getConsumedCount();
+            int64_t latency = sConsumer->getTotalLatencyInNano();
+            sConsumer.reset();
+            state.counters["avg_wakeup_latency_ns"] =
+                    consumed == 0 ? 0 : static_cast<double>(latency) / consumed;
+            sQueue.reset();
+        }
+    }
+
+    static std::unique_ptr<Queue> sQueue;
+    static std::unique_ptr<Consumer<Queue>> sConsumer;
+};
+
+template <class Queue>
+std::unique_ptr<Queue> ContendedQueueFixture<Queue>::sQueue;
+template <class Queue>
+std::unique_ptr<Consumer<Queue>> ContendedQueueFixture<Queue>::sConsumer;
+
+template <class Queue>
+void BM_Push(State& state) {
+    using Fixture = ContendedQueueFixture<Queue>;
+    Fixture::setUp(state);
+    int64_t retries = 0;
+    for (auto _ : state) {
+        while (!Fixture::sQueue->push(elapsedRealtimeNano())) {
+            // Queue is full, wait for the consumer to catch up.
+            retries++;
+            std::this_thread::yield();
+        }
+    }
+    state.counters["items_per_second"] =
+            Counter(state.iterations(), Counter::kIsRate | Counter::kAvgThreads);
+    state.counters["full_retries"] = Counter(retries, Counter::kAvgThreads);
+    Fixture::tearDown(state);
+}
+
+template <class Queue>
+void BM_BatchPush(State& state) {
+    using Fixture = ContendedQueueFixture<Queue>;
+    Fixture::setUp(state);
+    int64_t retries = 0;
+    for (auto _ : state) {
+        std::vector<int64_t> batch(BATCH_SIZE, elapsedRealtimeNano());
+        size_t pushed = Fixture::sQueue->push(std::move(batch));
+        while (pushed < BATCH_SIZE) {
+            retries++;
+            std::this_thread::yield();
+            pushed += Fixture::sQueue->push(elapsedRealtimeNano()) ? 1 : 0;
+        }
+    }
+    state.counters["items_per_second"] =
+            Counter(state.iterations() * BATCH_SIZE, Counter::kIsRate | Counter::kAvgThreads);
+    state.counters["full_retries"] = Counter(retries, Counter::kAvgThreads);
+    Fixture::tearDown(state);
+}
+
+BENCHMARK_TEMPLATE(BM_Push, UnboundedQueue<int64_t>)->ThreadRange(1, 8)->UseRealTime();
+BENCHMARK_TEMPLATE(BM_Push, BoundedMpscQueue<int64_t>)->ThreadRange(1, 8)->UseRealTime();
+BENCHMARK_TEMPLATE(BM_BatchPush, UnboundedQueue<int64_t>)->ThreadRange(1, 8)->UseRealTime();
+BENCHMARK_TEMPLATE(BM_BatchPush, BoundedMpscQueue<int64_t>)->ThreadRange(1, 8)->UseRealTime();
+
+}  // namespace
+
+}  // namespace vehicle
+}  // namespace automotive
+}  // namespace hardware
+}  // namespace android
@@ -0,0 +1,126 @@
+/*
+ * Copyright (C) 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <RecurrentTimer.h>
+#include <benchmark/benchmark.h>
+#include <utils/SystemClock.h>
+
+#include <time.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <thread>
+#include <vector>
+
+namespace android {
+namespace hardware {
+namespace automotive {
+namespace vehicle {
+
+namespace {
+
+using ::benchmark::Counter;
+using ::benchmark::State;
+
+// Intervals for common continuous property sample rates: 100Hz, 50Hz, 20Hz, 10Hz, 1Hz.
+constexpr int64_t INTERVALS_IN_NANO[] = {10'000'000, 20'000'000, 50'000'000, 100'000'000,
+                                         1'000'000'000};
+constexpr size_t INTERVAL_COUNT = sizeof(INTERVALS_IN_NANO) / sizeof(INTERVALS_IN_NANO[0]);
+
+int64_t getProcessCpuTimeNano() {
+    timespec ts;
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+    return ts.tv_sec * 1'000'000'000 + ts.tv_nsec;
+}
+
+std::vector<std::shared_ptr<RecurrentTimer::Callback>> registerCallbacks(
+        RecurrentTimer* timer, size_t count, RecurrentTimer::Callback callback) {
+    std::vector<std::shared_ptr<RecurrentTimer::Callback>> callbacks;
+    for (size_t i = 0; i < count; i++) {
+        callbacks.push_back(std::make_shared<RecurrentTimer::Callback>(callback));
+        timer->registerTimerCallback(INTERVALS_IN_NANO[i % INTERVAL_COUNT], callbacks.back());
+    }
+    return callbacks;
+}
+
+void unregisterCallbacks(RecurrentTimer* timer,
+                         const std::vector<std::shared_ptr<RecurrentTimer::Callback>>& callbacks) {
+    for (const auto& callback : callbacks) {
+        timer->unregisterTimerCallback(callback);
+    }
+}
+
+}  // namespace
+
+// Measures the cost of registering and unregistering one callback while 'state.range(0)'
+// callbacks are already registered.
+static void BM_RegisterUnregister(State& state) {
+    RecurrentTimer timer;
+    auto callbacks = registerCallbacks(&timer, state.range(0), [] {});
+    auto callback = std::make_shared<RecurrentTimer::Callback>([] {});
+
+    for (auto _ : state) {
+        timer.registerTimerCallback(INTERVALS_IN_NANO[0], callback);
+        timer.unregisterTimerCallback(callback);
+    }
+
+    unregisterCallbacks(&timer, callbacks);
+}
+BENCHMARK(BM_RegisterUnregister)->Arg(1'000)->Arg(10'000);
+
+// Measures how late callbacks are called compared to their scheduled time and how much CPU the
+// timer thread uses while 'state.range(0)' callbacks are registered.
+static void BM_TimerJitterAndCpu(State& state) {
+    std::atomic<int64_t> totalJitter = 0;
+    std::atomic<int64_t> maxJitter = 0;
+    std::atomic<int64_t> callCount = 0;
+    // Callbacks are scheduled at multiples of their intervals, and the smallest interval divides
+    // all the others, so the lateness is the time passed since the last multiple of it.
+    RecurrentTimer::Callback callback = [&totalJitter, &maxJitter, &callCount] {
+        int64_t jitter = elapsedRealtimeNano() % INTERVALS_IN_NANO[0];
+        totalJitter += jitter;
+        int64_t currentMax = maxJitter;
+        while (jitter > currentMax && !maxJitter.compare_exchange_weak(currentMax, jitter)) {
+        }
+        callCount++;
+    };
+
+    RecurrentTimer timer;
+    auto callbacks = registerCallbacks(&timer, state.range(0), callback);
+    int64_t startCpuTime = getProcessCpuTimeNano();
+    int64_t startTime = elapsedRealtimeNano();
+
+    for (auto _ : state) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    }
+
+    int64_t cpuTime = getProcessCpuTimeNano() - startCpuTime;
+    int64_t wallTime = elapsedRealtimeNano() - startTime;
+    unregisterCallbacks(&timer, callbacks);
+
+    int64_t count = std::max(callCount.load(), static_cast<int64_t>(1));
+    state.counters["avg_jitter_us"] = Counter(totalJitter / count / 1000.0);
+    state.counters["max_jitter_us"] = Counter(maxJitter / 1000.0);
+    state.counters["cpu_percent"] = Counter(100.0 * cpuTime / wallTime);
+    state.counters["calls_per_second"] = Counter(callCount * 1e9 / wallTime);
+}
+BENCHMARK(BM_TimerJitterAndCpu)->Arg(1'000)->Arg(10'000)->Iterations(20)->UseRealTime();
+
+}  // namespace vehicle
+}  // namespace automotive
+}  // namespace hardware
+}  // namespace android
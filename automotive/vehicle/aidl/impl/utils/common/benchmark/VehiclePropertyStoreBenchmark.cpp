@@ -0,0 +1,157 @@
+/*
+ * Copyright (C) 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <VehicleHalTypes.h>
+#include <VehiclePropertyStore.h>
+#include <VehicleUtils.h>
+#include <benchmark/benchmark.h>
+
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <vector>
+
+namespace android {
+namespace hardware {
+namespace automotive {
+namespace vehicle {
+
+namespace {
+
+using ::aidl::android::hardware::automotive::vehicle::VehicleArea;
+using ::aidl::android::hardware::automotive::vehicle::VehiclePropConfig;
+using ::aidl::android::hardware::automotive::vehicle::VehiclePropertyAccess;
+using ::aidl::android::hardware::automotive::vehicle::VehiclePropertyChangeMode;
+using ::aidl::android::hardware::automotive::vehicle::VehiclePropertyGroup;
+using ::aidl::android::hardware::automotive::vehicle::VehiclePropertyType;
+using ::benchmark::State;
+
+// The number of distinct global float properties registered to the store.
+constexpr int32_t PROPERTY_COUNT = 256;
+
+int32_t getTestPropId(int32_t index) {
+    return toInt(VehiclePropertyGroup::VENDOR) | toInt(VehicleArea::GLOBAL) |
+           toInt(VehiclePropertyType::FLOAT) | (0x1000 + index);
+}
+
+// Runs 'contenderCount' background threads that continuously access properties other than the
+// one the benchmark loop accesses. If 'contendersWrite' is true, the background threads write
+// values, otherwise they read values.
+class VehiclePropertyStoreFixture : public ::benchmark::Fixture {
+  public:
+    void setUp(size_t shardCount, int32_t contenderCount, bool contendersWrite) {
+        mValuePool = std::make_shared<VehiclePropValuePool>();
+        mStore = std::make_unique<VehiclePropertyStore>(mValuePool, shardCount);
+        for (int32_t i = 0; i < PROPERTY_COUNT; i++) {
+            mStore->registerProperty(VehiclePropConfig{
+                    .prop = getTestPropId(i),
+                    .access = VehiclePropertyAccess::READ_WRITE,
+                    .changeMode = VehiclePropertyChangeMode::CONTINUOUS,
+            });
+            writeValue(getTestPropId(i), 0);
+        }
+
+        mStop = false;
+        for (int32_t t = 0; t < contenderCount; t++) {
+            mThreads.emplace_back([this, t, contenderCount, contendersWrite] {
+                int64_t timestamp = 0;
+                while (!mStop) {
+                    // Property 0 is reserved for the benchmark loop.
+                    for (int32_t i = 1 + t; i < PROPERTY_COUNT; i += contenderCount) {
+                        if (contendersWrite) {
+                            writeValue(getTestPropId(i), ++timestamp);
+                        } else {
+                            ::benchmark::DoNotOptimize(mStore->readValue(getTestPropId(i)));
+                        }
+                    }
+                }
+            });
+        }
+    }
+
+    void TearDown(State&) override {
+        mStop = true;
+        for (auto& thread : mThreads) {
+            thread.join();
+        }
+        mThreads.clear();
+        mStore.reset();
+        mValuePool.reset();
+    }
+
+  protected:
+    std::shared_ptr<VehiclePropValuePool> mValuePool;
+    std::unique_ptr<VehiclePropertyStore> mStore;
+
+    void writeValue(int32_t propId, int64_t timestamp) {
+        auto value = mValuePool->obtain(VehiclePropertyType::FLOAT);
+        value->prop = propId;
+        value->timestamp = timestamp;
+        value->value.floatValues[0] = static_cast<float>(timestamp);
+        ::benchmark::DoNotOptimize(mStore->writeValue(std::move(value)));
+    }
+
+  private:
+    std::atomic<bool> mStop;
+    std::vector<std::thread> mThreads;
+};
+
+// Arguments are {shardCount, contenderCount}. A shard count of 1 behaves like a store guarded by
+// a single lock.
+void storeArgs(::benchmark::internal::Benchmark* b) {
+    for (int64_t shardCount :
+         {static_cast<int64_t>(1),
+          static_cast<int64_t>(VehiclePropertyStore::DEFAULT_SHARD_COUNT)}) {
+        for (int64_t contenderCount : {0, 1, 2, 4}) {
+            b->Args({shardCount, contenderCount});
+        }
+    }
+    b->UseRealTime();
+}
+
+}  // namespace
+
+BENCHMARK_DEFINE_F(VehiclePropertyStoreFixture, BM_ReadValueWithContendingWriters)
+(State& state) {
+    setUp(state.range(0), state.range(1), /*contendersWrite=*/true);
+    int32_t propId = getTestPropId(0);
+    for (auto _ : state) {
+        ::benchmark::DoNotOptimize(mStore->readValue(propId));
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK_REGISTER_F(VehiclePropertyStoreFixture, BM_ReadValueWithContendingWriters)
+        ->Apply(storeArgs);
+
+BENCHMARK_DEFINE_F(VehiclePropertyStoreFixture, BM_WriteValueWithContendingReaders)
+(State& state) {
+    setUp(state.range(0), state.range(1), /*contendersWrite=*/false);
+    int32_t propId = getTestPropId(0);
+    int64_t timestamp = 0;
+    for (auto _ : state) {
+        writeValue(propId, ++timestamp);
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK_REGISTER_F(VehiclePropertyStoreFixture, BM_WriteValueWithContendingReaders)
+        ->Apply(storeArgs);
+
+}  // namespace vehicle
+}  // namespace automotive
+}  // namespace hardware
+}  // namespace android
+
+BENCHMARK_MAIN();
@@ -21,9 +21,13 @@
 
 #include <atomic>
 #include <condition_variable>
+#include <cstdint>
 #include <iostream>
+#include <memory>
+#include <mutex>
 #include <queue>
 #include <thread>
+#include <vector>
 
 namespace android {
 namespace hardware {
@@ -92,6 +96,184 @@ class ConcurrentQueue {
     std::queue<T> mQueue GUARDED_BY(mLock);
 };
 
+// A multi-producer, single-consumer queue backed by a fixed-capacity ring buffer.
+//
+// It has the same push/flush/waitForItems/deactivate semantics as {@code ConcurrentQueue}, except
+// that push fails when the queue is full. Producers never take a lock: a slot is claimed with a
+// single compare-and-swap and published with a release store. The consumer only takes a lock
+// when it has to sleep in {@code waitForItems}, and producers only take it to wake up a sleeping
+// consumer.
+//
+// Only one thread may call {@code flush} and {@code waitForItems}. T must be default
+// constructible and move assignable.
+template <typename T>
+class BoundedMpscQueue {
+  public:
+    // 'capacity' is rounded up to the next power of 2.
+    explicit BoundedMpscQueue(size_t capacity) : mMask(roundUpToPowerOf2(capacity) - 1) {
+        mCells = std::make_unique<Cell[]>(mMask + 1);
+        for (size_t i = 0; i <= mMask; i++) {
+            mCells[i].sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    BoundedMpscQueue(const BoundedMpscQueue&) = delete;
+    BoundedMpscQueue& operator=(const BoundedMpscQueue&) = delete;
+
+    bool waitForItems() {
+        while (true) {
+            if (!isEmpty() || !mIsActive.load(std::memory_order_acquire)) {
+                return mIsActive.load(std::memory_order_acquire);
+            }
+            std::unique_lock<std::mutex> lockGuard(mWaitLock);
+            mConsumerWaiting.store(true, std::memory_order_seq_cst);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            // Check again after announcing that we are waiting, a producer that pushed before
+            // seeing the flag would not notify us.
+            if (isEmpty() && mIsActive.load(std::memory_order_seq_cst)) {
+                mCond.wait(lockGuard);
+            }
+            mConsumerWaiting.store(false, std::memory_order_relaxed);
+        }
+    }
+
+    std::vector<T> flush() {
+        std::vector<T> items;
+        // Even if the queue is deactivated, we should still flush all the remaining values in the
+        // queue.
+        while (true) {
+            Cell& cell = mCells[mDequeuePos & mMask];
+            if (cell.sequence.load(std::memory_order_acquire) != mDequeuePos + 1) {
+                // Either empty or the producer that claimed this slot has not published it yet.
+                break;
+            }
+            items.push_back(std::move(cell.item));
+            cell.item = T();
+            // Release the slot for the producers in the next lap.
+            cell.sequence.store(mDequeuePos + mMask + 1, std::memory_order_release);
+            mDequeuePos++;
+        }
+        return items;
+    }
+
+    // Returns false if the queue is deactivated or full, in which case the item is not pushed.
+    bool push(T&& item) {
+        if (!mIsActive.load(std::memory_order_acquire)) {
+            return false;
+        }
+        size_t pos;
+        if (!claim(1, &pos)) {
+            return false;
+        }
+        publish(pos, std::move(item));
+        notifyConsumer();
+        return true;
+    }
+
+    // Pushes all the items with one slot claim and at most one consumer wakeup. Returns the number
+    // of items pushed. If there is not enough space for all of them, the items are pushed one by
+    // one until the queue is full.
+    size_t push(std::vector<T>&& items) {
+        if (items.empty() || !mIsActive.load(std::memory_order_acquire)) {
+            return 0;
+        }
+        size_t pos;
+        size_t count = 0;
+        if (items.size() <= mMask + 1 && claim(items.size(), &pos)) {
+            for (; count < items.size(); count++) {
+                publish(pos + count, std::move(items[count]));
+            }
+        } else {
+            for (; count < items.size() && claim(1, &pos); count++) {
+                publish(pos, std::move(items[count]));
+            }
+        }
+        if (count != 0) {
+            notifyConsumer();
+        }
+        return count;
+    }
+
+    // Deactivates the queue, thus no one can push items to it, also notifies the waiting consumer.
+    // The items already in the queue could still be flushed even after the queue is deactivated.
+    void deactivate() {
+        mIsActive.store(false, std::memory_order_seq_cst);
+        std::scoped_lock<std::mutex> lockGuard(mWaitLock);
+        mCond.notify_all();
+    }
+
+  private:
+    struct Cell {
+        // Equals to the position of the slot if it is free for the producer at that position,
+        // and position + 1 once the item at that position is published.
+        std::atomic<size_t> sequence;
+        T item;
+    };
+
+    const size_t mMask;
+    std::unique_ptr<Cell[]> mCells;
+    // Keep the producer and consumer positions on separate cache lines.
+    alignas(64) std::atomic<size_t> mEnqueuePos = 0;
+    // Only accessed by the consumer.
+    alignas(64) size_t mDequeuePos = 0;
+    std::atomic<bool> mIsActive = true;
+    std::atomic<bool> mConsumerWaiting = false;
+    std::mutex mWaitLock;
+    std::condition_variable mCond;
+
+    static size_t roundUpToPowerOf2(size_t n) {
+        size_t result = 1;
+        while (result < n) {
+            result <<= 1;
+        }
+        return result;
+    }
+
+    bool isEmpty() {
+        return mCells[mDequeuePos & mMask].sequence.load(std::memory_order_acquire) !=
+               mDequeuePos + 1;
+    }
+
+    // Claims 'count' consecutive slots and stores the first position to 'pos'. Returns false if
+    // there are not enough free slots.
+    bool claim(size_t count, size_t* pos) {
+        size_t currentPos = mEnqueuePos.load(std::memory_order_relaxed);
+        while (true) {
+            // Slots are released by the consumer in order, so if the last slot is free, all the
+            // slots before it are free as well.
+            size_t lastPos = currentPos + count - 1;
+            size_t sequence = mCells[lastPos & mMask].sequence.load(std::memory_order_acquire);
+            intptr_t diff = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(lastPos);
+            if (diff == 0) {
+                if (mEnqueuePos.compare_exchange_weak(currentPos, currentPos + count,
+                                                      std::memory_order_relaxed)) {
+                    *pos = currentPos;
+                    return true;
+                }
+            } else if (diff < 0) {
+                // The consumer has not released the slot from the previous lap, queue is full.
+                return false;
+            } else {
+                currentPos = mEnqueuePos.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    void publish(size_t pos, T&& item) {
+        Cell& cell = mCells[pos & mMask];
+        cell.item = std::move(item);
+        cell.sequence.store(pos + 1, std::memory_order_release);
+    }
+
+    void notifyConsumer() {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (mConsumerWaiting.load(std::memory_order_seq_cst)) {
+            std::scoped_lock<std::mutex> lockGuard(mWaitLock);
+            mCond.notify_one();
+        }
+    }
+};
+
 }  // namespace vehicle
 }  // namespace automotive
 }  // namespace hardware
@@ -22,7 +22,7 @@
 #include <android-base/thread_annotations.h>
 
 #include <atomic>
-#include <list>
+#include <deque>
 #include <mutex>
 #include <thread>
 #include <unordered_map>
@@ -74,16 +74,30 @@ class PendingRequestPool final {
     // more requests would fail. This is to prevent spamming from client.
     static constexpr size_t MAX_PENDING_REQUEST_PER_CLIENT = 10000;
 
+    // A batch of requests added in one {@code addRequests} call, sharing the same timeout callback.
     struct PendingRequest {
+        const void* clientId;
         std::unordered_set<int64_t> requestIds;
         int64_t timeoutTimestamp;
         std::shared_ptr<const TimeoutCallbackFunc> callback;
     };
 
+    struct Deadline {
+        int64_t timeoutTimestamp;
+        uint64_t batchId;
+    };
+
     int64_t mTimeoutInNano;
     mutable std::mutex mLock;
-    std::unordered_map<const void*, std::list<PendingRequest>> mPendingRequestsByClient
+    uint64_t mNextBatchId GUARDED_BY(mLock) = 0;
+    std::unordered_map<uint64_t, PendingRequest> mPendingRequestsByBatchId GUARDED_BY(mLock);
+    // Maps each pending request ID to the ID of the batch it belongs to, for each client.
+    std::unordered_map<const void*, std::unordered_map<int64_t, uint64_t>> mBatchIdsByClient
             GUARDED_BY(mLock);
+    // Batches ordered by timeout timestamp. Since all batches have the same timeout, this is also
+    // the order they are added. Finished batches are not removed from this queue, they are skipped
+    // when their deadline is reached.
+    std::deque<Deadline> mDeadlines GUARDED_BY(mLock);
     std::thread mThread;
     std::atomic<bool> mThreadStop = false;
     std::condition_variable mCv;
@@ -92,7 +106,8 @@ class PendingRequestPool final {
     bool isRequestPendingLocked(const void* clientId, int64_t requestId) const REQUIRES(mLock);
 
     // Checks whether the requests in the pool has timed-out, run periodically in a separate thread.
-    void checkTimeout();
+    // Returns how long to wait before the next check.
+    int64_t checkTimeout();
 };
 
 }  // namespace vehicle
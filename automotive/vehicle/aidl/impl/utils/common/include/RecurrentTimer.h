@@ -19,11 +19,14 @@
 
 #include <android-base/thread_annotations.h>
 
+#include <condition_variable>
+#include <functional>
 #include <memory>
 #include <mutex>
-#include <queue>
+#include <set>
 #include <thread>
 #include <unordered_map>
+#include <utility>
 #include <vector>
 
 namespace android {
@@ -32,6 +35,11 @@ namespace automotive {
 namespace vehicle {
 
 // A thread-safe recurrent timer.
+//
+// Callbacks registered with the same interval are coalesced into one group that fires on a single
+// tick, so the cost of scheduling depends on the number of distinct intervals rather than the
+// number of callbacks. Registering and unregistering a callback takes constant time unless it
+// creates or removes a group.
 class RecurrentTimer final {
   public:
     // The class for the function that would be called recurrently.
@@ -52,39 +60,37 @@ class RecurrentTimer final {
     // friend class for unit testing.
     friend class RecurrentTimerTest;
 
+    // The location of a registered callback.
     struct CallbackInfo {
-        std::shared_ptr<Callback> callback;
         int64_t interval;
-        int64_t nextTime;
-        // A flag to indicate whether this CallbackInfo is already outdated and should be ignored.
-        // The reason we need this flag is because we cannot easily remove an element from a heap.
-        bool outdated = false;
+        // The index of the callback in the group's callbacks.
+        size_t index;
+    };
 
-        static bool cmp(const std::unique_ptr<CallbackInfo>& lhs,
-                        const std::unique_ptr<CallbackInfo>& rhs);
+    // All the callbacks registered with the same interval.
+    struct IntervalGroup {
+        int64_t nextTime;
+        std::vector<std::shared_ptr<Callback>> callbacks;
     };
 
     std::mutex mLock;
     std::thread mThread;
     std::condition_variable mCond;
     bool mStopRequested GUARDED_BY(mLock) = false;
-    // A map to map each callback to its current active CallbackInfo in the mCallbackQueue.
-    std::unordered_map<std::shared_ptr<Callback>, CallbackInfo*> mCallbacks GUARDED_BY(mLock);
-    // A min-heap sorted by nextTime. Note that because we cannot remove arbitrary element from the
-    // heap, a single Callback can have multiple entries in this queue, all but one should be valid.
-    // The rest should be mark as outdated. The valid one is one stored in mCallbacks.
-    std::vector<std::unique_ptr<CallbackInfo>> mCallbackQueue GUARDED_BY(mLock);
+    // A map to map each callback to its location in mGroupsByInterval.
+    std::unordered_map<std::shared_ptr<Callback>, CallbackInfo> mCallbacks GUARDED_BY(mLock);
+    // A map from interval to the group of callbacks registered with that interval. A group is
+    // removed once it becomes empty.
+    std::unordered_map<int64_t, IntervalGroup> mGroupsByInterval GUARDED_BY(mLock);
+    // The {nextTime, interval} for each group in mGroupsByInterval, ordered by nextTime.
+    std::set<std::pair<int64_t, int64_t>> mCallbackQueue GUARDED_BY(mLock);
 
     void loop();
 
-    // Mark the callbackInfo as outdated and should be ignored when popped from the heap.
-    void markOutdatedLocked(CallbackInfo* callback) REQUIRES(mLock);
-    // Remove all outdated callbackInfos from the top of the heap. This function must be called
-    // each time we might introduce outdated elements to the top. We must make sure the heap is
-    // always valid from the top.
-    void removeInvalidCallbackLocked() REQUIRES(mLock);
-    // Pops the next closest callback (must be valid) from the heap.
-    std::unique_ptr<CallbackInfo> popNextCallbackLocked() REQUIRES(mLock);
+    // Removes the callback from its group. Removes the group if it becomes empty.
+    void removeCallbackLocked(const CallbackInfo& info) REQUIRES(mLock);
+    // Calls all the callbacks in the groups that are due at 'now' and schedules their next ticks.
+    void fireDueGroupsLocked(int64_t now) REQUIRES(mLock);
 };
 
 }  // namespace vehicle
@@ -17,10 +17,14 @@
 #ifndef android_hardware_automotive_vehicle_utils_include_VehicleObjectPool_H_
 #define android_hardware_automotive_vehicle_utils_include_VehicleObjectPool_H_
 
+#include <atomic>
 #include <deque>
 #include <map>
 #include <memory>
 #include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
 
 #include <VehicleHalTypes.h>
 
@@ -36,6 +40,10 @@ namespace vehicle {
 
 struct PoolStats {
     std::atomic<uint32_t> Obtained{0};
+    // Obtained from the calling thread's cache without taking any lock.
+    std::atomic<uint32_t> Hit{0};
+    // Not in the calling thread's cache, obtained from the shared pool or newly created.
+    std::atomic<uint32_t> Miss{0};
     std::atomic<uint32_t> Created{0};
     std::atomic<uint32_t> Recycled{0};
     std::atomic<uint32_t> Deleted{0};
@@ -68,6 +76,11 @@ using recyclable_ptr = typename std::unique_ptr<T, Deleter<T>>;
 
 // Generic abstract object pool class. Users of this class must implement {@Code createObject}.
 //
+// Each thread has its own small cache of recycled objects, which is used first without taking
+// any lock. Objects that do not fit in the calling thread's cache go to a shared pool. Objects in
+// the thread caches count against {@Code maxPoolObjectsSize} just like the ones in the shared
+// pool, so the pool never holds more than that no matter how many threads use it.
+//
 // This class is thread-safe. Concurrent calls to {@Code obtain} from multiple threads is OK, also
 // client can obtain an object in one thread and then move ownership to another thread.
 template <typename T>
@@ -75,13 +88,30 @@ class ObjectPool {
   public:
     using GetSizeFunc = std::function<size_t(const T&)>;
 
-    ObjectPool(size_t maxPoolObjectsSize, GetSizeFunc getSizeFunc)
-        : mMaxPoolObjectsSize(maxPoolObjectsSize), mGetSizeFunc(getSizeFunc){};
+    // The default max number of recycled objects cached in each thread for each pool.
+    static constexpr size_t DEFAULT_MAX_THREAD_CACHE_COUNT = 16;
+
+    ObjectPool(size_t maxPoolObjectsSize, GetSizeFunc getSizeFunc,
+               size_t maxThreadCacheCount = DEFAULT_MAX_THREAD_CACHE_COUNT)
+        : mMaxPoolObjectsSize(maxPoolObjectsSize),
+          mMaxThreadCacheCount(maxThreadCacheCount),
+          mGetSizeFunc(getSizeFunc){};
     virtual ~ObjectPool() = default;
 
     virtual recyclable_ptr<T> obtain() {
-        std::scoped_lock<std::mutex> lock(mLock);
         INC_METRIC_IF_DEBUG(Obtained)
+        if (ThreadCache* cache = getThreadCache(); cache != nullptr && !cache->objects.empty()) {
+            INC_METRIC_IF_DEBUG(Hit)
+            auto o = wrap(cache->objects.back().release());
+            cache->objects.pop_back();
+            size_t objectSize = mGetSizeFunc(*o);
+            cache->objectsSize -= objectSize;
+            *mRecycledObjectsSize -= objectSize;
+            return o;
+        }
+
+        INC_METRIC_IF_DEBUG(Miss)
+        std::scoped_lock<std::mutex> lock(mLock);
         if (mObjects.empty()) {
             INC_METRIC_IF_DEBUG(Created)
             return wrap(createObject());
@@ -89,7 +119,7 @@ class ObjectPool {
 
         auto o = wrap(mObjects.front().release());
         mObjects.pop_front();
-        mPoolObjectsSize -= mGetSizeFunc(*o);
+        *mRecycledObjectsSize -= mGetSizeFunc(*o);
         return o;
     }
 
@@ -100,11 +130,8 @@ class ObjectPool {
     virtual T* createObject() = 0;
 
     virtual void recycle(T* o) {
-        std::scoped_lock<std::mutex> lock(mLock);
         size_t objectSize = mGetSizeFunc(*o);
-
-        if (objectSize > mMaxPoolObjectsSize ||
-            mPoolObjectsSize > mMaxPoolObjectsSize - objectSize) {
+        if (!tryReserve(objectSize)) {
             INC_METRIC_IF_DEBUG(Deleted)
 
             // We have no space left in the pool.
@@ -114,13 +141,90 @@ class ObjectPool {
 
         INC_METRIC_IF_DEBUG(Recycled)
 
+        if (ThreadCache* cache = getThreadCache();
+            cache != nullptr && cache->objects.size() < mMaxThreadCacheCount) {
+            cache->objects.push_back(std::unique_ptr<T>{o});
+            cache->objectsSize += objectSize;
+            return;
+        }
+
+        std::scoped_lock<std::mutex> lock(mLock);
         mObjects.push_back(std::unique_ptr<T>{o});
-        mPoolObjectsSize += objectSize;
     }
 
     const size_t mMaxPoolObjectsSize;
 
   private:
+    struct ThreadCache {
+        // The owning pool's mRecycledObjectsSize. Expires when the pool is destroyed.
+        std::weak_ptr<std::atomic<size_t>> owner;
+        std::vector<std::unique_ptr<T>> objects;
+        // The total size of 'objects', which is counted in the owner's mRecycledObjectsSize.
+        size_t objectsSize = 0;
+
+        ThreadCache() = default;
+        ThreadCache(const ThreadCache&) = delete;
+        ThreadCache& operator=(const ThreadCache&) = delete;
+
+        // Gives the objects' share of the size limit back to the owner when the thread exits.
+        ~ThreadCache() {
+            if (auto recycledObjectsSize = owner.lock(); recycledObjectsSize != nullptr) {
+                *recycledObjectsSize -= objectsSize;
+            }
+        }
+    };
+
+    // All the thread caches for pools of type T in the current thread, keyed by the pool's
+    // mRecycledObjectsSize.
+    struct ThreadCaches {
+        std::unordered_map<const void*, ThreadCache> cachesByToken;
+
+        ~ThreadCaches() { sThreadCachesDestroyed = true; }
+    };
+
+    // Returns the calling thread's cache for this pool, or nullptr if the thread is exiting and
+    // the caches are already destroyed.
+    ThreadCache* getThreadCache() {
+        if (sThreadCachesDestroyed) {
+            return nullptr;
+        }
+        static thread_local ThreadCaches threadCaches;
+        auto& cachesByToken = threadCaches.cachesByToken;
+        auto it = cachesByToken.find(mRecycledObjectsSize.get());
+        if (it != cachesByToken.end() && !it->second.owner.expired()) {
+            return &it->second;
+        }
+        if (it == cachesByToken.end()) {
+            // Drop the caches for destroyed pools before adding a new one.
+            for (auto cacheIt = cachesByToken.begin(); cacheIt != cachesByToken.end();) {
+                if (cacheIt->second.owner.expired()) {
+                    cacheIt = cachesByToken.erase(cacheIt);
+                } else {
+                    cacheIt++;
+                }
+            }
+            it = cachesByToken.try_emplace(mRecycledObjectsSize.get()).first;
+        }
+        // Either a new cache or a stale cache for a destroyed pool at the same address.
+        it->second.owner = mRecycledObjectsSize;
+        it->second.objects.clear();
+        it->second.objectsSize = 0;
+        it->second.objects.reserve(mMaxThreadCacheCount);
+        return &it->second;
+    }
+
+    // Reserves 'objectSize' of the size limit for an object to be recycled. Returns false if the
+    // pool has no space left for it.
+    bool tryReserve(size_t objectSize) {
+        size_t current = mRecycledObjectsSize->load();
+        do {
+            if (objectSize > mMaxPoolObjectsSize || current > mMaxPoolObjectsSize - objectSize) {
+                return false;
+            }
+        } while (!mRecycledObjectsSize->compare_exchange_weak(current, current + objectSize));
+        return true;
+    }
+
     const Deleter<T>& getDeleter() {
         if (!mDeleter.get()) {
             Deleter<T>* d =
@@ -135,8 +239,14 @@ class ObjectPool {
     mutable std::mutex mLock;
     std::deque<std::unique_ptr<T>> mObjects GUARDED_BY(mLock);
     std::unique_ptr<Deleter<T>> mDeleter;
-    size_t mPoolObjectsSize GUARDED_BY(mLock);
+    const size_t mMaxThreadCacheCount;
     GetSizeFunc mGetSizeFunc;
+    // The total size of the recycled objects, both in the shared pool and in all the thread
+    // caches. Also identifies this pool's thread caches, which hold weak references to it.
+    const std::shared_ptr<std::atomic<size_t>> mRecycledObjectsSize =
+            std::make_shared<std::atomic<size_t>>(0);
+
+    static inline thread_local bool sThreadCachesDestroyed = false;
 };
 
 #undef INC_METRIC_IF_DEBUG
@@ -155,6 +265,11 @@ class ObjectPool {
 // immediately once the go out of scope. There's no synchronization penalty for these objects since
 // we do not store them in the pool.
 //
+// Vector values are pooled by size class: the vector size is rounded up to the next power of 2
+// (capped at maxRecyclableVectorSize), so values with different but close vector sizes share the
+// same pool and reuse the vector capacity. All the internal pools are created in the constructor,
+// so obtaining a value never takes a pool-wide lock.
+//
 // This class is thread-safe. Users can obtain an object in one thread and pass it to another.
 //
 // Sample usage:
@@ -178,11 +293,10 @@ class VehiclePropValuePool {
     // unique pointer instead of a recyclable pointer. The object would not be recycled once it
     // goes out of scope, but would be deleted.
     // @param maxPoolObjectsSize - The approximate upper bound of memory each internal recycling
-    // pool could take. We have 4 different type pools, each with 4 different vector size, so
-    // approximately this pool would at-most take 4 * 4 * 10240 = 160k memory.
-    VehiclePropValuePool(size_t maxRecyclableVectorSize = 4, size_t maxPoolObjectsSize = 10240)
-        : mMaxRecyclableVectorSize(maxRecyclableVectorSize),
-          mMaxPoolObjectsSize(maxPoolObjectsSize){};
+    // pool could take, including the values cached in each thread. We have 4 different type
+    // pools, each with 4 different vector size, so approximately this pool would at-most take
+    // 4 * 4 * 10240 = 160k memory.
+    VehiclePropValuePool(size_t maxRecyclableVectorSize = 4, size_t maxPoolObjectsSize = 10240);
 
     // Obtain a recyclable VehiclePropertyValue object from the pool for the given type. If the
     // given type is not MIXED or STRING, the internal value vector size would be set to 1.
@@ -218,6 +332,9 @@ class VehiclePropValuePool {
     VehiclePropValuePool(VehiclePropValuePool&) = delete;
     VehiclePropValuePool& operator=(VehiclePropValuePool&) = delete;
 
+    // Returns a human-readable summary of the pool statistics, used in dump.
+    static std::string dumpStats();
+
   private:
     static inline bool isSingleValueType(
             aidl::android::hardware::automotive::vehicle::VehiclePropertyType type) {
@@ -238,6 +355,9 @@ class VehiclePropValuePool {
         return vectorSize > mMaxRecyclableVectorSize || isComplexType(type);
     }
 
+    // Returns the vector size of the pool that values with 'vectorSize' are obtained from.
+    size_t getSizeClass(size_t vectorSize) const;
+
     RecyclableType obtainDisposable(
             aidl::android::hardware::automotive::vehicle::VehiclePropertyType valueType,
             size_t vectorSize) const;
@@ -248,6 +368,8 @@ class VehiclePropValuePool {
     class InternalPool
         : public ObjectPool<aidl::android::hardware::automotive::vehicle::VehiclePropValue> {
       public:
+        // 'vectorSize' is the size class, objects in this pool could hold values with vector size
+        // up to it.
         InternalPool(aidl::android::hardware::automotive::vehicle::VehiclePropertyType type,
                      size_t vectorSize, size_t maxPoolObjectsSize,
                      ObjectPool::GetSizeFunc getSizeFunc)
@@ -264,7 +386,7 @@ class VehiclePropValuePool {
 
         template <typename VecType>
         bool check(std::vector<VecType>* vec, bool isVectorType) {
-            return vec->size() == (isVectorType ? mVectorSize : 0);
+            return isVectorType ? (!vec->empty() && vec->size() <= mVectorSize) : vec->empty();
         }
 
       private:
@@ -277,12 +399,12 @@ class VehiclePropValuePool {
                         delete v;
                     }};
 
-    mutable std::mutex mLock;
     const size_t mMaxRecyclableVectorSize;
     const size_t mMaxPoolObjectsSize;
-    // A map with 'property_type' | 'value_vector_size' as key and a recyclable object pool as
-    // value. We would create a recyclable pool for each property type and vector size combination.
-    std::map<int32_t, std::unique_ptr<InternalPool>> mValueTypePools GUARDED_BY(mLock);
+    // A map with 'property_type' | 'size_class' as key and a recyclable object pool as value. We
+    // create a recyclable pool for each property type and size class combination in the
+    // constructor, the map is never modified afterwards so it could be read without lock.
+    std::map<int32_t, std::unique_ptr<InternalPool>> mValueTypePools;
 };
 
 }  // namespace vehicle
@@ -22,6 +22,7 @@
 #include <memory>
 #include <mutex>
 #include <unordered_map>
+#include <vector>
 
 #include <VehicleHalTypes.h>
 #include <VehicleObjectPool.h>
@@ -40,14 +41,21 @@ namespace vehicle {
 // VehiclePropertyValues stored in a sorted map thus it makes easier to get range of values, e.g.
 // to get value for all areas for particular property.
 //
-// This class is thread-safe, however it uses blocking synchronization across all methods.
+// This class is thread-safe. Records are partitioned by property ID into shards, each guarded by
+// its own lock, so that reads and writes for one property do not block on operations for
+// unrelated properties that live in a different shard.
 class VehiclePropertyStore final {
   public:
     using ValueResultType = VhalResult<VehiclePropValuePool::RecyclableType>;
     using ValuesResultType = VhalResult<std::vector<VehiclePropValuePool::RecyclableType>>;
 
-    explicit VehiclePropertyStore(std::shared_ptr<VehiclePropValuePool> valuePool)
-        : mValuePool(valuePool) {}
+    // The default number of shards. Must be a power of 2.
+    static constexpr size_t DEFAULT_SHARD_COUNT = 16;
+
+    // 'shardCount' is rounded up to the next power of 2. A 'shardCount' of 1 makes all operations
+    // share a single lock.
+    explicit VehiclePropertyStore(std::shared_ptr<VehiclePropValuePool> valuePool,
+                                  size_t shardCount = DEFAULT_SHARD_COUNT);
 
     ~VehiclePropertyStore();
 
@@ -134,20 +142,33 @@ class VehiclePropertyStore final {
         std::unordered_map<RecordId, VehiclePropValuePool::RecyclableType, RecordIdHash> values;
     };
 
+    // A partition of the records. A property always maps to the same shard.
+    struct Shard {
+        mutable std::mutex lock;
+        std::unordered_map<int32_t, Record> recordsByPropId GUARDED_BY(lock);
+    };
+
     // {@code VehiclePropValuePool} is thread-safe.
     std::shared_ptr<VehiclePropValuePool> mValuePool;
-    mutable std::mutex mLock;
-    std::unordered_map<int32_t, Record> mRecordsByPropId GUARDED_BY(mLock);
-    OnValueChangeCallback mOnValueChangeCallback GUARDED_BY(mLock);
+    // The number of shards is fixed at construction and is always a power of 2.
+    std::vector<Shard> mShards;
+    // The callback is set rarely but read on every write, so it is swapped atomically instead of
+    // being guarded by a lock that all the shards would contend on.
+    std::shared_ptr<const OnValueChangeCallback> mOnValueChangeCallback;
+
+    Shard& getShard(int32_t propId);
+
+    const Shard& getShard(int32_t propId) const;
 
-    const Record* getRecordLocked(int32_t propId) const;
+    const Record* getRecordLocked(const Shard& shard, int32_t propId) const REQUIRES(shard.lock);
 
-    Record* getRecordLocked(int32_t propId);
+    Record* getRecordLocked(Shard& shard, int32_t propId) REQUIRES(shard.lock);
 
-    RecordId getRecordIdLocked(
+    RecordId getRecordId(
             const aidl::android::hardware::automotive::vehicle::VehiclePropValue& propValue,
             const Record& record) const;
 
+    // Must be called with the lock of the shard that contains 'record' held.
     ValueResultType readValueLocked(const RecordId& recId, const Record& record) const;
 };
 
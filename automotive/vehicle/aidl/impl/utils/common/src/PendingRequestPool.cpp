@@ -22,6 +22,7 @@
 #include <utils/Log.h>
 #include <utils/SystemClock.h>
 
+#include <algorithm>
 #include <vector>
 
 namespace android {
@@ -47,7 +48,7 @@ PendingRequestPool::PendingRequestPool(int64_t timeoutInNano)
           std::unique_lock<std::mutex> lk(mCvLock);
           while (!mCv.wait_for(lk, std::chrono::nanoseconds(sleepTime),
                                [this] { return mThreadStop.load(); })) {
-              checkTimeout();
+              sleepTime = checkTimeout();
           }
       }) {}
 
@@ -62,12 +63,16 @@ PendingRequestPool::~PendingRequestPool() {
     {
         std::scoped_lock<std::mutex> lockGuard(mLock);
 
-        for (auto& [_, pendingRequests] : mPendingRequestsByClient) {
-            for (const auto& request : pendingRequests) {
-                (*request.callback)(request.requestIds);
+        for (const auto& deadline : mDeadlines) {
+            auto it = mPendingRequestsByBatchId.find(deadline.batchId);
+            if (it == mPendingRequestsByBatchId.end()) {
+                continue;
             }
+            (*it->second.callback)(it->second.requestIds);
         }
-        mPendingRequestsByClient.clear();
+        mPendingRequestsByBatchId.clear();
+        mBatchIdsByClient.clear();
+        mDeadlines.clear();
     }
 }
 
@@ -75,36 +80,36 @@ VhalResult<void> PendingRequestPool::addRequests(
         const void* clientId, const std::unordered_set<int64_t>& requestIds,
         std::shared_ptr<const TimeoutCallbackFunc> callback) {
     std::scoped_lock<std::mutex> lockGuard(mLock);
-    std::list<PendingRequest>* pendingRequests;
-    size_t pendingRequestCount = 0;
-    if (mPendingRequestsByClient.find(clientId) != mPendingRequestsByClient.end()) {
-        pendingRequests = &mPendingRequestsByClient[clientId];
-        for (const auto& pendingRequest : *pendingRequests) {
-            const auto& pendingRequestIds = pendingRequest.requestIds;
-            for (int64_t requestId : requestIds) {
-                if (pendingRequestIds.find(requestId) != pendingRequestIds.end()) {
-                    return StatusError(StatusCode::INVALID_ARG)
-                           << "duplicate request ID: " << requestId;
-                }
-            }
-            pendingRequestCount += pendingRequestIds.size();
+    auto& batchIds = mBatchIdsByClient[clientId];
+    for (int64_t requestId : requestIds) {
+        if (batchIds.find(requestId) != batchIds.end()) {
+            return StatusError(StatusCode::INVALID_ARG) << "duplicate request ID: " << requestId;
         }
-    } else {
-        // Create a new empty list for this client.
-        pendingRequests = &mPendingRequestsByClient[clientId];
     }
 
-    if (requestIds.size() > MAX_PENDING_REQUEST_PER_CLIENT - pendingRequestCount) {
+    if (requestIds.size() > MAX_PENDING_REQUEST_PER_CLIENT - batchIds.size()) {
+        if (batchIds.empty()) {
+            mBatchIdsByClient.erase(clientId);
+        }
         return StatusError(StatusCode::TRY_AGAIN) << "too many pending requests";
     }
 
     int64_t currentTime = elapsedRealtimeNano();
     int64_t timeoutTimestamp = currentTime + mTimeoutInNano;
+    uint64_t batchId = mNextBatchId++;
 
-    pendingRequests->push_back({
+    for (int64_t requestId : requestIds) {
+        batchIds[requestId] = batchId;
+    }
+    mPendingRequestsByBatchId[batchId] = {
+            .clientId = clientId,
             .requestIds = std::unordered_set<int64_t>(requestIds.begin(), requestIds.end()),
             .timeoutTimestamp = timeoutTimestamp,
             .callback = callback,
+    };
+    mDeadlines.push_back({
+            .timeoutTimestamp = timeoutTimestamp,
+            .batchId = batchId,
     });
 
     return {};
@@ -120,10 +125,8 @@ size_t PendingRequestPool::countPendingRequests() const {
     std::scoped_lock<std::mutex> lockGuard(mLock);
 
     size_t count = 0;
-    for (const auto& [clientId, requests] : mPendingRequestsByClient) {
-        for (const auto& request : requests) {
-            count += request.requestIds.size();
-        }
+    for (const auto& [_, batchIds] : mBatchIdsByClient) {
+        count += batchIds.size();
     }
     return count;
 }
@@ -131,59 +134,55 @@ size_t PendingRequestPool::countPendingRequests() const {
 size_t PendingRequestPool::countPendingRequests(const void* clientId) const {
     std::scoped_lock<std::mutex> lockGuard(mLock);
 
-    auto it = mPendingRequestsByClient.find(clientId);
-    if (it == mPendingRequestsByClient.end()) {
+    auto it = mBatchIdsByClient.find(clientId);
+    if (it == mBatchIdsByClient.end()) {
         return 0;
     }
-
-    size_t count = 0;
-    for (const auto& pendingRequest : it->second) {
-        count += pendingRequest.requestIds.size();
-    }
-
-    return count;
+    return it->second.size();
 }
 
 bool PendingRequestPool::isRequestPendingLocked(const void* clientId, int64_t requestId) const {
-    auto it = mPendingRequestsByClient.find(clientId);
-    if (it == mPendingRequestsByClient.end()) {
+    auto it = mBatchIdsByClient.find(clientId);
+    if (it == mBatchIdsByClient.end()) {
         return false;
     }
-    for (const auto& pendingRequest : it->second) {
-        const auto& requestIds = pendingRequest.requestIds;
-        if (requestIds.find(requestId) != requestIds.end()) {
-            return true;
-        }
-    }
-    return false;
+    return it->second.find(requestId) != it->second.end();
 }
 
-void PendingRequestPool::checkTimeout() {
+int64_t PendingRequestPool::checkTimeout() {
     std::vector<PendingRequest> timeoutRequests;
+    int64_t sleepTime = std::min(mTimeoutInNano, static_cast<int64_t>(CHECK_TIME_IN_NANO));
     {
         std::scoped_lock<std::mutex> lockGuard(mLock);
 
         int64_t currentTime = elapsedRealtimeNano();
 
-        std::vector<const void*> clientsWithEmptyRequests;
-
-        for (auto& [clientId, pendingRequests] : mPendingRequestsByClient) {
-            auto it = pendingRequests.begin();
-            while (it != pendingRequests.end()) {
-                if (it->timeoutTimestamp >= currentTime) {
-                    break;
-                }
-                timeoutRequests.push_back(std::move(*it));
-                it = pendingRequests.erase(it);
+        while (!mDeadlines.empty()) {
+            const Deadline& deadline = mDeadlines.front();
+            if (deadline.timeoutTimestamp >= currentTime) {
+                // Wake up right after the earliest deadline.
+                sleepTime = std::min(sleepTime, deadline.timeoutTimestamp - currentTime + 1);
+                break;
             }
-
-            if (pendingRequests.empty()) {
-                clientsWithEmptyRequests.push_back(clientId);
+            auto it = mPendingRequestsByBatchId.find(deadline.batchId);
+            mDeadlines.pop_front();
+            if (it == mPendingRequestsByBatchId.end()) {
+                // All the requests in this batch are already finished.
+                continue;
             }
-        }
 
-        for (const void* clientId : clientsWithEmptyRequests) {
-            mPendingRequestsByClient.erase(clientId);
+            PendingRequest& request = it->second;
+            auto clientIt = mBatchIdsByClient.find(request.clientId);
+            if (clientIt != mBatchIdsByClient.end()) {
+                for (int64_t requestId : request.requestIds) {
+                    clientIt->second.erase(requestId);
+                }
+                if (clientIt->second.empty()) {
+                    mBatchIdsByClient.erase(clientIt);
+                }
+            }
+            timeoutRequests.push_back(std::move(request));
+            mPendingRequestsByBatchId.erase(it);
         }
     }
 
@@ -191,6 +190,7 @@ void PendingRequestPool::checkTimeout() {
     for (const auto& request : timeoutRequests) {
         (*request.callback)(request.requestIds);
     }
+    return sleepTime;
 }
 
 std::unordered_set<int64_t> PendingRequestPool::tryFinishRequests(
@@ -199,27 +199,32 @@ std::unordered_set<int64_t> PendingRequestPool::tryFinishRequests(
 
     std::unordered_set<int64_t> foundIds;
 
-    if (mPendingRequestsByClient.find(clientId) == mPendingRequestsByClient.end()) {
+    auto clientIt = mBatchIdsByClient.find(clientId);
+    if (clientIt == mBatchIdsByClient.end()) {
         return foundIds;
     }
 
-    auto& pendingRequests = mPendingRequestsByClient[clientId];
-    auto it = pendingRequests.begin();
-    while (it != pendingRequests.end()) {
-        auto& pendingRequestIds = it->requestIds;
-        for (int64_t requestId : requestIds) {
-            auto idIt = pendingRequestIds.find(requestId);
-            if (idIt == pendingRequestIds.end()) {
-                continue;
-            }
-            pendingRequestIds.erase(idIt);
-            foundIds.insert(requestId);
+    auto& batchIds = clientIt->second;
+    for (int64_t requestId : requestIds) {
+        auto idIt = batchIds.find(requestId);
+        if (idIt == batchIds.end()) {
+            continue;
         }
-        if (pendingRequestIds.empty()) {
-            it = pendingRequests.erase(it);
+        auto batchIt = mPendingRequestsByBatchId.find(idIt->second);
+        batchIds.erase(idIt);
+        foundIds.insert(requestId);
+        if (batchIt == mPendingRequestsByBatchId.end()) {
             continue;
         }
-        it++;
+        auto& pendingRequestIds = batchIt->second.requestIds;
+        pendingRequestIds.erase(requestId);
+        if (pendingRequestIds.empty()) {
+            // The deadline for this batch stays in mDeadlines and is skipped when reached.
+            mPendingRequestsByBatchId.erase(batchIt);
+        }
+    }
+    if (batchIds.empty()) {
+        mBatchIdsByClient.erase(clientIt);
     }
 
     return foundIds;
@@ -47,25 +47,26 @@ void RecurrentTimer::registerTimerCallback(int64_t intervalInNano,
     {
         std::scoped_lock<std::mutex> lockGuard(mLock);
 
-        // Aligns the nextTime to multiply of interval.
-        int64_t nextTime = ceil(elapsedRealtimeNano() / intervalInNano) * intervalInNano;
-
-        std::unique_ptr<CallbackInfo> info = std::make_unique<CallbackInfo>();
-        info->callback = callback;
-        info->interval = intervalInNano;
-        info->nextTime = nextTime;
-
         auto it = mCallbacks.find(callback);
         if (it != mCallbacks.end()) {
             ALOGI("Replacing an existing timer callback with a new interval, current: %" PRId64
                   " ns, new: %" PRId64 " ns",
-                  it->second->interval, intervalInNano);
-            markOutdatedLocked(it->second);
+                  it->second.interval, intervalInNano);
+            removeCallbackLocked(it->second);
         }
-        mCallbacks[callback] = info.get();
-        mCallbackQueue.push_back(std::move(info));
-        // Insert the last element into the heap.
-        std::push_heap(mCallbackQueue.begin(), mCallbackQueue.end(), CallbackInfo::cmp);
+
+        auto [groupIt, inserted] = mGroupsByInterval.try_emplace(intervalInNano);
+        IntervalGroup& group = groupIt->second;
+        if (inserted) {
+            // Aligns the nextTime to multiply of interval.
+            group.nextTime = ceil(elapsedRealtimeNano() / intervalInNano) * intervalInNano;
+            mCallbackQueue.emplace(group.nextTime, intervalInNano);
+        }
+        mCallbacks[callback] = CallbackInfo{
+                .interval = intervalInNano,
+                .index = group.callbacks.size(),
+        };
+        group.callbacks.push_back(std::move(callback));
     }
     mCond.notify_one();
 }
@@ -80,34 +81,46 @@ void RecurrentTimer::unregisterTimerCallback(std::shared_ptr<RecurrentTimer::Cal
             return;
         }
 
-        markOutdatedLocked(it->second);
+        removeCallbackLocked(it->second);
         mCallbacks.erase(it);
     }
 
     mCond.notify_one();
 }
 
-void RecurrentTimer::markOutdatedLocked(RecurrentTimer::CallbackInfo* info) {
-    info->outdated = true;
-    info->callback = nullptr;
-    // Make sure the first element is always valid.
-    removeInvalidCallbackLocked();
-}
+void RecurrentTimer::removeCallbackLocked(const RecurrentTimer::CallbackInfo& info) {
+    auto groupIt = mGroupsByInterval.find(info.interval);
+    IntervalGroup& group = groupIt->second;
 
-void RecurrentTimer::removeInvalidCallbackLocked() {
-    while (mCallbackQueue.size() != 0 && mCallbackQueue[0]->outdated) {
-        std::pop_heap(mCallbackQueue.begin(), mCallbackQueue.end(), CallbackInfo::cmp);
-        mCallbackQueue.pop_back();
+    // Moves the last callback into the removed slot so that removal does not shift the others.
+    if (info.index != group.callbacks.size() - 1) {
+        group.callbacks[info.index] = std::move(group.callbacks.back());
+        mCallbacks[group.callbacks[info.index]].index = info.index;
+    }
+    group.callbacks.pop_back();
+
+    if (group.callbacks.empty()) {
+        mCallbackQueue.erase({group.nextTime, info.interval});
+        mGroupsByInterval.erase(groupIt);
     }
 }
 
-std::unique_ptr<RecurrentTimer::CallbackInfo> RecurrentTimer::popNextCallbackLocked() {
-    std::pop_heap(mCallbackQueue.begin(), mCallbackQueue.end(), CallbackInfo::cmp);
-    std::unique_ptr<CallbackInfo> info = std::move(mCallbackQueue[mCallbackQueue.size() - 1]);
-    mCallbackQueue.pop_back();
-    // Make sure the first element is always valid.
-    removeInvalidCallbackLocked();
-    return info;
+void RecurrentTimer::fireDueGroupsLocked(int64_t now) {
+    while (!mCallbackQueue.empty()) {
+        auto [nextTime, interval] = *mCallbackQueue.begin();
+        if (nextTime > now) {
+            break;
+        }
+        mCallbackQueue.erase(mCallbackQueue.begin());
+
+        IntervalGroup& group = mGroupsByInterval[interval];
+        group.nextTime += interval;
+        mCallbackQueue.emplace(group.nextTime, interval);
+
+        for (const auto& callback : group.callbacks) {
+            (*callback)();
+        }
+    }
 }
 
 void RecurrentTimer::loop() {
@@ -120,57 +133,28 @@ void RecurrentTimer::loop() {
             return mStopRequested || mCallbackQueue.size() != 0;
         });
 
-        int64_t interval;
-        {
-            ScopedLockAssertion lockAssertion(mLock);
-            if (mStopRequested) {
-                return;
-            }
-            // The first element is the nearest next event.
-            int64_t nextTime = mCallbackQueue[0]->nextTime;
-            int64_t now = elapsedRealtimeNano();
-            if (nextTime > now) {
-                interval = nextTime - now;
-            } else {
-                interval = 0;
-            }
+        ScopedLockAssertion lockAssertion(mLock);
+        if (mStopRequested) {
+            return;
         }
 
-        // Wait for the next event or the timer exits.
-        if (mCond.wait_for(uniqueLock, std::chrono::nanoseconds(interval), [this] {
-                ScopedLockAssertion lockAssertion(mLock);
-                return mStopRequested;
-            })) {
-            return;
+        // The first element is the nearest next event.
+        int64_t nextTime = mCallbackQueue.begin()->first;
+        int64_t now = elapsedRealtimeNano();
+        if (nextTime <= now) {
+            fireDueGroupsLocked(now);
+            continue;
         }
 
-        {
+        // Wait for the next event, the timer exits or an earlier event is registered.
+        mCond.wait_for(uniqueLock, std::chrono::nanoseconds(nextTime - now), [this, nextTime] {
             ScopedLockAssertion lockAssertion(mLock);
-            int64_t now = elapsedRealtimeNano();
-            while (mCallbackQueue.size() > 0) {
-                int64_t nextTime = mCallbackQueue[0]->nextTime;
-                if (nextTime > now) {
-                    break;
-                }
-
-                std::unique_ptr<CallbackInfo> info = popNextCallbackLocked();
-                info->nextTime += info->interval;
-
-                auto callback = info->callback;
-                mCallbackQueue.push_back(std::move(info));
-                std::push_heap(mCallbackQueue.begin(), mCallbackQueue.end(), CallbackInfo::cmp);
-
-                (*callback)();
-            }
-        }
+            return mStopRequested || mCallbackQueue.empty() ||
+                   mCallbackQueue.begin()->first != nextTime;
+        });
     }
 }
 
-bool RecurrentTimer::CallbackInfo::cmp(const std::unique_ptr<RecurrentTimer::CallbackInfo>& lhs,
-                                       const std::unique_ptr<RecurrentTimer::CallbackInfo>& rhs) {
-    return lhs->nextTime > rhs->nextTime;
-}
-
 }  // namespace vehicle
 }  // namespace automotive
 }  // namespace hardware
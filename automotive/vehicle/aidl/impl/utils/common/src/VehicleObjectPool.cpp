@@ -20,9 +20,13 @@
 
 #include <VehicleUtils.h>
 
+#include <android-base/stringprintf.h>
 #include <assert.h>
+#include <inttypes.h>
 #include <utils/Log.h>
 
+#include <algorithm>
+
 namespace android {
 namespace hardware {
 namespace automotive {
@@ -32,6 +36,68 @@ using ::aidl::android::hardware::automotive::vehicle::RawPropValues;
 using ::aidl::android::hardware::automotive::vehicle::VehicleProperty;
 using ::aidl::android::hardware::automotive::vehicle::VehiclePropertyType;
 using ::aidl::android::hardware::automotive::vehicle::VehiclePropValue;
+using ::android::base::StringPrintf;
+
+namespace {
+
+constexpr VehiclePropertyType RECYCLABLE_SINGLE_VALUE_TYPES[] = {
+        VehiclePropertyType::BOOLEAN,
+        VehiclePropertyType::INT32,
+        VehiclePropertyType::INT64,
+        VehiclePropertyType::FLOAT,
+};
+
+constexpr VehiclePropertyType RECYCLABLE_VECTOR_TYPES[] = {
+        VehiclePropertyType::INT32_VEC,
+        VehiclePropertyType::INT64_VEC,
+        VehiclePropertyType::FLOAT_VEC,
+        VehiclePropertyType::BYTES,
+};
+
+int32_t getPoolKey(VehiclePropertyType type, size_t sizeClass) {
+    // VehiclePropertyType is not overlapping with vectorSize.
+    return static_cast<int32_t>(type) | static_cast<int32_t>(sizeClass);
+}
+
+}  // namespace
+
+VehiclePropValuePool::VehiclePropValuePool(size_t maxRecyclableVectorSize,
+                                           size_t maxPoolObjectsSize)
+    : mMaxRecyclableVectorSize(maxRecyclableVectorSize), mMaxPoolObjectsSize(maxPoolObjectsSize) {
+    auto addPool = [this](VehiclePropertyType type, size_t sizeClass) {
+        mValueTypePools.emplace(getPoolKey(type, sizeClass),
+                                std::make_unique<InternalPool>(type, sizeClass, mMaxPoolObjectsSize,
+                                                               getVehiclePropValueSize));
+    };
+    for (VehiclePropertyType type : RECYCLABLE_SINGLE_VALUE_TYPES) {
+        addPool(type, 1);
+    }
+    for (VehiclePropertyType type : RECYCLABLE_VECTOR_TYPES) {
+        for (size_t vectorSize = 1; vectorSize <= mMaxRecyclableVectorSize; vectorSize++) {
+            size_t sizeClass = getSizeClass(vectorSize);
+            if (sizeClass == vectorSize) {
+                addPool(type, sizeClass);
+            }
+        }
+    }
+}
+
+size_t VehiclePropValuePool::getSizeClass(size_t vectorSize) const {
+    size_t sizeClass = 1;
+    while (sizeClass < vectorSize) {
+        sizeClass <<= 1;
+    }
+    return std::min(sizeClass, mMaxRecyclableVectorSize);
+}
+
+std::string VehiclePropValuePool::dumpStats() {
+    PoolStats* stats = PoolStats::instance();
+    return StringPrintf(
+            "Value pool: obtained: %" PRIu32 ", thread cache hit: %" PRIu32 ", miss: %" PRIu32
+            ", created: %" PRIu32 ", recycled: %" PRIu32 ", deleted: %" PRIu32 "\n",
+            stats->Obtained.load(), stats->Hit.load(), stats->Miss.load(), stats->Created.load(),
+            stats->Recycled.load(), stats->Deleted.load());
+}
 
 VehiclePropValuePool::RecyclableType VehiclePropValuePool::obtain(VehiclePropertyType type) {
     if (isComplexType(type)) {
@@ -103,19 +169,33 @@ VehiclePropValuePool::RecyclableType VehiclePropValuePool::obtainComplex() {
 
 VehiclePropValuePool::RecyclableType VehiclePropValuePool::obtainRecyclable(
         VehiclePropertyType type, size_t vectorSize) {
-    std::scoped_lock<std::mutex> lock(mLock);
     assert(vectorSize > 0);
 
-    // VehiclePropertyType is not overlapping with vectorSize.
-    int32_t key = static_cast<int32_t>(type) | static_cast<int32_t>(vectorSize);
-    auto it = mValueTypePools.find(key);
-
+    auto it = mValueTypePools.find(getPoolKey(type, getSizeClass(vectorSize)));
     if (it == mValueTypePools.end()) {
-        auto newPool(std::make_unique<InternalPool>(type, vectorSize, mMaxPoolObjectsSize,
-                                                    getVehiclePropValueSize));
-        it = mValueTypePools.emplace(key, std::move(newPool)).first;
+        // Not a recyclable type.
+        return obtainDisposable(type, vectorSize);
+    }
+    auto value = it->second->obtain();
+    // The value might come from a larger size class, resizing down keeps the capacity so the
+    // vector could be reused for any size within the class without reallocation.
+    switch (type) {
+        case VehiclePropertyType::INT32_VEC:
+            value->value.int32Values.resize(vectorSize);
+            break;
+        case VehiclePropertyType::INT64_VEC:
+            value->value.int64Values.resize(vectorSize);
+            break;
+        case VehiclePropertyType::FLOAT_VEC:
+            value->value.floatValues.resize(vectorSize);
+            break;
+        case VehiclePropertyType::BYTES:
+            value->value.byteValues.resize(vectorSize);
+            break;
+        default:
+            break;
     }
-    return it->second->obtain();
+    return value;
 }
 
 VehiclePropValuePool::RecyclableType VehiclePropValuePool::obtainBoolean(bool value) {
@@ -54,29 +54,53 @@ size_t VehiclePropertyStore::RecordIdHash::operator()(RecordId const& recordId)
     return res;
 }
 
-VehiclePropertyStore::~VehiclePropertyStore() {
-    std::scoped_lock<std::mutex> lockGuard(mLock);
+namespace {
+
+size_t roundUpToPowerOf2(size_t n) {
+    size_t result = 1;
+    while (result < n) {
+        result <<= 1;
+    }
+    return result;
+}
+
+}  // namespace
+
+VehiclePropertyStore::VehiclePropertyStore(std::shared_ptr<VehiclePropValuePool> valuePool,
+                                           size_t shardCount)
+    : mValuePool(valuePool), mShards(roundUpToPowerOf2(shardCount)) {}
 
+VehiclePropertyStore::~VehiclePropertyStore() {
     // Recycling record requires mValuePool, so need to recycle them before destroying mValuePool.
-    mRecordsByPropId.clear();
+    for (Shard& shard : mShards) {
+        std::scoped_lock<std::mutex> lockGuard(shard.lock);
+        shard.recordsByPropId.clear();
+    }
     mValuePool.reset();
 }
 
-const VehiclePropertyStore::Record* VehiclePropertyStore::getRecordLocked(int32_t propId) const
-        REQUIRES(mLock) {
-    auto RecordIt = mRecordsByPropId.find(propId);
-    return RecordIt == mRecordsByPropId.end() ? nullptr : &RecordIt->second;
+VehiclePropertyStore::Shard& VehiclePropertyStore::getShard(int32_t propId) {
+    return mShards[std::hash<int32_t>{}(propId) & (mShards.size() - 1)];
+}
+
+const VehiclePropertyStore::Shard& VehiclePropertyStore::getShard(int32_t propId) const {
+    return mShards[std::hash<int32_t>{}(propId) & (mShards.size() - 1)];
+}
+
+const VehiclePropertyStore::Record* VehiclePropertyStore::getRecordLocked(
+        const VehiclePropertyStore::Shard& shard, int32_t propId) const {
+    auto RecordIt = shard.recordsByPropId.find(propId);
+    return RecordIt == shard.recordsByPropId.end() ? nullptr : &RecordIt->second;
 }
 
-VehiclePropertyStore::Record* VehiclePropertyStore::getRecordLocked(int32_t propId)
-        REQUIRES(mLock) {
-    auto RecordIt = mRecordsByPropId.find(propId);
-    return RecordIt == mRecordsByPropId.end() ? nullptr : &RecordIt->second;
+VehiclePropertyStore::Record* VehiclePropertyStore::getRecordLocked(
+        VehiclePropertyStore::Shard& shard, int32_t propId) {
+    auto RecordIt = shard.recordsByPropId.find(propId);
+    return RecordIt == shard.recordsByPropId.end() ? nullptr : &RecordIt->second;
 }
 
-VehiclePropertyStore::RecordId VehiclePropertyStore::getRecordIdLocked(
-        const VehiclePropValue& propValue, const VehiclePropertyStore::Record& record) const
-        REQUIRES(mLock) {
+VehiclePropertyStore::RecordId VehiclePropertyStore::getRecordId(
+        const VehiclePropValue& propValue, const VehiclePropertyStore::Record& record) const {
     VehiclePropertyStore::RecordId recId{
             .area = isGlobalProp(propValue.prop) ? 0 : propValue.areaId, .token = 0};
 
@@ -87,7 +111,7 @@ VehiclePropertyStore::RecordId VehiclePropertyStore::getRecordIdLocked(
 }
 
 VhalResult<VehiclePropValuePool::RecyclableType> VehiclePropertyStore::readValueLocked(
-        const RecordId& recId, const Record& record) const REQUIRES(mLock) {
+        const RecordId& recId, const Record& record) const {
     if (auto it = record.values.find(recId); it != record.values.end()) {
         return mValuePool->obtain(*(it->second));
     }
@@ -97,9 +121,10 @@ VhalResult<VehiclePropValuePool::RecyclableType> VehiclePropertyStore::readValue
 
 void VehiclePropertyStore::registerProperty(const VehiclePropConfig& config,
                                             VehiclePropertyStore::TokenFunction tokenFunc) {
-    std::scoped_lock<std::mutex> g(mLock);
+    Shard& shard = getShard(config.prop);
+    std::scoped_lock<std::mutex> g(shard.lock);
 
-    mRecordsByPropId[config.prop] = Record{
+    shard.recordsByPropId[config.prop] = Record{
             .propConfig = config,
             .tokenFunction = tokenFunc,
     };
@@ -107,11 +132,12 @@ void VehiclePropertyStore::registerProperty(const VehiclePropConfig& config,
 
 VhalResult<void> VehiclePropertyStore::writeValue(VehiclePropValuePool::RecyclableType propValue,
                                                   bool updateStatus) {
-    std::scoped_lock<std::mutex> g(mLock);
-
     int32_t propId = propValue->prop;
 
-    VehiclePropertyStore::Record* record = getRecordLocked(propId);
+    Shard& shard = getShard(propId);
+    std::scoped_lock<std::mutex> g(shard.lock);
+
+    VehiclePropertyStore::Record* record = getRecordLocked(shard, propId);
     if (record == nullptr) {
         return StatusError(StatusCode::INVALID_ARG) << "property: " << propId << " not registered";
     }
@@ -121,7 +147,7 @@ VhalResult<void> VehiclePropertyStore::writeValue(VehiclePropValuePool::Recyclab
                << "no config for property: " << propId << " area: " << propValue->areaId;
     }
 
-    VehiclePropertyStore::RecordId recId = getRecordIdLocked(*propValue, *record);
+    VehiclePropertyStore::RecordId recId = getRecordId(*propValue, *record);
     bool valueUpdated = true;
     if (auto it = record->values.find(recId); it != record->values.end()) {
         const VehiclePropValue* valueToUpdate = it->second.get();
@@ -145,30 +171,37 @@ VhalResult<void> VehiclePropertyStore::writeValue(VehiclePropValuePool::Recyclab
     }
 
     record->values[recId] = std::move(propValue);
-    if (valueUpdated && mOnValueChangeCallback != nullptr) {
-        mOnValueChangeCallback(*(record->values[recId]));
+    if (!valueUpdated) {
+        return {};
+    }
+    std::shared_ptr<const OnValueChangeCallback> callback =
+            std::atomic_load(&mOnValueChangeCallback);
+    if (callback != nullptr && *callback != nullptr) {
+        (*callback)(*(record->values[recId]));
     }
     return {};
 }
 
 void VehiclePropertyStore::removeValue(const VehiclePropValue& propValue) {
-    std::scoped_lock<std::mutex> g(mLock);
+    Shard& shard = getShard(propValue.prop);
+    std::scoped_lock<std::mutex> g(shard.lock);
 
-    VehiclePropertyStore::Record* record = getRecordLocked(propValue.prop);
+    VehiclePropertyStore::Record* record = getRecordLocked(shard, propValue.prop);
     if (record == nullptr) {
         return;
     }
 
-    VehiclePropertyStore::RecordId recId = getRecordIdLocked(propValue, *record);
+    VehiclePropertyStore::RecordId recId = getRecordId(propValue, *record);
     if (auto it = record->values.find(recId); it != record->values.end()) {
         record->values.erase(it);
     }
 }
 
 void VehiclePropertyStore::removeValuesForProperty(int32_t propId) {
-    std::scoped_lock<std::mutex> g(mLock);
+    Shard& shard = getShard(propId);
+    std::scoped_lock<std::mutex> g(shard.lock);
 
-    VehiclePropertyStore::Record* record = getRecordLocked(propId);
+    VehiclePropertyStore::Record* record = getRecordLocked(shard, propId);
     if (record == nullptr) {
         return;
     }
@@ -177,13 +210,16 @@ void VehiclePropertyStore::removeValuesForProperty(int32_t propId) {
 }
 
 std::vector<VehiclePropValuePool::RecyclableType> VehiclePropertyStore::readAllValues() const {
-    std::scoped_lock<std::mutex> g(mLock);
-
     std::vector<VehiclePropValuePool::RecyclableType> allValues;
 
-    for (auto const& [_, record] : mRecordsByPropId) {
-        for (auto const& [_, value] : record.values) {
-            allValues.push_back(std::move(mValuePool->obtain(*value)));
+    // Shards are locked one at a time so that a full read never stalls all the writers at once.
+    for (const Shard& shard : mShards) {
+        std::scoped_lock<std::mutex> g(shard.lock);
+
+        for (auto const& [_, record] : shard.recordsByPropId) {
+            for (auto const& [_, value] : record.values) {
+                allValues.push_back(std::move(mValuePool->obtain(*value)));
+            }
         }
     }
 
@@ -192,11 +228,12 @@ std::vector<VehiclePropValuePool::RecyclableType> VehiclePropertyStore::readAllV
 
 VehiclePropertyStore::ValuesResultType VehiclePropertyStore::readValuesForProperty(
         int32_t propId) const {
-    std::scoped_lock<std::mutex> g(mLock);
+    const Shard& shard = getShard(propId);
+    std::scoped_lock<std::mutex> g(shard.lock);
 
     std::vector<VehiclePropValuePool::RecyclableType> values;
 
-    const VehiclePropertyStore::Record* record = getRecordLocked(propId);
+    const VehiclePropertyStore::Record* record = getRecordLocked(shard, propId);
     if (record == nullptr) {
         return StatusError(StatusCode::INVALID_ARG) << "property: " << propId << " not registered";
     }
@@ -209,24 +246,26 @@ VehiclePropertyStore::ValuesResultType VehiclePropertyStore::readValuesForProper
 
 VehiclePropertyStore::ValueResultType VehiclePropertyStore::readValue(
         const VehiclePropValue& propValue) const {
-    std::scoped_lock<std::mutex> g(mLock);
-
     int32_t propId = propValue.prop;
-    const VehiclePropertyStore::Record* record = getRecordLocked(propId);
+    const Shard& shard = getShard(propId);
+    std::scoped_lock<std::mutex> g(shard.lock);
+
+    const VehiclePropertyStore::Record* record = getRecordLocked(shard, propId);
     if (record == nullptr) {
         return StatusError(StatusCode::INVALID_ARG) << "property: " << propId << " not registered";
     }
 
-    VehiclePropertyStore::RecordId recId = getRecordIdLocked(propValue, *record);
+    VehiclePropertyStore::RecordId recId = getRecordId(propValue, *record);
     return readValueLocked(recId, *record);
 }
 
 VehiclePropertyStore::ValueResultType VehiclePropertyStore::readValue(int32_t propId,
                                                                       int32_t areaId,
                                                                       int64_t token) const {
-    std::scoped_lock<std::mutex> g(mLock);
+    const Shard& shard = getShard(propId);
+    std::scoped_lock<std::mutex> g(shard.lock);
 
-    const VehiclePropertyStore::Record* record = getRecordLocked(propId);
+    const VehiclePropertyStore::Record* record = getRecordLocked(shard, propId);
     if (record == nullptr) {
         return StatusError(StatusCode::INVALID_ARG) << "property: " << propId << " not registered";
     }
@@ -236,20 +275,22 @@ VehiclePropertyStore::ValueResultType VehiclePropertyStore::readValue(int32_t pr
 }
 
 std::vector<VehiclePropConfig> VehiclePropertyStore::getAllConfigs() const {
-    std::scoped_lock<std::mutex> g(mLock);
-
     std::vector<VehiclePropConfig> configs;
-    configs.reserve(mRecordsByPropId.size());
-    for (auto& [_, config] : mRecordsByPropId) {
-        configs.push_back(config.propConfig);
+    for (const Shard& shard : mShards) {
+        std::scoped_lock<std::mutex> g(shard.lock);
+
+        for (auto& [_, config] : shard.recordsByPropId) {
+            configs.push_back(config.propConfig);
+        }
     }
     return configs;
 }
 
 VhalResult<const VehiclePropConfig*> VehiclePropertyStore::getConfig(int32_t propId) const {
-    std::scoped_lock<std::mutex> g(mLock);
+    const Shard& shard = getShard(propId);
+    std::scoped_lock<std::mutex> g(shard.lock);
 
-    const VehiclePropertyStore::Record* record = getRecordLocked(propId);
+    const VehiclePropertyStore::Record* record = getRecordLocked(shard, propId);
     if (record == nullptr) {
         return StatusError(StatusCode::INVALID_ARG) << "property: " << propId << " not registered";
     }
@@ -259,9 +300,8 @@ VhalResult<const VehiclePropConfig*> VehiclePropertyStore::getConfig(int32_t pro
 
 void VehiclePropertyStore::setOnValueChangeCallback(
         const VehiclePropertyStore::OnValueChangeCallback& callback) {
-    std::scoped_lock<std::mutex> g(mLock);
-
-    mOnValueChangeCallback = callback;
+    std::atomic_store(&mOnValueChangeCallback,
+                      std::make_shared<const OnValueChangeCallback>(callback));
 }
 
 }  // namespace vehicle
@@ -268,6 +268,58 @@ TEST_F(PendingRequestPoolTest, testPendingRequestCountLimit) {
     getPool()->tryFinishRequests(reinterpret_cast<const void*>(0), requests);
 }
 
+TEST_F(PendingRequestPoolTest, testManyPendingRequests) {
+    // MAX_PENDING_REQUEST_PER_CLIENT = 10000
+    constexpr size_t CLIENT_COUNT = 10;
+    constexpr int64_t REQUEST_COUNT_PER_CLIENT = 10000;
+    constexpr int64_t BATCH_SIZE = 10;
+    // Use a longer timeout so that no request times out before all of them are added.
+    constexpr int64_t TIMEOUT_IN_NANO = 10'000'000'000;
+    auto pool = std::make_unique<PendingRequestPool>(TIMEOUT_IN_NANO);
+    std::mutex lock;
+    std::vector<int64_t> timeoutRequestIds;
+    auto callback = std::make_shared<PendingRequestPool::TimeoutCallbackFunc>(
+            [&lock, &timeoutRequestIds](const std::unordered_set<int64_t>& requests) {
+                std::scoped_lock<std::mutex> lockGuard(lock);
+                for (int64_t request : requests) {
+                    timeoutRequestIds.push_back(request);
+                }
+            });
+
+    for (size_t i = 0; i < CLIENT_COUNT; i++) {
+        const void* clientId = reinterpret_cast<const void*>(i);
+        for (int64_t j = 0; j < REQUEST_COUNT_PER_CLIENT; j += BATCH_SIZE) {
+            std::unordered_set<int64_t> requestIds;
+            for (int64_t k = j; k < j + BATCH_SIZE; k++) {
+                requestIds.insert(k);
+            }
+            ASSERT_RESULT_OK(pool->addRequests(clientId, requestIds, callback));
+        }
+    }
+
+    ASSERT_EQ(pool->countPendingRequests(), CLIENT_COUNT * REQUEST_COUNT_PER_CLIENT);
+
+    // Finish all the even requests one by one, in reverse order.
+    for (size_t i = 0; i < CLIENT_COUNT; i++) {
+        const void* clientId = reinterpret_cast<const void*>(i);
+        for (int64_t j = REQUEST_COUNT_PER_CLIENT - 2; j >= 0; j -= 2) {
+            ASSERT_THAT(pool->tryFinishRequests(clientId, {j}), UnorderedElementsAre(j));
+        }
+    }
+
+    ASSERT_EQ(pool->countPendingRequests(), CLIENT_COUNT * REQUEST_COUNT_PER_CLIENT / 2);
+    ASSERT_FALSE(pool->isRequestPending(reinterpret_cast<const void*>(0), 0));
+    ASSERT_TRUE(pool->isRequestPending(reinterpret_cast<const void*>(0), 1));
+
+    // Destroying the pool sends out all the remaining requests as timeout.
+    pool.reset();
+
+    ASSERT_EQ(timeoutRequestIds.size(), CLIENT_COUNT * REQUEST_COUNT_PER_CLIENT / 2);
+    for (int64_t requestId : timeoutRequestIds) {
+        ASSERT_EQ(requestId % 2, 1);
+    }
+}
+
 }  // namespace vehicle
 }  // namespace automotive
 }  // namespace hardware
@@ -19,6 +19,7 @@
 #include <android-base/thread_annotations.h>
 #include <gtest/gtest.h>
 
+#include <algorithm>
 #include <chrono>
 #include <memory>
 #include <mutex>
@@ -186,6 +187,38 @@ TEST_F(RecurrentTimerTest, testRegisterSameCallbackMultipleTimes) {
     ASSERT_EQ(countTimerCallbackQueue(&timer), static_cast<size_t>(0));
 }
 
+TEST_F(RecurrentTimerTest, testRegisterCallbacksWithSameInterval) {
+    RecurrentTimer timer;
+    // 0.01s
+    int64_t interval = 10000000;
+    auto action1 = getCallback(1);
+    auto action2 = getCallback(2);
+    auto action3 = getCallback(3);
+
+    timer.registerTimerCallback(interval, action1);
+    timer.registerTimerCallback(interval, action2);
+    timer.registerTimerCallback(interval, action3);
+
+    // Callbacks with the same interval share one entry in the callback queue.
+    ASSERT_EQ(countTimerCallbackQueue(&timer), static_cast<size_t>(1));
+
+    timer.unregisterTimerCallback(action1);
+    clearCalledCallbacks();
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+    std::vector<size_t> calledCallbacks = getCalledCallbacks();
+    ASSERT_EQ(std::count(calledCallbacks.begin(), calledCallbacks.end(), 1), 0);
+    // Theoretically trigger 10 times, but check for at least 9 times to be stable.
+    ASSERT_GE(std::count(calledCallbacks.begin(), calledCallbacks.end(), 2), 9);
+    ASSERT_GE(std::count(calledCallbacks.begin(), calledCallbacks.end(), 3), 9);
+
+    timer.unregisterTimerCallback(action2);
+    timer.unregisterTimerCallback(action3);
+
+    ASSERT_EQ(countTimerCallbackQueue(&timer), static_cast<size_t>(0));
+}
+
 }  // namespace vehicle
 }  // namespace automotive
 }  // namespace hardware
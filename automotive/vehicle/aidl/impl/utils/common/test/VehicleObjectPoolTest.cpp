@@ -134,6 +134,8 @@ class VehicleObjectPoolTest : public ::testing::Test {
   private:
     void resetStats() {
         mStats->Obtained = 0;
+        mStats->Hit = 0;
+        mStats->Miss = 0;
         mStats->Created = 0;
         mStats->Recycled = 0;
         mStats->Deleted = 0;
@@ -361,6 +363,95 @@ TEST_F(VehicleObjectPoolTest, testMultithreaded) {
     ASSERT_LE(mStats->Created, static_cast<uint32_t>(T * O));
 }
 
+TEST_F(VehicleObjectPoolTest, testObtainFromSameSizeClass) {
+    auto value = mValuePool->obtain(VehiclePropertyType::INT32_VEC, 4);
+    void* raw = value.get();
+    value.reset();
+
+    // Vector size 3 is in the same size class as 4.
+    auto newValue = mValuePool->obtain(VehiclePropertyType::INT32_VEC, 3);
+
+    ASSERT_EQ(newValue.get(), raw);
+    ASSERT_EQ(newValue->value.int32Values.size(), 3u);
+    ASSERT_EQ(mStats->Created, 1u);
+}
+
+TEST_F(VehicleObjectPoolTest, testObtainFromDifferentSizeClass) {
+    auto value = mValuePool->obtain(VehiclePropertyType::INT32_VEC, 4);
+    void* raw = value.get();
+    value.reset();
+
+    auto newValue = mValuePool->obtain(VehiclePropertyType::INT32_VEC, 2);
+
+    ASSERT_NE(newValue.get(), raw);
+    ASSERT_EQ(newValue->value.int32Values.size(), 2u);
+    ASSERT_EQ(mStats->Created, 2u);
+}
+
+TEST_F(VehicleObjectPoolTest, testThreadCacheHit) {
+    std::vector<recyclable_ptr<VehiclePropValue>> vec;
+    for (size_t i = 0; i < 2; i++) {
+        vec.push_back(mValuePool->obtain(VehiclePropertyType::INT32));
+    }
+    // Both values go to this thread's cache.
+    vec.clear();
+    for (size_t i = 0; i < 2; i++) {
+        vec.push_back(mValuePool->obtain(VehiclePropertyType::INT32));
+    }
+
+    ASSERT_EQ(mStats->Obtained, 4u);
+    ASSERT_EQ(mStats->Hit, 2u);
+    ASSERT_EQ(mStats->Miss, 2u);
+    ASSERT_EQ(mStats->Created, 2u);
+}
+
+TEST_F(VehicleObjectPoolTest, testRecycleFromAnotherThread) {
+    auto value = mValuePool->obtain(VehiclePropertyType::INT32);
+    void* raw = value.get();
+
+    // The value is recycled to the other thread's cache first, and then to the shared pool when
+    // the other thread's cache is full.
+    std::thread t([this, &value]() {
+        std::vector<recyclable_ptr<VehiclePropValue>> vec;
+        for (size_t i = 0; i < ObjectPool<VehiclePropValue>::DEFAULT_MAX_THREAD_CACHE_COUNT;
+             i++) {
+            vec.push_back(mValuePool->obtain(VehiclePropertyType::INT32));
+        }
+        vec.clear();
+        value.reset();
+    });
+    t.join();
+
+    ASSERT_EQ(mValuePool->obtain(VehiclePropertyType::INT32).get(), raw);
+    ASSERT_EQ(mStats->Hit, 0u);
+}
+
+TEST_F(VehicleObjectPoolTest, testThreadCacheCountsAgainstMemoryLimitation) {
+    size_t valueSize = getVehiclePropValueSize(*mValuePool->obtain(VehiclePropertyType::INT32));
+    // Only 2 values fit in the pool, even though each thread cache could hold more.
+    VehiclePropValuePool pool(/*maxRecyclableVectorSize=*/4, /*maxPoolObjectsSize=*/2 * valueSize);
+
+    // Values cached by a thread give their share of the limit back when the thread exits.
+    std::thread t([&pool]() {
+        std::vector<recyclable_ptr<VehiclePropValue>> vec;
+        for (size_t i = 0; i < 2; i++) {
+            vec.push_back(pool.obtain(VehiclePropertyType::INT32));
+        }
+    });
+    t.join();
+
+    uint32_t recycled = mStats->Recycled;
+    uint32_t deleted = mStats->Deleted;
+    std::vector<recyclable_ptr<VehiclePropValue>> vec;
+    for (size_t i = 0; i < 10; i++) {
+        vec.push_back(pool.obtain(VehiclePropertyType::INT32));
+    }
+    vec.clear();
+
+    ASSERT_EQ(mStats->Recycled - recycled, 2u);
+    ASSERT_EQ(mStats->Deleted - deleted, 8u);
+}
+
 TEST_F(VehicleObjectPoolTest, testMemoryLimitation) {
     std::vector<recyclable_ptr<VehiclePropValue>> vec;
     for (size_t i = 0; i < 10000; i++) {
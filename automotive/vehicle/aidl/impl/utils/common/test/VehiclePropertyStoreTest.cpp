@@ -21,6 +21,9 @@
 #include <gmock/gmock.h>
 #include <gtest/gtest.h>
 
+#include <thread>
+#include <vector>
+
 namespace android {
 namespace hardware {
 namespace automotive {
@@ -448,6 +451,65 @@ TEST_F(VehiclePropertyStoreTest, testPropertyChangeCallbackNoUpdate) {
     ASSERT_EQ(updatedValue.prop, INVALID_PROP_ID);
 }
 
+TEST_F(VehiclePropertyStoreTest, testSingleShard) {
+    VehiclePropertyStore store(mValuePool, /*shardCount=*/1);
+    store.registerProperty(mConfigFuelCapacity);
+    VehiclePropValue fuelCapacity = {
+            .prop = toInt(VehicleProperty::INFO_FUEL_CAPACITY),
+            .value = {.floatValues = {1.0}},
+    };
+
+    ASSERT_RESULT_OK(store.writeValue(mValuePool->obtain(fuelCapacity)));
+
+    auto result = store.readValue(fuelCapacity);
+    ASSERT_RESULT_OK(result);
+    ASSERT_EQ(result.value()->value.floatValues, std::vector<float>({1.0}));
+    ASSERT_EQ(store.getAllConfigs().size(), static_cast<size_t>(1));
+}
+
+TEST_F(VehiclePropertyStoreTest, testConcurrentReadWrite) {
+    constexpr int32_t WRITE_COUNT = 1000;
+    int32_t tirePressure = toInt(VehicleProperty::TIRE_PRESSURE);
+    std::vector<std::thread> threads;
+
+    threads.emplace_back([this] {
+        for (int64_t i = 0; i < WRITE_COUNT; i++) {
+            VehiclePropValue fuelCapacity = {
+                    .timestamp = i,
+                    .prop = toInt(VehicleProperty::INFO_FUEL_CAPACITY),
+                    .value = {.floatValues = {static_cast<float>(i)}},
+            };
+            ASSERT_RESULT_OK(mStore->writeValue(mValuePool->obtain(fuelCapacity)));
+        }
+    });
+    threads.emplace_back([this, tirePressure] {
+        for (int64_t i = 0; i < WRITE_COUNT; i++) {
+            VehiclePropValue value = {
+                    .timestamp = i,
+                    .areaId = WHEEL_FRONT_LEFT,
+                    .prop = tirePressure,
+                    .value = {.floatValues = {static_cast<float>(i)}},
+            };
+            ASSERT_RESULT_OK(mStore->writeValue(mValuePool->obtain(value)));
+        }
+    });
+    threads.emplace_back([this, tirePressure] {
+        for (int32_t i = 0; i < WRITE_COUNT; i++) {
+            mStore->readValue(tirePressure, WHEEL_FRONT_LEFT);
+            mStore->readAllValues();
+        }
+    });
+
+    for (auto& thread : threads) {
+        thread.join();
+    }
+
+    auto result = mStore->readValue(tirePressure, WHEEL_FRONT_LEFT);
+    ASSERT_RESULT_OK(result);
+    ASSERT_EQ(result.value()->timestamp, WRITE_COUNT - 1);
+    ASSERT_EQ(mStore->readAllValues().size(), static_cast<size_t>(2));
+}
+
 }  // namespace vehicle
 }  // namespace automotive
 }  // namespace hardware
@@ -21,6 +21,7 @@
 
 #include <gtest/gtest.h>
 
+#include <algorithm>
 #include <atomic>
 #include <thread>
 #include <vector>
@@ -762,6 +763,116 @@ TEST(VehicleUtilsTest, testConcurrentQueueDeactivateNotifyWaitingThread) {
     t.join();
 }
 
+TEST(VehicleUtilsTest, testBoundedMpscQueueOneThread) {
+    BoundedMpscQueue<int> queue(/*capacity=*/4);
+
+    ASSERT_TRUE(queue.push(1));
+    ASSERT_TRUE(queue.push(2));
+    auto result = queue.flush();
+
+    ASSERT_EQ(result, std::vector<int>({1, 2}));
+}
+
+TEST(VehicleUtilsTest, testBoundedMpscQueuePushWhenFull) {
+    BoundedMpscQueue<int> queue(/*capacity=*/3);
+
+    // Capacity is rounded up to 4.
+    for (int i = 0; i < 4; i++) {
+        ASSERT_TRUE(queue.push(std::move(i)));
+    }
+    ASSERT_FALSE(queue.push(4));
+    ASSERT_EQ(queue.flush(), std::vector<int>({0, 1, 2, 3}));
+
+    // Slots are reusable after flush.
+    ASSERT_TRUE(queue.push(5));
+    ASSERT_EQ(queue.flush(), std::vector<int>({5}));
+}
+
+TEST(VehicleUtilsTest, testBoundedMpscQueueBatchPush) {
+    BoundedMpscQueue<int> queue(/*capacity=*/4);
+
+    ASSERT_EQ(queue.push(std::vector<int>({1, 2, 3})), 3u);
+    // Only one slot left, the rest of the batch is dropped.
+    ASSERT_EQ(queue.push(std::vector<int>({4, 5})), 1u);
+
+    ASSERT_EQ(queue.flush(), std::vector<int>({1, 2, 3, 4}));
+}
+
+TEST(VehicleUtilsTest, testBoundedMpscQueueMultipleThreads) {
+    BoundedMpscQueue<int> queue(/*capacity=*/16);
+    std::vector<int> results;
+    std::atomic<bool> stop = false;
+
+    auto producer = [&queue](int value) {
+        for (int i = 0; i < 1000; i++) {
+            while (!queue.push(std::move(value))) {
+                std::this_thread::yield();
+            }
+        }
+    };
+    std::thread t1(producer, 0);
+    std::thread t2(producer, 1);
+    std::thread t3([&queue]() {
+        for (int i = 0; i < 100; i++) {
+            std::vector<int> batch(10, 2);
+            size_t pushed = 0;
+            while (pushed < batch.size()) {
+                std::vector<int> remaining(batch.begin() + pushed, batch.end());
+                pushed += queue.push(std::move(remaining));
+            }
+        }
+    });
+    std::thread consumer([&queue, &results, &stop]() {
+        while (!stop) {
+            queue.waitForItems();
+            for (int i : queue.flush()) {
+                results.push_back(i);
+            }
+        }
+
+        // After we stop, get all the remaining values in the queue.
+        for (int i : queue.flush()) {
+            results.push_back(i);
+        }
+    });
+
+    t1.join();
+    t2.join();
+    t3.join();
+
+    stop = true;
+    queue.deactivate();
+    consumer.join();
+
+    EXPECT_EQ(results.size(), static_cast<size_t>(3000));
+    EXPECT_EQ(std::count(results.begin(), results.end(), 0), 1000);
+    EXPECT_EQ(std::count(results.begin(), results.end(), 1), 1000);
+    EXPECT_EQ(std::count(results.begin(), results.end(), 2), 1000);
+}
+
+TEST(VehicleUtilsTest, testBoundedMpscQueuePushAfterDeactivate) {
+    BoundedMpscQueue<int> queue(/*capacity=*/4);
+
+    queue.deactivate();
+
+    ASSERT_FALSE(queue.push(1));
+    ASSERT_EQ(queue.push(std::vector<int>({1, 2})), 0u);
+    ASSERT_TRUE(queue.flush().empty());
+}
+
+TEST(VehicleUtilsTest, testBoundedMpscQueueDeactivateNotifyWaitingThread) {
+    BoundedMpscQueue<int> queue(/*capacity=*/4);
+
+    std::thread t([&queue]() {
+        // This would block until queue is deactivated.
+        queue.waitForItems();
+    });
+
+    queue.deactivate();
+
+    t.join();
+}
+
 TEST(VehicleUtilsTest, testVhalError) {
     VhalResult<void> result = Error<VhalError>(StatusCode::INVALID_ARG) << "error message";
 
@@ -25,8 +25,15 @@
 
 #include <aidl/android/hardware/automotive/vehicle/IVehicleCallback.h>
 #include <android-base/result.h>
+#include <android-base/thread_annotations.h>
+#include <android/binder_auto_utils.h>
+#include <android/binder_parcel.h>
 
+#include <functional>
 #include <memory>
+#include <mutex>
+#include <optional>
+#include <unordered_map>
 #include <unordered_set>
 #include <vector>
 
@@ -99,6 +106,84 @@ class GetSetValuesClient final : public ConnectedClient {
     std::shared_ptr<const std::function<void(std::vector<ResultType>)>> mResultCallback;
 };
 
+// A class to keep track of the shared memory files lent to a subscription client through
+// {@code onPropertyEvent}. A file is lent until the client returns it through
+// {@code IVehicle.returnSharedMemory}. Returned files stay mapped and are reused for later events,
+// so a busy client does not cost a new file and mapping for every large event.
+// This class is thread-safe.
+class SharedMemoryTracker final {
+  public:
+    // A value for {@code setMaxFileCount} that puts no limit on the number of lent files.
+    static constexpr int32_t UNLIMITED_FILE_COUNT = -1;
+    // The maximum number of returned files kept mapped for reuse.
+    static constexpr size_t MAX_FREE_FILE_COUNT = 4;
+    // The minimum size of a shared memory file. Sizes are rounded up to a power of two so that a
+    // returned file fits most later events.
+    static constexpr size_t MIN_FILE_SIZE = 16 * 1024;
+
+    // A shared memory file lent to the client.
+    struct LentFile {
+        int64_t sharedMemoryId;
+        ndk::ScopedFileDescriptor fd;
+    };
+
+    ~SharedMemoryTracker();
+
+    // Sets the maximum number of shared memory files that could be lent to the client at the same
+    // time. A value of 0 means a new file is created for every event and never reused, such a file
+    // is not tracked and need not be returned. {@code UNLIMITED_FILE_COUNT} means there is no
+    // limit.
+    void setMaxFileCount(int32_t maxFileCount);
+
+    // Copies the marshaled 'parcel' into a shared memory file, reusing a returned file if one is
+    // large enough, and lends the file to the client. Returns {@code std::nullopt} if the client
+    // already holds the maximum number of files or the file could not be written. 'fileCount' is
+    // set to the number of files lent to the client, including the new one. If the maximum number
+    // of files is 0, the file is created by {@code lendOnce} instead and is not counted.
+    std::optional<LentFile> tryLend(const AParcel* parcel, int32_t* fileCount);
+
+    // Copies the marshaled 'parcel' into a new shared memory file that is not tracked. The file's
+    // ID is {@code IVehicle.INVALID_MEMORY_ID}, so the client never returns it and the file is
+    // freed once the client closes it. Returns {@code std::nullopt} if the file could not be
+    // written.
+    static std::optional<LentFile> lendOnce(const AParcel* parcel);
+
+    // Marks the file with the ID as returned. Returns {@code INVALID_ARG} error if the file is not
+    // currently lent to the client.
+    VhalResult<void> giveBack(int64_t sharedMemoryId);
+
+    // Gets the number of files that are lent to the client and not yet returned.
+    int32_t countLentFiles();
+
+    // Forgets all the lent files and unmaps all the files kept for reuse. Called when the client
+    // dies, since it would never return the files it holds.
+    void releaseAll();
+
+  private:
+    // A shared memory file together with the writable mapping made before it was sealed
+    // read-only.
+    struct Region {
+        ndk::ScopedFileDescriptor fd;
+        void* address = nullptr;
+        size_t size = 0;
+
+        ~Region();
+    };
+
+    static std::unique_ptr<Region> createRegion(size_t size);
+    // Copies the marshaled 'parcel' into the region and returns a new descriptor of the region's
+    // file to send to the client, or an invalid descriptor on failure.
+    static ndk::ScopedFileDescriptor fillRegion(Region* region, const AParcel* parcel);
+
+    std::mutex mLock;
+    int32_t mMaxFileCount GUARDED_BY(mLock) = 0;
+    // The last assigned shared memory ID. IDs start from 1 since 0 is
+    // {@code IVehicle.INVALID_MEMORY_ID}.
+    int64_t mLastId GUARDED_BY(mLock) = 0;
+    std::unordered_map<int64_t, std::unique_ptr<Region>> mLentRegions GUARDED_BY(mLock);
+    std::vector<std::unique_ptr<Region>> mFreeRegions GUARDED_BY(mLock);
+};
+
 // A class to represent a client that calls {@code IVehicle.subscribe}.
 class SubscriptionClient final : public ConnectedClient {
   public:
@@ -107,10 +192,47 @@ class SubscriptionClient final : public ConnectedClient {
     // Gets the callback to be called when the request for this client has finished.
     std::shared_ptr<const IVehicleHardware::GetValuesCallback> getResultCallback();
 
+    // Sets the maximum number of shared memory files that could be lent to this client at the same
+    // time. A value of 0 means a new file is created for every event and never reused,
+    // {@code SharedMemoryTracker::UNLIMITED_FILE_COUNT} means there is no limit.
+    void setMaxSharedMemoryFileCount(int32_t maxSharedMemoryFileCount);
+
+    // Marks the shared memory file with the ID as returned by the client. Returns
+    // {@code INVALID_ARG} error if the file is not currently lent to the client.
+    VhalResult<void> returnSharedMemory(int64_t sharedMemoryId);
+
+    // Gets the number of shared memory files that are lent to the client and not yet returned.
+    int32_t countSharedMemoryFiles();
+
+    // Releases all the shared memory files lent to this client. Must be called when the client
+    // dies.
+    void releaseSharedMemory();
+
+    // Sends the updated values to this client through {@code onPropertyEvent} callback.
+    void sendUpdatedValues(
+            std::vector<aidl::android::hardware::automotive::vehicle::VehiclePropValue>&&
+                    updatedValues);
+
+    // Queues the updated values to be sent to this client in the next {@code flushUpdatedValues}
+    // call. If 'canCoalesce' returns true for a value, the value replaces the queued value for the
+    // same [propId, areaId], if any.
+    void queueUpdatedValues(
+            const std::vector<
+                    const aidl::android::hardware::automotive::vehicle::VehiclePropValue*>&
+                    updatedValues,
+            const std::function<bool(const PropIdAreaId&)>& canCoalesce);
+
+    // Sends all the queued values to this client through one {@code onPropertyEvent} callback.
+    void flushUpdatedValues();
+
     // Marshals the updated values into largeParcelable and sents it through {@code onPropertyEvent}
-    // callback.
+    // callback. If the values do not fit in the binder payload, they are put into a shared memory
+    // file that is lent to the client until it is returned. If the client already holds the
+    // maximum number of shared memory files, the values are split into several callback
+    // invocations that each fit in the binder payload instead, and a single value that does not
+    // fit is sent through a shared memory file that is not tracked.
     static void sendUpdatedValues(
-            CallbackType callback,
+            CallbackType callback, std::shared_ptr<SharedMemoryTracker> sharedMemoryTracker,
             std::vector<aidl::android::hardware::automotive::vehicle::VehiclePropValue>&&
                     updatedValues);
 
@@ -123,11 +245,36 @@ class SubscriptionClient final : public ConnectedClient {
     std::shared_ptr<const PendingRequestPool::TimeoutCallbackFunc> mTimeoutCallback;
     std::shared_ptr<const IVehicleHardware::GetValuesCallback> mResultCallback;
     std::shared_ptr<const IVehicleHardware::PropertyChangeCallback> mPropertyChangeCallback;
+    // SharedMemoryTracker is thread-safe. It is shared with mResultCallback which might outlive
+    // this client.
+    std::shared_ptr<SharedMemoryTracker> mSharedMemoryTracker;
+
+    std::mutex mLock;
+    std::vector<aidl::android::hardware::automotive::vehicle::VehiclePropValue> mQueuedValues
+            GUARDED_BY(mLock);
+    // The index in mQueuedValues for each [propId, areaId] whose queued value could be replaced.
+    std::unordered_map<PropIdAreaId, size_t, PropIdAreaIdHash> mCoalescedValueIndexes
+            GUARDED_BY(mLock);
 
     static void onGetValueResults(
             const void* clientId, CallbackType callback,
+            std::shared_ptr<SharedMemoryTracker> sharedMemoryTracker,
             std::shared_ptr<PendingRequestPool> requestPool,
             std::vector<aidl::android::hardware::automotive::vehicle::GetValueResult> results);
+
+    // Sends the values through one or more {@code onPropertyEvent} calls without using tracked
+    // shared memory files, splitting them until each call fits in the binder payload. A single
+    // value that is too large is sent through an untracked shared memory file.
+    static void sendUpdatedValuesInPayloads(
+            CallbackType callback,
+            const std::vector<aidl::android::hardware::automotive::vehicle::VehiclePropValue>&
+                    updatedValues,
+            int32_t sharedMemoryFileCount);
+
+    static void callOnPropertyEvent(
+            CallbackType callback,
+            const aidl::android::hardware::automotive::vehicle::VehiclePropValues& values,
+            int32_t sharedMemoryFileCount);
 };
 
 }  // namespace vehicle
@@ -47,7 +47,12 @@ class DefaultVehicleHal final : public aidl::android::hardware::automotive::vehi
     using CallbackType =
             std::shared_ptr<aidl::android::hardware::automotive::vehicle::IVehicleCallback>;
 
-    explicit DefaultVehicleHal(std::unique_ptr<IVehicleHardware> hardware);
+    // If 'eventBatchingWindowInNano' is not 0, property change events are queued for each
+    // subscription client and sent in one batch every window. Within a batch, updates to a
+    // continuous property are coalesced to the latest value if the client's sample interval is no
+    // shorter than the window.
+    explicit DefaultVehicleHal(std::unique_ptr<IVehicleHardware> hardware,
+                               int64_t eventBatchingWindowInNano = 0);
 
     ~DefaultVehicleHal();
 
@@ -115,6 +120,9 @@ class DefaultVehicleHal final : public aidl::android::hardware::automotive::vehi
 
         size_t countClients();
 
+        // Sends the queued property change events to all the clients.
+        void flushUpdatedValues();
+
       private:
         std::mutex mLock;
         std::unordered_map<const AIBinder*, std::shared_ptr<SubscriptionClient>> mClients
@@ -191,6 +199,10 @@ class DefaultVehicleHal final : public aidl::android::hardware::automotive::vehi
 
     // Only initialized once.
     std::shared_ptr<std::function<void()>> mRecurrentAction;
+    // Only initialized once. 0 means property change events are sent without batching.
+    const int64_t mEventBatchingWindowInNano;
+    // Only initialized once if mEventBatchingWindowInNano is not 0.
+    std::shared_ptr<std::function<void()>> mFlushEventsAction;
     // RecurrentTimer is thread-safe.
     RecurrentTimer mRecurrentTimer;
 
@@ -248,11 +260,17 @@ class DefaultVehicleHal final : public aidl::android::hardware::automotive::vehi
 
     static void onPropertyChangeEvent(
             std::weak_ptr<SubscriptionManager> subscriptionManager,
+            std::weak_ptr<SubscriptionClients> subscriptionClients,
             const std::vector<aidl::android::hardware::automotive::vehicle::VehiclePropValue>&
-                    updatedValues);
+                    updatedValues,
+            int64_t eventBatchingWindowInNano);
 
+    // Sends a heartbeat event if the hardware is healthy. With event batching, the heartbeat is
+    // queued behind the events raised before it, so that clients receive events in order.
     static void checkHealth(IVehicleHardware* hardware,
-                            std::weak_ptr<SubscriptionManager> subscriptionManager);
+                            std::weak_ptr<SubscriptionManager> subscriptionManager,
+                            std::weak_ptr<SubscriptionClients> subscriptionClients,
+                            int64_t eventBatchingWindowInNano);
 
     static void onBinderDied(void* cookie);
 
@@ -44,6 +44,8 @@ class ContSubConfigs final {
     void addClient(const ClientIdType& clientId, float sampleRate);
     void removeClient(const ClientIdType& clientId);
     float getMaxSampleRate();
+    // Returns {@code std::nullopt} if the client is not subscribed.
+    std::optional<float> getSampleRate(const ClientIdType& clientId) const;
 
   private:
     float mMaxSampleRate = 0.;
@@ -104,6 +106,14 @@ class SubscriptionManager final {
     std::optional<float> getSampleRate(const ClientIdType& clientId, int32_t propId,
                                        int32_t areaId);
 
+    // Checks whether the updates for [propId, areaId] could be coalesced to the latest value when
+    // they are sent to the client in batches every 'windowInNano'. This is true if the client
+    // subscribes to the continuous property with a sample interval no shorter than the window, so
+    // it still gets at least one value per sample interval. Updates for on-change properties are
+    // never coalesced.
+    bool canCoalesce(const ClientIdType& clientId, const PropIdAreaId& propIdAreaId,
+                     int64_t windowInNano);
+
     // Checks whether the sample rate is valid.
     static bool checkSampleRate(float sampleRate);
 
@@ -17,12 +17,20 @@
 #include "ConnectedClient.h"
 #include "ParcelableUtils.h"
 
+#include <LargeParcelableBase.h>
 #include <VehicleHalTypes.h>
 
+#include <aidl/android/hardware/automotive/vehicle/IVehicle.h>
+#include <cutils/ashmem.h>
 #include <utils/Log.h>
 
+#include <errno.h>
 #include <inttypes.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
 #include <unordered_set>
+#include <utility>
 #include <vector>
 
 namespace android {
@@ -34,14 +42,19 @@ namespace {
 
 using ::aidl::android::hardware::automotive::vehicle::GetValueResult;
 using ::aidl::android::hardware::automotive::vehicle::GetValueResults;
+using ::aidl::android::hardware::automotive::vehicle::IVehicle;
 using ::aidl::android::hardware::automotive::vehicle::IVehicleCallback;
 using ::aidl::android::hardware::automotive::vehicle::SetValueResult;
 using ::aidl::android::hardware::automotive::vehicle::SetValueResults;
 using ::aidl::android::hardware::automotive::vehicle::StatusCode;
 using ::aidl::android::hardware::automotive::vehicle::VehiclePropValue;
 using ::aidl::android::hardware::automotive::vehicle::VehiclePropValues;
+using ::android::automotive::car_binder_lib::LargeParcelableBase;
+using ::android::base::Error;
 using ::android::base::Result;
+using ::ndk::ScopedAParcel;
 using ::ndk::ScopedAStatus;
+using ::ndk::ScopedFileDescriptor;
 
 // A function to call the specific callback based on results type.
 template <class T>
@@ -107,6 +120,20 @@ void sendGetOrSetValueResults(std::shared_ptr<IVehicleCallback> callback,
                                                                 parcelableResults.payloads);
 }
 
+// Marshals the values into a new parcel, which is used both to check whether the values fit in the
+// binder payload and as the content of a shared memory file.
+Result<ScopedAParcel> marshalPropValues(const VehiclePropValues& values) {
+    ScopedAParcel parcel(AParcel_create());
+    if (binder_status_t status = values.writeToParcel(parcel.get()); status != STATUS_OK) {
+        return Error(status) << "failed to write values to parcel";
+    }
+    return parcel;
+}
+
+bool fitsInPayload(const AParcel* parcel) {
+    return AParcel_getDataSize(parcel) <= LargeParcelableBase::MAX_DIRECT_PAYLOAD_SIZE;
+}
+
 // The timeout callback for GetValues/SetValues.
 template <class ResultType, class ResultsType>
 void onTimeout(
@@ -248,9 +275,161 @@ void GetSetValuesClient<ResultType, ResultsType>::sendResultsSeparately(
 template class GetSetValuesClient<GetValueResult, GetValueResults>;
 template class GetSetValuesClient<SetValueResult, SetValueResults>;
 
+SharedMemoryTracker::Region::~Region() {
+    if (address != nullptr) {
+        munmap(address, size);
+    }
+}
+
+SharedMemoryTracker::~SharedMemoryTracker() {
+    releaseAll();
+}
+
+std::unique_ptr<SharedMemoryTracker::Region> SharedMemoryTracker::createRegion(size_t size) {
+    size_t regionSize = MIN_FILE_SIZE;
+    while (regionSize < size) {
+        regionSize *= 2;
+    }
+    auto region = std::make_unique<Region>();
+    region->fd.set(ashmem_create_region("VehiclePropValues", regionSize));
+    if (region->fd.get() < 0) {
+        ALOGE("subscribe: failed to create shared memory file of size: %zu", regionSize);
+        return nullptr;
+    }
+    void* address = mmap(nullptr, regionSize, PROT_READ | PROT_WRITE, MAP_SHARED, region->fd.get(),
+                         /*offset=*/0);
+    if (address == MAP_FAILED) {
+        ALOGE("subscribe: failed to map shared memory file, errno: %d", errno);
+        return nullptr;
+    }
+    region->address = address;
+    region->size = regionSize;
+    // The mapping made above stays writable, so the region could be refilled once the client
+    // returns it, but the client could only map it read-only.
+    if (ashmem_set_prot_region(region->fd.get(), PROT_READ) != 0) {
+        ALOGE("subscribe: failed to seal shared memory file, errno: %d", errno);
+        return nullptr;
+    }
+    return region;
+}
+
+ScopedFileDescriptor SharedMemoryTracker::fillRegion(Region* region, const AParcel* parcel) {
+    size_t size = AParcel_getDataSize(parcel);
+    uint8_t* address = reinterpret_cast<uint8_t*>(region->address);
+    if (binder_status_t status = AParcel_marshal(parcel, address, /*start=*/0, size);
+        status != STATUS_OK) {
+        ALOGE("subscribe: failed to marshal values into shared memory file, status: %d", status);
+        return ScopedFileDescriptor();
+    }
+    // Clear what is left from a larger previous event.
+    memset(address + size, 0, region->size - size);
+
+    ScopedFileDescriptor fd(dup(region->fd.get()));
+    if (fd.get() < 0) {
+        ALOGE("subscribe: failed to dup shared memory file, errno: %d", errno);
+    }
+    return fd;
+}
+
+std::optional<SharedMemoryTracker::LentFile> SharedMemoryTracker::lendOnce(const AParcel* parcel) {
+    std::unique_ptr<Region> region = createRegion(AParcel_getDataSize(parcel));
+    if (region == nullptr) {
+        return std::nullopt;
+    }
+    ScopedFileDescriptor fd = fillRegion(region.get(), parcel);
+    if (fd.get() < 0) {
+        return std::nullopt;
+    }
+    // The region is unmapped and its descriptor closed here, the file lives on through the
+    // descriptor sent to the client.
+    return LentFile{
+            .sharedMemoryId = IVehicle::INVALID_MEMORY_ID,
+            .fd = std::move(fd),
+    };
+}
+
+void SharedMemoryTracker::setMaxFileCount(int32_t maxFileCount) {
+    std::scoped_lock<std::mutex> lockGuard(mLock);
+    mMaxFileCount = maxFileCount;
+}
+
+std::optional<SharedMemoryTracker::LentFile> SharedMemoryTracker::tryLend(const AParcel* parcel,
+                                                                          int32_t* fileCount) {
+    std::scoped_lock<std::mutex> lockGuard(mLock);
+    *fileCount = mLentRegions.size();
+    if (mMaxFileCount == 0) {
+        // The client asked for a new file for every event, which it never returns.
+        return lendOnce(parcel);
+    }
+    if (mMaxFileCount != UNLIMITED_FILE_COUNT &&
+        mLentRegions.size() >= static_cast<size_t>(mMaxFileCount)) {
+        return std::nullopt;
+    }
+
+    size_t size = AParcel_getDataSize(parcel);
+    // Reuse the smallest returned region that is large enough.
+    auto bestIt = mFreeRegions.end();
+    for (auto it = mFreeRegions.begin(); it != mFreeRegions.end(); it++) {
+        if ((*it)->size < size) {
+            continue;
+        }
+        if (bestIt == mFreeRegions.end() || (*it)->size < (*bestIt)->size) {
+            bestIt = it;
+        }
+    }
+    std::unique_ptr<Region> region;
+    if (bestIt != mFreeRegions.end()) {
+        region = std::move(*bestIt);
+        mFreeRegions.erase(bestIt);
+    } else {
+        region = createRegion(size);
+        if (region == nullptr) {
+            return std::nullopt;
+        }
+    }
+    ScopedFileDescriptor fd = fillRegion(region.get(), parcel);
+    if (fd.get() < 0) {
+        return std::nullopt;
+    }
+    int64_t id = ++mLastId;
+    mLentRegions[id] = std::move(region);
+    *fileCount = mLentRegions.size();
+    return LentFile{
+            .sharedMemoryId = id,
+            .fd = std::move(fd),
+    };
+}
+
+VhalResult<void> SharedMemoryTracker::giveBack(int64_t sharedMemoryId) {
+    std::scoped_lock<std::mutex> lockGuard(mLock);
+    auto it = mLentRegions.find(sharedMemoryId);
+    if (it == mLentRegions.end()) {
+        return StatusError(StatusCode::INVALID_ARG)
+               << "shared memory ID: " << sharedMemoryId << " is not lent to the client";
+    }
+    // A client that asked for a new file for every event gets no returned file reused.
+    if (mMaxFileCount != 0 && mFreeRegions.size() < MAX_FREE_FILE_COUNT) {
+        mFreeRegions.push_back(std::move(it->second));
+    }
+    mLentRegions.erase(it);
+    return {};
+}
+
+int32_t SharedMemoryTracker::countLentFiles() {
+    std::scoped_lock<std::mutex> lockGuard(mLock);
+    return mLentRegions.size();
+}
+
+void SharedMemoryTracker::releaseAll() {
+    std::scoped_lock<std::mutex> lockGuard(mLock);
+    mLentRegions.clear();
+    mFreeRegions.clear();
+}
+
 SubscriptionClient::SubscriptionClient(std::shared_ptr<PendingRequestPool> requestPool,
                                        std::shared_ptr<IVehicleCallback> callback)
-    : ConnectedClient(requestPool, callback) {
+    : ConnectedClient(requestPool, callback),
+      mSharedMemoryTracker(std::make_shared<SharedMemoryTracker>()) {
     mTimeoutCallback = std::make_shared<const PendingRequestPool::TimeoutCallbackFunc>(
             [](std::unordered_set<int64_t> timeoutIds) {
                 for (int64_t id : timeoutIds) {
@@ -261,10 +440,13 @@ SubscriptionClient::SubscriptionClient(std::shared_ptr<PendingRequestPool> reque
                 }
             });
     auto requestPoolCopy = mRequestPool;
+    auto sharedMemoryTrackerCopy = mSharedMemoryTracker;
     const void* clientId = reinterpret_cast<const void*>(this);
     mResultCallback = std::make_shared<const IVehicleHardware::GetValuesCallback>(
-            [clientId, callback, requestPoolCopy](std::vector<GetValueResult> results) {
-                onGetValueResults(clientId, callback, requestPoolCopy, results);
+            [clientId, callback, sharedMemoryTrackerCopy,
+             requestPoolCopy](std::vector<GetValueResult> results) {
+                onGetValueResults(clientId, callback, sharedMemoryTrackerCopy, requestPoolCopy,
+                                  results);
             });
 }
 
@@ -278,27 +460,152 @@ SubscriptionClient::getTimeoutCallback() {
     return mTimeoutCallback;
 }
 
+void SubscriptionClient::setMaxSharedMemoryFileCount(int32_t maxSharedMemoryFileCount) {
+    mSharedMemoryTracker->setMaxFileCount(maxSharedMemoryFileCount);
+}
+
+VhalResult<void> SubscriptionClient::returnSharedMemory(int64_t sharedMemoryId) {
+    return mSharedMemoryTracker->giveBack(sharedMemoryId);
+}
+
+int32_t SubscriptionClient::countSharedMemoryFiles() {
+    return mSharedMemoryTracker->countLentFiles();
+}
+
+void SubscriptionClient::releaseSharedMemory() {
+    mSharedMemoryTracker->releaseAll();
+}
+
+void SubscriptionClient::queueUpdatedValues(
+        const std::vector<const VehiclePropValue*>& updatedValues,
+        const std::function<bool(const PropIdAreaId&)>& canCoalesce) {
+    std::scoped_lock<std::mutex> lockGuard(mLock);
+
+    for (const VehiclePropValue* value : updatedValues) {
+        PropIdAreaId propIdAreaId{
+                .propId = value->prop,
+                .areaId = value->areaId,
+        };
+        if (!canCoalesce(propIdAreaId)) {
+            mQueuedValues.push_back(*value);
+            continue;
+        }
+        if (auto it = mCoalescedValueIndexes.find(propIdAreaId);
+            it != mCoalescedValueIndexes.end()) {
+            mQueuedValues[it->second] = *value;
+            continue;
+        }
+        mCoalescedValueIndexes[propIdAreaId] = mQueuedValues.size();
+        mQueuedValues.push_back(*value);
+    }
+}
+
+void SubscriptionClient::flushUpdatedValues() {
+    std::vector<VehiclePropValue> values;
+    {
+        std::scoped_lock<std::mutex> lockGuard(mLock);
+        values = std::move(mQueuedValues);
+        mQueuedValues.clear();
+        mCoalescedValueIndexes.clear();
+    }
+    sendUpdatedValues(std::move(values));
+}
+
+void SubscriptionClient::sendUpdatedValues(std::vector<VehiclePropValue>&& updatedValues) {
+    sendUpdatedValues(mCallback, mSharedMemoryTracker, std::move(updatedValues));
+}
+
 void SubscriptionClient::sendUpdatedValues(std::shared_ptr<IVehicleCallback> callback,
+                                           std::shared_ptr<SharedMemoryTracker> sharedMemoryTracker,
                                            std::vector<VehiclePropValue>&& updatedValues) {
     if (updatedValues.empty()) {
         return;
     }
 
-    // TODO(b/205189110): Use memory pool here and fill in sharedMemoryId.
     VehiclePropValues vehiclePropValues;
-    int32_t sharedMemoryFileCount = 0;
-    ScopedAStatus status =
-            vectorToStableLargeParcelable(std::move(updatedValues), &vehiclePropValues);
-    if (!status.isOk()) {
-        int statusCode = status.getServiceSpecificError();
+    vehiclePropValues.payloads = std::move(updatedValues);
+    auto result = marshalPropValues(vehiclePropValues);
+    if (!result.ok()) {
         ALOGE("subscribe: failed to marshal result into large parcelable, error: "
               "%s, code: %d",
-              status.getMessage(), statusCode);
+              result.error().message().c_str(), static_cast<int>(result.error().code()));
+        return;
+    }
+
+    if (fitsInPayload(result.value().get())) {
+        // The values fit in the binder payload, no shared memory file is needed.
+        callOnPropertyEvent(callback, vehiclePropValues, sharedMemoryTracker->countLentFiles());
         return;
     }
 
-    if (ScopedAStatus callbackStatus =
-                callback->onPropertyEvent(vehiclePropValues, sharedMemoryFileCount);
+    int32_t sharedMemoryFileCount = 0;
+    std::optional<SharedMemoryTracker::LentFile> lentFile =
+            sharedMemoryTracker->tryLend(result.value().get(), &sharedMemoryFileCount);
+    if (!lentFile.has_value()) {
+        ALOGW("subscribe: client ID: %p holds %" PRId32
+              " shared memory files, send values without shared memory file",
+              callback->asBinder().get(), sharedMemoryFileCount);
+        sendUpdatedValuesInPayloads(callback, vehiclePropValues.payloads, sharedMemoryFileCount);
+        return;
+    }
+
+    vehiclePropValues.payloads.clear();
+    vehiclePropValues.sharedMemoryFd = std::move(lentFile->fd);
+    vehiclePropValues.sharedMemoryId = lentFile->sharedMemoryId;
+    callOnPropertyEvent(callback, vehiclePropValues, sharedMemoryFileCount);
+}
+
+void SubscriptionClient::sendUpdatedValuesInPayloads(std::shared_ptr<IVehicleCallback> callback,
+                                                     const std::vector<VehiclePropValue>& values,
+                                                     int32_t sharedMemoryFileCount) {
+    // The ranges of values still to be sent, the next one at the back. A range that does not fit
+    // in the binder payload is split in half, the first half is sent first to keep the order.
+    std::vector<std::pair<size_t, size_t>> ranges = {{0, values.size()}};
+    while (!ranges.empty()) {
+        auto [begin, end] = ranges.back();
+        ranges.pop_back();
+
+        VehiclePropValues vehiclePropValues;
+        vehiclePropValues.payloads.assign(values.begin() + begin, values.begin() + end);
+        auto result = marshalPropValues(vehiclePropValues);
+        if (!result.ok()) {
+            ALOGE("subscribe: failed to marshal result into large parcelable, error: "
+                  "%s, code: %d",
+                  result.error().message().c_str(), static_cast<int>(result.error().code()));
+            continue;
+        }
+        if (fitsInPayload(result.value().get())) {
+            callOnPropertyEvent(callback, vehiclePropValues, sharedMemoryFileCount);
+            continue;
+        }
+        if (end - begin == 1) {
+            // A single value that does not fit in the binder payload is sent through a new shared
+            // memory file that is not counted against the client's limit, as it was done before
+            // files were reused.
+            std::optional<SharedMemoryTracker::LentFile> file =
+                    SharedMemoryTracker::lendOnce(result.value().get());
+            if (!file.has_value()) {
+                ALOGE("subscribe: failed to send value for property: %" PRId32
+                      " through shared memory file, dropped",
+                      values[begin].prop);
+                continue;
+            }
+            vehiclePropValues.payloads.clear();
+            vehiclePropValues.sharedMemoryFd = std::move(file->fd);
+            vehiclePropValues.sharedMemoryId = file->sharedMemoryId;
+            callOnPropertyEvent(callback, vehiclePropValues, sharedMemoryFileCount);
+            continue;
+        }
+        size_t middle = begin + (end - begin) / 2;
+        ranges.push_back({middle, end});
+        ranges.push_back({begin, middle});
+    }
+}
+
+void SubscriptionClient::callOnPropertyEvent(std::shared_ptr<IVehicleCallback> callback,
+                                             const VehiclePropValues& values,
+                                             int32_t sharedMemoryFileCount) {
+    if (ScopedAStatus callbackStatus = callback->onPropertyEvent(values, sharedMemoryFileCount);
         !callbackStatus.isOk()) {
         ALOGE("subscribe: failed to call UpdateValues callback, client ID: %p, error: %s, "
               "exception: %d, service specific error: %d",
@@ -309,6 +616,7 @@ void SubscriptionClient::sendUpdatedValues(std::shared_ptr<IVehicleCallback> cal
 
 void SubscriptionClient::onGetValueResults(const void* clientId,
                                            std::shared_ptr<IVehicleCallback> callback,
+                                           std::shared_ptr<SharedMemoryTracker> sharedMemoryTracker,
                                            std::shared_ptr<PendingRequestPool> requestPool,
                                            std::vector<GetValueResult> results) {
     std::unordered_set<int64_t> requestIds;
@@ -341,7 +649,7 @@ void SubscriptionClient::onGetValueResults(const void* clientId,
         propValues.push_back(std::move(result.prop.value()));
     }
 
-    sendUpdatedValues(callback, std::move(propValues));
+    sendUpdatedValues(callback, sharedMemoryTracker, std::move(propValues));
 }
 
 }  // namespace vehicle
@@ -20,6 +20,7 @@
 
 #include <LargeParcelableBase.h>
 #include <VehicleHalTypes.h>
+#include <VehicleObjectPool.h>
 #include <VehicleUtils.h>
 
 #include <android-base/result.h>
@@ -115,7 +116,14 @@ int64_t DefaultVehicleHal::SubscribeIdByClient::getId(const CallbackType& callba
 
 void DefaultVehicleHal::SubscriptionClients::removeClient(const AIBinder* clientId) {
     std::scoped_lock<std::mutex> lockGuard(mLock);
-    mClients.erase(clientId);
+    auto it = mClients.find(clientId);
+    if (it == mClients.end()) {
+        return;
+    }
+    // A dead client would never return the shared memory files it holds. Pending hardware
+    // callbacks might keep the client's tracker alive, so release the files explicitly.
+    it->second->releaseSharedMemory();
+    mClients.erase(it);
 }
 
 size_t DefaultVehicleHal::SubscriptionClients::countClients() {
@@ -123,9 +131,26 @@ size_t DefaultVehicleHal::SubscriptionClients::countClients() {
     return mClients.size();
 }
 
-DefaultVehicleHal::DefaultVehicleHal(std::unique_ptr<IVehicleHardware> hardware)
+void DefaultVehicleHal::SubscriptionClients::flushUpdatedValues() {
+    std::vector<std::shared_ptr<SubscriptionClient>> clients;
+    {
+        std::scoped_lock<std::mutex> lockGuard(mLock);
+        clients.reserve(mClients.size());
+        for (const auto& [_, client] : mClients) {
+            clients.push_back(client);
+        }
+    }
+    // Send the events without holding the lock since binder calls might be slow.
+    for (const auto& client : clients) {
+        client->flushUpdatedValues();
+    }
+}
+
+DefaultVehicleHal::DefaultVehicleHal(std::unique_ptr<IVehicleHardware> hardware,
+                                     int64_t eventBatchingWindowInNano)
     : mVehicleHardware(std::move(hardware)),
-      mPendingRequestPool(std::make_shared<PendingRequestPool>(TIMEOUT_IN_NANO)) {
+      mPendingRequestPool(std::make_shared<PendingRequestPool>(TIMEOUT_IN_NANO)),
+      mEventBatchingWindowInNano(eventBatchingWindowInNano) {
     auto configs = mVehicleHardware->getAllPropertyConfigs();
     for (auto& config : configs) {
         mConfigsByPropId[config.prop] = config;
@@ -151,16 +176,31 @@ DefaultVehicleHal::DefaultVehicleHal(std::unique_ptr<IVehicleHardware> hardware)
     mSubscriptionManager = std::make_shared<SubscriptionManager>(hardwarePtr);
 
     std::weak_ptr<SubscriptionManager> subscriptionManagerCopy = mSubscriptionManager;
+    std::weak_ptr<SubscriptionClients> subscriptionClientsCopy = mSubscriptionClients;
+    int64_t eventBatchingWindowCopy = mEventBatchingWindowInNano;
     mVehicleHardware->registerOnPropertyChangeEvent(
             std::make_unique<IVehicleHardware::PropertyChangeCallback>(
-                    [subscriptionManagerCopy](std::vector<VehiclePropValue> updatedValues) {
-                        onPropertyChangeEvent(subscriptionManagerCopy, updatedValues);
+                    [subscriptionManagerCopy, subscriptionClientsCopy,
+                     eventBatchingWindowCopy](std::vector<VehiclePropValue> updatedValues) {
+                        onPropertyChangeEvent(subscriptionManagerCopy, subscriptionClientsCopy,
+                                              updatedValues, eventBatchingWindowCopy);
                     }));
 
+    if (mEventBatchingWindowInNano != 0) {
+        mFlushEventsAction = std::make_shared<std::function<void()>>([subscriptionClientsCopy]() {
+            if (auto clients = subscriptionClientsCopy.lock(); clients != nullptr) {
+                clients->flushUpdatedValues();
+            }
+        });
+        mRecurrentTimer.registerTimerCallback(mEventBatchingWindowInNano, mFlushEventsAction);
+    }
+
     // Register heartbeat event.
-    mRecurrentAction =
-            std::make_shared<std::function<void()>>([hardwarePtr, subscriptionManagerCopy]() {
-                checkHealth(hardwarePtr, subscriptionManagerCopy);
+    mRecurrentAction = std::make_shared<std::function<void()>>(
+            [hardwarePtr, subscriptionManagerCopy, subscriptionClientsCopy,
+             eventBatchingWindowCopy]() {
+                checkHealth(hardwarePtr, subscriptionManagerCopy, subscriptionClientsCopy,
+                            eventBatchingWindowCopy);
             });
     mRecurrentTimer.registerTimerCallback(HEART_BEAT_INTERVAL_IN_NANO, mRecurrentAction);
 
@@ -182,6 +222,9 @@ DefaultVehicleHal::~DefaultVehicleHal() {
     // mRecurrentAction uses pointer to mVehicleHardware, so it has to be unregistered before
     // mVehicleHardware.
     mRecurrentTimer.unregisterTimerCallback(mRecurrentAction);
+    if (mFlushEventsAction != nullptr) {
+        mRecurrentTimer.unregisterTimerCallback(mFlushEventsAction);
+    }
     // mSubscriptionManager uses pointer to mVehicleHardware, so it has to be destroyed before
     // mVehicleHardware.
     mSubscriptionManager.reset();
@@ -190,19 +233,34 @@ DefaultVehicleHal::~DefaultVehicleHal() {
 
 void DefaultVehicleHal::onPropertyChangeEvent(
         std::weak_ptr<SubscriptionManager> subscriptionManager,
-        const std::vector<VehiclePropValue>& updatedValues) {
+        std::weak_ptr<SubscriptionClients> subscriptionClients,
+        const std::vector<VehiclePropValue>& updatedValues, int64_t eventBatchingWindowInNano) {
     auto manager = subscriptionManager.lock();
-    if (manager == nullptr) {
+    auto clients = subscriptionClients.lock();
+    if (manager == nullptr || clients == nullptr) {
         ALOGW("the SubscriptionManager is destroyed, DefaultVehicleHal is ending");
         return;
     }
     auto updatedValuesByClients = manager->getSubscribedClients(updatedValues);
     for (const auto& [callback, valuePtrs] : updatedValuesByClients) {
+        std::shared_ptr<SubscriptionClient> client = clients->getClient(callback);
+        if (client == nullptr) {
+            // The client has died and is being removed.
+            continue;
+        }
+        if (eventBatchingWindowInNano != 0) {
+            const AIBinder* clientId = callback->asBinder().get();
+            client->queueUpdatedValues(valuePtrs, [&manager, clientId, eventBatchingWindowInNano](
+                                                          const PropIdAreaId& propIdAreaId) {
+                return manager->canCoalesce(clientId, propIdAreaId, eventBatchingWindowInNano);
+            });
+            continue;
+        }
         std::vector<VehiclePropValue> values;
         for (const VehiclePropValue* valuePtr : valuePtrs) {
             values.push_back(*valuePtr);
         }
-        SubscriptionClient::sendUpdatedValues(callback, std::move(values));
+        client->sendUpdatedValues(std::move(values));
     }
 }
 
@@ -623,8 +681,16 @@ VhalResult<void> DefaultVehicleHal::checkSubscribeOptions(
 
 ScopedAStatus DefaultVehicleHal::subscribe(const CallbackType& callback,
                                            const std::vector<SubscribeOptions>& options,
-                                           [[maybe_unused]] int32_t maxSharedMemoryFileCount) {
-    // TODO(b/205189110): Use shared memory file count.
+                                           int32_t maxSharedMemoryFileCount) {
+    if (maxSharedMemoryFileCount < 0 ||
+        maxSharedMemoryFileCount >= IVehicle::MAX_SHARED_MEMORY_FILES_PER_CLIENT) {
+        ALOGE("subscribe: invalid maxSharedMemoryFileCount: %" PRId32, maxSharedMemoryFileCount);
+        return ScopedAStatus::fromServiceSpecificErrorWithMessage(
+                toInt(StatusCode::INVALID_ARG),
+                StringPrintf("maxSharedMemoryFileCount: %" PRId32 " must be >= 0 and < %" PRId32,
+                             maxSharedMemoryFileCount, IVehicle::MAX_SHARED_MEMORY_FILES_PER_CLIENT)
+                        .c_str());
+    }
     if (auto result = checkSubscribeOptions(options); !result.ok()) {
         ALOGE("subscribe: invalid subscribe options: %s", getErrorMsg(result).c_str());
         return toScopedAStatus(result);
@@ -667,7 +733,8 @@ ScopedAStatus DefaultVehicleHal::subscribe(const CallbackType& callback,
         }
 
         // Create a new SubscriptionClient if there isn't an existing one.
-        mSubscriptionClients->maybeAddClient(callback);
+        mSubscriptionClients->maybeAddClient(callback)->setMaxSharedMemoryFileCount(
+                maxSharedMemoryFileCount);
 
         // Since we have already check the sample rates, the following functions must succeed.
         if (!onChangeSubscriptions.empty()) {
@@ -688,9 +755,14 @@ ScopedAStatus DefaultVehicleHal::unsubscribe(const CallbackType& callback,
     return toScopedAStatus(mSubscriptionManager->unsubscribe(callback->asBinder().get(), propIds));
 }
 
-ScopedAStatus DefaultVehicleHal::returnSharedMemory(const CallbackType&, int64_t) {
-    // TODO(b/200737967): implement this.
-    return ScopedAStatus::ok();
+ScopedAStatus DefaultVehicleHal::returnSharedMemory(const CallbackType& callback,
+                                                    int64_t sharedMemoryId) {
+    std::shared_ptr<SubscriptionClient> client = mSubscriptionClients->getClient(callback);
+    if (client == nullptr) {
+        return ScopedAStatus::fromServiceSpecificErrorWithMessage(
+                toInt(StatusCode::INVALID_ARG), "returnSharedMemory: client is not subscribed");
+    }
+    return toScopedAStatus(client->returnSharedMemory(sharedMemoryId));
 }
 
 IVehicleHardware* DefaultVehicleHal::getHardware() {
@@ -730,7 +802,9 @@ VhalResult<void> DefaultVehicleHal::checkReadPermission(const VehiclePropValue&
 }
 
 void DefaultVehicleHal::checkHealth(IVehicleHardware* hardware,
-                                    std::weak_ptr<SubscriptionManager> subscriptionManager) {
+                                    std::weak_ptr<SubscriptionManager> subscriptionManager,
+                                    std::weak_ptr<SubscriptionClients> subscriptionClients,
+                                    int64_t eventBatchingWindowInNano) {
     StatusCode status = hardware->checkHealth();
     if (status != StatusCode::OK) {
         ALOGE("VHAL check health returns non-okay status");
@@ -742,7 +816,10 @@ void DefaultVehicleHal::checkHealth(IVehicleHardware* hardware,
             .status = VehiclePropertyStatus::AVAILABLE,
             .value.int64Values = {uptimeMillis()},
     }};
-    onPropertyChangeEvent(subscriptionManager, values);
+    // The heartbeat goes through the same queue as the other events, so that it does not overtake
+    // the events raised before it.
+    onPropertyChangeEvent(subscriptionManager, subscriptionClients, values,
+                          eventBatchingWindowInNano);
     return;
 }
 
@@ -790,6 +867,7 @@ binder_status_t DefaultVehicleHal::dump(int fd, const char** args, uint32_t numA
         dprintf(fd, "Currently have %zu subscription clients\n",
                 mSubscriptionClients->countClients());
     }
+    dprintf(fd, "%s", VehiclePropValuePool::dumpStats().c_str());
     return STATUS_OK;
 }
 
@@ -93,6 +93,13 @@ float ContSubConfigs::getMaxSampleRate() {
     return mMaxSampleRate;
 }
 
+std::optional<float> ContSubConfigs::getSampleRate(const ClientIdType& clientId) const {
+    if (auto it = mSampleRates.find(clientId); it != mSampleRates.end()) {
+        return it->second;
+    }
+    return std::nullopt;
+}
+
 VhalResult<void> SubscriptionManager::updateSampleRateLocked(const ClientIdType& clientId,
                                                              const PropIdAreaId& propIdAreaId,
                                                              float sampleRate) {
@@ -281,6 +288,31 @@ SubscriptionManager::getSubscribedClients(const std::vector<VehiclePropValue>& u
     return clients;
 }
 
+std::optional<float> SubscriptionManager::getSampleRate(const ClientIdType& clientId,
+                                                       int32_t propId, int32_t areaId) {
+    std::scoped_lock<std::mutex> lockGuard(mLock);
+
+    auto it = mContSubConfigsByPropIdArea.find(PropIdAreaId{
+            .propId = propId,
+            .areaId = areaId,
+    });
+    if (it == mContSubConfigsByPropIdArea.end()) {
+        return std::nullopt;
+    }
+    return it->second.getSampleRate(clientId);
+}
+
+bool SubscriptionManager::canCoalesce(const ClientIdType& clientId,
+                                      const PropIdAreaId& propIdAreaId, int64_t windowInNano) {
+    std::optional<float> sampleRate =
+            getSampleRate(clientId, propIdAreaId.propId, propIdAreaId.areaId);
+    if (!sampleRate.has_value()) {
+        return false;
+    }
+    auto intervalResult = getInterval(*sampleRate);
+    return intervalResult.ok() && intervalResult.value() >= windowInNano;
+}
+
 bool SubscriptionManager::isEmpty() {
     std::scoped_lock<std::mutex> lockGuard(mLock);
     return mSubscribedPropsByClient.empty() && mClientsByPropIdArea.empty();
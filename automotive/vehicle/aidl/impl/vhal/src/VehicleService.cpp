@@ -19,17 +19,33 @@
 #include <DefaultVehicleHal.h>
 #include <FakeVehicleHardware.h>
 
+#include <android-base/properties.h>
 #include <android/binder_manager.h>
 #include <android/binder_process.h>
 #include <utils/Log.h>
 
+using ::android::base::GetIntProperty;
 using ::android::hardware::automotive::vehicle::DefaultVehicleHal;
 using ::android::hardware::automotive::vehicle::fake::FakeVehicleHardware;
 
+namespace {
+
+// Property change events could be sent to each client in batches, one batch every window, by
+// setting the window through the property below. By default, or if set to 0, every event is sent
+// as soon as it happens.
+constexpr char EVENT_BATCHING_WINDOW_PROPERTY[] = "ro.vendor.vhal.event_batching_window_ms";
+constexpr int64_t DEFAULT_EVENT_BATCHING_WINDOW_IN_MILLI = 0;
+
+}  // namespace
+
 int main(int /* argc */, char* /* argv */[]) {
+    int64_t eventBatchingWindowInNano =
+            GetIntProperty<int64_t>(EVENT_BATCHING_WINDOW_PROPERTY,
+                                    DEFAULT_EVENT_BATCHING_WINDOW_IN_MILLI, /*min=*/0) *
+            1'000'000;
     std::unique_ptr<FakeVehicleHardware> hardware = std::make_unique<FakeVehicleHardware>();
-    std::shared_ptr<DefaultVehicleHal> vhal =
-            ::ndk::SharedRefBase::make<DefaultVehicleHal>(std::move(hardware));
+    std::shared_ptr<DefaultVehicleHal> vhal = ::ndk::SharedRefBase::make<DefaultVehicleHal>(
+            std::move(hardware), eventBatchingWindowInNano);
 
     ALOGI("Registering as service...");
     binder_exception_t err = AServiceManager_addService(
@@ -17,10 +17,15 @@
 #include "ConnectedClient.h"
 #include "MockVehicleCallback.h"
 
+#include <LargeParcelableBase.h>
+
+#include <aidl/android/hardware/automotive/vehicle/IVehicle.h>
 #include <aidl/android/hardware/automotive/vehicle/IVehicleCallback.h>
 
 #include <gtest/gtest.h>
 
+#include <sys/stat.h>
+
 namespace android {
 namespace hardware {
 namespace automotive {
@@ -28,11 +33,14 @@ namespace vehicle {
 
 using ::aidl::android::hardware::automotive::vehicle::GetValueResult;
 using ::aidl::android::hardware::automotive::vehicle::GetValueResults;
+using ::aidl::android::hardware::automotive::vehicle::IVehicle;
 using ::aidl::android::hardware::automotive::vehicle::IVehicleCallback;
 using ::aidl::android::hardware::automotive::vehicle::SetValueResult;
 using ::aidl::android::hardware::automotive::vehicle::SetValueResults;
 using ::aidl::android::hardware::automotive::vehicle::StatusCode;
 using ::aidl::android::hardware::automotive::vehicle::VehiclePropValue;
+using ::aidl::android::hardware::automotive::vehicle::VehiclePropValues;
+using ::android::automotive::car_binder_lib::LargeParcelableBase;
 
 class ConnectedClientTest : public testing::Test {
   public:
@@ -50,6 +58,37 @@ class ConnectedClientTest : public testing::Test {
 
     std::shared_ptr<PendingRequestPool> getPool() { return mPool; }
 
+    // Gets values that are too large to be sent in one binder payload.
+    std::vector<VehiclePropValue> getLargeValues() {
+        std::vector<VehiclePropValue> values;
+        for (int32_t i = 0; i < 1000; i++) {
+            values.push_back({
+                    .prop = i,
+                    .value.int32Values = {i},
+            });
+        }
+        return values;
+    }
+
+    // Gets a single value that is too large to be sent in one binder payload.
+    VehiclePropValue getOversizedValue() {
+        VehiclePropValue value = {
+                .prop = 1,
+        };
+        value.value.byteValues.resize(LargeParcelableBase::MAX_DIRECT_PAYLOAD_SIZE, 1);
+        return value;
+    }
+
+    // Reads the values sent through the shared memory file.
+    std::vector<VehiclePropValue> readSharedMemory(const VehiclePropValues& results) {
+        auto result = LargeParcelableBase::stableLargeParcelableToParcelable(results);
+        if (!result.ok()) {
+            ADD_FAILURE() << "failed to parse shared memory file: " << result.error().message();
+            return {};
+        }
+        return result.value().getObject()->payloads;
+    }
+
   protected:
     using GetValuesClient = GetSetValuesClient<GetValueResult, GetValueResults>;
     using SetValuesClient = GetSetValuesClient<SetValueResult, SetValueResults>;
@@ -214,6 +253,193 @@ TEST_F(ConnectedClientTest, testSetValuesGetResultCallback) {
     ASSERT_EQ(maybeSetValueResults.value().payloads, results);
 }
 
+TEST_F(ConnectedClientTest, testSubscriptionClientSendUpdatedValuesSmall) {
+    SubscriptionClient client(getPool(), getCallbackClient());
+    std::vector<VehiclePropValue> values = {{
+            .prop = 1,
+    }};
+
+    client.sendUpdatedValues(std::vector<VehiclePropValue>(values));
+
+    auto maybeResults = getCallback()->nextOnPropertyEventResults();
+    ASSERT_TRUE(maybeResults.has_value());
+    ASSERT_EQ(maybeResults.value().payloads, values);
+    ASSERT_EQ(maybeResults.value().sharedMemoryId, IVehicle::INVALID_MEMORY_ID);
+    ASSERT_EQ(getCallback()->getSharedMemoryFileCount(), 0);
+    ASSERT_EQ(client.countSharedMemoryFiles(), 0);
+}
+
+TEST_F(ConnectedClientTest, testSubscriptionClientSendUpdatedValuesLarge) {
+    SubscriptionClient client(getPool(), getCallbackClient());
+    client.setMaxSharedMemoryFileCount(2);
+
+    // Send one file and return it.
+    client.sendUpdatedValues(getLargeValues());
+
+    auto maybeResults = getCallback()->nextOnPropertyEventResults();
+    ASSERT_TRUE(maybeResults.has_value());
+    ASSERT_TRUE(maybeResults.value().payloads.empty());
+    ASSERT_NE(maybeResults.value().sharedMemoryFd.get(), -1);
+    int64_t sharedMemoryId = maybeResults.value().sharedMemoryId;
+    ASSERT_NE(sharedMemoryId, IVehicle::INVALID_MEMORY_ID);
+    ASSERT_EQ(getCallback()->getSharedMemoryFileCount(), 1);
+
+    ASSERT_TRUE(client.returnSharedMemory(sharedMemoryId).ok());
+    ASSERT_EQ(client.countSharedMemoryFiles(), 0);
+    ASSERT_FALSE(client.returnSharedMemory(sharedMemoryId).ok())
+            << "returning a shared memory file twice must fail";
+}
+
+TEST_F(ConnectedClientTest, testSubscriptionClientSendUpdatedValuesNoSharedMemoryLeft) {
+    SubscriptionClient client(getPool(), getCallbackClient());
+    client.setMaxSharedMemoryFileCount(1);
+    std::vector<VehiclePropValue> values = getLargeValues();
+
+    client.sendUpdatedValues(std::vector<VehiclePropValue>(values));
+    ASSERT_TRUE(getCallback()->nextOnPropertyEventResults().has_value());
+    // The only shared memory file is not returned, so the values are sent in multiple payloads.
+    client.sendUpdatedValues(std::vector<VehiclePropValue>(values));
+
+    std::vector<VehiclePropValue> gotValues;
+    while (true) {
+        auto maybeResults = getCallback()->nextOnPropertyEventResults();
+        if (!maybeResults.has_value()) {
+            break;
+        }
+        ASSERT_EQ(maybeResults.value().sharedMemoryFd.get(), -1);
+        ASSERT_EQ(maybeResults.value().sharedMemoryId, IVehicle::INVALID_MEMORY_ID);
+        for (auto& value : maybeResults.value().payloads) {
+            gotValues.push_back(std::move(value));
+        }
+    }
+    ASSERT_EQ(gotValues, values);
+    ASSERT_EQ(getCallback()->getSharedMemoryFileCount(), 1);
+}
+
+TEST_F(ConnectedClientTest, testSubscriptionClientSendUpdatedValuesZeroMaxSharedMemoryFileCount) {
+    SubscriptionClient client(getPool(), getCallbackClient());
+    client.setMaxSharedMemoryFileCount(0);
+    std::vector<VehiclePropValue> values = getLargeValues();
+
+    client.sendUpdatedValues(std::vector<VehiclePropValue>(values));
+    auto firstResults = getCallback()->nextOnPropertyEventResults();
+    ASSERT_TRUE(firstResults.has_value());
+    ASSERT_TRUE(firstResults.value().payloads.empty());
+    ASSERT_EQ(firstResults.value().sharedMemoryId, IVehicle::INVALID_MEMORY_ID)
+            << "a file created for a single event must not be returned";
+    ASSERT_EQ(readSharedMemory(firstResults.value()), values);
+
+    client.sendUpdatedValues(std::vector<VehiclePropValue>(values));
+    // Both files are still open here, so they cannot share an inode unless one is reused.
+    auto secondResults = getCallback()->nextOnPropertyEventResults();
+    ASSERT_TRUE(secondResults.has_value());
+    struct stat firstStat;
+    ASSERT_EQ(fstat(firstResults.value().sharedMemoryFd.get(), &firstStat), 0);
+    struct stat secondStat;
+    ASSERT_EQ(fstat(secondResults.value().sharedMemoryFd.get(), &secondStat), 0);
+    ASSERT_NE(firstStat.st_ino, secondStat.st_ino) << "a new file must be created for every event";
+    ASSERT_EQ(readSharedMemory(secondResults.value()), values);
+    ASSERT_EQ(getCallback()->getSharedMemoryFileCount(), 0);
+    ASSERT_EQ(client.countSharedMemoryFiles(), 0);
+}
+
+TEST_F(ConnectedClientTest, testSubscriptionClientSendUpdatedValuesOversizedNoSharedMemoryLeft) {
+    SubscriptionClient client(getPool(), getCallbackClient());
+    client.setMaxSharedMemoryFileCount(1);
+
+    client.sendUpdatedValues(getLargeValues());
+    ASSERT_TRUE(getCallback()->nextOnPropertyEventResults().has_value());
+    // The only shared memory file is not returned and the value cannot be split, so it is sent
+    // through a file that is not counted against the limit.
+    std::vector<VehiclePropValue> values = {getOversizedValue()};
+    client.sendUpdatedValues(std::vector<VehiclePropValue>(values));
+
+    auto maybeResults = getCallback()->nextOnPropertyEventResults();
+    ASSERT_TRUE(maybeResults.has_value()) << "an oversized value must not be dropped";
+    ASSERT_TRUE(maybeResults.value().payloads.empty());
+    ASSERT_EQ(maybeResults.value().sharedMemoryId, IVehicle::INVALID_MEMORY_ID);
+    ASSERT_EQ(readSharedMemory(maybeResults.value()), values);
+    ASSERT_FALSE(getCallback()->nextOnPropertyEventResults().has_value());
+    ASSERT_EQ(getCallback()->getSharedMemoryFileCount(), 1);
+    ASSERT_EQ(client.countSharedMemoryFiles(), 1);
+}
+
+TEST_F(ConnectedClientTest, testSubscriptionClientSendUpdatedValuesReuseSharedMemory) {
+    SubscriptionClient client(getPool(), getCallbackClient());
+    client.setMaxSharedMemoryFileCount(SharedMemoryTracker::UNLIMITED_FILE_COUNT);
+
+    client.sendUpdatedValues(getLargeValues());
+    auto maybeResults = getCallback()->nextOnPropertyEventResults();
+    ASSERT_TRUE(maybeResults.has_value());
+    struct stat firstStat;
+    ASSERT_EQ(fstat(maybeResults.value().sharedMemoryFd.get(), &firstStat), 0);
+    ASSERT_TRUE(client.returnSharedMemory(maybeResults.value().sharedMemoryId).ok());
+
+    client.sendUpdatedValues(getLargeValues());
+    maybeResults = getCallback()->nextOnPropertyEventResults();
+    ASSERT_TRUE(maybeResults.has_value());
+    ASSERT_NE(maybeResults.value().sharedMemoryId, IVehicle::INVALID_MEMORY_ID);
+    struct stat secondStat;
+    ASSERT_EQ(fstat(maybeResults.value().sharedMemoryFd.get(), &secondStat), 0);
+    ASSERT_EQ(firstStat.st_ino, secondStat.st_ino) << "a returned file must be reused";
+    ASSERT_EQ(client.countSharedMemoryFiles(), 1);
+}
+
+TEST_F(ConnectedClientTest, testSubscriptionClientReleaseSharedMemory) {
+    SubscriptionClient client(getPool(), getCallbackClient());
+    client.setMaxSharedMemoryFileCount(1);
+
+    client.sendUpdatedValues(getLargeValues());
+    auto maybeResults = getCallback()->nextOnPropertyEventResults();
+    ASSERT_TRUE(maybeResults.has_value());
+    int64_t sharedMemoryId = maybeResults.value().sharedMemoryId;
+    ASSERT_EQ(client.countSharedMemoryFiles(), 1);
+
+    client.releaseSharedMemory();
+
+    ASSERT_EQ(client.countSharedMemoryFiles(), 0);
+    ASSERT_FALSE(client.returnSharedMemory(sharedMemoryId).ok())
+            << "a released shared memory file must not be returned";
+    // The released file no longer counts against the limit.
+    client.sendUpdatedValues(getLargeValues());
+    maybeResults = getCallback()->nextOnPropertyEventResults();
+    ASSERT_TRUE(maybeResults.has_value());
+    ASSERT_NE(maybeResults.value().sharedMemoryId, IVehicle::INVALID_MEMORY_ID);
+}
+
+TEST_F(ConnectedClientTest, testSubscriptionClientQueueAndFlushUpdatedValues) {
+    SubscriptionClient client(getPool(), getCallbackClient());
+    // Property 1 is coalescable, property 2 is not.
+    auto canCoalesce = [](const PropIdAreaId& propIdAreaId) { return propIdAreaId.propId == 1; };
+    std::vector<VehiclePropValue> values = {
+            {.timestamp = 1, .prop = 1}, {.timestamp = 1, .prop = 2},
+            {.timestamp = 2, .prop = 1}, {.timestamp = 2, .prop = 2},
+    };
+    std::vector<const VehiclePropValue*> valuePtrs;
+    for (const auto& value : values) {
+        valuePtrs.push_back(&value);
+    }
+
+    client.queueUpdatedValues(valuePtrs, canCoalesce);
+
+    ASSERT_EQ(getCallback()->countOnPropertyEventResults(), static_cast<size_t>(0))
+            << "queued values must not be sent before flush";
+
+    client.flushUpdatedValues();
+
+    auto maybeResults = getCallback()->nextOnPropertyEventResults();
+    ASSERT_TRUE(maybeResults.has_value());
+    ASSERT_EQ(maybeResults.value().payloads,
+              std::vector<VehiclePropValue>({values[2], values[1], values[3]}));
+    ASSERT_FALSE(getCallback()->nextOnPropertyEventResults().has_value())
+            << "all the queued values must be sent in one callback";
+
+    // Flush again with nothing queued must not call the callback.
+    client.flushUpdatedValues();
+
+    ASSERT_EQ(getCallback()->countOnPropertyEventResults(), static_cast<size_t>(0));
+}
+
 }  // namespace vehicle
 }  // namespace automotive
 }  // namespace hardware
@@ -316,7 +316,8 @@ class DefaultVehicleHalTest : public testing::Test {
         });
         hardware->setPropertyConfigs(testConfigs);
         mHardwarePtr = hardware.get();
-        mVhal = ndk::SharedRefBase::make<DefaultVehicleHal>(std::move(hardware));
+        mVhal = ndk::SharedRefBase::make<DefaultVehicleHal>(std::move(hardware),
+                                                            getEventBatchingWindowInNano());
         mVhalClient = IVehicle::fromBinder(mVhal->asBinder());
         mCallback = ndk::SharedRefBase::make<MockVehicleCallback>();
         // Keep the local binder alive.
@@ -334,6 +335,9 @@ class DefaultVehicleHalTest : public testing::Test {
                 << "must have no pending requests when test finishes";
     }
 
+    // The event batching window the VHAL under test is created with.
+    virtual int64_t getEventBatchingWindowInNano() { return 0; }
+
     MockVehicleHardware* getHardware() { return mHardwarePtr; }
 
     std::shared_ptr<IVehicle> getClient() { return mVhal; }
@@ -1163,6 +1167,72 @@ TEST_F(DefaultVehicleHalTest, testSubscribeGlobalOnChangeNormal) {
             << "expect 2 clients, 1 subscribe client and 1 setvalue client";
 }
 
+class DefaultVehicleHalEventBatchingTest : public DefaultVehicleHalTest {
+  public:
+    // Long enough that all the events in a test are sent within the first window.
+    static constexpr int64_t EVENT_BATCHING_WINDOW_IN_NANO = 1'000'000'000;
+
+    int64_t getEventBatchingWindowInNano() override { return EVENT_BATCHING_WINDOW_IN_NANO; }
+};
+
+TEST_F(DefaultVehicleHalEventBatchingTest, testSubscribeEventsInOneWindowSentInOneBatch) {
+    std::vector<SubscribeOptions> options = {
+            {
+                    .propId = GLOBAL_ON_CHANGE_PROP,
+            },
+    };
+
+    auto status = getClient()->subscribe(getCallbackClient(), options, 0);
+
+    ASSERT_TRUE(status.isOk()) << "subscribe failed: " << status.getMessage();
+
+    std::vector<VehiclePropValue> testValues;
+    for (int32_t i = 0; i < 3; i++) {
+        VehiclePropValue testValue{
+                .prop = GLOBAL_ON_CHANGE_PROP,
+                .value.int32Values = {i},
+        };
+        SetValueRequests setValueRequests = {
+                .payloads =
+                        {
+                                SetValueRequest{
+                                        .requestId = i,
+                                        .value = testValue,
+                                },
+                        },
+        };
+        std::vector<SetValueResult> setValueResults = {{
+                .requestId = i,
+                .status = StatusCode::OK,
+        }};
+
+        // Each set triggers a separate property change event from the hardware.
+        getHardware()->addSetValueResponses(setValueResults);
+        status = getClient()->setValues(getCallbackClient(), setValueRequests);
+
+        ASSERT_TRUE(status.isOk()) << "setValues failed: " << status.getMessage();
+        testValues.push_back(testValue);
+    }
+
+    ASSERT_EQ(getCallback()->countOnPropertyEventResults(), static_cast<size_t>(0))
+            << "events must not be sent before the batching window ends";
+
+    // Wait for the batching window to end.
+    auto deadline = std::chrono::steady_clock::now() +
+                    std::chrono::nanoseconds(3 * EVENT_BATCHING_WINDOW_IN_NANO);
+    while (getCallback()->countOnPropertyEventResults() == 0 &&
+           std::chrono::steady_clock::now() < deadline) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+
+    auto maybeResults = getCallback()->nextOnPropertyEventResults();
+    ASSERT_TRUE(maybeResults.has_value()) << "no results in callback";
+    ASSERT_EQ(maybeResults.value().payloads, testValues)
+            << "all the events within one window must be sent in one batch, in order";
+    ASSERT_FALSE(getCallback()->nextOnPropertyEventResults().has_value())
+            << "more results than expected";
+}
+
 TEST_F(DefaultVehicleHalTest, testSubscribeGlobalOnchangeUnrelatedEventIgnored) {
     std::vector<SubscribeOptions> options = {
             {
@@ -1512,6 +1582,31 @@ TEST_F(DefaultVehicleHalTest, testSubscribeNoReadPermission) {
     ASSERT_EQ(status.getServiceSpecificError(), toInt(StatusCode::ACCESS_DENIED));
 }
 
+TEST_F(DefaultVehicleHalTest, testSubscribeInvalidSharedMemoryFileCount) {
+    std::vector<SubscribeOptions> options = {{
+            .propId = GLOBAL_ON_CHANGE_PROP,
+    }};
+
+    auto status = getClient()->subscribe(getCallbackClient(), options,
+                                         IVehicle::MAX_SHARED_MEMORY_FILES_PER_CLIENT);
+
+    ASSERT_FALSE(status.isOk()) << "subscribe with too many shared memory files must fail";
+    ASSERT_EQ(status.getServiceSpecificError(), toInt(StatusCode::INVALID_ARG));
+}
+
+TEST_F(DefaultVehicleHalTest, testReturnSharedMemoryNotLent) {
+    std::vector<SubscribeOptions> options = {{
+            .propId = GLOBAL_ON_CHANGE_PROP,
+    }};
+    auto status = getClient()->subscribe(getCallbackClient(), options, 2);
+    ASSERT_TRUE(status.isOk()) << "subscribe failed: " << status.getMessage();
+
+    status = getClient()->returnSharedMemory(getCallbackClient(), 1);
+
+    ASSERT_FALSE(status.isOk()) << "returning a shared memory file that is not lent must fail";
+    ASSERT_EQ(status.getServiceSpecificError(), toInt(StatusCode::INVALID_ARG));
+}
+
 TEST_F(DefaultVehicleHalTest, testUnsubscribeFailure) {
     auto status = getClient()->unsubscribe(getCallbackClient(),
                                            std::vector<int32_t>({GLOBAL_ON_CHANGE_PROP}));
@@ -1634,6 +1729,7 @@ TEST_F(DefaultVehicleHalTest, testDumpCallerShouldDump) {
     std::string msg(buf);
 
     ASSERT_THAT(msg, ContainsRegex(buffer + "\nVehicle HAL State: \n"));
+    ASSERT_THAT(msg, ContainsRegex("Value pool: obtained: [0-9]+, thread cache hit: [0-9]+"));
 }
 
 TEST_F(DefaultVehicleHalTest, testDumpCallerShouldNotDump) {
@@ -60,7 +60,9 @@ ScopedAStatus MockVehicleCallback::onPropertyEvent(const VehiclePropValues& resu
     std::scoped_lock<std::mutex> lockGuard(mLock);
 
     mSharedMemoryFileCount = sharedMemoryFileCount;
-    return storeResults(results, &mOnPropertyEventResults);
+    ScopedAStatus status = storeResults(results, &mOnPropertyEventResults);
+    mOnPropertyEventResults.back().sharedMemoryId = results.sharedMemoryId;
+    return status;
 }
 
 ScopedAStatus MockVehicleCallback::onPropertySetError(const VehiclePropErrors&) {
@@ -87,6 +89,11 @@ size_t MockVehicleCallback::countOnPropertyEventResults() {
     return mOnPropertyEventResults.size();
 }
 
+int32_t MockVehicleCallback::getSharedMemoryFileCount() {
+    std::scoped_lock<std::mutex> lockGuard(mLock);
+    return mSharedMemoryFileCount;
+}
+
 }  // namespace vehicle
 }  // namespace automotive
 }  // namespace hardware
@@ -63,6 +63,7 @@ class MockVehicleCallback final
     std::optional<aidl::android::hardware::automotive::vehicle::VehiclePropValues>
     nextOnPropertyEventResults();
     size_t countOnPropertyEventResults();
+    int32_t getSharedMemoryFileCount();
 
   private:
     std::mutex mLock;
@@ -72,7 +73,7 @@ class MockVehicleCallback final
             GUARDED_BY(mLock);
     std::list<aidl::android::hardware::automotive::vehicle::VehiclePropValues>
             mOnPropertyEventResults GUARDED_BY(mLock);
-    int32_t mSharedMemoryFileCount GUARDED_BY(mLock);
+    int32_t mSharedMemoryFileCount GUARDED_BY(mLock) = 0;
 };
 
 }  // namespace vehicle
@@ -489,6 +489,30 @@ TEST_F(SubscriptionManagerTest, testCheckSampleRateInvalidZero) {
     ASSERT_FALSE(SubscriptionManager::checkSampleRate(0));
 }
 
+TEST_F(SubscriptionManagerTest, testCanCoalesce) {
+    std::vector<SubscribeOptions> options = {{
+            .propId = 0,
+            .areaIds = {0},
+            // Interval: 100ms.
+            .sampleRate = 10.0,
+    }};
+    auto result = getManager()->subscribe(getCallbackClient(), options, true);
+    ASSERT_TRUE(result.ok()) << "failed to subscribe: " << result.error().message();
+    options[0].propId = 1;
+    result = getManager()->subscribe(getCallbackClient(), options, false);
+    ASSERT_TRUE(result.ok()) << "failed to subscribe: " << result.error().message();
+
+    const AIBinder* clientId = getCallbackClient()->asBinder().get();
+    PropIdAreaId continuousProp = {.propId = 0, .areaId = 0};
+    PropIdAreaId onChangeProp = {.propId = 1, .areaId = 0};
+
+    EXPECT_TRUE(getManager()->canCoalesce(clientId, continuousProp, 50'000'000));
+    EXPECT_FALSE(getManager()->canCoalesce(clientId, continuousProp, 200'000'000))
+            << "must not coalesce if the window is longer than the sample interval";
+    EXPECT_FALSE(getManager()->canCoalesce(clientId, onChangeProp, 50'000'000))
+            << "must not coalesce on-change property updates";
+}
+
 }  // namespace vehicle
 }  // namespace automotive
 }  // namespace hardware
@@ -19,6 +19,8 @@
 #include <log/log.h>
 
 #include <inttypes.h>
+#include <algorithm>
+#include <numeric>
 #include "ExternalCameraDeviceSession.h"
 
 #include "android-base/macros.h"
@@ -81,6 +83,59 @@ bool tryLock(std::mutex& mutex)
     return locked;
 }
 
+// Returns the smallest frame in scaledFrames that is larger than size and has the same aspect
+// ratio, or null if there is none.
+sp<AllocatedFrame> findScaledSource(
+        const std::unordered_map<Size, sp<AllocatedFrame>, SizeHasher>& scaledFrames,
+        const Size& size) {
+    sp<AllocatedFrame> source;
+    for (const auto& entry : scaledFrames) {
+        const Size& sz = entry.first;
+        if (sz.width <= size.width || sz.height <= size.height ||
+                static_cast<uint64_t>(sz.width) * size.height !=
+                static_cast<uint64_t>(size.width) * sz.height) {
+            continue;
+        }
+        if (source == nullptr || sz.width < source->mWidth) {
+            source = entry.second;
+        }
+    }
+    return source;
+}
+
+// Allocates an intermediate YU12 buffer of every size in sizes other than v4lSize, and frees the
+// buffers of the sizes no longer listed.
+int updateIntermediateBuffers(const Size& v4lSize, const std::vector<Size>& sizes,
+        std::unordered_map<Size, sp<AllocatedFrame>, SizeHasher>* buffers) {
+    for (const auto& sz : sizes) {
+        if (sz == v4lSize) {
+            continue; // Don't need an intermediate buffer same size as v4lBuffer
+        }
+        if (buffers->count(sz) == 0) {
+            // Create new intermediate buffer
+            sp<AllocatedFrame> buf = new AllocatedFrame(sz.width, sz.height);
+            int ret = buf->allocate();
+            if (ret != 0) {
+                ALOGE("%s: allocating intermediate YU12 frame %dx%d failed!",
+                            __FUNCTION__, sz.width, sz.height);
+                return ret;
+            }
+            (*buffers)[sz] = buf;
+        }
+    }
+
+    // Remove unconfigured buffers
+    auto it = buffers->begin();
+    while (it != buffers->end()) {
+        if (std::find(sizes.begin(), sizes.end(), it->first) != sizes.end()) {
+            it++;
+        } else {
+            it = buffers->erase(it);
+        }
+    }
+    return 0;
+}
+
 } // Anonymous namespace
 
 // Static instances
@@ -923,7 +978,13 @@ ExternalCameraDeviceSession::OutputThread::OutputThread(
         const common::V1_0::helper::CameraMetadata& chars) :
         mParent(parent), mCroppingType(ct), mCameraCharacteristics(chars) {}
 
-ExternalCameraDeviceSession::OutputThread::~OutputThread() {}
+ExternalCameraDeviceSession::OutputThread::~OutputThread() {
+    // Stop the pipeline stages before the members they use are destroyed
+    if (mConvertStage != nullptr) {
+        mConvertStage->requestExitAndWait();
+        mEncodeStage->requestExitAndWait();
+    }
+}
 
 void ExternalCameraDeviceSession::OutputThread::setExifMakeModel(
         const std::string& make, const std::string& model) {
@@ -933,6 +994,12 @@ void ExternalCameraDeviceSession::OutputThread::setExifMakeModel(
 
 int ExternalCameraDeviceSession::OutputThread::cropAndScaleLocked(
         sp<AllocatedFrame>& in, const Size& outSz, YCbCrLayout* out) {
+    return cropAndScale(in, outSz, mIntermediateBuffers, &mScaledYu12Frames, out);
+}
+
+int ExternalCameraDeviceSession::OutputThread::cropAndScale(
+        sp<AllocatedFrame>& in, const Size& outSz,
+        const FrameMap& intermediateBuffers, FrameMap* scaledFrames, YCbCrLayout* out) {
     Size inSz = {in->mWidth, in->mHeight};
 
     int ret;
@@ -945,6 +1012,16 @@ int ExternalCameraDeviceSession::OutputThread::cropAndScaleLocked(
         return ret;
     }
 
+    // Each output size is only scaled once per frame
+    auto it = scaledFrames->find(outSz);
+    if (it != scaledFrames->end()) {
+        ret = it->second->getLayout(out);
+        if (ret != 0) {
+            ALOGE("%s: failed to get scaled image layout", __FUNCTION__);
+        }
+        return ret;
+    }
+
     // Cropping to output aspect ratio
     IMapper::Rect inputCrop;
     ret = getCropRect(mCroppingType, inSz, outSz, &inputCrop);
@@ -969,19 +1046,13 @@ int ExternalCameraDeviceSession::OutputThread::cropAndScaleLocked(
         return 0;
     }
 
-    auto it = mScaledYu12Frames.find(outSz);
-    sp<AllocatedFrame> scaledYu12Buf;
-    if (it != mScaledYu12Frames.end()) {
-        scaledYu12Buf = it->second;
-    } else {
-        it = mIntermediateBuffers.find(outSz);
-        if (it == mIntermediateBuffers.end()) {
-            ALOGE("%s: failed to find intermediate buffer size %dx%d",
-                    __FUNCTION__, outSz.width, outSz.height);
-            return -1;
-        }
-        scaledYu12Buf = it->second;
+    auto bufIt = intermediateBuffers.find(outSz);
+    if (bufIt == intermediateBuffers.end()) {
+        ALOGE("%s: failed to find intermediate buffer size %dx%d",
+                __FUNCTION__, outSz.width, outSz.height);
+        return -1;
     }
+    sp<AllocatedFrame> scaledYu12Buf = bufIt->second;
     // Scale
     YCbCrLayout outLayout;
     ret = scaledYu12Buf->getLayout(&outLayout);
@@ -990,15 +1061,26 @@ int ExternalCameraDeviceSession::OutputThread::cropAndScaleLocked(
         return ret;
     }
 
+    // An output of the same aspect ratio scaled earlier in this frame covers the same crop of the
+    // input, so scale from the smallest such output that is still larger instead of the input
+    YCbCrLayout srcLayout = croppedLayout;
+    Size srcSz = {static_cast<uint32_t>(inputCrop.width), static_cast<uint32_t>(inputCrop.height)};
+    sp<AllocatedFrame> scaledSrc = findScaledSource(*scaledFrames, outSz);
+    YCbCrLayout scaledSrcLayout;
+    if (scaledSrc != nullptr && scaledSrc->getLayout(&scaledSrcLayout) == 0) {
+        srcLayout = scaledSrcLayout;
+        srcSz = {scaledSrc->mWidth, scaledSrc->mHeight};
+    }
+
     ret = libyuv::I420Scale(
-            static_cast<uint8_t*>(croppedLayout.y),
-            croppedLayout.yStride,
-            static_cast<uint8_t*>(croppedLayout.cb),
-            croppedLayout.cStride,
-            static_cast<uint8_t*>(croppedLayout.cr),
-            croppedLayout.cStride,
-            inputCrop.width,
-            inputCrop.height,
+            static_cast<uint8_t*>(srcLayout.y),
+            srcLayout.yStride,
+            static_cast<uint8_t*>(srcLayout.cb),
+            srcLayout.cStride,
+            static_cast<uint8_t*>(srcLayout.cr),
+            srcLayout.cStride,
+            srcSz.width,
+            srcSz.height,
             static_cast<uint8_t*>(outLayout.y),
             outLayout.yStride,
             static_cast<uint8_t*>(outLayout.cb),
@@ -1012,13 +1094,13 @@ int ExternalCameraDeviceSession::OutputThread::cropAndScaleLocked(
 
     if (ret != 0) {
         ALOGE("%s: failed to scale buffer from %dx%d to %dx%d. Ret %d",
-                __FUNCTION__, inputCrop.width, inputCrop.height,
+                __FUNCTION__, srcSz.width, srcSz.height,
                 outSz.width, outSz.height, ret);
         return ret;
     }
 
     *out = outLayout;
-    mScaledYu12Frames.insert({outSz, scaledYu12Buf});
+    scaledFrames->insert({outSz, scaledYu12Buf});
     return 0;
 }
 
@@ -1236,6 +1318,15 @@ ssize_t ExternalCameraDeviceSession::getJpegBufferSize(
 int ExternalCameraDeviceSession::OutputThread::createJpegLocked(
         HalStreamBuffer &halBuf,
         const common::V1_0::helper::CameraMetadata& setting)
+{
+    return createJpeg(halBuf, setting, mYu12Frame, mIntermediateBuffers, &mScaledYu12Frames);
+}
+
+int ExternalCameraDeviceSession::OutputThread::createJpeg(
+        HalStreamBuffer &halBuf,
+        const common::V1_0::helper::CameraMetadata& setting,
+        sp<AllocatedFrame>& yu12Frame,
+        const FrameMap& intermediateBuffers, FrameMap* scaledFrames)
 {
     ATRACE_CALL();
     int ret;
@@ -1258,7 +1349,7 @@ int ExternalCameraDeviceSession::OutputThread::createJpegLocked(
           halBuf.bufPtr);
     ALOGV("%s: YV12 buffer %d x %d",
           __FUNCTION__,
-          mYu12Frame->mWidth, mYu12Frame->mHeight);
+          yu12Frame->mWidth, yu12Frame->mHeight);
 
     int jpegQuality, thumbQuality;
     Size thumbSize;
@@ -1321,9 +1412,22 @@ int ExternalCameraDeviceSession::OutputThread::createJpegLocked(
     /* Temporary thumbnail code buffer */
     std::vector<uint8_t> thumbCode(outputThumbnail ? maxThumbCodeSize : 0);
 
+    /* Scale and crop main jpeg */
+    ret = cropAndScale(yu12Frame, jpegSize, intermediateBuffers, scaledFrames, &yu12Main);
+
+    if (ret != 0) {
+        return lfail("%s: crop and scale main failed!", __FUNCTION__);
+    }
+
+    /* Derive the thumbnail from the main image when it has the same aspect
+     * ratio, rather than from the full input frame */
     YCbCrLayout yu12Thumb;
     if (outputThumbnail) {
-        ret = cropAndScaleThumbLocked(mYu12Frame, thumbSize, &yu12Thumb);
+        sp<AllocatedFrame> thumbSrc = findScaledSource(*scaledFrames, thumbSize);
+        if (thumbSrc == nullptr) {
+            thumbSrc = yu12Frame;
+        }
+        ret = cropAndScaleThumbLocked(thumbSrc, thumbSize, &yu12Thumb);
 
         if (ret != 0) {
             return lfail(
@@ -1331,13 +1435,6 @@ int ExternalCameraDeviceSession::OutputThread::createJpegLocked(
         }
     }
 
-    /* Scale and crop main jpeg */
-    ret = cropAndScaleLocked(mYu12Frame, jpegSize, &yu12Main);
-
-    if (ret != 0) {
-        return lfail("%s: crop and scale main failed!", __FUNCTION__);
-    }
-
     /* Encode the thumbnail image */
     if (outputThumbnail) {
         ret = encodeJpegYU12(thumbSize, yu12Thumb,
@@ -1413,6 +1510,179 @@ int ExternalCameraDeviceSession::OutputThread::createJpegLocked(
     return 0;
 }
 
+ExternalCameraDeviceSession::OutputThread::PipelineStage::PipelineStage(Handler handler) :
+        mHandler(std::move(handler)) {}
+
+void ExternalCameraDeviceSession::OutputThread::PipelineStage::submit(PipelineRequest request) {
+    std::unique_lock<std::mutex> lk(mLock);
+    mRequests.push_back(std::move(request));
+    lk.unlock();
+    mCond.notify_one();
+}
+
+void ExternalCameraDeviceSession::OutputThread::PipelineStage::requestExit() {
+    Thread::requestExit();
+    mCond.notify_one();
+}
+
+bool ExternalCameraDeviceSession::OutputThread::PipelineStage::threadLoop() {
+    std::unique_lock<std::mutex> lk(mLock);
+    if (mRequests.empty()) {
+        // Return to check exitPending() even if no request is submitted
+        mCond.wait_for(lk, std::chrono::milliseconds(kReqWaitTimeoutMs));
+        return true;
+    }
+    PipelineRequest request = std::move(mRequests.front());
+    mRequests.pop_front();
+    lk.unlock();
+    mHandler(request);
+    return true;
+}
+
+bool ExternalCameraDeviceSession::OutputThread::startPipeline() {
+    std::lock_guard<std::mutex> lk(mPipelineLock);
+    if (mConvertStage != nullptr) {
+        return true;
+    }
+    if (exitPending()) {
+        return false;
+    }
+    mConvertStage = new PipelineStage([this](PipelineRequest& request) {
+        convertStage(request);
+    });
+    mEncodeStage = new PipelineStage([this](PipelineRequest& request) {
+        encodeStage(request);
+    });
+    mConvertStage->run("ExtCamConvert", PRIORITY_DISPLAY);
+    mEncodeStage->run("ExtCamEncode", PRIORITY_DISPLAY);
+    return true;
+}
+
+void ExternalCameraDeviceSession::OutputThread::requestExit() {
+    Thread::requestExit();
+    std::lock_guard<std::mutex> lk(mPipelineLock);
+    if (mConvertStage != nullptr) {
+        mConvertStage->requestExit();
+        mEncodeStage->requestExit();
+    }
+    mPipelineFrameCond.notify_all();
+}
+
+sp<AllocatedFrame> ExternalCameraDeviceSession::OutputThread::acquirePipelineFrame() {
+    std::unique_lock<std::mutex> lk(mPipelineLock);
+    while (mFreePipelineFrames.empty()) {
+        if (mPipelineFrameCount < kPipelineDepth) {
+            // Frames beyond mYu12Frame are only allocated once the pipeline fills up
+            sp<AllocatedFrame> frame = new AllocatedFrame(mYu12Frame->mWidth, mYu12Frame->mHeight);
+            if (frame->allocate() != 0) {
+                ALOGE("%s: allocating YU12 frame failed!", __FUNCTION__);
+                return nullptr;
+            }
+            mPipelineFrameCount++;
+            return frame;
+        }
+        if (exitPending()) {
+            return nullptr;
+        }
+        mPipelineFrameCond.wait_for(lk, std::chrono::milliseconds(kReqWaitTimeoutMs));
+    }
+    sp<AllocatedFrame> frame = mFreePipelineFrames.back();
+    mFreePipelineFrames.pop_back();
+    return frame;
+}
+
+void ExternalCameraDeviceSession::OutputThread::releasePipelineFrame(sp<AllocatedFrame>& frame) {
+    if (frame == nullptr) {
+        return;
+    }
+    std::unique_lock<std::mutex> lk(mPipelineLock);
+    mFreePipelineFrames.push_back(frame);
+    frame.clear();
+    lk.unlock();
+    mPipelineFrameCond.notify_one();
+}
+
+void ExternalCameraDeviceSession::OutputThread::waitForAcquireFences(
+        std::vector<HalStreamBuffer>* buffers) {
+    const int kSyncWaitTimeoutMs = 500;
+    for (auto& halBuf : *buffers) {
+        if (*(halBuf.bufPtr) == nullptr) {
+            ALOGW("%s: buffer for stream %d missing", __FUNCTION__, halBuf.streamId);
+            halBuf.fenceTimeout = true;
+        } else if (halBuf.acquireFence >= 0) {
+            int ret = sync_wait(halBuf.acquireFence, kSyncWaitTimeoutMs);
+            if (ret) {
+                halBuf.fenceTimeout = true;
+            } else {
+                ::close(halBuf.acquireFence);
+                halBuf.acquireFence = -1;
+            }
+        }
+    }
+}
+
+bool ExternalCameraDeviceSession::OutputThread::canDecodeToOutput(const HalRequest& req) const {
+    if (req.frameIn->mFourcc != V4L2_PIX_FMT_MJPEG || mCameraMuted || req.buffers.size() != 1) {
+        return false;
+    }
+    const HalStreamBuffer& halBuf = req.buffers[0];
+    return (halBuf.format == PixelFormat::YCBCR_420_888 || halBuf.format == PixelFormat::YV12) &&
+            halBuf.width == req.frameIn->mWidth && halBuf.height == req.frameIn->mHeight;
+}
+
+int ExternalCameraDeviceSession::OutputThread::decodeLocked(
+        uint8_t* inData, size_t inDataSize, const Size& size, const YCbCrLayout& out) {
+    if (mCameraMuted) {
+        return libyuv::ConvertToI420(
+                mMuteTestPatternFrame.data(), mMuteTestPatternFrame.size(),
+                static_cast<uint8_t*>(out.y), out.yStride,
+                static_cast<uint8_t*>(out.cb), out.cStride,
+                static_cast<uint8_t*>(out.cr), out.cStride, 0, 0,
+                size.width, size.height, size.width, size.height,
+                libyuv::kRotate0, libyuv::FOURCC_RAW);
+    }
+    return libyuv::MJPGToI420(
+            inData, inDataSize, static_cast<uint8_t*>(out.y), out.yStride,
+            static_cast<uint8_t*>(out.cb), out.cStride,
+            static_cast<uint8_t*>(out.cr), out.cStride,
+            size.width, size.height, size.width, size.height);
+}
+
+int ExternalCameraDeviceSession::OutputThread::decodeToOutputLocked(
+        uint8_t* inData, size_t inDataSize, HalStreamBuffer& halBuf) {
+    ATRACE_CALL();
+    IMapper::Rect outRect {0, 0,
+            static_cast<int32_t>(halBuf.width),
+            static_cast<int32_t>(halBuf.height)};
+    YCbCrLayout outLayout = sHandleImporter.lockYCbCr(
+            *(halBuf.bufPtr), halBuf.usage, outRect);
+    Size sz {halBuf.width, halBuf.height};
+
+    int ret = 0;
+    if (outLayout.chromaStep == 1) {
+        ret = decodeLocked(inData, inDataSize, sz, outLayout);
+    } else {
+        // libyuv only decodes MJPEG to planar YUV, so go through a YU12 frame
+        sp<AllocatedFrame> yu12Frame = acquirePipelineFrame();
+        YCbCrLayout yu12Layout;
+        if (yu12Frame == nullptr || yu12Frame->getLayout(&yu12Layout) != 0) {
+            ret = -1;
+        } else {
+            ret = decodeLocked(inData, inDataSize, sz, yu12Layout);
+            if (ret == 0) {
+                ret = formatConvert(yu12Layout, outLayout, sz, getFourCcFromLayout(outLayout));
+            }
+        }
+        releasePipelineFrame(yu12Frame);
+    }
+
+    int relFence = sHandleImporter.unlock(*(halBuf.bufPtr));
+    if (relFence >= 0) {
+        halBuf.acquireFence = relFence;
+    }
+    return ret;
+}
+
 bool ExternalCameraDeviceSession::OutputThread::threadLoop() {
     std::shared_ptr<HalRequest> req;
     auto parent = mParent.promote();
@@ -1421,6 +1691,10 @@ bool ExternalCameraDeviceSession::OutputThread::threadLoop() {
        return false;
     }
 
+    if (!startPipeline()) {
+        return false;
+    }
+
     // TODO: maybe we need to setup a sensor thread to dq/enq v4l frames
     //       regularly to prevent v4l buffer queue filled with stale buffers
     //       when app doesn't program a preveiw request
@@ -1430,11 +1704,15 @@ bool ExternalCameraDeviceSession::OutputThread::threadLoop() {
         return true;
     }
 
+    PipelineRequest request;
+    request.req = req;
+
     auto onDeviceError = [&](auto... args) {
         ALOGE(args...);
         parent->notifyError(
                 req->frameNumber, /*stream*/-1, ErrorCode::ERROR_DEVICE);
-        signalRequestDone();
+        releasePipelineFrame(request.yu12Frame);
+        signalRequestDone(req->frameNumber);
         return false;
     };
 
@@ -1486,38 +1764,45 @@ bool ExternalCameraDeviceSession::OutputThread::threadLoop() {
         }
     }
 
-    // TODO: in some special case maybe we can decode jpg directly to gralloc output?
-    if (req->frameIn->mFourcc == V4L2_PIX_FMT_MJPEG) {
+    auto onDecodeError = [&](int ret) {
+        // For some webcam, the first few V4L2 frames might be malformed...
+        ALOGE("%s: Convert V4L2 frame to YU12 failed! res %d", __FUNCTION__, ret);
+        releasePipelineFrame(request.yu12Frame);
+        lk.unlock();
+        request.failed = true;
+        mConvertStage->submit(std::move(request));
+        return true;
+    };
+
+    // A request whose only output is the size of the V4L2 frame skips the YU12 frame and the
+    // later stages, it is decoded directly into the output buffer once that is available
+    const bool decodeToOutput = canDecodeToOutput(*req);
+    if (!decodeToOutput) {
+        request.yu12Frame = acquirePipelineFrame();
+        if (request.yu12Frame == nullptr) {
+            if (exitPending()) {
+                lk.unlock();
+                request.failed = true;
+                mConvertStage->submit(std::move(request));
+                return false;
+            }
+            lk.unlock();
+            return onDeviceError("%s: no YU12 frame to decode into!", __FUNCTION__);
+        }
+    }
+
+    if (req->frameIn->mFourcc == V4L2_PIX_FMT_MJPEG && !decodeToOutput) {
         ATRACE_BEGIN("MJPGtoI420");
-        int res = 0;
-        if (mCameraMuted) {
-            res = libyuv::ConvertToI420(
-                    mMuteTestPatternFrame.data(), mMuteTestPatternFrame.size(),
-                    static_cast<uint8_t*>(mYu12FrameLayout.y), mYu12FrameLayout.yStride,
-                    static_cast<uint8_t*>(mYu12FrameLayout.cb), mYu12FrameLayout.cStride,
-                    static_cast<uint8_t*>(mYu12FrameLayout.cr), mYu12FrameLayout.cStride, 0, 0,
-                    mYu12Frame->mWidth, mYu12Frame->mHeight, mYu12Frame->mWidth,
-                    mYu12Frame->mHeight, libyuv::kRotate0, libyuv::FOURCC_RAW);
-        } else {
-            res = libyuv::MJPGToI420(
-                    inData, inDataSize, static_cast<uint8_t*>(mYu12FrameLayout.y),
-                    mYu12FrameLayout.yStride, static_cast<uint8_t*>(mYu12FrameLayout.cb),
-                    mYu12FrameLayout.cStride, static_cast<uint8_t*>(mYu12FrameLayout.cr),
-                    mYu12FrameLayout.cStride, mYu12Frame->mWidth, mYu12Frame->mHeight,
-                    mYu12Frame->mWidth, mYu12Frame->mHeight);
+        YCbCrLayout yu12Layout;
+        int res = request.yu12Frame->getLayout(&yu12Layout);
+        if (res == 0) {
+            Size sz {request.yu12Frame->mWidth, request.yu12Frame->mHeight};
+            res = decodeLocked(inData, inDataSize, sz, yu12Layout);
         }
         ATRACE_END();
 
         if (res != 0) {
-            // For some webcam, the first few V4L2 frames might be malformed...
-            ALOGE("%s: Convert V4L2 frame to YU12 failed! res %d", __FUNCTION__, res);
-            lk.unlock();
-            Status st = parent->processCaptureRequestError(req);
-            if (st != Status::OK) {
-                return onDeviceError("%s: failed to process capture request error!", __FUNCTION__);
-            }
-            signalRequestDone();
-            return true;
+            return onDecodeError(res);
         }
     }
 
@@ -1531,38 +1816,78 @@ bool ExternalCameraDeviceSession::OutputThread::threadLoop() {
         return onDeviceError("%s: failed to process buffer request error!", __FUNCTION__);
     }
 
-    ALOGV("%s processing new request", __FUNCTION__);
-    const int kSyncWaitTimeoutMs = 500;
-    for (auto& halBuf : req->buffers) {
-        if (*(halBuf.bufPtr) == nullptr) {
-            ALOGW("%s: buffer for stream %d missing", __FUNCTION__, halBuf.streamId);
-            halBuf.fenceTimeout = true;
-        } else if (halBuf.acquireFence >= 0) {
-            int ret = sync_wait(halBuf.acquireFence, kSyncWaitTimeoutMs);
-            if (ret) {
-                halBuf.fenceTimeout = true;
-            } else {
-                ::close(halBuf.acquireFence);
-                halBuf.acquireFence = -1;
+    if (decodeToOutput) {
+        waitForAcquireFences(&req->buffers);
+        HalStreamBuffer& halBuf = req->buffers[0];
+        if (!halBuf.fenceTimeout) {
+            res = decodeToOutputLocked(inData, inDataSize, halBuf);
+            if (res != 0) {
+                return onDecodeError(res);
             }
         }
+    }
+    lk.unlock();
+
+    mConvertStage->submit(std::move(request));
+    return true;
+}
+
+void ExternalCameraDeviceSession::OutputThread::convertStage(PipelineRequest& request) {
+    ATRACE_CALL();
+    const std::shared_ptr<HalRequest>& req = request.req;
+    auto parent = mParent.promote();
+    if (parent == nullptr) {
+       ALOGE("%s: session has been disconnected!", __FUNCTION__);
+       return;
+    }
+
+    auto onDeviceError = [&](auto... args) {
+        ALOGE(args...);
+        parent->notifyError(
+                req->frameNumber, /*stream*/-1, ErrorCode::ERROR_DEVICE);
+        mScaledYu12Frames.clear();
+        releasePipelineFrame(request.yu12Frame);
+        signalRequestDone(req->frameNumber);
+        // Stop the whole pipeline, the session cannot recover from a device error
+        requestExit();
+    };
+
+    if (request.failed || request.yu12Frame == nullptr) {
+        // Failed, or already decoded into its only output buffer
+        mEncodeStage->submit(std::move(request));
+        return;
+    }
 
+    ALOGV("%s processing new request", __FUNCTION__);
+    waitForAcquireFences(&req->buffers);
+    // Handle the largest outputs first, so that smaller outputs of the same aspect ratio can be
+    // scaled from them
+    std::vector<size_t> order(req->buffers.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+        const HalStreamBuffer& bufA = req->buffers[a];
+        const HalStreamBuffer& bufB = req->buffers[b];
+        return static_cast<uint64_t>(bufA.width) * bufA.height >
+                static_cast<uint64_t>(bufB.width) * bufB.height;
+    });
+    for (size_t i : order) {
+        auto& halBuf = req->buffers[i];
         if (halBuf.fenceTimeout) {
             continue;
         }
 
         // Gralloc lockYCbCr the buffer
         switch (halBuf.format) {
-            case PixelFormat::BLOB: {
-                int ret = createJpegLocked(halBuf, req->setting);
-
-                if(ret != 0) {
-                    lk.unlock();
-                    return onDeviceError("%s: createJpegLocked failed with %d",
-                          __FUNCTION__, ret);
-                }
-            } break;
+            case PixelFormat::BLOB:
+                // Encoded by mEncodeStage
+                break;
             case PixelFormat::Y16: {
+                uint8_t* inData;
+                size_t inDataSize;
+                if (req->frameIn->getData(&inData, &inDataSize) != 0) {
+                    return onDeviceError("%s: V4L2 buffer map failed", __FUNCTION__);
+                }
+
                 void* outLayout = sHandleImporter.lock(*(halBuf.bufPtr), halBuf.usage, inDataSize);
 
                 std::memcpy(outLayout, inData, inDataSize);
@@ -1592,14 +1917,14 @@ bool ExternalCameraDeviceSession::OutputThread::threadLoop() {
                         (outputFourcc >> 24) & 0xFF);
 
                 YCbCrLayout cropAndScaled;
-                ATRACE_BEGIN("cropAndScaleLocked");
-                int ret = cropAndScaleLocked(
-                        mYu12Frame,
+                ATRACE_BEGIN("cropAndScale");
+                int ret = cropAndScale(
+                        request.yu12Frame,
                         Size { halBuf.width, halBuf.height },
+                        mIntermediateBuffers, &mScaledYu12Frames,
                         &cropAndScaled);
                 ATRACE_END();
                 if (ret != 0) {
-                    lk.unlock();
                     return onDeviceError("%s: crop and scale failed!", __FUNCTION__);
                 }
 
@@ -1608,7 +1933,6 @@ bool ExternalCameraDeviceSession::OutputThread::threadLoop() {
                 ret = formatConvert(cropAndScaled, outLayout, sz, outputFourcc);
                 ATRACE_END();
                 if (ret != 0) {
-                    lk.unlock();
                     return onDeviceError("%s: format coversion failed!", __FUNCTION__);
                 }
                 int relFence = sHandleImporter.unlock(*(halBuf.bufPtr));
@@ -1617,20 +1941,64 @@ bool ExternalCameraDeviceSession::OutputThread::threadLoop() {
                 }
             } break;
             default:
-                lk.unlock();
                 return onDeviceError("%s: unknown output format %x", __FUNCTION__, halBuf.format);
         }
     } // for each buffer
     mScaledYu12Frames.clear();
 
-    // Don't hold the lock while calling back to parent
-    lk.unlock();
+    mEncodeStage->submit(std::move(request));
+}
+
+void ExternalCameraDeviceSession::OutputThread::encodeStage(PipelineRequest& request) {
+    ATRACE_CALL();
+    std::shared_ptr<HalRequest>& req = request.req;
+    auto parent = mParent.promote();
+    if (parent == nullptr) {
+       ALOGE("%s: session has been disconnected!", __FUNCTION__);
+       return;
+    }
+
+    auto onDeviceError = [&](auto... args) {
+        ALOGE(args...);
+        parent->notifyError(
+                req->frameNumber, /*stream*/-1, ErrorCode::ERROR_DEVICE);
+        mJpegScaledYu12Frames.clear();
+        releasePipelineFrame(request.yu12Frame);
+        signalRequestDone(req->frameNumber);
+        // Stop the whole pipeline, the session cannot recover from a device error
+        requestExit();
+    };
+
+    if (request.failed) {
+        // For some webcam, the first few V4L2 frames might be malformed...
+        Status st = parent->processCaptureRequestError(req);
+        if (st != Status::OK) {
+            return onDeviceError("%s: failed to process capture request error!", __FUNCTION__);
+        }
+        signalRequestDone(req->frameNumber);
+        return;
+    }
+
+    for (auto& halBuf : req->buffers) {
+        if (halBuf.fenceTimeout || halBuf.format != PixelFormat::BLOB) {
+            continue;
+        }
+        int ret = createJpeg(halBuf, req->setting, request.yu12Frame,
+                mJpegIntermediateBuffers, &mJpegScaledYu12Frames);
+        if (ret != 0) {
+            return onDeviceError("%s: createJpeg failed with %d", __FUNCTION__, ret);
+        }
+    }
+    mJpegScaledYu12Frames.clear();
+
+    // Return the YU12 frame before the result, so that it is back in the pool once the framework
+    // sees the request is no longer in flight and can reconfigure the streams
+    releasePipelineFrame(request.yu12Frame);
     Status st = parent->processCaptureResult(req);
     if (st != Status::OK) {
         return onDeviceError("%s: failed to process capture result!", __FUNCTION__);
     }
-    signalRequestDone();
-    return true;
+    signalRequestDone(req->frameNumber);
 }
 
 Status ExternalCameraDeviceSession::OutputThread::allocateIntermediateBuffers(
@@ -1654,6 +2022,12 @@ Status ExternalCameraDeviceSession::OutputThread::allocateIntermediateBuffers(
             ALOGE("%s: allocating YU12 frame failed!", __FUNCTION__);
             return Status::INTERNAL_ERROR;
         }
+
+        // The other pipeline frames are allocated in the new size as they are needed
+        std::lock_guard<std::mutex> pipelineLk(mPipelineLock);
+        mFreePipelineFrames.clear();
+        mFreePipelineFrames.push_back(mYu12Frame);
+        mPipelineFrameCount = 1;
     }
 
     // Allocating intermediate YU12 thumbnail frame
@@ -1669,41 +2043,19 @@ Status ExternalCameraDeviceSession::OutputThread::allocateIntermediateBuffers(
         }
     }
 
-    // Allocating scaled buffers
+    // Allocating scaled buffers, with a separate set for the JPEG outputs
+    std::vector<Size> sizes;
+    std::vector<Size> jpegSizes;
     for (const auto& stream : streams) {
         Size sz = {stream.width, stream.height};
-        if (sz == v4lSize) {
-            continue; // Don't need an intermediate buffer same size as v4lBuffer
-        }
-        if (mIntermediateBuffers.count(sz) == 0) {
-            // Create new intermediate buffer
-            sp<AllocatedFrame> buf = new AllocatedFrame(stream.width, stream.height);
-            int ret = buf->allocate();
-            if (ret != 0) {
-                ALOGE("%s: allocating intermediate YU12 frame %dx%d failed!",
-                            __FUNCTION__, stream.width, stream.height);
-                return Status::INTERNAL_ERROR;
-            }
-            mIntermediateBuffers[sz] = buf;
+        sizes.push_back(sz);
+        if (stream.format == PixelFormat::BLOB) {
+            jpegSizes.push_back(sz);
         }
     }
-
-    // Remove unconfigured buffers
-    auto it = mIntermediateBuffers.begin();
-    while (it != mIntermediateBuffers.end()) {
-        bool configured = false;
-        auto sz = it->first;
-        for (const auto& stream : streams) {
-            if (stream.width == sz.width && stream.height == sz.height) {
-                configured = true;
-                break;
-            }
-        }
-        if (configured) {
-            it++;
-        } else {
-            it = mIntermediateBuffers.erase(it);
-        }
+    if (updateIntermediateBuffers(v4lSize, sizes, &mIntermediateBuffers) != 0 ||
+            updateIntermediateBuffers(v4lSize, jpegSizes, &mJpegIntermediateBuffers) != 0) {
+        return Status::INTERNAL_ERROR;
     }
 
     // Allocate mute test pattern frame
@@ -1718,8 +2070,13 @@ void ExternalCameraDeviceSession::OutputThread::clearIntermediateBuffers() {
     mYu12Frame.clear();
     mYu12ThumbFrame.clear();
     mIntermediateBuffers.clear();
+    mJpegIntermediateBuffers.clear();
     mMuteTestPatternFrame.clear();
     mBlobBufferSize = 0;
+
+    std::lock_guard<std::mutex> pipelineLk(mPipelineLock);
+    mFreePipelineFrames.clear();
+    mPipelineFrameCount = 0;
 }
 
 Status ExternalCameraDeviceSession::OutputThread::submitRequest(
@@ -1742,12 +2099,9 @@ void ExternalCameraDeviceSession::OutputThread::flush() {
     std::unique_lock<std::mutex> lk(mRequestListLock);
     std::list<std::shared_ptr<HalRequest>> reqs = std::move(mRequestList);
     mRequestList.clear();
-    if (mProcessingRequest) {
-        std::chrono::seconds timeout = std::chrono::seconds(kFlushWaitTimeoutSec);
-        auto st = mRequestDoneCond.wait_for(lk, timeout);
-        if (st == std::cv_status::timeout) {
-            ALOGE("%s: wait for inflight request finish timeout!", __FUNCTION__);
-        }
+    std::chrono::seconds timeout = std::chrono::seconds(kFlushWaitTimeoutSec);
+    if (!mRequestDoneCond.wait_for(lk, timeout, [&] { return mProcessingFrameNumbers.empty(); })) {
+        ALOGE("%s: wait for inflight request finish timeout!", __FUNCTION__);
     }
 
     ALOGV("%s: flusing inflight requests", __FUNCTION__);
@@ -1770,12 +2124,9 @@ ExternalCameraDeviceSession::OutputThread::switchToOffline() {
     std::unique_lock<std::mutex> lk(mRequestListLock);
     std::list<std::shared_ptr<HalRequest>> reqs = std::move(mRequestList);
     mRequestList.clear();
-    if (mProcessingRequest) {
-        std::chrono::seconds timeout = std::chrono::seconds(kFlushWaitTimeoutSec);
-        auto st = mRequestDoneCond.wait_for(lk, timeout);
-        if (st == std::cv_status::timeout) {
-            ALOGE("%s: wait for inflight request finish timeout!", __FUNCTION__);
-        }
+    std::chrono::seconds timeout = std::chrono::seconds(kFlushWaitTimeoutSec);
+    if (!mRequestDoneCond.wait_for(lk, timeout, [&] { return mProcessingFrameNumbers.empty(); })) {
+        ALOGE("%s: wait for inflight request finish timeout!", __FUNCTION__);
     }
     lk.unlock();
     clearIntermediateBuffers();
@@ -1809,22 +2160,24 @@ void ExternalCameraDeviceSession::OutputThread::waitForNextRequest(
     }
     *out = mRequestList.front();
     mRequestList.pop_front();
-    mProcessingRequest = true;
-    mProcessingFrameNumer = (*out)->frameNumber;
+    mProcessingFrameNumbers.push_back((*out)->frameNumber);
 }
 
-void ExternalCameraDeviceSession::OutputThread::signalRequestDone() {
+void ExternalCameraDeviceSession::OutputThread::signalRequestDone(uint32_t frameNumber) {
     std::unique_lock<std::mutex> lk(mRequestListLock);
-    mProcessingRequest = false;
-    mProcessingFrameNumer = 0;
+    mProcessingFrameNumbers.remove(frameNumber);
     lk.unlock();
-    mRequestDoneCond.notify_one();
+    mRequestDoneCond.notify_all();
 }
 
 void ExternalCameraDeviceSession::OutputThread::dump(int fd) {
     std::lock_guard<std::mutex> lk(mRequestListLock);
-    if (mProcessingRequest) {
-        dprintf(fd, "OutputThread processing frame %d\n", mProcessingFrameNumer);
+    if (!mProcessingFrameNumbers.empty()) {
+        dprintf(fd, "OutputThread processing frame: ");
+        for (const auto& frameNumber : mProcessingFrameNumbers) {
+            dprintf(fd, "%d, ", frameNumber);
+        }
+        dprintf(fd, "\n");
     } else {
         dprintf(fd, "OutputThread not processing any frames\n");
     }
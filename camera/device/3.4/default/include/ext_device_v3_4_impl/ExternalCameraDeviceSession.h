@@ -25,6 +25,7 @@
 #include <include/convert.h>
 #include <chrono>
 #include <condition_variable>
+#include <functional>
 #include <list>
 #include <unordered_map>
 #include <unordered_set>
@@ -125,6 +126,8 @@ struct ExternalCameraDeviceSession : public virtual RefBase,
         void flush();
         void dump(int fd);
         virtual bool threadLoop() override;
+        // Also stops the pipeline stage threads started by threadLoop()
+        virtual void requestExit() override;
 
         void setExifMakeModel(const std::string& make, const std::string& model);
 
@@ -132,6 +135,36 @@ struct ExternalCameraDeviceSession : public virtual RefBase,
         std::list<std::shared_ptr<HalRequest>> switchToOffline();
 
     protected:
+        using FrameMap = std::unordered_map<Size, sp<AllocatedFrame>, SizeHasher>;
+
+        // A request handed from one stage of the pipeline to the next
+        struct PipelineRequest {
+            std::shared_ptr<HalRequest> req;
+            // YU12 frame decoded from req->frameIn. Null if the request was decoded directly
+            // into its only output buffer.
+            sp<AllocatedFrame> yu12Frame;
+            // Set if the V4L2 frame could not be decoded. The request still goes through every
+            // stage, so that mEncodeStage returns it as an error in frame number order.
+            bool failed = false;
+        };
+
+        // Runs one stage of the pipeline on the requests submitted to it, in submission order
+        class PipelineStage : public android::Thread {
+        public:
+            using Handler = std::function<void(PipelineRequest&)>;
+
+            explicit PipelineStage(Handler handler);
+            void submit(PipelineRequest request);
+            virtual void requestExit() override;
+            virtual bool threadLoop() override;
+
+        private:
+            const Handler mHandler;
+            std::mutex mLock;
+            std::condition_variable mCond;
+            std::list<PipelineRequest> mRequests;
+        };
+
         // Methods to request output buffer in parallel
         // No-op for device@3.4. Implemented in device@3.5
         virtual int requestBufferStart(const std::vector<HalStreamBuffer>&) { return 0; }
@@ -141,14 +174,39 @@ struct ExternalCameraDeviceSession : public virtual RefBase,
         static const int kFlushWaitTimeoutSec = 3; // 3 sec
         static const int kReqWaitTimeoutMs = 33;   // 33ms
         static const int kReqWaitTimesMax = 90;    // 33ms * 90 ~= 3 sec
+        // Number of requests that can be in the pipeline at once, one per stage
+        static const size_t kPipelineDepth = 3;
 
         void waitForNextRequest(std::shared_ptr<HalRequest>* out);
-        void signalRequestDone();
+        void signalRequestDone(uint32_t frameNumber);
+
+        // threadLoop() decodes each V4L2 frame and hands it to mConvertStage, which crops, scales
+        // and converts it into the YUV and Y16 outputs, then to mEncodeStage, which encodes the
+        // JPEG outputs and sends the result. Each stage runs on its own thread so consecutive
+        // frames are processed in parallel. startPipeline() returns false if the thread is exiting.
+        bool startPipeline();
+        void convertStage(PipelineRequest& request);
+        void encodeStage(PipelineRequest& request);
+        // Returns null if the thread is asked to exit before a frame is returned to the pool
+        sp<AllocatedFrame> acquirePipelineFrame();
+        void releasePipelineFrame(sp<AllocatedFrame>& frame);
+        void waitForAcquireFences(std::vector<HalStreamBuffer>* buffers);
+        // True if the request's only output is a YUV buffer the size of the V4L2 frame, so the
+        // MJPEG frame can be decoded directly into it
+        bool canDecodeToOutput(const HalRequest& req) const;
+        int decodeToOutputLocked(uint8_t* inData, size_t inDataSize, HalStreamBuffer& halBuf);
+        int decodeLocked(uint8_t* inData, size_t inDataSize, const Size& size,
+                const YCbCrLayout& out);
 
         int cropAndScaleLocked(
                 sp<AllocatedFrame>& in, const Size& outSize,
                 YCbCrLayout* out);
 
+        int cropAndScale(
+                sp<AllocatedFrame>& in, const Size& outSize,
+                const FrameMap& intermediateBuffers, FrameMap* scaledFrames,
+                YCbCrLayout* out);
+
         int cropAndScaleThumbLocked(
                 sp<AllocatedFrame>& in, const Size& outSize,
                 YCbCrLayout* out);
@@ -156,19 +214,32 @@ struct ExternalCameraDeviceSession : public virtual RefBase,
         int createJpegLocked(HalStreamBuffer &halBuf,
                 const common::V1_0::helper::CameraMetadata& settings);
 
+        int createJpeg(HalStreamBuffer &halBuf,
+                const common::V1_0::helper::CameraMetadata& settings,
+                sp<AllocatedFrame>& yu12Frame,
+                const FrameMap& intermediateBuffers, FrameMap* scaledFrames);
+
         void clearIntermediateBuffers();
 
         const wp<OutputThreadInterface> mParent;
         const CroppingType mCroppingType;
         const common::V1_0::helper::CameraMetadata mCameraCharacteristics;
 
-        mutable std::mutex mRequestListLock;      // Protect acccess to mRequestList,
-                                                  // mProcessingRequest and mProcessingFrameNumer
+        mutable std::mutex mRequestListLock;      // Protect acccess to mRequestList and
+                                                  // mProcessingFrameNumbers
         std::condition_variable mRequestCond;     // signaled when a new request is submitted
         std::condition_variable mRequestDoneCond; // signaled when a request is done processing
         std::list<std::shared_ptr<HalRequest>> mRequestList;
-        bool mProcessingRequest = false;
-        uint32_t mProcessingFrameNumer = 0;
+        // Requests taken from mRequestList that are still being processed, oldest first
+        std::list<uint32_t> mProcessingFrameNumbers;
+
+        std::mutex mPipelineLock; // Protect access to the members below
+        std::condition_variable mPipelineFrameCond; // signaled when a frame is released
+        sp<PipelineStage> mConvertStage;
+        sp<PipelineStage> mEncodeStage;
+        // Decoded frames not used by any request in the pipeline, and the number allocated
+        std::vector<sp<AllocatedFrame>> mFreePipelineFrames;
+        size_t mPipelineFrameCount = 0;
 
         // V4L2 frameIn
         // (MJPG decode)-> mYu12Frame
@@ -177,8 +248,12 @@ struct ExternalCameraDeviceSession : public virtual RefBase,
         mutable std::mutex mBufferLock; // Protect access to intermediate buffers
         sp<AllocatedFrame> mYu12Frame;
         sp<AllocatedFrame> mYu12ThumbFrame;
-        std::unordered_map<Size, sp<AllocatedFrame>, SizeHasher> mIntermediateBuffers;
-        std::unordered_map<Size, sp<AllocatedFrame>, SizeHasher> mScaledYu12Frames;
+        FrameMap mIntermediateBuffers;
+        FrameMap mScaledYu12Frames;
+        // Intermediate buffers of the JPEG outputs, used by mEncodeStage while mConvertStage
+        // uses the ones above
+        FrameMap mJpegIntermediateBuffers;
+        FrameMap mJpegScaledYu12Frames;
         YCbCrLayout mYu12FrameLayout;
         YCbCrLayout mYu12ThumbFrameLayout;
         std::vector<uint8_t> mMuteTestPatternFrame;
@@ -0,0 +1,155 @@
+/*
+ * Copyright (C) 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <android-base/unique_fd.h>
+#include <gtest/gtest.h>
+#include <linux/videodev2.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "ExternalCameraDeviceSession.h"
+
+namespace android {
+namespace hardware {
+namespace camera {
+namespace device {
+namespace V3_4 {
+namespace implementation {
+namespace {
+
+constexpr uint32_t kWidth = 64;
+constexpr uint32_t kHeight = 48;
+constexpr uint32_t kV4l2BufferSize = 4096;
+constexpr auto kResultTimeout = std::chrono::seconds(5);
+
+// Records the results and errors the output thread sends, in the order it sends them.
+struct FakeOutputThreadParent : public virtual OutputThreadInterface {
+    struct Result {
+        uint32_t frameNumber;
+        bool failed;
+    };
+
+    Status importBuffer(int32_t, uint64_t, buffer_handle_t, buffer_handle_t**, bool) override {
+        return Status::OK;
+    }
+
+    void notifyError(uint32_t frameNumber, int32_t, ErrorCode ec) override {
+        ADD_FAILURE() << "Unexpected error " << static_cast<int>(ec) << " for frame "
+                      << frameNumber;
+    }
+
+    Status processCaptureRequestError(const std::shared_ptr<HalRequest>& req,
+            std::vector<V3_2::NotifyMsg>*, std::vector<V3_2::CaptureResult>*) override {
+        record(req->frameNumber, /*failed*/true);
+        return Status::OK;
+    }
+
+    Status processCaptureResult(std::shared_ptr<HalRequest>& req) override {
+        // Keep the first frame in the pipeline while the following ones are decoded
+        if (req->frameNumber == 1) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        }
+        record(req->frameNumber, /*failed*/false);
+        return Status::OK;
+    }
+
+    ssize_t getJpegBufferSize(uint32_t, uint32_t) const override { return 0; }
+
+    void record(uint32_t frameNumber, bool failed) {
+        std::lock_guard<std::mutex> lk(mLock);
+        mResults.push_back({frameNumber, failed});
+        mCond.notify_all();
+    }
+
+    std::vector<Result> waitForResults(size_t count) {
+        std::unique_lock<std::mutex> lk(mLock);
+        mCond.wait_for(lk, kResultTimeout, [&] { return mResults.size() >= count; });
+        return mResults;
+    }
+
+    std::mutex mLock;
+    std::condition_variable mCond;
+    std::vector<Result> mResults;
+};
+
+class ExternalCameraOutputThreadTest : public ::testing::Test {
+  protected:
+    void SetUp() override {
+        mV4l2Fd.reset(memfd_create("ExternalCameraOutputThreadTest", MFD_CLOEXEC));
+        ASSERT_GE(mV4l2Fd.get(), 0);
+        ASSERT_EQ(ftruncate(mV4l2Fd.get(), kV4l2BufferSize), 0);
+
+        mParent = new FakeOutputThreadParent();
+        mOutputThread = new ExternalCameraDeviceSession::OutputThread(
+                mParent, CroppingType::VERTICAL, common::V1_0::helper::CameraMetadata());
+        ASSERT_EQ(mOutputThread->allocateIntermediateBuffers(
+                Size{kWidth, kHeight}, Size{kWidth / 4, kHeight / 4}, {},
+                /*blobBufferSize*/0), Status::OK);
+        ASSERT_EQ(mOutputThread->run("ExtCamOutTest", PRIORITY_DISPLAY), OK);
+    }
+
+    void TearDown() override {
+        mOutputThread->requestExitAndWait();
+    }
+
+    // A request without output buffers. The V4L2 buffer is all zeros, so it only decodes when
+    // the camera is muted and the test pattern is used instead.
+    std::shared_ptr<HalRequest> makeRequest(uint32_t frameNumber, bool decodable) {
+        auto req = std::make_shared<HalRequest>();
+        req->frameNumber = frameNumber;
+        req->frameIn = new V4L2Frame(kWidth, kHeight, V4L2_PIX_FMT_MJPEG, /*bufIdx*/0,
+                mV4l2Fd.get(), kV4l2BufferSize, /*offset*/0);
+        uint8_t testPatternMode = decodable ? ANDROID_SENSOR_TEST_PATTERN_MODE_SOLID_COLOR
+                                            : ANDROID_SENSOR_TEST_PATTERN_MODE_OFF;
+        req->setting.update(ANDROID_SENSOR_TEST_PATTERN_MODE, &testPatternMode, 1);
+        return req;
+    }
+
+    base::unique_fd mV4l2Fd;
+    sp<FakeOutputThreadParent> mParent;
+    sp<ExternalCameraDeviceSession::OutputThread> mOutputThread;
+};
+
+}  // namespace
+
+TEST_F(ExternalCameraOutputThreadTest, DecodeErrorIsSentInFrameOrder) {
+    mOutputThread->submitRequest(makeRequest(1, /*decodable*/true));
+    mOutputThread->submitRequest(makeRequest(2, /*decodable*/false));
+    mOutputThread->submitRequest(makeRequest(3, /*decodable*/true));
+
+    const auto results = mParent->waitForResults(3);
+    ASSERT_EQ(results.size(), 3u);
+    EXPECT_EQ(results[0].frameNumber, 1u);
+    EXPECT_FALSE(results[0].failed);
+    EXPECT_EQ(results[1].frameNumber, 2u);
+    EXPECT_TRUE(results[1].failed);
+    EXPECT_EQ(results[2].frameNumber, 3u);
+    EXPECT_FALSE(results[2].failed);
+}
+
+}  // namespace implementation
+}  // namespace V3_4
+}  // namespace device
+}  // namespace camera
+}  // namespace hardware
+}  // namespace android
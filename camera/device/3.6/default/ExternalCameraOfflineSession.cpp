@@ -118,7 +118,7 @@ bool ExternalCameraOfflineSession::OutputThread::threadLoop() {
         ALOGE(args...);
         parent->notifyError(
                 req->frameNumber, /*stream*/-1, ErrorCode::ERROR_DEVICE);
-        signalRequestDone();
+        signalRequestDone(req->frameNumber);
         return false;
     };
 
@@ -164,7 +164,7 @@ bool ExternalCameraOfflineSession::OutputThread::threadLoop() {
             if (st != Status::OK) {
                 return onDeviceError("%s: failed to process capture request error!", __FUNCTION__);
             }
-            signalRequestDone();
+            signalRequestDone(req->frameNumber);
             return true;
         }
     }
@@ -277,7 +277,7 @@ bool ExternalCameraOfflineSession::OutputThread::threadLoop() {
     if (st != Status::OK) {
         return onDeviceError("%s: failed to process capture result!", __FUNCTION__);
     }
-    signalRequestDone();
+    signalRequestDone(req->frameNumber);
     return true;
 }
 
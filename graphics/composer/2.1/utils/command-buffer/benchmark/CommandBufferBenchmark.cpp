@@ -0,0 +1,125 @@
+/*
+ * Copyright 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Benchmarks for encoding a frame of commands with CommandWriterBase, sending them through the
+// message queue and decoding them with CommandReaderBase.
+
+#define LOG_TAG "ComposerCommandBufferBenchmark"
+
+#include <benchmark/benchmark.h>
+#include <composer-command-buffer/2.1/ComposerCommandBuffer.h>
+
+#include <vector>
+
+namespace android {
+namespace hardware {
+namespace graphics {
+namespace composer {
+namespace V2_1 {
+namespace {
+
+using ::benchmark::Counter;
+using ::benchmark::State;
+
+constexpr uint32_t kInitialWriterSize = 1024;
+
+// Walks over every command in the queue without interpreting it.
+class CommandReader : public CommandReaderBase {
+  public:
+    bool parse() {
+        IComposerClient::Command command;
+        uint16_t length;
+        while (!isEmpty()) {
+            if (!beginCommand(&command, &length)) {
+                return false;
+            }
+            for (uint16_t i = 0; i < length; i++) {
+                ::benchmark::DoNotOptimize(read());
+            }
+            endCommand();
+        }
+        return true;
+    }
+};
+
+// Writes one frame of 'layerCount' layers, each using 'damage' as its damage and visible regions.
+void writeFrame(CommandWriterBase* writer, int64_t layerCount,
+                const std::vector<IComposerClient::Rect>& damage) {
+    const IComposerClient::Rect frame = {0, 0, 1920, 1080};
+    const IComposerClient::FRect crop = {0.0f, 0.0f, 1920.0f, 1080.0f};
+    writer->selectDisplay(1);
+    for (int64_t layer = 0; layer < layerCount; layer++) {
+        writer->selectLayer(layer);
+        writer->setLayerCompositionType(IComposerClient::Composition::DEVICE);
+        writer->setLayerDisplayFrame(frame);
+        writer->setLayerSourceCrop(crop);
+        writer->setLayerPlaneAlpha(1.0f);
+        writer->setLayerZOrder(static_cast<uint32_t>(layer));
+        writer->setLayerSurfaceDamage(damage);
+        writer->setLayerVisibleRegion(damage);
+    }
+    writer->validateDisplay();
+}
+
+// Encodes, sends and decodes a frame with 'state.range(0)' layers whose regions have
+// 'state.range(1)' rectangles each.
+void BM_EncodeDecodeFrame(State& state) {
+    const int64_t layerCount = state.range(0);
+    const std::vector<IComposerClient::Rect> damage(state.range(1), {0, 0, 64, 64});
+
+    CommandWriterBase writer(kInitialWriterSize);
+    CommandReader reader;
+    int64_t bytes = 0;
+    for (auto _ : state) {
+        writeFrame(&writer, layerCount, damage);
+
+        bool queueChanged = false;
+        uint32_t commandLength = 0;
+        hidl_vec<hidl_handle> commandHandles;
+        if (!writer.writeQueue(&queueChanged, &commandLength, &commandHandles)) {
+            state.SkipWithError("failed to write the command queue");
+            break;
+        }
+        if (queueChanged && !reader.setMQDescriptor(*writer.getMQDescriptor())) {
+            state.SkipWithError("failed to set up the command reader");
+            break;
+        }
+        if (!reader.readQueue(commandLength, commandHandles) || !reader.parse()) {
+            state.SkipWithError("failed to read the command queue");
+            break;
+        }
+
+        bytes += commandLength * sizeof(uint32_t);
+        reader.reset();
+        writer.reset();
+    }
+
+    state.SetBytesProcessed(bytes);
+    state.counters["frames_per_second"] = Counter(state.iterations(), Counter::kIsRate);
+}
+
+BENCHMARK(BM_EncodeDecodeFrame)->ArgsProduct({{1, 8, 32}, {1, 16}});
+// A region that does not fit in one command.
+BENCHMARK(BM_EncodeDecodeFrame)->Args({1, 20000});
+
+}  // namespace
+}  // namespace V2_1
+}  // namespace composer
+}  // namespace graphics
+}  // namespace hardware
+}  // namespace android
+
+BENCHMARK_MAIN();
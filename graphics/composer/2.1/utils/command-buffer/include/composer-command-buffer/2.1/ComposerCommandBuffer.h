@@ -55,7 +55,7 @@ using CommandQueueType = MessageQueue<uint32_t, kSynchronizedReadWrite>;
 class CommandWriterBase {
    public:
     CommandWriterBase(uint32_t initialMaxSize) : mDataMaxSize(initialMaxSize) {
-        mData = std::make_unique<uint32_t[]>(mDataMaxSize);
+        mData.reset(new uint32_t[mDataMaxSize]);
         reset();
     }
 
@@ -304,16 +304,10 @@ class CommandWriterBase {
     }
 
     void setLayerSurfaceDamage(const std::vector<IComposerClient::Rect>& damage) {
-        bool doWrite = (damage.size() <= kMaxLength / 4);
-        size_t length = (doWrite) ? damage.size() * 4 : 0;
-
-        beginCommand(IComposerClient::Command::SET_LAYER_SURFACE_DAMAGE, length);
-        // When there are too many rectangles in the damage region and doWrite
-        // is false, we write no rectangle at all which means the entire
-        // layer is damaged.
-        if (doWrite) {
-            writeRegion(damage);
-        }
+        size_t rectCount = std::min(damage.size(), static_cast<size_t>(kMaxLength / 4));
+
+        beginCommand(IComposerClient::Command::SET_LAYER_SURFACE_DAMAGE, rectCount * 4);
+        writeRegion(damage, rectCount);
         endCommand();
     }
 
@@ -382,16 +376,10 @@ class CommandWriterBase {
     }
 
     void setLayerVisibleRegion(const std::vector<IComposerClient::Rect>& visible) {
-        bool doWrite = (visible.size() <= kMaxLength / 4);
-        size_t length = (doWrite) ? visible.size() * 4 : 0;
-
-        beginCommand(IComposerClient::Command::SET_LAYER_VISIBLE_REGION, length);
-        // When there are too many rectangles in the visible region and
-        // doWrite is false, we write no rectangle at all which means the
-        // entire layer is visible.
-        if (doWrite) {
-            writeRegion(visible);
-        }
+        size_t rectCount = std::min(visible.size(), static_cast<size_t>(kMaxLength / 4));
+
+        beginCommand(IComposerClient::Command::SET_LAYER_VISIBLE_REGION, rectCount * 4);
+        writeRegion(visible, rectCount);
         endCommand();
     }
 
@@ -411,20 +399,14 @@ class CommandWriterBase {
     void setClientTargetInternal(uint32_t slot, const native_handle_t* target, int acquireFence,
                                  int32_t dataspace,
                                  const std::vector<IComposerClient::Rect>& damage) {
-        bool doWrite = (damage.size() <= (kMaxLength - 4) / 4);
-        size_t length = 4 + ((doWrite) ? damage.size() * 4 : 0);
+        size_t rectCount = std::min(damage.size(), static_cast<size_t>(kMaxLength - 4) / 4);
 
-        beginCommand(IComposerClient::Command::SET_CLIENT_TARGET, length);
+        beginCommand(IComposerClient::Command::SET_CLIENT_TARGET, 4 + rectCount * 4);
         write(slot);
         writeHandle(target, true);
         writeFence(acquireFence);
         writeSigned(dataspace);
-        // When there are too many rectangles in the damage region and doWrite
-        // is false, we write no rectangle at all which means the entire
-        // client target is damaged.
-        if (doWrite) {
-            writeRegion(damage);
-        }
+        writeRegion(damage, rectCount);
         endCommand();
     }
 
@@ -487,6 +469,30 @@ class CommandWriterBase {
         }
     }
 
+    // Writes the region as rectCount rectangles.  When the region has more
+    // rectangles than that (because they do not fit in a single command),
+    // runs of consecutive rectangles are replaced by their bounding boxes, so
+    // the written region covers the original one instead of being dropped.
+    void writeRegion(const std::vector<IComposerClient::Rect>& region, size_t rectCount) {
+        if (rectCount == region.size()) {
+            writeRegion(region);
+            return;
+        }
+
+        for (size_t group = 0; group < rectCount; group++) {
+            size_t begin = group * region.size() / rectCount;
+            size_t end = (group + 1) * region.size() / rectCount;
+            IComposerClient::Rect bounds = region[begin];
+            for (size_t i = begin + 1; i < end; i++) {
+                bounds.left = std::min(bounds.left, region[i].left);
+                bounds.top = std::min(bounds.top, region[i].top);
+                bounds.right = std::max(bounds.right, region[i].right);
+                bounds.bottom = std::max(bounds.bottom, region[i].bottom);
+            }
+            writeRect(bounds);
+        }
+    }
+
     void writeFRect(const IComposerClient::FRect& rect) {
         writeFloat(rect.left);
         writeFloat(rect.top);
@@ -559,7 +565,9 @@ class CommandWriterBase {
             newMaxSize = newWritten;
         }
 
-        auto newData = std::make_unique<uint32_t[]>(newMaxSize);
+        // Only the written data is copied, so the new buffer does not need to
+        // be zero-initialized.
+        std::unique_ptr<uint32_t[]> newData(new uint32_t[newMaxSize]);
         std::copy_n(mData.get(), mDataWritten, newData.get());
         mDataMaxSize = newMaxSize;
         mData = std::move(newData);
@@ -599,7 +607,7 @@ class CommandReaderBase {
         auto quantumCount = mQueue->getQuantumCount();
         if (mDataMaxSize < quantumCount) {
             mDataMaxSize = quantumCount;
-            mData = std::make_unique<uint32_t[]>(mDataMaxSize);
+            mData.reset(new uint32_t[mDataMaxSize]);
         }
 
         if (commandLength > mDataMaxSize || !mQueue->read(mData.get(), commandLength)) {
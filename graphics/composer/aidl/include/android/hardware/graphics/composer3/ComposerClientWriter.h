@@ -19,6 +19,7 @@
 #include <algorithm>
 #include <limits>
 #include <memory>
+#include <optional>
 #include <unordered_map>
 #include <unordered_set>
 #include <vector>
@@ -67,17 +68,27 @@ class ComposerClientWriter {
 
     virtual ~ComposerClientWriter() { reset(); }
 
+    // Clears the pending commands. The vectors they own are kept, cleared, and reused by the
+    // commands of the next frame, so a steady-state frame does not allocate.
     void reset() {
-        mDisplayCommand.reset();
-        mLayerCommand.reset();
+        for (auto& command : mCommands) {
+            for (auto& layerCommand : command.layers) {
+                recycle(layerCommand.damage, mSpareRects);
+                recycle(layerCommand.visibleRegion, mSpareRects);
+                recycle(layerCommand.blockingRegion, mSpareRects);
+                recycle(layerCommand.colorTransform, mSpareFloats);
+                recycle(layerCommand.perFrameMetadata, mSparePerFrameMetadata);
+            }
+            recycle(command.colorTransformMatrix, mSpareFloats);
+            command.layers.clear();
+            mSpareLayers.push_back(std::move(command.layers));
+        }
         mCommands.clear();
+        mHasOpenDisplayCommand = false;
     }
 
     void setColorTransform(int64_t display, const float* matrix) {
-        std::vector<float> matVec;
-        matVec.reserve(16);
-        matVec.assign(matrix, matrix + 16);
-        getDisplayCommand(display).colorTransformMatrix.emplace(std::move(matVec));
+        assign(getDisplayCommand(display).colorTransformMatrix, matrix, matrix + 16, mSpareFloats);
     }
 
     void setDisplayBrightness(int64_t display, float brightness, float brightnessNits) {
@@ -133,7 +144,7 @@ class ComposerClientWriter {
     }
 
     void setLayerSurfaceDamage(int64_t display, int64_t layer, const std::vector<Rect>& damage) {
-        getLayerCommand(display, layer).damage.emplace(damage.begin(), damage.end());
+        assign(getLayerCommand(display, layer).damage, damage.begin(), damage.end(), mSpareRects);
     }
 
     void setLayerBlendMode(int64_t display, int64_t layer, BlendMode mode) {
@@ -185,7 +196,8 @@ class ComposerClientWriter {
     }
 
     void setLayerVisibleRegion(int64_t display, int64_t layer, const std::vector<Rect>& visible) {
-        getLayerCommand(display, layer).visibleRegion.emplace(visible.begin(), visible.end());
+        assign(getLayerCommand(display, layer).visibleRegion, visible.begin(), visible.end(),
+               mSpareRects);
     }
 
     void setLayerZOrder(int64_t display, int64_t layer, uint32_t z) {
@@ -196,12 +208,12 @@ class ComposerClientWriter {
 
     void setLayerPerFrameMetadata(int64_t display, int64_t layer,
                                   const std::vector<PerFrameMetadata>& metadataVec) {
-        getLayerCommand(display, layer)
-                .perFrameMetadata.emplace(metadataVec.begin(), metadataVec.end());
+        assign(getLayerCommand(display, layer).perFrameMetadata, metadataVec.begin(),
+               metadataVec.end(), mSparePerFrameMetadata);
     }
 
     void setLayerColorTransform(int64_t display, int64_t layer, const float* matrix) {
-        getLayerCommand(display, layer).colorTransform.emplace(matrix, matrix + 16);
+        assign(getLayerCommand(display, layer).colorTransform, matrix, matrix + 16, mSpareFloats);
     }
 
     void setLayerPerFrameMetadataBlobs(int64_t display, int64_t layer,
@@ -216,19 +228,53 @@ class ComposerClientWriter {
     }
 
     void setLayerBlockingRegion(int64_t display, int64_t layer, const std::vector<Rect>& blocking) {
-        getLayerCommand(display, layer).blockingRegion.emplace(blocking.begin(), blocking.end());
+        assign(getLayerCommand(display, layer).blockingRegion, blocking.begin(), blocking.end(),
+               mSpareRects);
     }
 
     const std::vector<DisplayCommand>& getPendingCommands() {
-        flushLayerCommand();
-        flushDisplayCommand();
+        mHasOpenDisplayCommand = false;
         return mCommands;
     }
 
   private:
-    std::optional<DisplayCommand> mDisplayCommand;
-    std::optional<LayerCommand> mLayerCommand;
     std::vector<DisplayCommand> mCommands;
+    // Whether commands for the display of mCommands.back() are still merged into it.
+    bool mHasOpenDisplayCommand = false;
+
+    // Cleared vectors of the commands of previous frames, reused by the next commands.
+    std::vector<std::vector<LayerCommand>> mSpareLayers;
+    std::vector<decltype(LayerCommand::damage)::value_type> mSpareRects;
+    std::vector<decltype(LayerCommand::colorTransform)::value_type> mSpareFloats;
+    std::vector<decltype(LayerCommand::perFrameMetadata)::value_type> mSparePerFrameMetadata;
+
+    template <typename T>
+    static std::vector<T> takeSpare(std::vector<std::vector<T>>& spares) {
+        if (spares.empty()) {
+            return {};
+        }
+        auto spare = std::move(spares.back());
+        spares.pop_back();
+        return spare;
+    }
+
+    template <typename T>
+    static void recycle(std::optional<std::vector<T>>& field, std::vector<std::vector<T>>& spares) {
+        if (field.has_value()) {
+            field->clear();
+            spares.push_back(std::move(*field));
+            field.reset();
+        }
+    }
+
+    template <typename T, typename InputIt>
+    static void assign(std::optional<std::vector<T>>& field, InputIt first, InputIt last,
+                       std::vector<std::vector<T>>& spares) {
+        if (!field.has_value()) {
+            field.emplace(takeSpare(spares));
+        }
+        field->assign(first, last);
+    }
 
     Buffer getBuffer(uint32_t slot, const native_handle_t* bufferHandle, int fence) {
         Buffer bufferCommand;
@@ -238,38 +284,24 @@ class ComposerClientWriter {
         return bufferCommand;
     }
 
-    void flushLayerCommand() {
-        if (mLayerCommand.has_value()) {
-            mDisplayCommand->layers.emplace_back(std::move(*mLayerCommand));
-            mLayerCommand.reset();
-        }
-    }
-
-    void flushDisplayCommand() {
-        if (mDisplayCommand.has_value()) {
-            mCommands.emplace_back(std::move(*mDisplayCommand));
-            mDisplayCommand.reset();
-        }
-    }
-
     DisplayCommand& getDisplayCommand(int64_t display) {
-        if (!mDisplayCommand.has_value() || mDisplayCommand->display != display) {
-            flushLayerCommand();
-            flushDisplayCommand();
-            mDisplayCommand.emplace();
-            mDisplayCommand->display = display;
+        if (!mHasOpenDisplayCommand || mCommands.back().display != display) {
+            auto& command = mCommands.emplace_back();
+            command.display = display;
+            command.layers = takeSpare(mSpareLayers);
+            mHasOpenDisplayCommand = true;
         }
-        return *mDisplayCommand;
+        return mCommands.back();
     }
 
+    // Consecutive setLayer* calls for the same layer are merged into one LayerCommand. A call for
+    // another layer starts a new LayerCommand, so the commands keep the order they were written in.
     LayerCommand& getLayerCommand(int64_t display, int64_t layer) {
-        getDisplayCommand(display);
-        if (!mLayerCommand.has_value() || mLayerCommand->layer != layer) {
-            flushLayerCommand();
-            mLayerCommand.emplace();
-            mLayerCommand->layer = layer;
+        auto& layers = getDisplayCommand(display).layers;
+        if (layers.empty() || layers.back().layer != layer) {
+            layers.emplace_back().layer = layer;
         }
-        return *mLayerCommand;
+        return layers.back();
     }
 };
 
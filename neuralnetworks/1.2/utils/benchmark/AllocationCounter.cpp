@@ -0,0 +1,63 @@
+/*
+ * Copyright (C) 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Replaces the global operator new of the benchmark binary to count the heap allocations made by
+// each thread. Allocations of a service thread are not counted on the benchmarked thread.
+
+#include "AllocationCounter.h"
+
+#include <benchmark/benchmark.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+
+namespace {
+
+thread_local int64_t tAllocationCount = 0;
+
+}  // namespace
+
+void* operator new(size_t size) {
+    ++tAllocationCount;
+    void* ptr = std::malloc(size);
+    if (ptr == nullptr) {
+        std::abort();
+    }
+    return ptr;
+}
+
+void operator delete(void* ptr) noexcept {
+    std::free(ptr);
+}
+
+void operator delete(void* ptr, size_t /*size*/) noexcept {
+    std::free(ptr);
+}
+
+namespace android::hardware::neuralnetworks::V1_2::utils {
+
+int64_t getThreadAllocationCount() {
+    return tAllocationCount;
+}
+
+void setAllocationCounter(benchmark::State& state, int64_t allocationsBefore) {
+    const int64_t allocations = getThreadAllocationCount() - allocationsBefore;
+    state.counters["allocations_per_iteration"] = benchmark::Counter(
+            static_cast<double>(allocations) / std::max<int64_t>(state.iterations(), 1));
+}
+
+}  // namespace android::hardware::neuralnetworks::V1_2::utils
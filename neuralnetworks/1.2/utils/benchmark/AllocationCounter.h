@@ -0,0 +1,35 @@
+/*
+ * Copyright (C) 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_HARDWARE_INTERFACES_NEURALNETWORKS_1_2_UTILS_BENCHMARK_ALLOCATION_COUNTER_H
+#define ANDROID_HARDWARE_INTERFACES_NEURALNETWORKS_1_2_UTILS_BENCHMARK_ALLOCATION_COUNTER_H
+
+#include <benchmark/benchmark.h>
+
+#include <cstdint>
+
+namespace android::hardware::neuralnetworks::V1_2::utils {
+
+// Returns how many times the calling thread has called operator new so far.
+int64_t getThreadAllocationCount();
+
+// Reports the heap allocations made by the calling thread since 'allocationsBefore' as the
+// "allocations_per_iteration" counter of 'state'.
+void setAllocationCounter(benchmark::State& state, int64_t allocationsBefore);
+
+}  // namespace android::hardware::neuralnetworks::V1_2::utils
+
+#endif  // ANDROID_HARDWARE_INTERFACES_NEURALNETWORKS_1_2_UTILS_BENCHMARK_ALLOCATION_COUNTER_H
@@ -0,0 +1,228 @@
+/*
+ * Copyright (C) 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Benchmarks for the throughput of the burst with several outstanding requests, and for the heap
+// allocations made by Burst::execute in the steady state.
+
+#include <android/hardware/neuralnetworks/1.2/IBurstContext.h>
+#include <android/hardware/neuralnetworks/1.2/IPreparedModel.h>
+#include <benchmark/benchmark.h>
+#include <nnapi/IBurst.h>
+#include <nnapi/IPreparedModel.h>
+#include <nnapi/SharedMemory.h>
+#include <nnapi/Types.h>
+#include <nnapi/hal/1.2/Burst.h>
+#include <nnapi/hal/1.2/BurstUtils.h>
+#include <nnapi/hal/1.2/PreparedModel.h>
+
+#include <algorithm>
+#include <chrono>
+#include <limits>
+#include <memory>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "AllocationCounter.h"
+
+namespace android::hardware::neuralnetworks::V1_2::utils {
+namespace {
+
+using ::benchmark::Counter;
+using ::benchmark::State;
+
+// How long the fake service spends on each execution.
+constexpr auto kExecutionTime = std::chrono::microseconds(20);
+constexpr auto kNoPolling = std::chrono::microseconds(0);
+constexpr auto kNoTiming = Timing{.timeOnDevice = std::numeric_limits<uint64_t>::max(),
+                                  .timeInDriver = std::numeric_limits<uint64_t>::max()};
+
+class FakeBurstContext final : public IBurstContext {
+  public:
+    Return<bool> linkToDeath(const sp<hidl_death_recipient>& /*recipient*/,
+                             uint64_t /*cookie*/) override {
+        return true;
+    }
+    Return<void> freeMemory(int32_t /*slot*/) override { return Void(); }
+};
+
+// Serves the burst like the service in utils/adapter/hidl does, one request packet at a time,
+// spending kExecutionTime on each of them.
+class FakePreparedModel final : public IPreparedModel {
+  public:
+    ~FakePreparedModel() override { stopBurst(); }
+
+    Return<bool> linkToDeath(const sp<hidl_death_recipient>& /*recipient*/,
+                             uint64_t /*cookie*/) override {
+        return true;
+    }
+
+    Return<V1_0::ErrorStatus> execute(const V1_0::Request& /*request*/,
+                                      const sp<V1_0::IExecutionCallback>& /*callback*/) override {
+        return V1_0::ErrorStatus::GENERAL_FAILURE;
+    }
+
+    Return<V1_0::ErrorStatus> execute_1_2(const V1_0::Request& /*request*/,
+                                          MeasureTiming /*measure*/,
+                                          const sp<IExecutionCallback>& /*callback*/) override {
+        return V1_0::ErrorStatus::GENERAL_FAILURE;
+    }
+
+    Return<void> executeSynchronously(const V1_0::Request& /*request*/, MeasureTiming /*measure*/,
+                                      executeSynchronously_cb cb) override {
+        cb(V1_0::ErrorStatus::GENERAL_FAILURE, {}, kNoTiming);
+        return Void();
+    }
+
+    Return<void> configureExecutionBurst(const sp<IBurstCallback>& /*callback*/,
+                                         const MQDescriptorSync<FmqRequestDatum>& requestChannel,
+                                         const MQDescriptorSync<FmqResultDatum>& resultChannel,
+                                         configureExecutionBurst_cb cb) override {
+        auto requestChannelReceiver = RequestChannelReceiver::create(requestChannel, kNoPolling);
+        auto resultChannelSender = ResultChannelSender::create(resultChannel);
+        if (!requestChannelReceiver.has_value() || !resultChannelSender.has_value()) {
+            cb(V1_0::ErrorStatus::GENERAL_FAILURE, nullptr);
+            return Void();
+        }
+        mRequestChannelReceiver = std::move(requestChannelReceiver).value();
+        mResultChannelSender = std::move(resultChannelSender).value();
+        mWorker = std::thread([this] { serve(); });
+        cb(V1_0::ErrorStatus::NONE, sp<FakeBurstContext>::make());
+        return Void();
+    }
+
+    void stopBurst() {
+        if (mWorker.joinable()) {
+            mRequestChannelReceiver->invalidate();
+            mWorker.join();
+        }
+    }
+
+  private:
+    void serve() {
+        while (mRequestChannelReceiver->getBlocking().has_value()) {
+            const auto end = std::chrono::steady_clock::now() + kExecutionTime;
+            while (std::chrono::steady_clock::now() < end) {
+            }
+            mResultChannelSender->send(V1_0::ErrorStatus::NONE, {}, kNoTiming);
+        }
+    }
+
+    std::unique_ptr<RequestChannelReceiver> mRequestChannelReceiver;
+    std::unique_ptr<ResultChannelSender> mResultChannelSender;
+    std::thread mWorker;
+};
+
+// Returns nullptr if the burst could not be created.
+std::shared_ptr<const Burst> createBurst(const sp<FakePreparedModel>& hidlPreparedModel,
+                                         size_t maxOutstandingRequests) {
+    auto preparedModel = PreparedModel::create(hidlPreparedModel, /*executeSynchronously=*/true);
+    if (!preparedModel.has_value()) {
+        return nullptr;
+    }
+    auto burst = Burst::create(std::move(preparedModel).value(), hidlPreparedModel, kNoPolling,
+                               maxOutstandingRequests);
+    if (!burst.has_value()) {
+        return nullptr;
+    }
+    return std::move(burst).value();
+}
+
+sp<FakePreparedModel> gHidlPreparedModel;
+std::shared_ptr<const Burst> gBurst;
+
+// Executes on one burst from 'state.threads()' threads, with as many outstanding requests allowed.
+void BM_BurstExecute(State& state) {
+    if (state.thread_index() == 0) {
+        gHidlPreparedModel = sp<FakePreparedModel>::make();
+        gBurst = createBurst(gHidlPreparedModel, state.threads());
+    }
+
+    const nn::Request request;
+    for (auto _ : state) {
+        if (gBurst == nullptr) {
+            state.SkipWithError("failed to create the burst");
+            break;
+        }
+        if (!gBurst->execute(request, nn::MeasureTiming::NO, {}, {}, {}, {}).has_value()) {
+            state.SkipWithError("failed to execute on the burst");
+            break;
+        }
+    }
+
+    state.counters["inferences_per_second"] = Counter(state.iterations(), Counter::kIsRate);
+
+    if (state.thread_index() == 0) {
+        gBurst.reset();
+        gHidlPreparedModel->stopBurst();
+        gHidlPreparedModel.clear();
+    }
+}
+
+BENCHMARK(BM_BurstExecute)->ThreadRange(1, 8)->UseRealTime();
+
+// Executes a request with 'state.range(0)' inputs and outputs in one memory pool, counting the
+// heap allocations made by the executing thread. The fake service runs on its own thread, so its
+// allocations are not counted.
+void BM_BurstExecuteAllocations(State& state) {
+    const size_t operandCount = state.range(0);
+    constexpr uint32_t kOperandLength = sizeof(float);
+    const auto hidlPreparedModel = sp<FakePreparedModel>::make();
+    auto burst = createBurst(hidlPreparedModel, /*maxOutstandingRequests=*/1);
+    auto memory = nn::createSharedMemory(std::max<size_t>(2 * operandCount * kOperandLength, 1));
+    if (burst == nullptr || !memory.has_value()) {
+        state.SkipWithError("failed to create the burst");
+        return;
+    }
+
+    nn::Request request = {.pools = {std::move(memory).value()}};
+    for (uint32_t i = 0; i < operandCount; ++i) {
+        request.inputs.push_back({.lifetime = nn::Request::Argument::LifeTime::POOL,
+                                  .location = {.poolIndex = 0,
+                                               .offset = i * kOperandLength,
+                                               .length = kOperandLength}});
+        request.outputs.push_back(
+                {.lifetime = nn::Request::Argument::LifeTime::POOL,
+                 .location = {.poolIndex = 0,
+                              .offset = static_cast<uint32_t>(operandCount + i) * kOperandLength,
+                              .length = kOperandLength}});
+    }
+
+    // The first execution sends the memory pool to the service and fills the caches.
+    if (!burst->execute(request, nn::MeasureTiming::NO, {}, {}, {}, {}).has_value()) {
+        state.SkipWithError("failed to execute on the burst");
+        return;
+    }
+
+    const int64_t allocationsBefore = getThreadAllocationCount();
+    for (auto _ : state) {
+        if (!burst->execute(request, nn::MeasureTiming::NO, {}, {}, {}, {}).has_value()) {
+            state.SkipWithError("failed to execute on the burst");
+            break;
+        }
+    }
+    setAllocationCounter(state, allocationsBefore);
+
+    burst.reset();
+    hidlPreparedModel->stopBurst();
+}
+
+BENCHMARK(BM_BurstExecuteAllocations)->Arg(0)->Arg(4)->Arg(16)->Arg(64);
+
+}  // namespace
+}  // namespace android::hardware::neuralnetworks::V1_2::utils
+
+BENCHMARK_MAIN();
@@ -0,0 +1,107 @@
+/*
+ * Copyright (C) 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Benchmarks for sending and receiving the burst packets over the FMQs, counting the heap
+// allocations made in the steady state.
+
+#include <android/hardware/neuralnetworks/1.0/types.h>
+#include <android/hardware/neuralnetworks/1.2/types.h>
+#include <benchmark/benchmark.h>
+#include <nnapi/hal/1.2/BurstUtils.h>
+
+#include <chrono>
+#include <limits>
+#include <vector>
+
+#include "AllocationCounter.h"
+
+namespace android::hardware::neuralnetworks::V1_2::utils {
+namespace {
+
+using ::benchmark::State;
+
+constexpr auto kNoPolling = std::chrono::microseconds(0);
+constexpr auto kNoTiming = Timing{.timeOnDevice = std::numeric_limits<uint64_t>::max(),
+                                  .timeInDriver = std::numeric_limits<uint64_t>::max()};
+constexpr uint32_t kRank = 4;
+
+// Sends and receives a request packet with 'state.range(0)' inputs, outputs and pools.
+void BM_RequestPacketRoundTrip(State& state) {
+    const size_t operandCount = state.range(0);
+    auto channel = RequestChannelSender::create(kExecutionBurstChannelLength);
+    if (!channel.has_value()) {
+        state.SkipWithError("failed to create the request channel");
+        return;
+    }
+    auto [sender, descriptor] = std::move(channel).value();
+    auto receiver = RequestChannelReceiver::create(*descriptor, kNoPolling);
+    if (!receiver.has_value()) {
+        state.SkipWithError("failed to create the request channel receiver");
+        return;
+    }
+
+    const V1_0::RequestArgument argument = {.dimensions = std::vector<uint32_t>(kRank, 1)};
+    V1_0::Request request;
+    request.inputs = std::vector<V1_0::RequestArgument>(operandCount, argument);
+    request.outputs = std::vector<V1_0::RequestArgument>(operandCount, argument);
+    const std::vector<int32_t> slots(operandCount, 0);
+
+    const int64_t allocationsBefore = getThreadAllocationCount();
+    for (auto _ : state) {
+        if (!sender->send(request, MeasureTiming::NO, slots).ok() ||
+            !receiver.value()->getPacketBlocking().has_value()) {
+            state.SkipWithError("failed to send the request packet");
+            break;
+        }
+    }
+    setAllocationCounter(state, allocationsBefore);
+}
+
+// Sends and receives a result packet with 'state.range(0)' output shapes.
+void BM_ResultPacketRoundTrip(State& state) {
+    const size_t operandCount = state.range(0);
+    auto channel = ResultChannelReceiver::create(kExecutionBurstChannelLength, kNoPolling);
+    if (!channel.has_value()) {
+        state.SkipWithError("failed to create the result channel");
+        return;
+    }
+    auto [receiver, descriptor] = std::move(channel).value();
+    auto sender = ResultChannelSender::create(*descriptor);
+    if (!sender.has_value()) {
+        state.SkipWithError("failed to create the result channel sender");
+        return;
+    }
+
+    const OutputShape outputShape = {.dimensions = std::vector<uint32_t>(kRank, 1),
+                                     .isSufficient = true};
+    const std::vector<OutputShape> outputShapes(operandCount, outputShape);
+
+    const int64_t allocationsBefore = getThreadAllocationCount();
+    for (auto _ : state) {
+        sender.value()->send(V1_0::ErrorStatus::NONE, outputShapes, kNoTiming);
+        if (!receiver->getPacketBlocking().has_value()) {
+            state.SkipWithError("failed to receive the result packet");
+            break;
+        }
+    }
+    setAllocationCounter(state, allocationsBefore);
+}
+
+BENCHMARK(BM_RequestPacketRoundTrip)->Arg(0)->Arg(4)->Arg(16)->Arg(64);
+BENCHMARK(BM_ResultPacketRoundTrip)->Arg(0)->Arg(4)->Arg(16)->Arg(64);
+
+}  // namespace
+}  // namespace android::hardware::neuralnetworks::V1_2::utils
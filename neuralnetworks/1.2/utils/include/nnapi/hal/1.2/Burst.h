@@ -37,12 +37,15 @@
 
 #include <atomic>
 #include <chrono>
+#include <condition_variable>
 #include <functional>
-#include <map>
+#include <limits>
 #include <memory>
 #include <mutex>
+#include <optional>
 #include <stack>
 #include <tuple>
+#include <unordered_map>
 #include <utility>
 #include <vector>
 
@@ -52,6 +55,10 @@ namespace android::hardware::neuralnetworks::V1_2::utils {
  * The Burst class manages both the serialization and deserialization of data across FMQ, making it
  * appear to the runtime as a regular synchronous inference. Additionally, this class manages the
  * burst's memory cache.
+ *
+ * Several threads may execute on the same Burst at once. Up to maxOutstandingRequests request
+ * packets are sent before the first result comes back, and each result is handed to the execution
+ * whose request was sent in the same order, since the service processes the requests one at a time.
  */
 class Burst final : public nn::IBurst, public std::enable_shared_from_this<Burst> {
     struct PrivateConstructorTag {};
@@ -74,6 +81,15 @@ class Burst final : public nn::IBurst, public std::enable_shared_from_this<Burst
      * efficiency, if two hidl_memory objects represent the same underlying buffer, they must use
      * the same key.
      *
+     * Up to `capacity` memory objects stay cached after their last hold has been released, so that
+     * executions reusing the same memory objects do not have to send them to the service through
+     * IBurstCallback::getMemories again. When the cache is full, the least recently used memory
+     * object without a hold is evicted. Held memory objects are never evicted, so the cache grows
+     * past `capacity` while all of its entries are held.
+     *
+     * Lookups, both by memory object and by slot, take no lock: they read an immutable snapshot of
+     * the cache entries, which is replaced under the lock whenever an entry is added or evicted.
+     *
      * This class is thread-safe.
      */
     class MemoryCache : public std::enable_shared_from_this<MemoryCache> {
@@ -83,10 +99,21 @@ class Burst final : public nn::IBurst, public std::enable_shared_from_this<Burst
         using Task = std::function<void()>;
         using Cleanup = base::ScopeGuard<Task>;
         using SharedCleanup = std::shared_ptr<const Cleanup>;
-        using WeakCleanup = std::weak_ptr<const Cleanup>;
 
-        // Custom constructor to pre-allocate cache sizes.
-        MemoryCache();
+        struct Statistics {
+            // Number of MemoryCache::cacheMemory calls that found the memory object cached.
+            uint64_t hits = 0;
+            // Number of MemoryCache::cacheMemory calls that had to assign a slot.
+            uint64_t misses = 0;
+            // Number of memory objects evicted to keep the cache within its capacity.
+            uint64_t evictions = 0;
+            // Number of memory objects the service requested through MemoryCache::getMemory.
+            uint64_t memoriesRequested = 0;
+        };
+
+        static constexpr size_t kDefaultCapacity = 128;
+
+        explicit MemoryCache(size_t capacity = kDefaultCapacity);
 
         /**
          * Add a burst context to the MemoryCache object.
@@ -115,17 +142,44 @@ class Burst final : public nn::IBurst, public std::enable_shared_from_this<Burst
          */
         nn::GeneralResult<nn::SharedMemory> getMemory(int32_t slot);
 
+        Statistics getStatistics() const;
+
       private:
-        void freeMemory(const nn::SharedMemory& memory);
-        int32_t allocateSlotLocked() REQUIRES(mMutex);
+        struct Entry {
+            Entry(nn::SharedMemory memory, int32_t slot);
+
+            const nn::SharedMemory memory;
+            const int32_t slot;
+            // Number of live holds, or kEvicted once the entry has been evicted.
+            std::atomic<int64_t> holds = 0;
+            std::atomic<uint64_t> lastUse = 0;
+        };
+        using SharedEntry = std::shared_ptr<Entry>;
+
+        struct Snapshot {
+            std::unordered_map<nn::SharedMemory, SharedEntry> memoryToEntry;
+            // Null for the free slots.
+            std::vector<SharedEntry> slotToEntry;
+        };
 
-        std::mutex mMutex;
-        std::condition_variable mCond;
+        static constexpr int64_t kEvicted = std::numeric_limits<int64_t>::min();
+
+        std::shared_ptr<const Snapshot> loadSnapshot() const;
+        std::optional<SharedCleanup> tryHold(const SharedEntry& entry);
+        bool evictLocked(Snapshot* snapshot) REQUIRES(mMutex);
+        int32_t allocateSlotLocked(Snapshot* snapshot) REQUIRES(mMutex);
+
+        const size_t kCapacity;
+        mutable std::mutex mMutex;
         sp<IBurstContext> mBurstContext GUARDED_BY(mMutex);
         std::stack<int32_t, std::vector<int32_t>> mFreeSlots GUARDED_BY(mMutex);
-        std::map<nn::SharedMemory, int32_t> mMemoryIdToSlot GUARDED_BY(mMutex);
-        std::vector<nn::SharedMemory> mMemoryCache GUARDED_BY(mMutex);
-        std::vector<WeakCleanup> mCacheCleaner GUARDED_BY(mMutex);
+        // Only replaced while holding mMutex, always accessed through std::atomic_load/store.
+        std::shared_ptr<const Snapshot> mSnapshot;
+        std::atomic<uint64_t> mUseClock{0};
+        std::atomic<uint64_t> mHits{0};
+        std::atomic<uint64_t> mMisses{0};
+        std::atomic<uint64_t> mEvictions{0};
+        std::atomic<uint64_t> mMemoriesRequested{0};
     };
 
     /**
@@ -151,18 +205,22 @@ class Burst final : public nn::IBurst, public std::enable_shared_from_this<Burst
      * @param pollingTimeWindow How much time (in microseconds) the Burst is allowed to poll the FMQ
      *     before waiting on the blocking futex. Polling may result in lower latencies at the
      *     potential cost of more power usage.
+     * @param maxOutstandingRequests How many request packets may be in the request FMQ or being
+     *     executed by the service at once. Values above 1 require a service that reads a single
+     *     request packet at a time from the FMQ, such as the one in utils/adapter/hidl, so they
+     *     must only be used with known services.
      * @return Burst Execution burst controller object.
      */
     static nn::GeneralResult<std::shared_ptr<const Burst>> create(
             nn::SharedPreparedModel preparedModel, const sp<IPreparedModel>& hidlPreparedModel,
-            std::chrono::microseconds pollingTimeWindow);
+            std::chrono::microseconds pollingTimeWindow, size_t maxOutstandingRequests = 1);
 
     Burst(PrivateConstructorTag tag, nn::SharedPreparedModel preparedModel,
           std::unique_ptr<RequestChannelSender> requestChannelSender,
           std::unique_ptr<ResultChannelReceiver> resultChannelReceiver,
           sp<ExecutionBurstCallback> callback, sp<IBurstContext> burstContext,
           std::shared_ptr<MemoryCache> memoryCache,
-          neuralnetworks::utils::DeathHandler deathHandler);
+          neuralnetworks::utils::DeathHandler deathHandler, size_t maxOutstandingRequests);
 
     // See IBurst::cacheMemory for information on this method.
     OptionalCacheHold cacheMemory(const nn::SharedMemory& memory) const override;
@@ -188,8 +246,27 @@ class Burst final : public nn::IBurst, public std::enable_shared_from_this<Burst
             const std::vector<FmqRequestDatum>& requestPacket,
             const hal::utils::RequestRelocation& relocation, FallbackFunction fallback) const;
 
+    // How the results have been waited for, see AdaptivePollingTimeWindow.
+    PollingStatistics getPollingStatistics() const;
+
+    MemoryCache::Statistics getMemoryCacheStatistics() const;
+
   private:
-    mutable std::atomic_flag mExecutionInFlight = ATOMIC_FLAG_INIT;
+    // Waits for a free request slot, sends the request packet of `requestPacketSize` elements by
+    // calling `send` while holding `mMutex`, and waits for the result. `send` may therefore use
+    // storage owned by `mRequestChannelSender`.
+    template <typename SendFunction>
+    nn::ExecutionResult<std::pair<std::vector<nn::OutputShape>, nn::Timing>> executeInternal(
+            size_t requestPacketSize, const SendFunction& send,
+            const hal::utils::RequestRelocation& relocation, FallbackFunction fallback) const;
+
+    const size_t kMaxOutstandingRequests;
+    // Requests are numbered in the order they are sent, and the results are received in the same
+    // order. `mNextResultToReceive` is the number of the oldest outstanding request.
+    mutable std::mutex mMutex;
+    mutable std::condition_variable mCondition;
+    mutable uint64_t mNextRequestToSend GUARDED_BY(mMutex) = 0;
+    mutable uint64_t mNextResultToReceive GUARDED_BY(mMutex) = 0;
     const nn::SharedPreparedModel kPreparedModel;
     const std::unique_ptr<RequestChannelSender> mRequestChannelSender;
     const std::unique_ptr<ResultChannelReceiver> mResultChannelReceiver;
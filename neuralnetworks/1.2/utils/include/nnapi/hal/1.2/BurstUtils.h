@@ -40,7 +40,7 @@ namespace android::hardware::neuralnetworks::V1_2::utils {
 constexpr const size_t kExecutionBurstChannelLength = 1024;
 
 /**
- * Get how long the burst controller should poll while waiting for results to be returned.
+ * Get the longest the burst controller may poll while waiting for results to be returned.
  *
  * This time can be affected by the property "debug.nn.burst-controller-polling-window".
  *
@@ -49,7 +49,7 @@ constexpr const size_t kExecutionBurstChannelLength = 1024;
 std::chrono::microseconds getBurstControllerPollingTimeWindow();
 
 /**
- * Get how long the burst server should poll while waiting for a request to be received.
+ * Get the longest the burst server may poll while waiting for a request to be received.
  *
  * This time can be affected by the property "debug.nn.burst-server-polling-window".
  *
@@ -57,17 +57,89 @@ std::chrono::microseconds getBurstControllerPollingTimeWindow();
  */
 std::chrono::microseconds getBurstServerPollingTimeWindow();
 
+/**
+ * How the packets of a channel receiver were waited for.
+ */
+struct PollingStatistics {
+    // Number of packets found while polling the FMQ.
+    uint64_t packetsReceivedWhilePolling = 0;
+    // Number of packets waited for on the futex, after polling for them, if at all.
+    uint64_t packetsReceivedOnFutex = 0;
+    // Total time spent polling the FMQ, including the polling that did not find a packet.
+    std::chrono::nanoseconds timeSpentPolling{0};
+    // Total time spent waiting on the futex.
+    std::chrono::nanoseconds timeSpentOnFutex{0};
+    // The current polling time window.
+    std::chrono::microseconds pollingTimeWindow{0};
+};
+
+/**
+ * Tunes how long a channel receiver polls the FMQ before waiting on the futex, from how long it has
+ * recently waited for a packet.
+ *
+ * Polling only pays off when the packet arrives within the polling time window, so the window is
+ * set to twice the average wait, and polling stops altogether while the average wait is longer than
+ * the maximum window. The average is still tracked while not polling, so polling resumes once the
+ * packets arrive faster again.
+ *
+ * The window is only used and updated by the thread receiving the packets, the statistics may be
+ * read from any thread.
+ */
+class AdaptivePollingTimeWindow final {
+  public:
+    explicit AdaptivePollingTimeWindow(std::chrono::microseconds maxPollingTimeWindow);
+
+    std::chrono::microseconds get() const;
+
+    void onPacketReceivedWhilePolling(std::chrono::nanoseconds timeSpentPolling);
+    void onPacketReceivedOnFutex(std::chrono::nanoseconds timeSpentPolling,
+                                 std::chrono::nanoseconds timeSpentOnFutex);
+
+    PollingStatistics getStatistics() const;
+
+  private:
+    void update(std::chrono::nanoseconds waitTime);
+
+    const std::chrono::microseconds kMaxPollingTimeWindow;
+    std::chrono::nanoseconds mAverageWaitTime{0};
+    std::atomic<int64_t> mPollingTimeWindowUs{0};
+    std::atomic<uint64_t> mPacketsReceivedWhilePolling{0};
+    std::atomic<uint64_t> mPacketsReceivedOnFutex{0};
+    std::atomic<int64_t> mTimeSpentPollingNs{0};
+    std::atomic<int64_t> mTimeSpentOnFutexNs{0};
+};
+
 /**
  * Function to serialize a request.
  *
  * @param request Request object without the pool information.
  * @param measure Whether to collect timing information for the execution.
- * @param memoryIds Slot identifiers corresponding to memory resources for the request.
+ * @param slots Slot identifiers corresponding to memory resources for the request.
  * @return Serialized FMQ request data.
  */
 std::vector<FmqRequestDatum> serialize(const V1_0::Request& request, MeasureTiming measure,
                                        const std::vector<int32_t>& slots);
 
+/**
+ * Function to serialize a request into an existing packet, reusing its storage.
+ *
+ * @param request Request object without the pool information.
+ * @param measure Whether to collect timing information for the execution.
+ * @param slots Slot identifiers corresponding to memory resources for the request.
+ * @param packet Output serialized FMQ request data, replacing its previous content.
+ */
+void serialize(const V1_0::Request& request, MeasureTiming measure,
+               const std::vector<int32_t>& slots, std::vector<FmqRequestDatum>* packet);
+
+/**
+ * Function to compute the size of a serialized request without serializing it.
+ *
+ * @param request Request object without the pool information.
+ * @param slots Slot identifiers corresponding to memory resources for the request.
+ * @return Number of FMQ elements the serialized request data is made of.
+ */
+size_t getSerializedSize(const V1_0::Request& request, const std::vector<int32_t>& slots);
+
 /**
  * Deserialize the FMQ request data.
  *
@@ -92,6 +164,17 @@ nn::Result<std::tuple<V1_0::Request, std::vector<int32_t>, MeasureTiming>> deser
 std::vector<FmqResultDatum> serialize(V1_0::ErrorStatus errorStatus,
                                       const std::vector<OutputShape>& outputShapes, Timing timing);
 
+/**
+ * Function to serialize results into an existing packet, reusing its storage.
+ *
+ * @param errorStatus Status of the execution.
+ * @param outputShapes Dynamic shapes of the output tensors.
+ * @param timing Timing information of the execution.
+ * @param packet Output serialized FMQ result data, replacing its previous content.
+ */
+void serialize(V1_0::ErrorStatus errorStatus, const std::vector<OutputShape>& outputShapes,
+               Timing timing, std::vector<FmqResultDatum>* packet);
+
 /**
  * Deserialize the FMQ result data.
  *
@@ -107,6 +190,10 @@ nn::Result<std::tuple<V1_0::ErrorStatus, std::vector<OutputShape>, Timing>> dese
 /**
  * RequestChannelSender is responsible for serializing the result packet of information, sending it
  * on the result channel, and signaling that the data is available.
+ *
+ * The packet is serialized into storage owned by the sender, so sending does not allocate once the
+ * storage has grown to the size of the channel. Calls to RequestChannelSender::send must not be
+ * made concurrently.
  */
 class RequestChannelSender final : public neuralnetworks::utils::IProtectedCallback {
     struct PrivateConstructorTag {};
@@ -143,11 +230,15 @@ class RequestChannelSender final : public neuralnetworks::utils::IProtectedCallb
     // prefer calling RequestChannelSender::send
     nn::Result<void> sendPacket(const std::vector<FmqRequestDatum>& packet);
 
+    // Number of elements that can currently be written to the channel.
+    size_t availableToWrite() const;
+
     RequestChannelSender(PrivateConstructorTag tag, size_t channelLength);
 
   private:
     MessageQueue<FmqRequestDatum, kSynchronizedReadWrite> mFmqRequestChannel;
     std::atomic<bool> mValid{true};
+    std::vector<FmqRequestDatum> mPacket;
 };
 
 /**
@@ -165,9 +256,10 @@ class RequestChannelReceiver final {
      * Create the receiving end of a request channel.
      *
      * @param requestChannel Descriptor for the request channel.
-     * @param pollingTimeWindow How much time (in microseconds) the RequestChannelReceiver is
+     * @param pollingTimeWindow The most time (in microseconds) the RequestChannelReceiver is
      *     allowed to poll the FMQ before waiting on the blocking futex. Polling may result in lower
-     *     latencies at the potential cost of more power usage.
+     *     latencies at the potential cost of more power usage. The actual window adapts to how
+     *     fast the requests arrive, see AdaptivePollingTimeWindow.
      * @return RequestChannelReceiver on successful creation, nullptr otherwise.
      */
     static nn::GeneralResult<std::unique_ptr<RequestChannelReceiver>> create(
@@ -192,21 +284,29 @@ class RequestChannelReceiver final {
      */
     void invalidate();
 
+    // prefer calling RequestChannelReceiver::getBlocking
+    // The packet is owned by the receiver and is only valid until the next call.
+    nn::Result<const std::vector<FmqRequestDatum>*> getPacketBlocking();
+
+    PollingStatistics getPollingStatistics() const;
+
     RequestChannelReceiver(PrivateConstructorTag tag,
                            const MQDescriptorSync<FmqRequestDatum>& requestChannel,
                            std::chrono::microseconds pollingTimeWindow);
 
   private:
-    nn::Result<std::vector<FmqRequestDatum>> getPacketBlocking();
-
     MessageQueue<FmqRequestDatum, kSynchronizedReadWrite> mFmqRequestChannel;
     std::atomic<bool> mTeardown{false};
-    const std::chrono::microseconds kPollingTimeWindow;
+    AdaptivePollingTimeWindow mPollingTimeWindow;
+    std::vector<FmqRequestDatum> mPacket;
 };
 
 /**
  * ResultChannelSender is responsible for serializing the result packet of information, sending it
  * on the result channel, and signaling that the data is available.
+ *
+ * Like RequestChannelSender, it reuses its own storage for the packet, so
+ * ResultChannelSender::send must not be called concurrently.
  */
 class ResultChannelSender final {
     struct PrivateConstructorTag {};
@@ -239,6 +339,7 @@ class ResultChannelSender final {
 
   private:
     MessageQueue<FmqResultDatum, kSynchronizedReadWrite> mFmqResultChannel;
+    std::vector<FmqResultDatum> mPacket;
 };
 
 /**
@@ -256,9 +357,10 @@ class ResultChannelReceiver final : public neuralnetworks::utils::IProtectedCall
      * Create the receiving end of a result channel.
      *
      * @param channelLength Number of elements in the FMQ.
-     * @param pollingTimeWindow How much time (in microseconds) the ResultChannelReceiver is allowed
+     * @param pollingTimeWindow The most time (in microseconds) the ResultChannelReceiver is allowed
      *     to poll the FMQ before waiting on the blocking futex. Polling may result in lower
-     *     latencies at the potential cost of more power usage.
+     *     latencies at the potential cost of more power usage. The actual window adapts to how
+     *     fast the results arrive, see AdaptivePollingTimeWindow.
      * @return A pair of ResultChannelReceiver and the FMQ descriptor on successful creation, or
      *     GeneralError otherwise.
      */
@@ -285,7 +387,10 @@ class ResultChannelReceiver final : public neuralnetworks::utils::IProtectedCall
     void notifyAsDeadObject() override;
 
     // prefer calling ResultChannelReceiver::getBlocking
-    nn::Result<std::vector<FmqResultDatum>> getPacketBlocking();
+    // The packet is owned by the receiver and is only valid until the next call.
+    nn::Result<const std::vector<FmqResultDatum>*> getPacketBlocking();
+
+    PollingStatistics getPollingStatistics() const;
 
     ResultChannelReceiver(PrivateConstructorTag tag, size_t channelLength,
                           std::chrono::microseconds pollingTimeWindow);
@@ -293,7 +398,8 @@ class ResultChannelReceiver final : public neuralnetworks::utils::IProtectedCall
   private:
     MessageQueue<FmqResultDatum, kSynchronizedReadWrite> mFmqResultChannel;
     std::atomic<bool> mValid{true};
-    const std::chrono::microseconds kPollingTimeWindow;
+    AdaptivePollingTimeWindow mPollingTimeWindow;
+    std::vector<FmqResultDatum> mPacket;
 };
 
 }  // namespace android::hardware::neuralnetworks::V1_2::utils
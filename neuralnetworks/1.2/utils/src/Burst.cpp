@@ -35,6 +35,7 @@
 #include <cstring>
 #include <limits>
 #include <memory>
+#include <optional>
 #include <string>
 #include <thread>
 #include <tuple>
@@ -106,13 +107,14 @@ nn::GeneralResult<hidl_vec<hidl_memory>> getMemoriesHelper(
 
 // MemoryCache methods
 
-Burst::MemoryCache::MemoryCache() {
-    constexpr size_t kPreallocatedCount = 1024;
+Burst::MemoryCache::Entry::Entry(nn::SharedMemory memory, int32_t slot)
+    : memory(std::move(memory)), slot(slot) {}
+
+Burst::MemoryCache::MemoryCache(size_t capacity)
+    : kCapacity(capacity), mSnapshot(std::make_shared<const Snapshot>()) {
     std::vector<int32_t> freeSlotsSpace;
-    freeSlotsSpace.reserve(kPreallocatedCount);
+    freeSlotsSpace.reserve(capacity);
     mFreeSlots = std::stack<int32_t, std::vector<int32_t>>(std::move(freeSlotsSpace));
-    mMemoryCache.reserve(kPreallocatedCount);
-    mCacheCleaner.reserve(kPreallocatedCount);
 }
 
 void Burst::MemoryCache::setBurstContext(sp<IBurstContext> burstContext) {
@@ -122,70 +124,125 @@ void Burst::MemoryCache::setBurstContext(sp<IBurstContext> burstContext) {
 
 std::pair<int32_t, Burst::MemoryCache::SharedCleanup> Burst::MemoryCache::cacheMemory(
         const nn::SharedMemory& memory) {
-    std::unique_lock lock(mMutex);
-    base::ScopedLockAssertion lockAssert(mMutex);
-
-    // Use existing cache entry if (1) the Memory object is in the cache and (2) the cache entry is
-    // not currently being freed.
-    auto iter = mMemoryIdToSlot.find(memory);
-    while (iter != mMemoryIdToSlot.end()) {
-        const int32_t slot = iter->second;
-        if (auto cleaner = mCacheCleaner.at(slot).lock()) {
-            return std::make_pair(slot, std::move(cleaner));
+    // Use the existing cache entry without taking the lock if the Memory object is in the cache.
+    const auto snapshot = loadSnapshot();
+    if (const auto iter = snapshot->memoryToEntry.find(memory);
+        iter != snapshot->memoryToEntry.end()) {
+        if (auto hold = tryHold(iter->second)) {
+            mHits.fetch_add(1, std::memory_order_relaxed);
+            return std::make_pair(iter->second->slot, std::move(hold).value());
         }
+        // If the code reaches this point, the entry was evicted after the snapshot was loaded.
+    }
+
+    std::lock_guard guard(mMutex);
 
-        // If the code reaches this point, the Memory object was in the cache, but is currently
-        // being destroyed. This code waits until the cache entry has been freed, then loops to
-        // ensure the cache entry has been freed or has been made present by another thread.
-        mCond.wait(lock);
-        iter = mMemoryIdToSlot.find(memory);
+    // Another thread may have added the Memory object since the snapshot was loaded. The entries
+    // of the current snapshot cannot be evicted while the lock is held.
+    const auto current = loadSnapshot();
+    if (const auto iter = current->memoryToEntry.find(memory);
+        iter != current->memoryToEntry.end()) {
+        mHits.fetch_add(1, std::memory_order_relaxed);
+        return std::make_pair(iter->second->slot, tryHold(iter->second).value());
     }
+    mMisses.fetch_add(1, std::memory_order_relaxed);
+    auto next = std::make_shared<Snapshot>(*current);
 
-    // Allocate a new cache entry.
-    const int32_t slot = allocateSlotLocked();
-    mMemoryIdToSlot[memory] = slot;
-    mMemoryCache[slot] = memory;
-
-    // Create reference-counted self-cleaning cache object.
-    auto self = weak_from_this();
-    Task cleanup = [memory, memoryCache = std::move(self)] {
-        if (const auto lock = memoryCache.lock()) {
-            lock->freeMemory(memory);
-        }
-    };
-    auto cleaner = std::make_shared<const Cleanup>(std::move(cleanup));
-    mCacheCleaner[slot] = cleaner;
+    // Make room for the new entry by evicting the least recently used entries without a hold.
+    while (next->memoryToEntry.size() >= kCapacity && evictLocked(next.get())) {
+    }
 
-    return std::make_pair(slot, std::move(cleaner));
+    // Allocate a new cache entry.
+    const int32_t slot = allocateSlotLocked(next.get());
+    auto entry = std::make_shared<Entry>(memory, slot);
+    next->memoryToEntry.emplace(memory, entry);
+    next->slotToEntry[slot] = entry;
+    auto hold = tryHold(entry).value();
+
+    std::atomic_store_explicit(&mSnapshot, std::shared_ptr<const Snapshot>(std::move(next)),
+                               std::memory_order_release);
+    return std::make_pair(slot, std::move(hold));
 }
 
 nn::GeneralResult<nn::SharedMemory> Burst::MemoryCache::getMemory(int32_t slot) {
-    std::lock_guard guard(mMutex);
-    if (slot < 0 || static_cast<size_t>(slot) >= mMemoryCache.size()) {
-        return NN_ERROR() << "Invalid slot: " << slot << " vs " << mMemoryCache.size();
+    mMemoriesRequested.fetch_add(1, std::memory_order_relaxed);
+    const auto snapshot = loadSnapshot();
+    if (slot < 0 || static_cast<size_t>(slot) >= snapshot->slotToEntry.size() ||
+        snapshot->slotToEntry[slot] == nullptr) {
+        return NN_ERROR() << "Invalid slot: " << slot << " vs " << snapshot->slotToEntry.size();
     }
-    return mMemoryCache[slot];
+    return snapshot->slotToEntry[slot]->memory;
 }
 
-void Burst::MemoryCache::freeMemory(const nn::SharedMemory& memory) {
-    {
-        std::lock_guard guard(mMutex);
-        const int32_t slot = mMemoryIdToSlot.at(memory);
+Burst::MemoryCache::Statistics Burst::MemoryCache::getStatistics() const {
+    return {
+            .hits = mHits.load(std::memory_order_relaxed),
+            .misses = mMisses.load(std::memory_order_relaxed),
+            .evictions = mEvictions.load(std::memory_order_relaxed),
+            .memoriesRequested = mMemoriesRequested.load(std::memory_order_relaxed),
+    };
+}
+
+std::shared_ptr<const Burst::MemoryCache::Snapshot> Burst::MemoryCache::loadSnapshot() const {
+    return std::atomic_load_explicit(&mSnapshot, std::memory_order_acquire);
+}
+
+std::optional<Burst::MemoryCache::SharedCleanup> Burst::MemoryCache::tryHold(
+        const SharedEntry& entry) {
+    // Take a hold unless the entry has been evicted. Eviction only succeeds while there is no hold,
+    // so an entry is never evicted under a hold.
+    int64_t holds = entry->holds.load(std::memory_order_relaxed);
+    do {
+        if (holds == kEvicted) {
+            return std::nullopt;
+        }
+    } while (!entry->holds.compare_exchange_weak(holds, holds + 1, std::memory_order_acquire,
+                                                 std::memory_order_relaxed));
+    entry->lastUse.store(mUseClock.fetch_add(1, std::memory_order_relaxed) + 1,
+                         std::memory_order_relaxed);
+
+    // The hold keeps the entry itself alive, so it may outlive the MemoryCache.
+    Task cleanup = [entry] { entry->holds.fetch_sub(1, std::memory_order_release); };
+    return std::make_shared<const Cleanup>(std::move(cleanup));
+}
+
+bool Burst::MemoryCache::evictLocked(Snapshot* snapshot) {
+    // Holds may be taken concurrently without the lock, so retry if the chosen entry got a hold
+    // before it could be evicted.
+    while (true) {
+        SharedEntry victim;
+        for (const auto& [memory, entry] : snapshot->memoryToEntry) {
+            if (entry->holds.load(std::memory_order_relaxed) == 0 &&
+                (victim == nullptr || entry->lastUse.load(std::memory_order_relaxed) <
+                                              victim->lastUse.load(std::memory_order_relaxed))) {
+                victim = entry;
+            }
+        }
+        if (victim == nullptr) {
+            return false;
+        }
+
+        int64_t holds = 0;
+        if (!victim->holds.compare_exchange_strong(holds, kEvicted, std::memory_order_acquire,
+                                                   std::memory_order_relaxed)) {
+            continue;
+        }
+
         if (mBurstContext) {
-            const auto ret = mBurstContext->freeMemory(slot);
+            const auto ret = mBurstContext->freeMemory(victim->slot);
             if (!ret.isOk()) {
                 LOG(ERROR) << "IBustContext::freeMemory failed: " << ret.description();
             }
         }
-        mMemoryIdToSlot.erase(memory);
-        mMemoryCache[slot] = {};
-        mCacheCleaner[slot].reset();
-        mFreeSlots.push(slot);
+        snapshot->memoryToEntry.erase(victim->memory);
+        snapshot->slotToEntry[victim->slot].reset();
+        mFreeSlots.push(victim->slot);
+        mEvictions.fetch_add(1, std::memory_order_relaxed);
+        return true;
     }
-    mCond.notify_all();
 }
 
-int32_t Burst::MemoryCache::allocateSlotLocked() {
+int32_t Burst::MemoryCache::allocateSlotLocked(Snapshot* snapshot) {
     constexpr size_t kMaxNumberOfSlots = std::numeric_limits<int32_t>::max();
 
     // If there is a free slot, use it.
@@ -196,10 +253,10 @@ int32_t Burst::MemoryCache::allocateSlotLocked() {
     }
 
     // Use a slot for the first time.
-    CHECK_LT(mMemoryCache.size(), kMaxNumberOfSlots) << "Exceeded maximum number of slots!";
-    const int32_t slot = static_cast<int32_t>(mMemoryCache.size());
-    mMemoryCache.emplace_back();
-    mCacheCleaner.emplace_back();
+    CHECK_LT(snapshot->slotToEntry.size(), kMaxNumberOfSlots)
+            << "Exceeded maximum number of slots!";
+    const int32_t slot = static_cast<int32_t>(snapshot->slotToEntry.size());
+    snapshot->slotToEntry.emplace_back();
 
     return slot;
 }
@@ -239,11 +296,14 @@ Return<void> Burst::ExecutionBurstCallback::getMemories(const hidl_vec<int32_t>&
 
 nn::GeneralResult<std::shared_ptr<const Burst>> Burst::create(
         nn::SharedPreparedModel preparedModel, const sp<V1_2::IPreparedModel>& hidlPreparedModel,
-        std::chrono::microseconds pollingTimeWindow) {
+        std::chrono::microseconds pollingTimeWindow, size_t maxOutstandingRequests) {
     // check inputs
     if (preparedModel == nullptr || hidlPreparedModel == nullptr) {
         return NN_ERROR() << "Burst::create passed a nullptr";
     }
+    if (maxOutstandingRequests == 0) {
+        return NN_ERROR() << "Burst::create passed a maxOutstandingRequests of 0";
+    }
 
     // create FMQ objects
     auto [requestChannelSender, requestChannelDescriptor] =
@@ -281,7 +341,7 @@ nn::GeneralResult<std::shared_ptr<const Burst>> Burst::create(
     return std::make_shared<const Burst>(
             PrivateConstructorTag{}, std::move(preparedModel), std::move(requestChannelSender),
             std::move(resultChannelReceiver), std::move(burstCallback), std::move(burstContext),
-            std::move(memoryCache), std::move(deathHandler));
+            std::move(memoryCache), std::move(deathHandler), maxOutstandingRequests);
 }
 
 Burst::Burst(PrivateConstructorTag /*tag*/, nn::SharedPreparedModel preparedModel,
@@ -289,8 +349,9 @@ Burst::Burst(PrivateConstructorTag /*tag*/, nn::SharedPreparedModel preparedMode
              std::unique_ptr<ResultChannelReceiver> resultChannelReceiver,
              sp<ExecutionBurstCallback> callback, sp<IBurstContext> burstContext,
              std::shared_ptr<MemoryCache> memoryCache,
-             neuralnetworks::utils::DeathHandler deathHandler)
-    : kPreparedModel(std::move(preparedModel)),
+             neuralnetworks::utils::DeathHandler deathHandler, size_t maxOutstandingRequests)
+    : kMaxOutstandingRequests(maxOutstandingRequests),
+      kPreparedModel(std::move(preparedModel)),
       mRequestChannelSender(std::move(requestChannelSender)),
       mResultChannelReceiver(std::move(resultChannelReceiver)),
       mBurstCallback(std::move(callback)),
@@ -344,12 +405,14 @@ nn::ExecutionResult<std::pair<std::vector<nn::OutputShape>, nn::Timing>> Burst::
         holds.push_back(std::move(hold));
     }
 
-    // send request packet
-    const auto requestPacket = serialize(hidlRequest, hidlMeasure, slots);
+    // send request packet, serialized into the storage owned by the request channel sender
+    const auto send = [this, &hidlRequest, hidlMeasure, &slots] {
+        return mRequestChannelSender->send(hidlRequest, hidlMeasure, slots);
+    };
     const auto fallback = [this, &request, measure, &deadline, &loopTimeoutDuration] {
         return kPreparedModel->execute(request, measure, deadline, loopTimeoutDuration, {}, {});
     };
-    return executeInternal(requestPacket, relocation, fallback);
+    return executeInternal(getSerializedSize(hidlRequest, slots), send, relocation, fallback);
 }
 
 // See IBurst::createReusableExecution for information on this method.
@@ -399,31 +462,62 @@ nn::GeneralResult<nn::SharedExecution> Burst::createReusableExecution(
 nn::ExecutionResult<std::pair<std::vector<nn::OutputShape>, nn::Timing>> Burst::executeInternal(
         const std::vector<FmqRequestDatum>& requestPacket,
         const hal::utils::RequestRelocation& relocation, FallbackFunction fallback) const {
-    NNTRACE_FULL(NNTRACE_LAYER_IPC, NNTRACE_PHASE_EXECUTION, "Burst::executeInternal");
+    const auto send = [this, &requestPacket] {
+        return mRequestChannelSender->sendPacket(requestPacket);
+    };
+    return executeInternal(requestPacket.size(), send, relocation, std::move(fallback));
+}
 
-    // Ensure that at most one execution is in flight at any given time.
-    const bool alreadyInFlight = mExecutionInFlight.test_and_set();
-    if (alreadyInFlight) {
-        return NN_ERROR() << "IBurst already has an execution in flight";
-    }
-    const auto guard = base::make_scope_guard([this] { mExecutionInFlight.clear(); });
+template <typename SendFunction>
+nn::ExecutionResult<std::pair<std::vector<nn::OutputShape>, nn::Timing>> Burst::executeInternal(
+        size_t requestPacketSize, const SendFunction& send,
+        const hal::utils::RequestRelocation& relocation, FallbackFunction fallback) const {
+    NNTRACE_FULL(NNTRACE_LAYER_IPC, NNTRACE_PHASE_EXECUTION, "Burst::executeInternal");
 
     if (relocation.input) {
         relocation.input->flush();
     }
 
+    std::unique_lock lock(mMutex);
+    base::ScopedLockAssertion lockAssert(mMutex);
+
+    // Wait for a free request slot. A request packet that does not fit in the request FMQ next to
+    // the outstanding ones waits for them to finish, so that it is only rejected (and falls back)
+    // when it could never fit.
+    while (mNextRequestToSend - mNextResultToReceive >= kMaxOutstandingRequests ||
+           (mNextRequestToSend != mNextResultToReceive &&
+            requestPacketSize > mRequestChannelSender->availableToWrite())) {
+        mCondition.wait(lock);
+    }
+
     // send request packet
-    const auto sendStatus = mRequestChannelSender->sendPacket(requestPacket);
+    const auto sendStatus = send();
     if (!sendStatus.ok()) {
+        lock.unlock();
         // fallback to another execution path if the packet could not be sent
         if (fallback) {
             return fallback();
         }
         return NN_ERROR() << "Error sending FMQ packet: " << sendStatus.error();
     }
+    const uint64_t request = mNextRequestToSend++;
+
+    // The results come back in the order the requests were sent, so wait for the results of all
+    // the earlier requests to be received first.
+    while (mNextResultToReceive != request) {
+        mCondition.wait(lock);
+    }
+    lock.unlock();
 
     // get result packet
-    const auto [status, outputShapes, timing] = NN_TRY(mResultChannelReceiver->getBlocking());
+    auto result = mResultChannelReceiver->getBlocking();
+
+    lock.lock();
+    mNextResultToReceive++;
+    lock.unlock();
+    mCondition.notify_all();
+
+    const auto [status, outputShapes, timing] = NN_TRY(std::move(result));
 
     if (relocation.output) {
         relocation.output->flush();
@@ -431,6 +525,14 @@ nn::ExecutionResult<std::pair<std::vector<nn::OutputShape>, nn::Timing>> Burst::
     return executionCallback(status, outputShapes, timing);
 }
 
+PollingStatistics Burst::getPollingStatistics() const {
+    return mResultChannelReceiver->getPollingStatistics();
+}
+
+Burst::MemoryCache::Statistics Burst::getMemoryCacheStatistics() const {
+    return mMemoryCache->getStatistics();
+}
+
 nn::GeneralResult<std::shared_ptr<const BurstExecution>> BurstExecution::create(
         std::shared_ptr<const Burst> controller, std::vector<FmqRequestDatum> request,
         hal::utils::RequestRelocation relocation,
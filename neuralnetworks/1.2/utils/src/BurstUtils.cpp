@@ -27,6 +27,7 @@
 #include <nnapi/Types.h>
 #include <nnapi/hal/1.0/ProtectCallback.h>
 
+#include <algorithm>
 #include <atomic>
 #include <chrono>
 #include <memory>
@@ -41,6 +42,9 @@ namespace {
 constexpr V1_2::Timing kNoTiming = {std::numeric_limits<uint64_t>::max(),
                                     std::numeric_limits<uint64_t>::max()};
 
+// The weight of each new wait time in the average wait time, roughly averaging the last 8 waits.
+constexpr int64_t kWaitTimeAverageWeight = 8;
+
 std::chrono::microseconds getPollingTimeWindow(const std::string& property) {
     constexpr int32_t kDefaultPollingTimeWindow = 0;
 #ifdef NN_DEBUGGABLE
@@ -54,6 +58,30 @@ std::chrono::microseconds getPollingTimeWindow(const std::string& property) {
 #endif  // NN_DEBUGGABLE
 }
 
+// Read the rest of the packet whose first element has already been read from the channel.
+//
+// NOTE: all of the packet is already available at this point, so there's no need to do a blocking
+// wait to wait for more data. This is known because in FMQ, all writes are published (made
+// available) atomically. Currently, the producer always publishes the entire packet in one function
+// call, so if the first element of the packet is available, the remaining elements are also
+// available.
+//
+// Only the elements of this packet are read, so that any packet sent after it stays in the channel
+// when more than one request is in flight. If the first element is not a valid packet information,
+// everything available is read and the packet is rejected on deserialization.
+template <typename Datum>
+bool readRemainingPacket(MessageQueue<Datum, kSynchronizedReadWrite>* channel, const Datum& first,
+                         std::vector<Datum>* packet) {
+    size_t count = channel->availableToRead();
+    if (first.getDiscriminator() == Datum::hidl_discriminator::packetInformation &&
+        first.packetInformation().packetSize > 0) {
+        count = std::min<size_t>(count, first.packetInformation().packetSize - 1);
+    }
+    packet->resize(count + 1);
+    packet->front() = first;
+    return channel->read(packet->data() + 1, count);
+}
+
 }  // namespace
 
 std::chrono::microseconds getBurstControllerPollingTimeWindow() {
@@ -64,21 +92,82 @@ std::chrono::microseconds getBurstServerPollingTimeWindow() {
     return getPollingTimeWindow("debug.nn.burst-server-polling-window");
 }
 
+// AdaptivePollingTimeWindow methods
+
+AdaptivePollingTimeWindow::AdaptivePollingTimeWindow(
+        std::chrono::microseconds maxPollingTimeWindow)
+    : kMaxPollingTimeWindow(maxPollingTimeWindow),
+      mPollingTimeWindowUs(maxPollingTimeWindow.count()) {}
+
+std::chrono::microseconds AdaptivePollingTimeWindow::get() const {
+    return std::chrono::microseconds(mPollingTimeWindowUs.load(std::memory_order_relaxed));
+}
+
+void AdaptivePollingTimeWindow::onPacketReceivedWhilePolling(
+        std::chrono::nanoseconds timeSpentPolling) {
+    mPacketsReceivedWhilePolling.fetch_add(1, std::memory_order_relaxed);
+    mTimeSpentPollingNs.fetch_add(timeSpentPolling.count(), std::memory_order_relaxed);
+    update(timeSpentPolling);
+}
+
+void AdaptivePollingTimeWindow::onPacketReceivedOnFutex(std::chrono::nanoseconds timeSpentPolling,
+                                                        std::chrono::nanoseconds timeSpentOnFutex) {
+    mPacketsReceivedOnFutex.fetch_add(1, std::memory_order_relaxed);
+    mTimeSpentPollingNs.fetch_add(timeSpentPolling.count(), std::memory_order_relaxed);
+    mTimeSpentOnFutexNs.fetch_add(timeSpentOnFutex.count(), std::memory_order_relaxed);
+    update(timeSpentPolling + timeSpentOnFutex);
+}
+
+PollingStatistics AdaptivePollingTimeWindow::getStatistics() const {
+    return {
+            .packetsReceivedWhilePolling =
+                    mPacketsReceivedWhilePolling.load(std::memory_order_relaxed),
+            .packetsReceivedOnFutex = mPacketsReceivedOnFutex.load(std::memory_order_relaxed),
+            .timeSpentPolling = std::chrono::nanoseconds(
+                    mTimeSpentPollingNs.load(std::memory_order_relaxed)),
+            .timeSpentOnFutex = std::chrono::nanoseconds(
+                    mTimeSpentOnFutexNs.load(std::memory_order_relaxed)),
+            .pollingTimeWindow = get(),
+    };
+}
+
+void AdaptivePollingTimeWindow::update(std::chrono::nanoseconds waitTime) {
+    if (mAverageWaitTime.count() == 0) {
+        mAverageWaitTime = waitTime;
+    } else {
+        mAverageWaitTime += (waitTime - mAverageWaitTime) / kWaitTimeAverageWeight;
+    }
+
+    // Polling would not find the packet most of the time, so go straight to the futex.
+    if (mAverageWaitTime > kMaxPollingTimeWindow) {
+        mPollingTimeWindowUs.store(0, std::memory_order_relaxed);
+        return;
+    }
+
+    // Round up, so that sub-microsecond waits still get a window to poll in.
+    const auto pollingTimeWindow =
+            std::min(std::chrono::ceil<std::chrono::microseconds>(2 * mAverageWaitTime),
+                     kMaxPollingTimeWindow);
+    mPollingTimeWindowUs.store(pollingTimeWindow.count(), std::memory_order_relaxed);
+}
+
 // serialize a request into a packet
 std::vector<FmqRequestDatum> serialize(const V1_0::Request& request, V1_2::MeasureTiming measure,
                                        const std::vector<int32_t>& slots) {
+    std::vector<FmqRequestDatum> data;
+    serialize(request, measure, slots, &data);
+    return data;
+}
+
+void serialize(const V1_0::Request& request, V1_2::MeasureTiming measure,
+               const std::vector<int32_t>& slots, std::vector<FmqRequestDatum>* packet) {
     // count how many elements need to be sent for a request
-    size_t count = 2 + request.inputs.size() + request.outputs.size() + slots.size();
-    for (const auto& input : request.inputs) {
-        count += input.dimensions.size();
-    }
-    for (const auto& output : request.outputs) {
-        count += output.dimensions.size();
-    }
+    const size_t count = getSerializedSize(request, slots);
     CHECK_LE(count, std::numeric_limits<uint32_t>::max());
 
-    // create buffer to temporarily store elements
-    std::vector<FmqRequestDatum> data;
+    // reuse the storage of the packet
+    std::vector<FmqRequestDatum>& data = *packet;
+    data.clear();
     data.reserve(count);
 
     // package packetInfo
@@ -132,23 +221,39 @@ std::vector<FmqRequestDatum> serialize(const V1_0::Request& request, V1_2::Measu
     data.back().measureTiming(measure);
 
     CHECK_EQ(data.size(), count);
+}
 
-    // return packet
-    return data;
+size_t getSerializedSize(const V1_0::Request& request, const std::vector<int32_t>& slots) {
+    size_t count = 2 + request.inputs.size() + request.outputs.size() + slots.size();
+    for (const auto& input : request.inputs) {
+        count += input.dimensions.size();
+    }
+    for (const auto& output : request.outputs) {
+        count += output.dimensions.size();
+    }
+    return count;
 }
 
 // serialize result
 std::vector<FmqResultDatum> serialize(V1_0::ErrorStatus errorStatus,
                                       const std::vector<V1_2::OutputShape>& outputShapes,
                                       V1_2::Timing timing) {
+    std::vector<FmqResultDatum> data;
+    serialize(errorStatus, outputShapes, timing, &data);
+    return data;
+}
+
+void serialize(V1_0::ErrorStatus errorStatus, const std::vector<V1_2::OutputShape>& outputShapes,
+               V1_2::Timing timing, std::vector<FmqResultDatum>* packet) {
     // count how many elements need to be sent for a request
     size_t count = 2 + outputShapes.size();
     for (const auto& outputShape : outputShapes) {
         count += outputShape.dimensions.size();
     }
 
-    // create buffer to temporarily store elements
-    std::vector<FmqResultDatum> data;
+    // reuse the storage of the packet
+    std::vector<FmqResultDatum>& data = *packet;
+    data.clear();
     data.reserve(count);
 
     // package packetInfo
@@ -177,9 +282,6 @@ std::vector<FmqResultDatum> serialize(V1_0::ErrorStatus errorStatus,
     data.back().executionTiming(timing);
 
     CHECK_EQ(data.size(), count);
-
-    // return result
-    return data;
 }
 
 // deserialize request
@@ -415,13 +517,15 @@ RequestChannelSender::create(size_t channelLength) {
 }
 
 RequestChannelSender::RequestChannelSender(PrivateConstructorTag /*tag*/, size_t channelLength)
-    : mFmqRequestChannel(channelLength, /*configureEventFlagWord=*/true) {}
+    : mFmqRequestChannel(channelLength, /*configureEventFlagWord=*/true) {
+    mPacket.reserve(channelLength);
+}
 
 nn::Result<void> RequestChannelSender::send(const V1_0::Request& request,
                                             V1_2::MeasureTiming measure,
                                             const std::vector<int32_t>& slots) {
-    const std::vector<FmqRequestDatum> serialized = serialize(request, measure, slots);
-    return sendPacket(serialized);
+    serialize(request, measure, slots, &mPacket);
+    return sendPacket(mPacket);
 }
 
 nn::Result<void> RequestChannelSender::sendPacket(const std::vector<FmqRequestDatum>& packet) {
@@ -445,6 +549,10 @@ nn::Result<void> RequestChannelSender::sendPacket(const std::vector<FmqRequestDa
     return {};
 }
 
+size_t RequestChannelSender::availableToWrite() const {
+    return mFmqRequestChannel.availableToWrite();
+}
+
 void RequestChannelSender::notifyAsDeadObject() {
     mValid = false;
 }
@@ -471,12 +579,14 @@ nn::GeneralResult<std::unique_ptr<RequestChannelReceiver>> RequestChannelReceive
 RequestChannelReceiver::RequestChannelReceiver(
         PrivateConstructorTag /*tag*/, const MQDescriptorSync<FmqRequestDatum>& requestChannel,
         std::chrono::microseconds pollingTimeWindow)
-    : mFmqRequestChannel(requestChannel), kPollingTimeWindow(pollingTimeWindow) {}
+    : mFmqRequestChannel(requestChannel), mPollingTimeWindow(pollingTimeWindow) {
+    mPacket.reserve(mFmqRequestChannel.getQuantumCount());
+}
 
 nn::Result<std::tuple<V1_0::Request, std::vector<int32_t>, V1_2::MeasureTiming>>
 RequestChannelReceiver::getBlocking() {
     const auto packet = NN_TRY(getPacketBlocking());
-    return deserialize(packet);
+    return deserialize(*packet);
 }
 
 void RequestChannelReceiver::invalidate() {
@@ -490,7 +600,7 @@ void RequestChannelReceiver::invalidate() {
     mFmqRequestChannel.writeBlocking(data.data(), data.size());
 }
 
-nn::Result<std::vector<FmqRequestDatum>> RequestChannelReceiver::getPacketBlocking() {
+nn::Result<const std::vector<FmqRequestDatum>*> RequestChannelReceiver::getPacketBlocking() {
     if (mTeardown) {
         return NN_ERROR() << "FMQ object is being torn down";
     }
@@ -500,7 +610,8 @@ nn::Result<std::vector<FmqRequestDatum>> RequestChannelReceiver::getPacketBlocki
     // poll for a limited period of time.
 
     auto& getCurrentTime = std::chrono::high_resolution_clock::now;
-    const auto timeToStopPolling = getCurrentTime() + kPollingTimeWindow;
+    const auto startTime = getCurrentTime();
+    const auto timeToStopPolling = startTime + mPollingTimeWindow.get();
 
     while (getCurrentTime() < timeToStopPolling) {
         // if class is being torn down, immediately return
@@ -509,14 +620,15 @@ nn::Result<std::vector<FmqRequestDatum>> RequestChannelReceiver::getPacketBlocki
         }
 
         // Check if data is available. If it is, immediately retrieve it and return.
-        const size_t available = mFmqRequestChannel.availableToRead();
-        if (available > 0) {
-            std::vector<FmqRequestDatum> packet(available);
-            const bool success = mFmqRequestChannel.readBlocking(packet.data(), available);
+        if (mFmqRequestChannel.availableToRead() > 0) {
+            FmqRequestDatum datum;
+            const bool success = mFmqRequestChannel.readBlocking(&datum, 1) &&
+                                 readRemainingPacket(&mFmqRequestChannel, datum, &mPacket);
             if (!success) {
                 return NN_ERROR() << "Error receiving packet";
             }
-            return packet;
+            mPollingTimeWindow.onPacketReceivedWhilePolling(getCurrentTime() - startTime);
+            return &mPacket;
         }
 
         std::this_thread::yield();
@@ -526,19 +638,13 @@ nn::Result<std::vector<FmqRequestDatum>> RequestChannelReceiver::getPacketBlocki
     // was not allowed. Instead, perform a blocking call which uses a futex to save power.
 
     // wait for request packet and read first element of request packet
+    const auto futexStartTime = getCurrentTime();
     FmqRequestDatum datum;
     bool success = mFmqRequestChannel.readBlocking(&datum, 1);
+    const auto futexEndTime = getCurrentTime();
 
     // retrieve remaining elements
-    // NOTE: all of the data is already available at this point, so there's no need to do a blocking
-    // wait to wait for more data. This is known because in FMQ, all writes are published (made
-    // available) atomically. Currently, the producer always publishes the entire packet in one
-    // function call, so if the first element of the packet is available, the remaining elements are
-    // also available.
-    const size_t count = mFmqRequestChannel.availableToRead();
-    std::vector<FmqRequestDatum> packet(count + 1);
-    std::memcpy(&packet.front(), &datum, sizeof(datum));
-    success &= mFmqRequestChannel.read(packet.data() + 1, count);
+    success &= readRemainingPacket(&mFmqRequestChannel, datum, &mPacket);
 
     // terminate loop
     if (mTeardown) {
@@ -550,7 +656,13 @@ nn::Result<std::vector<FmqRequestDatum>> RequestChannelReceiver::getPacketBlocki
         return NN_ERROR() << "Error receiving packet";
     }
 
-    return packet;
+    mPollingTimeWindow.onPacketReceivedOnFutex(futexStartTime - startTime,
+                                               futexEndTime - futexStartTime);
+    return &mPacket;
+}
+
+PollingStatistics RequestChannelReceiver::getPollingStatistics() const {
+    return mPollingTimeWindow.getStatistics();
 }
 
 // ResultChannelSender methods
@@ -573,13 +685,15 @@ nn::GeneralResult<std::unique_ptr<ResultChannelSender>> ResultChannelSender::cre
 
 ResultChannelSender::ResultChannelSender(PrivateConstructorTag /*tag*/,
                                          const MQDescriptorSync<FmqResultDatum>& resultChannel)
-    : mFmqResultChannel(resultChannel) {}
+    : mFmqResultChannel(resultChannel) {
+    mPacket.reserve(mFmqResultChannel.getQuantumCount());
+}
 
 void ResultChannelSender::send(V1_0::ErrorStatus errorStatus,
                                const std::vector<V1_2::OutputShape>& outputShapes,
                                V1_2::Timing timing) {
-    const std::vector<FmqResultDatum> serialized = serialize(errorStatus, outputShapes, timing);
-    sendPacket(serialized);
+    serialize(errorStatus, outputShapes, timing, &mPacket);
+    sendPacket(mPacket);
 }
 
 void ResultChannelSender::sendPacket(const std::vector<FmqResultDatum>& packet) {
@@ -618,12 +732,14 @@ ResultChannelReceiver::create(size_t channelLength, std::chrono::microseconds po
 ResultChannelReceiver::ResultChannelReceiver(PrivateConstructorTag /*tag*/, size_t channelLength,
                                              std::chrono::microseconds pollingTimeWindow)
     : mFmqResultChannel(channelLength, /*configureEventFlagWord=*/true),
-      kPollingTimeWindow(pollingTimeWindow) {}
+      mPollingTimeWindow(pollingTimeWindow) {
+    mPacket.reserve(channelLength);
+}
 
 nn::Result<std::tuple<V1_0::ErrorStatus, std::vector<V1_2::OutputShape>, V1_2::Timing>>
 ResultChannelReceiver::getBlocking() {
     const auto packet = NN_TRY(getPacketBlocking());
-    return deserialize(packet);
+    return deserialize(*packet);
 }
 
 void ResultChannelReceiver::notifyAsDeadObject() {
@@ -637,7 +753,7 @@ void ResultChannelReceiver::notifyAsDeadObject() {
     mFmqResultChannel.writeBlocking(data.data(), data.size());
 }
 
-nn::Result<std::vector<FmqResultDatum>> ResultChannelReceiver::getPacketBlocking() {
+nn::Result<const std::vector<FmqResultDatum>*> ResultChannelReceiver::getPacketBlocking() {
     if (!mValid) {
         return NN_ERROR() << "FMQ object is invalid";
     }
@@ -647,7 +763,8 @@ nn::Result<std::vector<FmqResultDatum>> ResultChannelReceiver::getPacketBlocking
     // poll for a limited period of time.
 
     auto& getCurrentTime = std::chrono::high_resolution_clock::now;
-    const auto timeToStopPolling = getCurrentTime() + kPollingTimeWindow;
+    const auto startTime = getCurrentTime();
+    const auto timeToStopPolling = startTime + mPollingTimeWindow.get();
 
     while (getCurrentTime() < timeToStopPolling) {
         // if class is being torn down, immediately return
@@ -656,14 +773,15 @@ nn::Result<std::vector<FmqResultDatum>> ResultChannelReceiver::getPacketBlocking
         }
 
         // Check if data is available. If it is, immediately retrieve it and return.
-        const size_t available = mFmqResultChannel.availableToRead();
-        if (available > 0) {
-            std::vector<FmqResultDatum> packet(available);
-            const bool success = mFmqResultChannel.readBlocking(packet.data(), available);
+        if (mFmqResultChannel.availableToRead() > 0) {
+            FmqResultDatum datum;
+            const bool success = mFmqResultChannel.readBlocking(&datum, 1) &&
+                                 readRemainingPacket(&mFmqResultChannel, datum, &mPacket);
             if (!success) {
                 return NN_ERROR() << "Error receiving packet";
             }
-            return packet;
+            mPollingTimeWindow.onPacketReceivedWhilePolling(getCurrentTime() - startTime);
+            return &mPacket;
         }
 
         std::this_thread::yield();
@@ -673,19 +791,13 @@ nn::Result<std::vector<FmqResultDatum>> ResultChannelReceiver::getPacketBlocking
     // was not allowed. Instead, perform a blocking call which uses a futex to save power.
 
     // wait for result packet and read first element of result packet
+    const auto futexStartTime = getCurrentTime();
     FmqResultDatum datum;
     bool success = mFmqResultChannel.readBlocking(&datum, 1);
+    const auto futexEndTime = getCurrentTime();
 
     // retrieve remaining elements
-    // NOTE: all of the data is already available at this point, so there's no need to do a blocking
-    // wait to wait for more data. This is known because in FMQ, all writes are published (made
-    // available) atomically. Currently, the producer always publishes the entire packet in one
-    // function call, so if the first element of the packet is available, the remaining elements are
-    // also available.
-    const size_t count = mFmqResultChannel.availableToRead();
-    std::vector<FmqResultDatum> packet(count + 1);
-    std::memcpy(&packet.front(), &datum, sizeof(datum));
-    success &= mFmqResultChannel.read(packet.data() + 1, count);
+    success &= readRemainingPacket(&mFmqResultChannel, datum, &mPacket);
 
     if (!mValid) {
         return NN_ERROR() << "FMQ object is invalid";
@@ -696,7 +808,13 @@ nn::Result<std::vector<FmqResultDatum>> ResultChannelReceiver::getPacketBlocking
         return NN_ERROR() << "Error receiving packet";
     }
 
-    return packet;
+    mPollingTimeWindow.onPacketReceivedOnFutex(futexStartTime - startTime,
+                                               futexEndTime - futexStartTime);
+    return &mPacket;
+}
+
+PollingStatistics ResultChannelReceiver::getPollingStatistics() const {
+    return mPollingTimeWindow.getStatistics();
 }
 
 }  // namespace android::hardware::neuralnetworks::V1_2::utils
@@ -0,0 +1,132 @@
+/*
+ * Copyright (C) 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <gtest/gtest.h>
+#include <nnapi/hal/1.2/BurstUtils.h>
+
+#include <chrono>
+
+namespace android::hardware::neuralnetworks::V1_2::utils {
+
+using namespace std::chrono_literals;
+
+namespace {
+
+constexpr auto kMaxPollingTimeWindow = 100us;
+
+}  // namespace
+
+TEST(AdaptivePollingTimeWindowTest, startsAtMaximum) {
+    // run test
+    const AdaptivePollingTimeWindow window(kMaxPollingTimeWindow);
+
+    // verify result
+    EXPECT_EQ(kMaxPollingTimeWindow, window.get());
+}
+
+TEST(AdaptivePollingTimeWindowTest, shortWaitsShrinkWindow) {
+    // setup test
+    AdaptivePollingTimeWindow window(kMaxPollingTimeWindow);
+
+    // run test
+    for (int i = 0; i < 16; ++i) {
+        window.onPacketReceivedWhilePolling(10us);
+    }
+
+    // verify result
+    EXPECT_EQ(20us, window.get());
+}
+
+TEST(AdaptivePollingTimeWindowTest, longWaitsStopPolling) {
+    // setup test
+    AdaptivePollingTimeWindow window(kMaxPollingTimeWindow);
+
+    // run test
+    window.onPacketReceivedOnFutex(kMaxPollingTimeWindow, 1ms);
+
+    // verify result
+    EXPECT_EQ(0us, window.get());
+}
+
+TEST(AdaptivePollingTimeWindowTest, pollingResumesWhenWaitsGetShorter) {
+    // setup test
+    AdaptivePollingTimeWindow window(kMaxPollingTimeWindow);
+    window.onPacketReceivedOnFutex(0us, 1ms);
+    ASSERT_EQ(0us, window.get());
+
+    // run test
+    for (int i = 0; i < 64; ++i) {
+        window.onPacketReceivedOnFutex(0us, 10us);
+    }
+
+    // verify result
+    EXPECT_GT(window.get(), 0us);
+    EXPECT_LE(window.get(), kMaxPollingTimeWindow);
+}
+
+TEST(AdaptivePollingTimeWindowTest, subMicrosecondWaitsKeepPolling) {
+    // setup test
+    AdaptivePollingTimeWindow window(kMaxPollingTimeWindow);
+
+    // run test
+    for (int i = 0; i < 64; ++i) {
+        window.onPacketReceivedWhilePolling(200ns);
+    }
+
+    // verify result
+    EXPECT_EQ(1us, window.get());
+}
+
+TEST(AdaptivePollingTimeWindowTest, windowNeverExceedsMaximum) {
+    // setup test
+    AdaptivePollingTimeWindow window(kMaxPollingTimeWindow);
+
+    // run test
+    window.onPacketReceivedWhilePolling(90us);
+
+    // verify result
+    EXPECT_EQ(kMaxPollingTimeWindow, window.get());
+}
+
+TEST(AdaptivePollingTimeWindowTest, noPollingWhenMaximumIsZero) {
+    // setup test
+    AdaptivePollingTimeWindow window(0us);
+
+    // run test
+    window.onPacketReceivedOnFutex(0us, 1us);
+
+    // verify result
+    EXPECT_EQ(0us, window.get());
+}
+
+TEST(AdaptivePollingTimeWindowTest, statistics) {
+    // setup test
+    AdaptivePollingTimeWindow window(kMaxPollingTimeWindow);
+
+    // run test
+    window.onPacketReceivedWhilePolling(10us);
+    window.onPacketReceivedOnFutex(20us, 30us);
+    const auto statistics = window.getStatistics();
+
+    // verify result
+    EXPECT_EQ(1u, statistics.packetsReceivedWhilePolling);
+    EXPECT_EQ(1u, statistics.packetsReceivedOnFutex);
+    EXPECT_EQ(30us, statistics.timeSpentPolling);
+    EXPECT_EQ(30us, statistics.timeSpentOnFutex);
+    EXPECT_EQ(window.get(), statistics.pollingTimeWindow);
+}
+
+}  // namespace android::hardware::neuralnetworks::V1_2::utils
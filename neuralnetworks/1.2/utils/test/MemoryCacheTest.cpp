@@ -0,0 +1,130 @@
+/*
+ * Copyright (C) 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "MockBurstContext.h"
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+#include <nnapi/Types.h>
+#include <nnapi/hal/1.2/Burst.h>
+
+#include <memory>
+
+namespace android::hardware::neuralnetworks::V1_2::utils {
+namespace {
+
+using ::testing::_;
+using ::testing::InvokeWithoutArgs;
+
+using MemoryCache = Burst::MemoryCache;
+
+nn::SharedMemory makeMemory() {
+    return std::make_shared<const nn::Memory>();
+}
+
+}  // namespace
+
+TEST(MemoryCacheTest, sameMemorySameSlot) {
+    // setup test
+    const auto cache = std::make_shared<MemoryCache>();
+    const auto memory = makeMemory();
+
+    // run test
+    const auto [slot1, hold1] = cache->cacheMemory(memory);
+    const auto [slot2, hold2] = cache->cacheMemory(memory);
+
+    // verify result
+    EXPECT_EQ(slot1, slot2);
+    const auto statistics = cache->getStatistics();
+    EXPECT_EQ(1u, statistics.hits);
+    EXPECT_EQ(1u, statistics.misses);
+}
+
+TEST(MemoryCacheTest, memoryStaysCachedAfterHoldReleased) {
+    // setup test
+    const auto cache = std::make_shared<MemoryCache>();
+    const auto memory = makeMemory();
+    const int32_t slot = cache->cacheMemory(memory).first;
+
+    // run test
+    const auto [sameSlot, hold] = cache->cacheMemory(memory);
+
+    // verify result
+    EXPECT_EQ(slot, sameSlot);
+    EXPECT_EQ(1u, cache->getStatistics().hits);
+    const auto result = cache->getMemory(slot);
+    ASSERT_TRUE(result.has_value());
+    EXPECT_EQ(memory, result.value());
+}
+
+TEST(MemoryCacheTest, evictsLeastRecentlyUsed) {
+    // setup test
+    const auto cache = std::make_shared<MemoryCache>(/*capacity=*/2);
+    const auto burstContext = sp<MockBurstContext>::make();
+    cache->setBurstContext(burstContext);
+    const auto memory1 = makeMemory();
+    const auto memory2 = makeMemory();
+    const int32_t slot1 = cache->cacheMemory(memory1).first;
+    const int32_t slot2 = cache->cacheMemory(memory2).first;
+    cache->cacheMemory(memory1);
+    EXPECT_CALL(*burstContext, freeMemory(slot2)).Times(1).WillOnce(InvokeWithoutArgs([] {
+        return Void();
+    }));
+
+    // run test
+    const int32_t slot3 = cache->cacheMemory(makeMemory()).first;
+
+    // verify result
+    EXPECT_EQ(slot2, slot3);
+    EXPECT_EQ(1u, cache->getStatistics().evictions);
+    const auto result = cache->getMemory(slot1);
+    ASSERT_TRUE(result.has_value());
+    EXPECT_EQ(memory1, result.value());
+}
+
+TEST(MemoryCacheTest, heldMemoryIsNotEvicted) {
+    // setup test
+    const auto cache = std::make_shared<MemoryCache>(/*capacity=*/1);
+    const auto burstContext = sp<MockBurstContext>::make();
+    cache->setBurstContext(burstContext);
+    const auto memory = makeMemory();
+    const auto [slot, hold] = cache->cacheMemory(memory);
+    EXPECT_CALL(*burstContext, freeMemory(_)).Times(0);
+
+    // run test
+    const auto [otherSlot, otherHold] = cache->cacheMemory(makeMemory());
+
+    // verify result
+    EXPECT_NE(slot, otherSlot);
+    EXPECT_EQ(0u, cache->getStatistics().evictions);
+    const auto result = cache->getMemory(slot);
+    ASSERT_TRUE(result.has_value());
+    EXPECT_EQ(memory, result.value());
+}
+
+TEST(MemoryCacheTest, getMemoryInvalidSlot) {
+    // setup test
+    const auto cache = std::make_shared<MemoryCache>();
+
+    // run test
+    const auto result = cache->getMemory(0);
+
+    // verify result
+    EXPECT_FALSE(result.has_value());
+    EXPECT_EQ(1u, cache->getStatistics().memoriesRequested);
+}
+
+}  // namespace android::hardware::neuralnetworks::V1_2::utils
@@ -182,12 +182,14 @@ PreparedModel::executeFenced(
         const nn::OptionalDuration& timeoutDurationAfterFence,
         const std::vector<nn::TokenValuePair>& hints,
         const std::vector<nn::ExtensionNameAndPrefix>& extensionNameToPrefix) const {
-    // Ensure that request is ready for IPC.
+    // Ensure that request is ready for IPC. The relocation is released when this function returns,
+    // likely before the fence signals, so the memory must not come from a pool where the next
+    // execution could overwrite it.
     std::optional<nn::Request> maybeRequestInShared;
     hal::utils::RequestRelocation relocation;
     const nn::Request& requestInShared = NN_TRY(hal::utils::convertRequestFromPointerToShared(
             &request, nn::kDefaultRequestMemoryAlignment, nn::kDefaultRequestMemoryPadding,
-            &maybeRequestInShared, &relocation));
+            &maybeRequestInShared, &relocation, /*pool=*/nullptr));
 
     const auto aidlRequest = NN_TRY(convert(requestInShared));
     const auto aidlWaitFor = NN_TRY(convert(waitFor));
@@ -235,12 +237,14 @@ nn::GeneralResult<nn::SharedExecution> PreparedModel::createReusableExecution(
         const nn::OptionalDuration& loopTimeoutDuration,
         const std::vector<nn::TokenValuePair>& hints,
         const std::vector<nn::ExtensionNameAndPrefix>& extensionNameToPrefix) const {
-    // Ensure that request is ready for IPC.
+    // Ensure that request is ready for IPC. The execution may be computed with computeFenced, whose
+    // fence may signal after the execution is released, so the memory must not come from a pool
+    // where the next execution could overwrite it.
     std::optional<nn::Request> maybeRequestInShared;
     hal::utils::RequestRelocation relocation;
     const nn::Request& requestInShared = NN_TRY(hal::utils::convertRequestFromPointerToShared(
             &request, nn::kDefaultRequestMemoryAlignment, nn::kDefaultRequestMemoryPadding,
-            &maybeRequestInShared, &relocation));
+            &maybeRequestInShared, &relocation, /*pool=*/nullptr));
 
     auto aidlRequest = NN_TRY(convert(requestInShared));
     auto aidlMeasure = NN_TRY(convert(measure));
@@ -27,10 +27,12 @@
 #include <nnapi/IPreparedModel.h>
 #include <nnapi/TypeUtils.h>
 #include <nnapi/Types.h>
+#include <nnapi/hal/RelocationArenaPool.h>
 #include <nnapi/hal/aidl/PreparedModel.h>
 
 #include <functional>
 #include <memory>
+#include <vector>
 
 namespace aidl::android::hardware::neuralnetworks::utils {
 namespace {
@@ -205,6 +207,38 @@ TEST_P(PreparedModelTest, executeFenced) {
                                             << callbackResult.error().message;
 }
 
+TEST_P(PreparedModelTest, executeFencedWithInputPointerDoesNotLeaseFromPool) {
+    if (kVersion.level >= nn::Version::Level::FEATURE_LEVEL_8) return;
+
+    // setup call
+    const auto mockPreparedModel = MockPreparedModel::create();
+    const auto preparedModel = PreparedModel::create(mockPreparedModel, kVersion).value();
+    const auto mockCallback = MockFencedExecutionCallback::create();
+    EXPECT_CALL(*mockPreparedModel, executeFenced(_, _, _, _, _, _, _))
+            .Times(1)
+            .WillOnce(Invoke(makeFencedExecutionResult(mockCallback)));
+    const std::vector<float> input = {1.0f, 2.0f, 3.0f, 4.0f};
+    const nn::Request request = {
+            .inputs = {{.lifetime = nn::Request::Argument::LifeTime::POINTER,
+                        .location = {.pointer = static_cast<const void*>(input.data()),
+                                     .length = static_cast<uint32_t>(input.size() *
+                                                                     sizeof(float))}}}};
+    const auto& pool = hal::utils::RelocationArenaPool::getDefault();
+    const auto statisticsBefore = pool->getStatistics();
+
+    // run test
+    const auto result = preparedModel->executeFenced(request, {}, {}, {}, {}, {}, {}, {});
+
+    // verify result
+    ASSERT_TRUE(result.has_value())
+            << "Failed with " << result.error().code << ": " << result.error().message;
+    // The input arena is released when executeFenced returns, before the fence signals, so it must
+    // not have been leased from the pool that hands it out to the next execution.
+    const auto statisticsAfter = pool->getStatistics();
+    EXPECT_EQ(statisticsBefore.hits, statisticsAfter.hits);
+    EXPECT_EQ(statisticsBefore.misses, statisticsAfter.misses);
+}
+
 TEST_P(PreparedModelTest, executeFencedCallbackError) {
     if (kVersion.level >= nn::Version::Level::FEATURE_LEVEL_8) return;
 
@@ -814,6 +848,38 @@ TEST_P(PreparedModelTest, createReusableExecution) {
     EXPECT_NE(result.value(), nullptr);
 }
 
+TEST_P(PreparedModelTest, createReusableExecutionWithInputPointerDoesNotLeaseFromPool) {
+    // setup test
+    const auto mockPreparedModel = MockPreparedModel::create();
+    if (kVersion.level >= nn::Version::Level::FEATURE_LEVEL_8) {
+        const auto mockExecution = ndk::SharedRefBase::make<MockExecution>();
+        EXPECT_CALL(*mockPreparedModel, createReusableExecution(_, _, _))
+                .Times(1)
+                .WillOnce(DoAll(SetArgPointee<2>(mockExecution), Invoke(makeStatusOk)));
+    }
+    const auto preparedModel = PreparedModel::create(mockPreparedModel, kVersion).value();
+    const std::vector<float> input = {1.0f, 2.0f, 3.0f, 4.0f};
+    const nn::Request request = {
+            .inputs = {{.lifetime = nn::Request::Argument::LifeTime::POINTER,
+                        .location = {.pointer = static_cast<const void*>(input.data()),
+                                     .length = static_cast<uint32_t>(input.size() *
+                                                                     sizeof(float))}}}};
+    const auto& pool = hal::utils::RelocationArenaPool::getDefault();
+    const auto statisticsBefore = pool->getStatistics();
+
+    // run test
+    const auto result = preparedModel->createReusableExecution(request, {}, {}, {}, {});
+
+    // verify result
+    ASSERT_TRUE(result.has_value())
+            << "Failed with " << result.error().code << ": " << result.error().message;
+    // The execution may be computed with computeFenced and released before the fence signals, so
+    // its input arena must not have been leased from the pool that hands it out again.
+    const auto statisticsAfter = pool->getStatistics();
+    EXPECT_EQ(statisticsBefore.hits, statisticsAfter.hits);
+    EXPECT_EQ(statisticsBefore.misses, statisticsAfter.misses);
+}
+
 TEST_P(PreparedModelTest, createReusableExecutionError) {
     if (kVersion.level < nn::Version::Level::FEATURE_LEVEL_8) return;
 
@@ -0,0 +1,114 @@
+/*
+ * Copyright (C) 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Benchmarks for the per-execution request handling of the AIDL adapter: converting and
+// validating the whole Request, compared with finding the cached reusable execution for it.
+
+#include <aidl/android/hardware/common/Ashmem.h>
+#include <aidl/android/hardware/neuralnetworks/Memory.h>
+#include <aidl/android/hardware/neuralnetworks/Request.h>
+#include <aidl/android/hardware/neuralnetworks/RequestArgument.h>
+#include <aidl/android/hardware/neuralnetworks/RequestMemoryPool.h>
+#include <android/binder_auto_utils.h>
+#include <benchmark/benchmark.h>
+#include <nnapi/Types.h>
+#include <nnapi/hal/aidl/Conversions.h>
+#include <nnapi/hal/aidl/ExecutionCache.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+namespace aidl::android::hardware::neuralnetworks::adapter {
+namespace {
+
+using ::benchmark::State;
+
+constexpr int64_t kOperandLength = 64;
+constexpr size_t kRank = 4;
+
+// Creates a request with 'operandCount' inputs and as many outputs, all in one memfd-backed pool.
+Request makeRequest(size_t operandCount) {
+    const int64_t poolSize = 2 * operandCount * kOperandLength;
+    ndk::ScopedFileDescriptor fd(memfd_create("ExecutionCacheBenchmark", MFD_CLOEXEC));
+    if (fd.get() < 0 || ftruncate(fd.get(), poolSize) != 0) {
+        return {};
+    }
+
+    Request request;
+    for (size_t i = 0; i < 2 * operandCount; ++i) {
+        const RequestArgument argument = {
+                .location = {.poolIndex = 0,
+                             .offset = static_cast<int64_t>(i) * kOperandLength,
+                             .length = kOperandLength},
+                .dimensions = std::vector<int32_t>(kRank, 4)};
+        (i < operandCount ? request.inputs : request.outputs).push_back(argument);
+    }
+    request.pools.push_back(RequestMemoryPool::make<RequestMemoryPool::Tag::pool>(
+            Memory::make<Memory::Tag::ashmem>(
+                    common::Ashmem{.fd = std::move(fd), .size = poolSize})));
+    return request;
+}
+
+// Converts the request to the canonical types, as every uncached execution does.
+void BM_ConvertRequest(State& state) {
+    const auto request = makeRequest(state.range(0));
+    for (auto _ : state) {
+        auto nnRequest = ::android::nn::convert(request);
+        if (!nnRequest.has_value()) {
+            state.SkipWithError("failed to convert the request");
+            break;
+        }
+        ::benchmark::DoNotOptimize(nnRequest);
+    }
+}
+
+// Finds the cached execution for the request and returns it to the cache, as every cached
+// execution does.
+void BM_ExecutionCacheHit(State& state) {
+    const auto request = makeRequest(state.range(0));
+    const ExecutionCache cache;
+    const ExecutionConfig config;
+    auto pools = ExecutionCache::identifyPools(request.pools);
+    if (!pools.has_value()) {
+        state.SkipWithError("failed to identify the memory pools");
+        return;
+    }
+    cache.release({.key = {.inputs = request.inputs,
+                           .outputs = request.outputs,
+                           .pools = std::move(pools).value(),
+                           .config = config}});
+
+    for (auto _ : state) {
+        const auto identities = ExecutionCache::identifyPools(request.pools);
+        auto entry = cache.acquire(request, identities.value(), config);
+        if (!entry.has_value()) {
+            state.SkipWithError("failed to find the cached execution");
+            break;
+        }
+        cache.release(std::move(entry).value());
+    }
+}
+
+BENCHMARK(BM_ConvertRequest)->Arg(16)->Arg(1024);
+BENCHMARK(BM_ExecutionCacheHit)->Arg(16)->Arg(1024);
+
+}  // namespace
+}  // namespace aidl::android::hardware::neuralnetworks::adapter
+
+BENCHMARK_MAIN();
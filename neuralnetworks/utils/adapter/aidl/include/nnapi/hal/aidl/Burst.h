@@ -25,6 +25,7 @@
 #include <nnapi/IBurst.h>
 #include <nnapi/Types.h>
 
+#include <atomic>
 #include <memory>
 #include <mutex>
 #include <unordered_map>
@@ -53,20 +54,53 @@ class Burst : public BnBurst {
 
     ndk::ScopedAStatus releaseMemoryResource(int64_t memoryIdentifierToken) override;
 
+    // Caches the memories by token, evicting the least recently used one once more than
+    // `capacity` are cached. Looking up a cached memory takes no lock: it reads an immutable
+    // snapshot of the cache, which is replaced under the lock whenever a memory is added or
+    // removed.
     class ThreadSafeMemoryCache {
       public:
         using Value =
                 std::pair<::android::nn::SharedMemory, ::android::nn::IBurst::OptionalCacheHold>;
 
+        struct Statistics {
+            uint64_t hits = 0;
+            uint64_t misses = 0;
+            uint64_t evictions = 0;
+        };
+
+        static constexpr size_t kDefaultCapacity = 128;
+
+        explicit ThreadSafeMemoryCache(size_t capacity = kDefaultCapacity);
+
         Value add(int64_t token, const ::android::nn::SharedMemory& memory,
                   const ::android::nn::IBurst& burst) const;
         void remove(int64_t token) const;
+        Statistics getStatistics() const;
 
       private:
+        struct Entry {
+            Value value;
+            mutable std::atomic<uint64_t> lastUse = 0;
+        };
+        using Snapshot = std::unordered_map<int64_t, std::shared_ptr<const Entry>>;
+
+        std::shared_ptr<const Snapshot> loadSnapshot() const;
+        void storeSnapshot(Snapshot snapshot) const REQUIRES(mMutex);
+        void touch(const Entry& entry) const;
+
+        const size_t kCapacity;
         mutable std::mutex mMutex;
-        mutable std::unordered_map<int64_t, Value> mCache GUARDED_BY(mMutex);
+        // Only replaced while holding mMutex, always accessed through std::atomic_load/store.
+        mutable std::shared_ptr<const Snapshot> mSnapshot;
+        mutable std::atomic<uint64_t> mUseClock = 0;
+        mutable std::atomic<uint64_t> mHits = 0;
+        mutable std::atomic<uint64_t> mMisses = 0;
+        mutable std::atomic<uint64_t> mEvictions = 0;
     };
 
+    ThreadSafeMemoryCache::Statistics getMemoryCacheStatistics() const;
+
   private:
     const ::android::nn::SharedBurst kBurst;
     const ThreadSafeMemoryCache kMemoryCache;
@@ -0,0 +1,119 @@
+/*
+ * Copyright (C) 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_HARDWARE_INTERFACES_NEURALNETWORKS_UTILS_ADAPTER_AIDL_EXECUTION_CACHE_H
+#define ANDROID_HARDWARE_INTERFACES_NEURALNETWORKS_UTILS_ADAPTER_AIDL_EXECUTION_CACHE_H
+
+#include <aidl/android/hardware/neuralnetworks/ExecutionConfig.h>
+#include <aidl/android/hardware/neuralnetworks/Request.h>
+#include <aidl/android/hardware/neuralnetworks/RequestArgument.h>
+#include <aidl/android/hardware/neuralnetworks/RequestMemoryPool.h>
+#include <android-base/thread_annotations.h>
+#include <nnapi/IExecution.h>
+#include <nnapi/Types.h>
+#include <sys/types.h>
+
+#include <cstdint>
+#include <list>
+#include <mutex>
+#include <optional>
+#include <vector>
+
+namespace aidl::android::hardware::neuralnetworks::adapter {
+
+// Cache of the reusable executions the adapter creates for IPreparedModel::executeSynchronously
+// and IPreparedModel::executeFenced.
+//
+// Every one-shot execution otherwise converts and validates the whole Request again. When a client
+// repeatedly executes the same request layout on the same memory pools, the adapter can instead
+// compute an nn::IExecution created once for that layout. The memory pools arrive as new file
+// descriptors on every call, so they are identified by the file they refer to. Pools that cannot
+// be identified that way (hardware buffers and character devices such as legacy ashmem) make the
+// request uncacheable. So do driver-managed buffers, as their tokens are reused once released.
+//
+// An execution is taken out of the cache while it is being computed, so it is never computed
+// concurrently. An execution returned after a fenced computation is only reused once its sync
+// fence has signaled. Request layouts for which no reusable execution could be created are
+// remembered as well, so that failing requests do not attempt the creation on every call.
+class ExecutionCache {
+  public:
+    // Identifies the memory behind a RequestMemoryPool across binder calls.
+    struct PoolIdentity {
+        dev_t device = 0;
+        ino_t inode = 0;
+        int64_t size = 0;
+        int64_t offset = 0;
+        int32_t prot = 0;
+
+        bool operator==(const PoolIdentity& other) const;
+    };
+
+    struct Key {
+        std::vector<RequestArgument> inputs;
+        std::vector<RequestArgument> outputs;
+        std::vector<PoolIdentity> pools;
+        ExecutionConfig config;
+    };
+
+    struct Entry {
+        Key key;
+        ::android::nn::SharedExecution execution;
+        ::android::nn::SyncFence syncFence = ::android::nn::SyncFence::createAsSignaled();
+    };
+
+    struct Statistics {
+        uint64_t hits = 0;
+        uint64_t misses = 0;
+    };
+
+    static constexpr size_t kDefaultCapacity = 4;
+
+    // Returns std::nullopt if any of the pools cannot be identified across binder calls.
+    static std::optional<std::vector<PoolIdentity>> identifyPools(
+            const std::vector<RequestMemoryPool>& pools);
+
+    explicit ExecutionCache(size_t capacity = kDefaultCapacity);
+
+    // Removes and returns an idle entry matching the request, if there is one. The caller gives the
+    // entry back with `release` once it is done computing.
+    std::optional<Entry> acquire(const Request& request, const std::vector<PoolIdentity>& pools,
+                                 const ExecutionConfig& config) const;
+
+    // Adds the entry as the most recently used one, evicting the least recently used entry if the
+    // cache is full.
+    void release(Entry entry) const;
+
+    // Returns true if the request was marked with `markUncacheable` and has not been evicted since.
+    bool isUncacheable(const Request& request, const std::vector<PoolIdentity>& pools,
+                       const ExecutionConfig& config) const;
+
+    // Remembers that no reusable execution could be created for the key, evicting the least
+    // recently marked key if the cache already remembers as many keys as it holds entries.
+    void markUncacheable(Key key) const;
+
+    Statistics getStatistics() const;
+
+  private:
+    const size_t kCapacity;
+    mutable std::mutex mMutex;
+    mutable std::list<Entry> mEntries GUARDED_BY(mMutex);
+    mutable std::list<Key> mUncacheableKeys GUARDED_BY(mMutex);
+    mutable Statistics mStatistics GUARDED_BY(mMutex);
+};
+
+}  // namespace aidl::android::hardware::neuralnetworks::adapter
+
+#endif  // ANDROID_HARDWARE_INTERFACES_NEURALNETWORKS_UTILS_ADAPTER_AIDL_EXECUTION_CACHE_H
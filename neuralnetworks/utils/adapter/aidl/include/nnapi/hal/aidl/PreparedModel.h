@@ -18,6 +18,7 @@
 #define ANDROID_HARDWARE_INTERFACES_NEURALNETWORKS_UTILS_ADAPTER_AIDL_PREPARED_MDOEL_H
 
 #include "nnapi/hal/aidl/Adapter.h"
+#include "nnapi/hal/aidl/ExecutionCache.h"
 
 #include <aidl/android/hardware/neuralnetworks/BnPreparedModel.h>
 #include <aidl/android/hardware/neuralnetworks/ExecutionResult.h>
@@ -64,9 +65,11 @@ class PreparedModel : public BnPreparedModel {
             FencedExecutionResult* executionResult) override;
 
     ::android::nn::SharedPreparedModel getUnderlyingPreparedModel() const;
+    ExecutionCache::Statistics getExecutionCacheStatistics() const;
 
   protected:
     const ::android::nn::SharedPreparedModel kPreparedModel;
+    const ExecutionCache kExecutionCache;
 };
 
 }  // namespace aidl::android::hardware::neuralnetworks::adapter
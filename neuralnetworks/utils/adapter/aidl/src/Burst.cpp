@@ -131,20 +131,82 @@ nn::ExecutionResult<ExecutionResult> executeSynchronously(
 
 }  // namespace
 
+Burst::ThreadSafeMemoryCache::ThreadSafeMemoryCache(size_t capacity)
+    : kCapacity(capacity), mSnapshot(std::make_shared<const Snapshot>()) {}
+
 Value Burst::ThreadSafeMemoryCache::add(int64_t token, const nn::SharedMemory& memory,
                                         const nn::IBurst& burst) const {
+    const auto snapshot = loadSnapshot();
+    if (const auto it = snapshot->find(token); it != snapshot->end()) {
+        touch(*it->second);
+        mHits.fetch_add(1, std::memory_order_relaxed);
+        return it->second->value;
+    }
+
     std::lock_guard guard(mMutex);
-    if (const auto it = mCache.find(token); it != mCache.end()) {
-        return it->second;
+
+    // Another thread may have added the token since the snapshot was loaded.
+    const auto current = loadSnapshot();
+    if (const auto it = current->find(token); it != current->end()) {
+        touch(*it->second);
+        mHits.fetch_add(1, std::memory_order_relaxed);
+        return it->second->value;
     }
-    auto hold = burst.cacheMemory(memory);
-    auto [it, _] = mCache.emplace(token, std::make_pair(memory, std::move(hold)));
-    return it->second;
+    mMisses.fetch_add(1, std::memory_order_relaxed);
+
+    // Evict the least recently used memories. The executions using them keep their own copy of the
+    // memory and its hold.
+    const auto lessRecentlyUsed = [](const auto& a, const auto& b) {
+        return a.second->lastUse.load(std::memory_order_relaxed) <
+               b.second->lastUse.load(std::memory_order_relaxed);
+    };
+    Snapshot next = *current;
+    while (!next.empty() && next.size() >= kCapacity) {
+        next.erase(std::min_element(next.begin(), next.end(), lessRecentlyUsed));
+        mEvictions.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    auto entry = std::make_shared<Entry>();
+    entry->value = std::make_pair(memory, burst.cacheMemory(memory));
+    touch(*entry);
+    Value value = entry->value;
+    next.emplace(token, std::move(entry));
+    storeSnapshot(std::move(next));
+    return value;
 }
 
 void Burst::ThreadSafeMemoryCache::remove(int64_t token) const {
     std::lock_guard guard(mMutex);
-    mCache.erase(token);
+    const auto current = loadSnapshot();
+    if (current->count(token) == 0) {
+        return;
+    }
+    Snapshot next = *current;
+    next.erase(token);
+    storeSnapshot(std::move(next));
+}
+
+Burst::ThreadSafeMemoryCache::Statistics Burst::ThreadSafeMemoryCache::getStatistics() const {
+    return {
+            .hits = mHits.load(std::memory_order_relaxed),
+            .misses = mMisses.load(std::memory_order_relaxed),
+            .evictions = mEvictions.load(std::memory_order_relaxed),
+    };
+}
+
+std::shared_ptr<const Burst::ThreadSafeMemoryCache::Snapshot>
+Burst::ThreadSafeMemoryCache::loadSnapshot() const {
+    return std::atomic_load_explicit(&mSnapshot, std::memory_order_acquire);
+}
+
+void Burst::ThreadSafeMemoryCache::storeSnapshot(Snapshot snapshot) const {
+    std::atomic_store_explicit(&mSnapshot, std::make_shared<const Snapshot>(std::move(snapshot)),
+                               std::memory_order_release);
+}
+
+void Burst::ThreadSafeMemoryCache::touch(const Entry& entry) const {
+    entry.lastUse.store(mUseClock.fetch_add(1, std::memory_order_relaxed) + 1,
+                        std::memory_order_relaxed);
 }
 
 Burst::Burst(nn::SharedBurst burst) : kBurst(std::move(burst)) {
@@ -186,6 +248,10 @@ ndk::ScopedAStatus Burst::executeSynchronouslyWithConfig(
     return ndk::ScopedAStatus::ok();
 }
 
+Burst::ThreadSafeMemoryCache::Statistics Burst::getMemoryCacheStatistics() const {
+    return kMemoryCache.getStatistics();
+}
+
 ndk::ScopedAStatus Burst::releaseMemoryResource(int64_t memoryIdentifierToken) {
     if (memoryIdentifierToken < -1) {
         return ndk::ScopedAStatus::fromServiceSpecificErrorWithMessage(
@@ -0,0 +1,161 @@
+/*
+ * Copyright (C) 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "ExecutionCache.h"
+
+#include <aidl/android/hardware/neuralnetworks/Memory.h>
+#include <aidl/android/hardware/neuralnetworks/RequestMemoryPool.h>
+#include <nnapi/Types.h>
+#include <sys/stat.h>
+
+#include <algorithm>
+#include <chrono>
+#include <iterator>
+#include <list>
+#include <mutex>
+#include <optional>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+namespace aidl::android::hardware::neuralnetworks::adapter {
+namespace {
+
+std::optional<ExecutionCache::PoolIdentity> identifyFile(int fd, int64_t size, int64_t offset,
+                                                         int32_t prot) {
+    struct stat st;
+    if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode)) {
+        return std::nullopt;
+    }
+    return ExecutionCache::PoolIdentity{.device = st.st_dev,
+                                        .inode = st.st_ino,
+                                        .size = size,
+                                        .offset = offset,
+                                        .prot = prot};
+}
+
+std::optional<ExecutionCache::PoolIdentity> identifyPool(const RequestMemoryPool& pool) {
+    // A token is handed out again once the IBuffer it refers to is released, so it does not
+    // identify the memory behind it.
+    if (pool.getTag() == RequestMemoryPool::Tag::token) {
+        return std::nullopt;
+    }
+    const auto& memory = pool.get<RequestMemoryPool::Tag::pool>();
+    switch (memory.getTag()) {
+        case Memory::Tag::ashmem: {
+            const auto& ashmem = memory.get<Memory::Tag::ashmem>();
+            return identifyFile(ashmem.fd.get(), ashmem.size, /*offset=*/0, /*prot=*/0);
+        }
+        case Memory::Tag::mappableFile: {
+            const auto& mappableFile = memory.get<Memory::Tag::mappableFile>();
+            return identifyFile(mappableFile.fd.get(), mappableFile.length, mappableFile.offset,
+                                mappableFile.prot);
+        }
+        case Memory::Tag::hardwareBuffer:
+            return std::nullopt;
+    }
+    return std::nullopt;
+}
+
+bool matches(const ExecutionCache::Key& key, const Request& request,
+             const std::vector<ExecutionCache::PoolIdentity>& pools,
+             const ExecutionConfig& config) {
+    return key.pools == pools && key.config == config && key.inputs == request.inputs &&
+           key.outputs == request.outputs;
+}
+
+}  // namespace
+
+bool ExecutionCache::PoolIdentity::operator==(const PoolIdentity& other) const {
+    return std::tie(device, inode, size, offset, prot) ==
+           std::tie(other.device, other.inode, other.size, other.offset, other.prot);
+}
+
+std::optional<std::vector<ExecutionCache::PoolIdentity>> ExecutionCache::identifyPools(
+        const std::vector<RequestMemoryPool>& pools) {
+    std::vector<PoolIdentity> identities;
+    identities.reserve(pools.size());
+    for (const auto& pool : pools) {
+        auto identity = identifyPool(pool);
+        if (!identity.has_value()) {
+            return std::nullopt;
+        }
+        identities.push_back(*identity);
+    }
+    return identities;
+}
+
+ExecutionCache::ExecutionCache(size_t capacity) : kCapacity(capacity) {}
+
+std::optional<ExecutionCache::Entry> ExecutionCache::acquire(
+        const Request& request, const std::vector<PoolIdentity>& pools,
+        const ExecutionConfig& config) const {
+    std::lock_guard guard(mMutex);
+    for (auto it = mEntries.begin(); it != mEntries.end(); ++it) {
+        if (!matches(it->key, request, pools, config)) {
+            continue;
+        }
+
+        // The execution may still be computing a previous fenced execution.
+        const auto state = it->syncFence.syncWait(std::chrono::milliseconds(0));
+        if (state == ::android::nn::SyncFence::FenceState::ACTIVE) {
+            continue;
+        }
+        if (state != ::android::nn::SyncFence::FenceState::SIGNALED) {
+            mEntries.erase(it);
+            break;
+        }
+
+        auto entry = std::move(*it);
+        mEntries.erase(it);
+        ++mStatistics.hits;
+        return entry;
+    }
+    ++mStatistics.misses;
+    return std::nullopt;
+}
+
+void ExecutionCache::release(Entry entry) const {
+    std::list<Entry> evicted;
+    std::lock_guard guard(mMutex);
+    mEntries.push_front(std::move(entry));
+    if (mEntries.size() > kCapacity) {
+        // Destroy the evicted execution after releasing the lock.
+        evicted.splice(evicted.begin(), mEntries, std::prev(mEntries.end()));
+    }
+}
+
+bool ExecutionCache::isUncacheable(const Request& request, const std::vector<PoolIdentity>& pools,
+                                   const ExecutionConfig& config) const {
+    std::lock_guard guard(mMutex);
+    return std::any_of(mUncacheableKeys.begin(), mUncacheableKeys.end(),
+                       [&](const Key& key) { return matches(key, request, pools, config); });
+}
+
+void ExecutionCache::markUncacheable(Key key) const {
+    std::lock_guard guard(mMutex);
+    mUncacheableKeys.push_front(std::move(key));
+    if (mUncacheableKeys.size() > kCapacity) {
+        mUncacheableKeys.pop_back();
+    }
+}
+
+ExecutionCache::Statistics ExecutionCache::getStatistics() const {
+    std::lock_guard guard(mMutex);
+    return mStatistics;
+}
+
+}  // namespace aidl::android::hardware::neuralnetworks::adapter
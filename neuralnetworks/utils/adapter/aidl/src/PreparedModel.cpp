@@ -18,6 +18,7 @@
 
 #include "Burst.h"
 #include "Execution.h"
+#include "ExecutionCache.h"
 
 #include <aidl/android/hardware/neuralnetworks/BnFencedExecutionCallback.h>
 #include <aidl/android/hardware/neuralnetworks/BnPreparedModel.h>
@@ -37,6 +38,7 @@
 #include <nnapi/hal/aidl/Utils.h>
 
 #include <memory>
+#include <optional>
 #include <utility>
 #include <vector>
 
@@ -100,6 +102,19 @@ nn::GeneralResult<std::vector<nn::SyncFence>> convertSyncFences(
     return syncFences;
 }
 
+nn::GeneralResult<FencedExecutionResult> makeFencedExecutionResult(
+        const nn::SyncFence& syncFence, nn::ExecuteFencedInfoCallback executeFencedInfoCallback) {
+    ndk::ScopedFileDescriptor fileDescriptor;
+    if (syncFence.hasFd()) {
+        auto uniqueFd = NN_TRY(nn::dupFd(syncFence.getFd()));
+        fileDescriptor = ndk::ScopedFileDescriptor(uniqueFd.release());
+    }
+
+    return FencedExecutionResult{.callback = ndk::SharedRefBase::make<FencedExecutionCallback>(
+                                         std::move(executeFencedInfoCallback)),
+                                 .syncFence = std::move(fileDescriptor)};
+}
+
 nn::Duration makeDuration(int64_t durationNs) {
     return nn::Duration(std::chrono::nanoseconds(durationNs));
 }
@@ -166,15 +181,7 @@ nn::GeneralResult<FencedExecutionResult> executeFenced(
             nnRequest, nnWaitFor, nnMeasureTiming, nnDeadline, nnLoopTimeoutDuration, nnDuration,
             nnHints, nnExtensionNameToPrefix));
 
-    ndk::ScopedFileDescriptor fileDescriptor;
-    if (syncFence.hasFd()) {
-        auto uniqueFd = NN_TRY(nn::dupFd(syncFence.getFd()));
-        fileDescriptor = ndk::ScopedFileDescriptor(uniqueFd.release());
-    }
-
-    return FencedExecutionResult{.callback = ndk::SharedRefBase::make<FencedExecutionCallback>(
-                                         std::move(executeFencedInfoCallback)),
-                                 .syncFence = std::move(fileDescriptor)};
+    return makeFencedExecutionResult(syncFence, std::move(executeFencedInfoCallback));
 }
 
 nn::GeneralResult<nn::SharedExecution> createReusableExecution(
@@ -221,15 +228,84 @@ nn::GeneralResult<FencedExecutionResult> executeFenced(
     auto [syncFence, executeFencedInfoCallback] =
             NN_TRY(execution.computeFenced(nnWaitFor, nnDeadline, nnDuration));
 
-    ndk::ScopedFileDescriptor fileDescriptor;
-    if (syncFence.hasFd()) {
-        auto uniqueFd = NN_TRY(nn::dupFd(syncFence.getFd()));
-        fileDescriptor = ndk::ScopedFileDescriptor(uniqueFd.release());
+    return makeFencedExecutionResult(syncFence, std::move(executeFencedInfoCallback));
+}
+
+// Returns an idle cached execution for the request, or creates a new one. Returns std::nullopt if
+// the request cannot be cached or the prepared model cannot create a reusable execution for it, in
+// which case the caller executes the request directly instead. A failed creation is remembered so
+// that it is not attempted again for the same request.
+std::optional<ExecutionCache::Entry> acquireCachedExecution(const nn::IPreparedModel& preparedModel,
+                                                            const ExecutionCache& executionCache,
+                                                            const Request& request,
+                                                            const ExecutionConfig& config) {
+    auto pools = ExecutionCache::identifyPools(request.pools);
+    if (!pools.has_value()) {
+        return std::nullopt;
+    }
+    if (auto entry = executionCache.acquire(request, *pools, config)) {
+        return entry;
+    }
+    if (executionCache.isUncacheable(request, *pools, config)) {
+        return std::nullopt;
     }
 
-    return FencedExecutionResult{.callback = ndk::SharedRefBase::make<FencedExecutionCallback>(
-                                         std::move(executeFencedInfoCallback)),
-                                 .syncFence = std::move(fileDescriptor)};
+    auto key = ExecutionCache::Key{.inputs = request.inputs,
+                                   .outputs = request.outputs,
+                                   .pools = std::move(pools).value(),
+                                   .config = config};
+    auto execution = createReusableExecution(preparedModel, request, config.measureTiming,
+                                             config.loopTimeoutDurationNs, config.executionHints,
+                                             config.extensionNameToPrefix);
+    if (!execution.has_value()) {
+        executionCache.markUncacheable(std::move(key));
+        return std::nullopt;
+    }
+    return ExecutionCache::Entry{.key = std::move(key), .execution = std::move(execution).value()};
+}
+
+nn::ExecutionResult<ExecutionResult> executeSynchronously(const nn::IPreparedModel& preparedModel,
+                                                          const ExecutionCache& executionCache,
+                                                          const Request& request,
+                                                          const ExecutionConfig& config,
+                                                          int64_t deadlineNs) {
+    auto entry = acquireCachedExecution(preparedModel, executionCache, request, config);
+    if (!entry.has_value()) {
+        return executeSynchronously(preparedModel, request, config.measureTiming, deadlineNs,
+                                    config.loopTimeoutDurationNs, config.executionHints,
+                                    config.extensionNameToPrefix);
+    }
+
+    auto result = executeSynchronously(*entry->execution, deadlineNs);
+    if (result.has_value()) {
+        executionCache.release(std::move(entry).value());
+    }
+    return result;
+}
+
+nn::GeneralResult<FencedExecutionResult> executeFenced(
+        const nn::IPreparedModel& preparedModel, const ExecutionCache& executionCache,
+        const Request& request, const std::vector<ndk::ScopedFileDescriptor>& waitFor,
+        const ExecutionConfig& config, int64_t deadlineNs, int64_t durationNs) {
+    auto entry = acquireCachedExecution(preparedModel, executionCache, request, config);
+    if (!entry.has_value()) {
+        return executeFenced(preparedModel, request, waitFor, config.measureTiming, deadlineNs,
+                             config.loopTimeoutDurationNs, durationNs, config.executionHints,
+                             config.extensionNameToPrefix);
+    }
+
+    const auto nnWaitFor = NN_TRY(convertSyncFences(waitFor));
+    const auto nnDeadline = NN_TRY(makeOptionalTimePoint(deadlineNs));
+    const auto nnDuration = NN_TRY(makeOptionalDuration(durationNs));
+
+    auto [syncFence, executeFencedInfoCallback] =
+            NN_TRY(entry->execution->computeFenced(nnWaitFor, nnDeadline, nnDuration));
+
+    // The execution is not reused until the fenced computation has finished.
+    entry->syncFence = syncFence;
+    executionCache.release(std::move(entry).value());
+
+    return makeFencedExecutionResult(syncFence, std::move(executeFencedInfoCallback));
 }
 
 }  // namespace
@@ -243,8 +319,10 @@ ndk::ScopedAStatus PreparedModel::executeSynchronously(const Request& request, b
                                                        int64_t deadlineNs,
                                                        int64_t loopTimeoutDurationNs,
                                                        ExecutionResult* executionResult) {
-    auto result = adapter::executeSynchronously(*kPreparedModel, request, measureTiming, deadlineNs,
-                                                loopTimeoutDurationNs, {}, {});
+    const auto config = ExecutionConfig{.measureTiming = measureTiming,
+                                        .loopTimeoutDurationNs = loopTimeoutDurationNs};
+    auto result = adapter::executeSynchronously(*kPreparedModel, kExecutionCache, request, config,
+                                                deadlineNs);
     if (!result.has_value()) {
         const auto& [message, code, _] = result.error();
         const auto aidlCode = utils::convert(code).value_or(ErrorStatus::GENERAL_FAILURE);
@@ -259,8 +337,10 @@ ndk::ScopedAStatus PreparedModel::executeFenced(
         const Request& request, const std::vector<ndk::ScopedFileDescriptor>& waitFor,
         bool measureTiming, int64_t deadlineNs, int64_t loopTimeoutDurationNs, int64_t durationNs,
         FencedExecutionResult* executionResult) {
-    auto result = adapter::executeFenced(*kPreparedModel, request, waitFor, measureTiming,
-                                         deadlineNs, loopTimeoutDurationNs, durationNs, {}, {});
+    const auto config = ExecutionConfig{.measureTiming = measureTiming,
+                                        .loopTimeoutDurationNs = loopTimeoutDurationNs};
+    auto result = adapter::executeFenced(*kPreparedModel, kExecutionCache, request, waitFor, config,
+                                         deadlineNs, durationNs);
     if (!result.has_value()) {
         const auto& [message, code] = result.error();
         const auto aidlCode = utils::convert(code).value_or(ErrorStatus::GENERAL_FAILURE);
@@ -275,9 +355,8 @@ ndk::ScopedAStatus PreparedModel::executeSynchronouslyWithConfig(const Request&
                                                                  const ExecutionConfig& config,
                                                                  int64_t deadlineNs,
                                                                  ExecutionResult* executionResult) {
-    auto result = adapter::executeSynchronously(
-            *kPreparedModel, request, config.measureTiming, deadlineNs,
-            config.loopTimeoutDurationNs, config.executionHints, config.extensionNameToPrefix);
+    auto result = adapter::executeSynchronously(*kPreparedModel, kExecutionCache, request, config,
+                                                deadlineNs);
     if (!result.has_value()) {
         const auto& [message, code, _] = result.error();
         const auto aidlCode = utils::convert(code).value_or(ErrorStatus::GENERAL_FAILURE);
@@ -292,9 +371,8 @@ ndk::ScopedAStatus PreparedModel::executeFencedWithConfig(
         const Request& request, const std::vector<ndk::ScopedFileDescriptor>& waitFor,
         const ExecutionConfig& config, int64_t deadlineNs, int64_t durationNs,
         FencedExecutionResult* executionResult) {
-    auto result = adapter::executeFenced(*kPreparedModel, request, waitFor, config.measureTiming,
-                                         deadlineNs, config.loopTimeoutDurationNs, durationNs,
-                                         config.executionHints, config.extensionNameToPrefix);
+    auto result = adapter::executeFenced(*kPreparedModel, kExecutionCache, request, waitFor, config,
+                                         deadlineNs, durationNs);
     if (!result.has_value()) {
         const auto& [message, code] = result.error();
         const auto aidlCode = utils::convert(code).value_or(ErrorStatus::GENERAL_FAILURE);
@@ -321,6 +399,10 @@ nn::SharedPreparedModel PreparedModel::getUnderlyingPreparedModel() const {
     return kPreparedModel;
 }
 
+ExecutionCache::Statistics PreparedModel::getExecutionCacheStatistics() const {
+    return kExecutionCache.getStatistics();
+}
+
 ndk::ScopedAStatus PreparedModel::createReusableExecution(const Request& request,
                                                           const ExecutionConfig& config,
                                                           std::shared_ptr<IExecution>* execution) {
@@ -0,0 +1,257 @@
+/*
+ * Copyright (C) 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <aidl/android/hardware/common/Ashmem.h>
+#include <aidl/android/hardware/neuralnetworks/ExecutionResult.h>
+#include <aidl/android/hardware/neuralnetworks/Memory.h>
+#include <aidl/android/hardware/neuralnetworks/Request.h>
+#include <aidl/android/hardware/neuralnetworks/RequestArgument.h>
+#include <aidl/android/hardware/neuralnetworks/RequestMemoryPool.h>
+#include <android-base/unique_fd.h>
+#include <android/binder_auto_utils.h>
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+#include <nnapi/Types.h>
+#include <nnapi/hal/aidl/ExecutionCache.h>
+#include <nnapi/hal/aidl/PreparedModel.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include "MockExecution.h"
+#include "MockPreparedModel.h"
+
+namespace aidl::android::hardware::neuralnetworks::adapter {
+namespace {
+
+namespace nn = ::android::nn;
+
+using ::testing::_;
+using ::testing::Return;
+
+constexpr int64_t kPoolSize = 64;
+
+const auto kReturnGeneralFailure = [](const auto&... /*args*/) {
+    return nn::error(nn::ErrorStatus::GENERAL_FAILURE);
+};
+const auto kNoExecutionError =
+        nn::ExecutionResult<std::pair<std::vector<nn::OutputShape>, nn::Timing>>{};
+
+// Creates a request with one input and one output in a new memfd-backed pool.
+Request makeRequest() {
+    ndk::ScopedFileDescriptor fd(memfd_create("ExecutionCacheTest", MFD_CLOEXEC));
+    EXPECT_GE(fd.get(), 0);
+    EXPECT_EQ(ftruncate(fd.get(), kPoolSize), 0);
+
+    Request request;
+    request.inputs.push_back({.location = {.poolIndex = 0, .offset = 0, .length = kPoolSize / 2}});
+    request.outputs.push_back(
+            {.location = {.poolIndex = 0, .offset = kPoolSize / 2, .length = kPoolSize / 2}});
+    request.pools.push_back(RequestMemoryPool::make<RequestMemoryPool::Tag::pool>(
+            Memory::make<Memory::Tag::ashmem>(
+                    common::Ashmem{.fd = std::move(fd), .size = kPoolSize})));
+    return request;
+}
+
+// Returns a copy of the request whose pools refer to the same files through new descriptors, as
+// they arrive on every binder call.
+Request copyRequest(const Request& request) {
+    Request copy{.inputs = request.inputs, .outputs = request.outputs};
+    for (const auto& pool : request.pools) {
+        const auto& ashmem = pool.get<RequestMemoryPool::Tag::pool>().get<Memory::Tag::ashmem>();
+        copy.pools.push_back(RequestMemoryPool::make<RequestMemoryPool::Tag::pool>(
+                Memory::make<Memory::Tag::ashmem>(common::Ashmem{
+                        .fd = ndk::ScopedFileDescriptor(dup(ashmem.fd.get())),
+                        .size = ashmem.size})));
+    }
+    return copy;
+}
+
+// Creates a request with one input and one output in the driver-managed buffer with `token`.
+Request makeTokenRequest(int32_t token) {
+    Request request;
+    request.inputs.push_back({.location = {.poolIndex = 0, .offset = 0, .length = kPoolSize / 2}});
+    request.outputs.push_back(
+            {.location = {.poolIndex = 0, .offset = kPoolSize / 2, .length = kPoolSize / 2}});
+    request.pools.push_back(RequestMemoryPool::make<RequestMemoryPool::Tag::token>(token));
+    return request;
+}
+
+ExecutionCache::Entry makeEntry(const Request& request) {
+    return {.key = {.inputs = request.inputs,
+                    .outputs = request.outputs,
+                    .pools = ExecutionCache::identifyPools(request.pools).value()},
+            .execution = std::make_shared<const nn::MockExecution>()};
+}
+
+std::optional<ExecutionCache::Entry> acquire(const ExecutionCache& cache, const Request& request) {
+    return cache.acquire(request, ExecutionCache::identifyPools(request.pools).value(), {});
+}
+
+}  // namespace
+
+TEST(ExecutionCacheTest, samePoolsThroughNewDescriptorsHit) {
+    // setup test
+    const ExecutionCache cache;
+    const auto request = makeRequest();
+    cache.release(makeEntry(request));
+
+    // run test
+    const auto entry = acquire(cache, copyRequest(request));
+
+    // verify result
+    EXPECT_TRUE(entry.has_value());
+    EXPECT_EQ(cache.getStatistics().hits, 1u);
+}
+
+TEST(ExecutionCacheTest, differentPoolWithSameLayoutMisses) {
+    // setup test
+    const ExecutionCache cache;
+    cache.release(makeEntry(makeRequest()));
+
+    // run test
+    const auto entry = acquire(cache, makeRequest());
+
+    // verify result
+    EXPECT_FALSE(entry.has_value());
+    EXPECT_EQ(cache.getStatistics().misses, 1u);
+}
+
+TEST(ExecutionCacheTest, entryWithActiveFenceIsSkipped) {
+    // setup test
+    int fds[2];
+    ASSERT_EQ(pipe(fds), 0);
+    const ::android::base::unique_fd writeFd(fds[1]);
+    const auto handle = std::make_shared<const nn::Handle>(::android::base::unique_fd(fds[0]));
+    const ExecutionCache cache;
+    const auto request = makeRequest();
+    auto entry = makeEntry(request);
+    entry.syncFence = nn::SyncFence::create(handle).value();
+    cache.release(std::move(entry));
+
+    // run test
+    const auto whileActive = acquire(cache, request);
+    ASSERT_EQ(write(writeFd.get(), "", 1), 1);
+    const auto onceSignaled = acquire(cache, request);
+
+    // verify result
+    EXPECT_FALSE(whileActive.has_value());
+    EXPECT_TRUE(onceSignaled.has_value());
+}
+
+TEST(ExecutionCacheTest, leastRecentlyUsedEntryIsEvicted) {
+    // setup test
+    const ExecutionCache cache(/*capacity=*/2);
+    const auto first = makeRequest();
+    const auto second = makeRequest();
+    const auto third = makeRequest();
+    cache.release(makeEntry(first));
+    cache.release(makeEntry(second));
+    cache.release(makeEntry(third));
+
+    // run test
+    const auto evicted = acquire(cache, first);
+    const auto kept = acquire(cache, second);
+
+    // verify result
+    EXPECT_FALSE(evicted.has_value());
+    EXPECT_TRUE(kept.has_value());
+}
+
+TEST(ExecutionCacheTest, failedComputeDropsExecution) {
+    // setup test
+    const auto mockPreparedModel = std::make_shared<const nn::MockPreparedModel>();
+    const auto failingExecution = std::make_shared<const nn::MockExecution>();
+    const auto workingExecution = std::make_shared<const nn::MockExecution>();
+    EXPECT_CALL(*mockPreparedModel, createReusableExecution(_, _, _, _, _))
+            .Times(2)
+            .WillOnce(Return(failingExecution))
+            .WillOnce(Return(workingExecution));
+    EXPECT_CALL(*failingExecution, compute(_)).Times(1).WillOnce(kReturnGeneralFailure);
+    EXPECT_CALL(*workingExecution, compute(_)).Times(2).WillRepeatedly(Return(kNoExecutionError));
+    const auto preparedModel = ndk::SharedRefBase::make<PreparedModel>(mockPreparedModel);
+    const auto request = makeRequest();
+    ExecutionResult executionResult;
+
+    // run test
+    const auto failed = preparedModel->executeSynchronously(request, false, -1, -1,
+                                                            &executionResult);
+    const auto recreated = preparedModel->executeSynchronously(copyRequest(request), false, -1,
+                                                               -1, &executionResult);
+    const auto reused = preparedModel->executeSynchronously(copyRequest(request), false, -1, -1,
+                                                            &executionResult);
+
+    // verify result
+    EXPECT_FALSE(failed.isOk());
+    EXPECT_TRUE(recreated.isOk());
+    EXPECT_TRUE(reused.isOk());
+    EXPECT_EQ(preparedModel->getExecutionCacheStatistics().hits, 1u);
+}
+
+TEST(ExecutionCacheTest, failedCreationIsNotRetried) {
+    // setup test
+    const auto mockPreparedModel = std::make_shared<const nn::MockPreparedModel>();
+    EXPECT_CALL(*mockPreparedModel, createReusableExecution(_, _, _, _, _))
+            .Times(1)
+            .WillOnce(kReturnGeneralFailure);
+    EXPECT_CALL(*mockPreparedModel, execute(_, _, _, _, _, _))
+            .Times(2)
+            .WillRepeatedly(Return(kNoExecutionError));
+    const auto preparedModel = ndk::SharedRefBase::make<PreparedModel>(mockPreparedModel);
+    const auto request = makeRequest();
+    ExecutionResult executionResult;
+
+    // run test
+    const auto first = preparedModel->executeSynchronously(request, false, -1, -1,
+                                                           &executionResult);
+    const auto second = preparedModel->executeSynchronously(copyRequest(request), false, -1, -1,
+                                                            &executionResult);
+
+    // verify result
+    EXPECT_TRUE(first.isOk());
+    EXPECT_TRUE(second.isOk());
+}
+
+TEST(ExecutionCacheTest, reusedBufferTokenIsNotCached) {
+    // setup test
+    constexpr int32_t kToken = 1;
+    const auto mockPreparedModel = std::make_shared<const nn::MockPreparedModel>();
+    EXPECT_CALL(*mockPreparedModel, createReusableExecution(_, _, _, _, _)).Times(0);
+    EXPECT_CALL(*mockPreparedModel, execute(_, _, _, _, _, _))
+            .Times(2)
+            .WillRepeatedly(Return(kNoExecutionError));
+    const auto preparedModel = ndk::SharedRefBase::make<PreparedModel>(mockPreparedModel);
+    ExecutionResult executionResult;
+
+    // run test
+    const auto beforeRelease = preparedModel->executeSynchronously(makeTokenRequest(kToken), false,
+                                                                   -1, -1, &executionResult);
+    // The buffer behind the token is released and the driver hands the token out again for a new
+    // buffer, so the same request now refers to different memory.
+    const auto afterReuse = preparedModel->executeSynchronously(makeTokenRequest(kToken), false,
+                                                                -1, -1, &executionResult);
+
+    // verify result
+    EXPECT_FALSE(ExecutionCache::identifyPools(makeTokenRequest(kToken).pools).has_value());
+    EXPECT_TRUE(beforeRelease.isOk());
+    EXPECT_TRUE(afterReuse.isOk());
+    EXPECT_EQ(preparedModel->getExecutionCacheStatistics().hits, 0u);
+}
+
+}  // namespace aidl::android::hardware::neuralnetworks::adapter
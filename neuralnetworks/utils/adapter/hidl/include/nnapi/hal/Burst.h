@@ -111,9 +111,10 @@ class Burst : public V1_2::IBurstContext {
      *     execution.
      * @param burstExecutor Object which maintains a local cache of the memory pools and executes
      *     using the cached memory pools.
-     * @param pollingTimeWindow How much time (in microseconds) the Burst is allowed to poll the FMQ
+     * @param pollingTimeWindow The most time (in microseconds) the Burst is allowed to poll the FMQ
      *     before waiting on the blocking futex. Polling may result in lower latencies at the
-     *     potential cost of more power usage.
+     *     potential cost of more power usage. The actual window adapts to how fast the requests
+     *     arrive, see V1_2::utils::AdaptivePollingTimeWindow.
      * @return V1_2::IBurstContext Handle to the burst context.
      */
     static nn::GeneralResult<sp<Burst>> create(
@@ -133,6 +134,9 @@ class Burst : public V1_2::IBurstContext {
     // V1_2::IBurstContext::freeMemory for more information.
     Return<void> freeMemory(int32_t slot) override;
 
+    // How the requests have been waited for, see V1_2::utils::AdaptivePollingTimeWindow.
+    V1_2::utils::PollingStatistics getPollingStatistics() const;
+
   private:
     // Work loop that will continue processing execution requests until the Burst object is freed.
     void task();
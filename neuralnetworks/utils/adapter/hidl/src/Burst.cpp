@@ -191,6 +191,10 @@ Return<void> Burst::freeMemory(int32_t slot) {
     return Void();
 }
 
+V1_2::utils::PollingStatistics Burst::getPollingStatistics() const {
+    return mRequestChannelReceiver->getPollingStatistics();
+}
+
 void Burst::task() {
     // loop until the burst object is being destroyed
     while (!mTeardown) {
@@ -0,0 +1,83 @@
+/*
+ * Copyright (C) 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Benchmarks for the per-execution cost of relocating the pointer arguments of a small-tensor
+// request into shared memory, with and without a RelocationArenaPool. Each iteration does the
+// work the HAL adapters do around an execution: convert the request, flush the inputs into shared
+// memory, flush the outputs back out of it, then destroy the relocation.
+
+#include <benchmark/benchmark.h>
+#include <nnapi/TypeUtils.h>
+#include <nnapi/Types.h>
+#include <nnapi/hal/CommonUtils.h>
+#include <nnapi/hal/RelocationArenaPool.h>
+
+#include <optional>
+#include <vector>
+
+namespace android::hardware::neuralnetworks::utils {
+namespace {
+
+using ::benchmark::State;
+
+// Number of elements in each input and output tensor.
+constexpr size_t kTensorSize = 16;
+
+// Converts a request with 'state.range(0)' small input and output tensors, using a pool if
+// 'state.range(1)' is non-zero.
+void BM_SmallTensorRelocation(State& state) {
+    const size_t operandCount = state.range(0);
+    const bool usePool = state.range(1) != 0;
+    const auto pool = usePool ? RelocationArenaPool::create() : nullptr;
+
+    std::vector<std::vector<float>> inputs(operandCount, std::vector<float>(kTensorSize, 1.0f));
+    std::vector<std::vector<float>> outputs(operandCount, std::vector<float>(kTensorSize));
+    nn::Request request;
+    const auto length = static_cast<uint32_t>(kTensorSize * sizeof(float));
+    for (size_t i = 0; i < operandCount; ++i) {
+        const nn::DataLocation inputLocation = {
+                .pointer = static_cast<const void*>(inputs[i].data()), .length = length};
+        const nn::DataLocation outputLocation = {.pointer = static_cast<void*>(outputs[i].data()),
+                                                 .length = length};
+        request.inputs.push_back(
+                {.lifetime = nn::Request::Argument::LifeTime::POINTER, .location = inputLocation});
+        request.outputs.push_back(
+                {.lifetime = nn::Request::Argument::LifeTime::POINTER, .location = outputLocation});
+    }
+
+    for (auto _ : state) {
+        std::optional<nn::Request> maybeRequestInShared;
+        RequestRelocation relocation;
+        const auto result = convertRequestFromPointerToShared(
+                &request, nn::kDefaultRequestMemoryAlignment, nn::kMinMemoryPadding,
+                &maybeRequestInShared, &relocation, pool.get());
+        if (!result.has_value()) {
+            state.SkipWithError("failed to relocate the request");
+            break;
+        }
+        relocation.input->flush();
+        relocation.output->flush();
+    }
+}
+
+BENCHMARK(BM_SmallTensorRelocation)
+        ->ArgsProduct({{1, 4, 16}, {0, 1}})
+        ->ArgNames({"operands", "pooled"});
+
+}  // namespace
+}  // namespace android::hardware::neuralnetworks::utils
+
+BENCHMARK_MAIN();
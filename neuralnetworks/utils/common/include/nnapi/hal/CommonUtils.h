@@ -22,8 +22,12 @@
 #include <nnapi/Types.h>
 
 #include <functional>
+#include <memory>
+#include <optional>
 #include <vector>
 
+#include "RelocationArenaPool.h"
+
 // Shorthands
 namespace android::hardware::neuralnetworks {
 namespace hal = ::android::hardware::neuralnetworks;
@@ -48,10 +52,29 @@ nn::Capabilities::OperandPerformanceTable makeQuantized8PerformanceConsistentWit
         const nn::Capabilities::PerformanceInfo& float32Performance,
         const nn::Capabilities::PerformanceInfo& quantized8Performance);
 
-using nn::convertRequestFromPointerToShared;
 using nn::flushDataFromPointerToShared;
 using nn::hasNoPointerData;
-using nn::RequestRelocation;
+
+// Same as nn::RequestRelocation, but also holds the arenas that the pointer arguments were
+// relocated into. The arenas are returned to their pool when the relocation is destroyed.
+struct RequestRelocation {
+    std::optional<RelocationArenaPool::Lease> inputArena;
+    std::optional<RelocationArenaPool::Lease> outputArena;
+    std::unique_ptr<nn::InputRelocationTracker> input;
+    std::unique_ptr<nn::OutputRelocationTracker> output;
+};
+
+// Same as nn::convertRequestFromPointerToShared, but relocates the pointer arguments into arenas
+// leased from `pool`, or into newly allocated shared memory if `pool` is nullptr.
+nn::GeneralResult<std::reference_wrapper<const nn::Request>> convertRequestFromPointerToShared(
+        const nn::Request* request, uint32_t alignment, uint32_t padding,
+        std::optional<nn::Request>* maybeRequestInSharedOut, RequestRelocation* relocationOut,
+        RelocationArenaPool* pool);
+
+// Relocates the pointer arguments into arenas leased from RelocationArenaPool::getDefault().
+nn::GeneralResult<std::reference_wrapper<const nn::Request>> convertRequestFromPointerToShared(
+        const nn::Request* request, uint32_t alignment, uint32_t padding,
+        std::optional<nn::Request>* maybeRequestInSharedOut, RequestRelocation* relocationOut);
 
 }  // namespace android::hardware::neuralnetworks::utils
 
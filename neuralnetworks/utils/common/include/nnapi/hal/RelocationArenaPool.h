@@ -0,0 +1,130 @@
+/*
+ * Copyright (C) 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_HARDWARE_INTERFACES_NEURALNETWORKS_UTILS_COMMON_RELOCATION_ARENA_POOL_H
+#define ANDROID_HARDWARE_INTERFACES_NEURALNETWORKS_UTILS_COMMON_RELOCATION_ARENA_POOL_H
+
+#include <android-base/thread_annotations.h>
+#include <nnapi/Result.h>
+#include <nnapi/Types.h>
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace android::hardware::neuralnetworks::utils {
+
+/**
+ * Pool of mapped shared memory arenas that the pointer arguments of a request are relocated into.
+ *
+ * Relocating the pointer arguments of a request otherwise creates and maps new shared memory on
+ * every execution. The pool instead keeps released arenas in power-of-two size classes and hands
+ * them out again, so repeated executions of small requests reuse the same memory. Reusing the same
+ * memory object also lets the burst memory caches hit instead of sending the memory again.
+ *
+ * Arenas are handed out as a Lease, which returns the arena to the pool when it is destroyed.
+ * Requests larger than kMaxSizeClass are not pooled. The released arenas kept by the pool are
+ * bounded both per size class and in total bytes, so a burst of large requests does not pin memory
+ * for the rest of the process lifetime.
+ *
+ * A leased arena must not be released while a driver might still access it, e.g. before the sync
+ * fence of a fenced execution using it has signaled, as the next lease of the arena overwrites it.
+ */
+class RelocationArenaPool final : public std::enable_shared_from_this<RelocationArenaPool> {
+    struct PrivateConstructorTag {};
+
+  public:
+    static constexpr size_t kMinSizeClass = 4096;
+    static constexpr size_t kMaxSizeClass = 1024 * 1024;
+    static constexpr size_t kDefaultMaxArenasPerSizeClass = 8;
+    static constexpr size_t kDefaultMaxFreeBytes = 2 * 1024 * 1024;
+
+    struct Arena {
+        nn::SharedMemory memory;
+        nn::Mapping mapping;
+    };
+
+    class Lease {
+      public:
+        Lease(std::weak_ptr<RelocationArenaPool> pool, size_t sizeClassIndex, Arena arena);
+        ~Lease();
+
+        Lease(Lease&& other) noexcept;
+        Lease& operator=(Lease&& other) noexcept;
+        Lease(const Lease&) = delete;
+        Lease& operator=(const Lease&) = delete;
+
+        const nn::SharedMemory& getMemory() const;
+        const nn::Mapping& getMapping() const;
+
+      private:
+        void release();
+
+        std::weak_ptr<RelocationArenaPool> mPool;
+        size_t mSizeClassIndex;
+        Arena mArena;
+    };
+
+    struct Statistics {
+        uint64_t hits = 0;
+        uint64_t misses = 0;
+    };
+
+    static std::shared_ptr<RelocationArenaPool> create(
+            size_t maxArenasPerSizeClass = kDefaultMaxArenasPerSizeClass,
+            size_t maxFreeBytes = kDefaultMaxFreeBytes);
+
+    /**
+     * Returns the process-wide pool used by the HAL adapters.
+     */
+    static const std::shared_ptr<RelocationArenaPool>& getDefault();
+
+    /**
+     * Creates an arena of at least `size` bytes that does not belong to any pool.
+     */
+    static nn::GeneralResult<Lease> allocate(size_t size);
+
+    RelocationArenaPool(PrivateConstructorTag tag, size_t maxArenasPerSizeClass,
+                        size_t maxFreeBytes);
+
+    /**
+     * Leases an arena of at least `size` bytes, reusing a released arena of the same size class if
+     * one is available.
+     */
+    nn::GeneralResult<Lease> acquire(size_t size);
+
+    Statistics getStatistics() const;
+
+  private:
+    static constexpr size_t kNumberOfSizeClasses = 9;
+    static_assert(kMinSizeClass << (kNumberOfSizeClasses - 1) == kMaxSizeClass);
+
+    void release(size_t sizeClassIndex, Arena arena);
+
+    const size_t kMaxArenasPerSizeClass;
+    const size_t kMaxFreeBytes;
+    mutable std::mutex mMutex;
+    std::array<std::vector<Arena>, kNumberOfSizeClasses> mFreeArenas GUARDED_BY(mMutex);
+    size_t mFreeBytes GUARDED_BY(mMutex) = 0;
+    Statistics mStatistics GUARDED_BY(mMutex);
+};
+
+}  // namespace android::hardware::neuralnetworks::utils
+
+#endif  // ANDROID_HARDWARE_INTERFACES_NEURALNETWORKS_UTILS_COMMON_RELOCATION_ARENA_POOL_H
@@ -16,6 +16,8 @@
 
 #include "CommonUtils.h"
 
+#include "RelocationArenaPool.h"
+
 #include <android-base/logging.h>
 #include <nnapi/Result.h>
 #include <nnapi/SharedMemory.h>
@@ -26,11 +28,60 @@
 #include <algorithm>
 #include <any>
 #include <functional>
+#include <memory>
 #include <optional>
+#include <utility>
 #include <variant>
 #include <vector>
 
 namespace android::hardware::neuralnetworks::utils {
+namespace {
+
+size_t roundUp(size_t size, size_t multiple) {
+    CHECK_GT(multiple, 0u);
+    return (size + multiple - 1) / multiple * multiple;
+}
+
+// Moves the pointer arguments in `arguments` into pool `poolIndex`, laying them out the same way
+// nn::MutableMemoryBuilder does, and returns where each argument's data must be copied from or to.
+// `arenaSizeOut` is set to the size of the pool needed to hold all of the relocated arguments.
+template <typename PointerType>
+std::vector<nn::RelocationInfo<PointerType>> relocateArguments(
+        std::vector<nn::Request::Argument>* arguments, uint32_t poolIndex, uint32_t alignment,
+        uint32_t padding, size_t* arenaSizeOut) {
+    std::vector<nn::RelocationInfo<PointerType>> relocationInfos;
+    size_t arenaSize = 0;
+    for (auto& argument : *arguments) {
+        if (argument.lifetime != nn::Request::Argument::LifeTime::POINTER) {
+            continue;
+        }
+        const PointerType data = std::visit(
+                [](auto ptr) { return const_cast<void*>(static_cast<const void*>(ptr)); },
+                argument.location.pointer);
+        const size_t length = argument.location.length;
+        const size_t offset = roundUp(arenaSize, alignment);
+        const size_t paddedLength = roundUp(length, padding);
+        arenaSize = offset + paddedLength;
+
+        argument.lifetime = nn::Request::Argument::LifeTime::POOL;
+        argument.location = {.poolIndex = poolIndex,
+                             .offset = static_cast<uint32_t>(offset),
+                             .length = static_cast<uint32_t>(length),
+                             .padding = static_cast<uint32_t>(paddedLength - length)};
+        relocationInfos.push_back({.data = data, .length = length, .offset = offset});
+    }
+    *arenaSizeOut = arenaSize;
+    return relocationInfos;
+}
+
+nn::GeneralResult<RelocationArenaPool::Lease> leaseArena(RelocationArenaPool* pool, size_t size) {
+    if (pool == nullptr) {
+        return RelocationArenaPool::allocate(size);
+    }
+    return pool->acquire(size);
+}
+
+}  // namespace
 
 nn::Capabilities::OperandPerformanceTable makeQuantized8PerformanceConsistentWithP(
         const nn::Capabilities::PerformanceInfo& float32Performance,
@@ -51,4 +102,57 @@ nn::Capabilities::OperandPerformanceTable makeQuantized8PerformanceConsistentWit
             .value();
 }
 
+nn::GeneralResult<std::reference_wrapper<const nn::Request>> convertRequestFromPointerToShared(
+        const nn::Request* request, uint32_t alignment, uint32_t padding,
+        std::optional<nn::Request>* maybeRequestInSharedOut, RequestRelocation* relocationOut,
+        RelocationArenaPool* pool) {
+    CHECK(request != nullptr);
+    CHECK(maybeRequestInSharedOut != nullptr);
+    CHECK(relocationOut != nullptr);
+
+    if (hasNoPointerData(*request)) {
+        return std::cref(*request);
+    }
+
+    auto& requestInShared = maybeRequestInSharedOut->emplace(*request);
+    RequestRelocation relocation;
+
+    // Change input pointers to shared memory.
+    size_t inputArenaSize = 0;
+    auto inputRelocationInfos = relocateArguments<const void*>(
+            &requestInShared.inputs, requestInShared.pools.size(), alignment, padding,
+            &inputArenaSize);
+    if (!inputRelocationInfos.empty()) {
+        auto arena = NN_TRY(leaseArena(pool, inputArenaSize));
+        requestInShared.pools.push_back(arena.getMemory());
+        relocation.input = std::make_unique<nn::InputRelocationTracker>(
+                std::move(inputRelocationInfos), arena.getMemory(), arena.getMapping());
+        relocation.inputArena = std::move(arena);
+    }
+
+    // Change output pointers to shared memory.
+    size_t outputArenaSize = 0;
+    auto outputRelocationInfos = relocateArguments<void*>(
+            &requestInShared.outputs, requestInShared.pools.size(), alignment, padding,
+            &outputArenaSize);
+    if (!outputRelocationInfos.empty()) {
+        auto arena = NN_TRY(leaseArena(pool, outputArenaSize));
+        requestInShared.pools.push_back(arena.getMemory());
+        relocation.output = std::make_unique<nn::OutputRelocationTracker>(
+                std::move(outputRelocationInfos), arena.getMemory(), arena.getMapping());
+        relocation.outputArena = std::move(arena);
+    }
+
+    *relocationOut = std::move(relocation);
+    return std::cref(requestInShared);
+}
+
+nn::GeneralResult<std::reference_wrapper<const nn::Request>> convertRequestFromPointerToShared(
+        const nn::Request* request, uint32_t alignment, uint32_t padding,
+        std::optional<nn::Request>* maybeRequestInSharedOut, RequestRelocation* relocationOut) {
+    return convertRequestFromPointerToShared(request, alignment, padding, maybeRequestInSharedOut,
+                                             relocationOut,
+                                             RelocationArenaPool::getDefault().get());
+}
+
 }  // namespace android::hardware::neuralnetworks::utils
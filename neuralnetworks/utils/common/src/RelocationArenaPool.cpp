@@ -0,0 +1,147 @@
+/*
+ * Copyright (C) 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "RelocationArenaPool.h"
+
+#include <android-base/logging.h>
+#include <nnapi/Result.h>
+#include <nnapi/SharedMemory.h>
+#include <nnapi/Types.h>
+
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+namespace android::hardware::neuralnetworks::utils {
+namespace {
+
+constexpr size_t kNotPooled = std::numeric_limits<size_t>::max();
+
+nn::GeneralResult<RelocationArenaPool::Arena> createArena(size_t size) {
+    auto memory = NN_TRY(nn::createSharedMemory(size));
+    auto mapping = NN_TRY(nn::map(memory));
+    return RelocationArenaPool::Arena{.memory = std::move(memory), .mapping = std::move(mapping)};
+}
+
+}  // namespace
+
+RelocationArenaPool::Lease::Lease(std::weak_ptr<RelocationArenaPool> pool, size_t sizeClassIndex,
+                                  Arena arena)
+    : mPool(std::move(pool)), mSizeClassIndex(sizeClassIndex), mArena(std::move(arena)) {}
+
+RelocationArenaPool::Lease::~Lease() {
+    release();
+}
+
+RelocationArenaPool::Lease::Lease(Lease&& other) noexcept
+    : mPool(std::move(other.mPool)),
+      mSizeClassIndex(other.mSizeClassIndex),
+      mArena(std::move(other.mArena)) {
+    other.mPool.reset();
+}
+
+RelocationArenaPool::Lease& RelocationArenaPool::Lease::operator=(Lease&& other) noexcept {
+    if (this != &other) {
+        release();
+        mPool = std::move(other.mPool);
+        mSizeClassIndex = other.mSizeClassIndex;
+        mArena = std::move(other.mArena);
+        other.mPool.reset();
+    }
+    return *this;
+}
+
+const nn::SharedMemory& RelocationArenaPool::Lease::getMemory() const {
+    return mArena.memory;
+}
+
+const nn::Mapping& RelocationArenaPool::Lease::getMapping() const {
+    return mArena.mapping;
+}
+
+void RelocationArenaPool::Lease::release() {
+    if (const auto pool = mPool.lock()) {
+        pool->release(mSizeClassIndex, std::move(mArena));
+    }
+    mPool.reset();
+}
+
+std::shared_ptr<RelocationArenaPool> RelocationArenaPool::create(size_t maxArenasPerSizeClass,
+                                                                 size_t maxFreeBytes) {
+    return std::make_shared<RelocationArenaPool>(PrivateConstructorTag{}, maxArenasPerSizeClass,
+                                                 maxFreeBytes);
+}
+
+const std::shared_ptr<RelocationArenaPool>& RelocationArenaPool::getDefault() {
+    static const auto* const kPool = new std::shared_ptr<RelocationArenaPool>(create());
+    return *kPool;
+}
+
+nn::GeneralResult<RelocationArenaPool::Lease> RelocationArenaPool::allocate(size_t size) {
+    auto arena = NN_TRY(createArena(size));
+    return Lease({}, kNotPooled, std::move(arena));
+}
+
+RelocationArenaPool::RelocationArenaPool(PrivateConstructorTag /*tag*/,
+                                         size_t maxArenasPerSizeClass, size_t maxFreeBytes)
+    : kMaxArenasPerSizeClass(maxArenasPerSizeClass), kMaxFreeBytes(maxFreeBytes) {}
+
+nn::GeneralResult<RelocationArenaPool::Lease> RelocationArenaPool::acquire(size_t size) {
+    if (size > kMaxSizeClass) {
+        return allocate(size);
+    }
+
+    size_t sizeClassIndex = 0;
+    while ((kMinSizeClass << sizeClassIndex) < size) {
+        ++sizeClassIndex;
+    }
+
+    {
+        std::lock_guard guard(mMutex);
+        auto& freeArenas = mFreeArenas[sizeClassIndex];
+        if (!freeArenas.empty()) {
+            auto arena = std::move(freeArenas.back());
+            freeArenas.pop_back();
+            mFreeBytes -= kMinSizeClass << sizeClassIndex;
+            ++mStatistics.hits;
+            return Lease(weak_from_this(), sizeClassIndex, std::move(arena));
+        }
+        ++mStatistics.misses;
+    }
+
+    auto arena = NN_TRY(createArena(kMinSizeClass << sizeClassIndex));
+    return Lease(weak_from_this(), sizeClassIndex, std::move(arena));
+}
+
+RelocationArenaPool::Statistics RelocationArenaPool::getStatistics() const {
+    std::lock_guard guard(mMutex);
+    return mStatistics;
+}
+
+void RelocationArenaPool::release(size_t sizeClassIndex, Arena arena) {
+    CHECK_LT(sizeClassIndex, kNumberOfSizeClasses);
+    const size_t size = kMinSizeClass << sizeClassIndex;
+    std::lock_guard guard(mMutex);
+    auto& freeArenas = mFreeArenas[sizeClassIndex];
+    if (freeArenas.size() < kMaxArenasPerSizeClass && mFreeBytes + size <= kMaxFreeBytes) {
+        freeArenas.push_back(std::move(arena));
+        mFreeBytes += size;
+    }
+}
+
+}  // namespace android::hardware::neuralnetworks::utils
@@ -0,0 +1,180 @@
+/*
+ * Copyright (C) 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <gmock/gmock.h>
+#include <nnapi/TypeUtils.h>
+#include <nnapi/Types.h>
+#include <nnapi/hal/CommonUtils.h>
+#include <nnapi/hal/RelocationArenaPool.h>
+
+#include <cstring>
+#include <memory>
+#include <optional>
+#include <utility>
+#include <variant>
+#include <vector>
+
+namespace android::hardware::neuralnetworks::utils {
+namespace {
+
+constexpr size_t kSmallSize = 64;
+
+nn::Request makePointerRequest(const std::vector<float>* input, std::vector<float>* output) {
+    const auto inputLength = static_cast<uint32_t>(input->size() * sizeof(float));
+    const auto outputLength = static_cast<uint32_t>(output->size() * sizeof(float));
+    return {.inputs = {{.lifetime = nn::Request::Argument::LifeTime::POINTER,
+                        .location = {.pointer = static_cast<const void*>(input->data()),
+                                     .length = inputLength}}},
+            .outputs = {{.lifetime = nn::Request::Argument::LifeTime::POINTER,
+                         .location = {.pointer = static_cast<void*>(output->data()),
+                                      .length = outputLength}}}};
+}
+
+}  // namespace
+
+TEST(RelocationArenaPoolTest, releasedArenaIsReused) {
+    // setup test
+    const auto pool = RelocationArenaPool::create();
+    nn::SharedMemory memory = pool->acquire(kSmallSize).value().getMemory();
+
+    // run test
+    const auto lease = pool->acquire(kSmallSize).value();
+
+    // verify result
+    EXPECT_EQ(memory, lease.getMemory());
+    const auto statistics = pool->getStatistics();
+    EXPECT_EQ(1u, statistics.hits);
+    EXPECT_EQ(1u, statistics.misses);
+}
+
+TEST(RelocationArenaPoolTest, leasedArenaIsNotShared) {
+    // setup test
+    const auto pool = RelocationArenaPool::create();
+    const auto lease = pool->acquire(kSmallSize).value();
+
+    // run test
+    const auto otherLease = pool->acquire(kSmallSize).value();
+
+    // verify result
+    EXPECT_NE(lease.getMemory(), otherLease.getMemory());
+    EXPECT_EQ(0u, pool->getStatistics().hits);
+}
+
+TEST(RelocationArenaPoolTest, arenasAreGroupedBySizeClass) {
+    // setup test
+    const auto pool = RelocationArenaPool::create();
+    pool->acquire(kSmallSize).value();
+
+    // run test
+    const auto lease = pool->acquire(RelocationArenaPool::kMinSizeClass + 1).value();
+
+    // verify result
+    EXPECT_EQ(0u, pool->getStatistics().hits);
+    EXPECT_EQ(2 * RelocationArenaPool::kMinSizeClass, lease.getMemory()->size);
+}
+
+TEST(RelocationArenaPoolTest, largeArenaIsNotPooled) {
+    // setup test
+    const auto pool = RelocationArenaPool::create();
+    pool->acquire(RelocationArenaPool::kMaxSizeClass + 1).value();
+
+    // run test
+    pool->acquire(RelocationArenaPool::kMaxSizeClass + 1).value();
+
+    // verify result
+    const auto statistics = pool->getStatistics();
+    EXPECT_EQ(0u, statistics.hits);
+    EXPECT_EQ(0u, statistics.misses);
+}
+
+TEST(RelocationArenaPoolTest, freeArenasAreCappedInBytes) {
+    // setup test
+    const auto pool =
+            RelocationArenaPool::create(RelocationArenaPool::kDefaultMaxArenasPerSizeClass,
+                                        /*maxFreeBytes=*/RelocationArenaPool::kMinSizeClass);
+    {
+        const auto lease = pool->acquire(kSmallSize).value();
+        const auto otherLease = pool->acquire(kSmallSize).value();
+    }
+
+    // run test
+    const auto lease = pool->acquire(kSmallSize).value();
+    const auto otherLease = pool->acquire(kSmallSize).value();
+
+    // verify result
+    const auto statistics = pool->getStatistics();
+    EXPECT_EQ(1u, statistics.hits);
+    EXPECT_EQ(3u, statistics.misses);
+}
+
+TEST(RelocationArenaPoolTest, convertRequestFromPointerToShared) {
+    // setup test
+    const auto pool = RelocationArenaPool::create();
+    const std::vector<float> input = {1.0f, 2.0f, 3.0f, 4.0f};
+    std::vector<float> output(4, 0.0f);
+    const auto request = makePointerRequest(&input, &output);
+    std::optional<nn::Request> maybeRequestInShared;
+    RequestRelocation relocation;
+
+    // run test
+    const auto result = convertRequestFromPointerToShared(
+            &request, nn::kDefaultRequestMemoryAlignment, nn::kMinMemoryPadding,
+            &maybeRequestInShared, &relocation, pool.get());
+
+    // verify result
+    ASSERT_TRUE(result.has_value()) << "Failed with " << result.error().code << ": "
+                                    << result.error().message;
+    const nn::Request& requestInShared = result.value();
+    EXPECT_TRUE(hasNoPointerData(requestInShared));
+    ASSERT_EQ(2u, requestInShared.pools.size());
+    ASSERT_NE(nullptr, relocation.input);
+    ASSERT_NE(nullptr, relocation.output);
+    ASSERT_TRUE(relocation.inputArena.has_value());
+    relocation.input->flush();
+    const auto* arena = static_cast<const uint8_t*>(
+            std::get<void*>(relocation.inputArena->getMapping().pointer));
+    const auto& location = requestInShared.inputs[0].location;
+    EXPECT_EQ(0, std::memcmp(arena + location.offset, input.data(), location.length));
+}
+
+TEST(RelocationArenaPoolTest, relocationReturnsArenasToPool) {
+    // setup test
+    const auto pool = RelocationArenaPool::create();
+    const std::vector<float> input = {1.0f, 2.0f, 3.0f, 4.0f};
+    std::vector<float> output(4, 0.0f);
+    const auto request = makePointerRequest(&input, &output);
+    {
+        std::optional<nn::Request> maybeRequestInShared;
+        RequestRelocation relocation;
+        ASSERT_TRUE(convertRequestFromPointerToShared(
+                            &request, nn::kDefaultRequestMemoryAlignment, nn::kMinMemoryPadding,
+                            &maybeRequestInShared, &relocation, pool.get())
+                            .has_value());
+    }
+    std::optional<nn::Request> maybeRequestInShared;
+    RequestRelocation relocation;
+
+    // run test
+    const auto result = convertRequestFromPointerToShared(
+            &request, nn::kDefaultRequestMemoryAlignment, nn::kMinMemoryPadding,
+            &maybeRequestInShared, &relocation, pool.get());
+
+    // verify result
+    ASSERT_TRUE(result.has_value());
+    EXPECT_EQ(2u, pool->getStatistics().hits);
+}
+
+}  // namespace android::hardware::neuralnetworks::utils
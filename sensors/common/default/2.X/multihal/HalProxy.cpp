@@ -221,8 +221,10 @@ Return<Result> HalProxy::initializeCommon(
     disableAllSensors();
 
     // Clears the queue if any events were pending write before.
-    mPendingWriteEventsQueue = std::queue<std::pair<std::vector<V2_1::Event>, size_t>>();
-    mSizePendingWriteEventsQueue = 0;
+    {
+        std::lock_guard<std::mutex> lock(mEventQueueWriteMutex);
+        mPendingWriteEvents.clear();
+    }
 
     // Clears previously connected dynamic sensors
     mDynamicSensors.clear();
@@ -367,14 +369,11 @@ Return<void> HalProxy::debug(const hidl_handle& fd, const hidl_vec<hidl_string>&
            << " ms ago" << std::endl;
     // TODO(b/142969448): Add logging for history of wakelock acquisition per subhal.
     stream << "  Wakelock ref count: " << mWakelockRefCount << std::endl;
-    stream << "  # of events on pending write writes queue: " << mSizePendingWriteEventsQueue
+    stream << "  # of events on pending write writes queue: " << mPendingWriteEvents.size()
            << std::endl;
     stream << " Most events seen on pending write events queue: "
            << mMostEventsObservedPendingWriteEventsQueue << std::endl;
-    if (!mPendingWriteEventsQueue.empty()) {
-        stream << "  Size of events list on front of pending writes queue: "
-               << mPendingWriteEventsQueue.front().first.size() << std::endl;
-    }
+    stream << "  # of events dropped: " << mNumDroppedEvents.load() << std::endl;
     stream << "  # of non-dynamic sensors across all subhals: " << mSensors.size() << std::endl;
     stream << "  # of dynamic sensors across all subhals: " << mDynamicSensors.size() << std::endl;
     stream << "SubHals (" << mSubHalList.size() << "):" << std::endl;
@@ -541,6 +540,11 @@ void HalProxy::stopThreads() {
         mWakelockQueueFlag->wake(static_cast<uint32_t>(WakeLockQueueFlagBits::DATA_WRITTEN));
     }
     mWakelockCV.notify_one();
+    {
+        // So that the background thread could not miss the notification between checking
+        // mThreadsRun and waiting.
+        std::lock_guard<std::mutex> lock(mPendingWritesMutex);
+    }
     mEventQueueWriteCV.notify_one();
     if (mPendingWritesThread.joinable()) {
         mPendingWritesThread.join();
@@ -567,43 +571,31 @@ void HalProxy::startPendingWritesThread(HalProxy* halProxy) {
 }
 
 void HalProxy::handlePendingWrites() {
-    // TODO(b/143302327): Find a way to optimize locking strategy maybe using two mutexes instead of
-    // one.
-    std::unique_lock<std::mutex> lock(mEventQueueWriteMutex);
     while (mThreadsRun.load()) {
-        mEventQueueWriteCV.wait(
-                lock, [&] { return !mPendingWriteEventsQueue.empty() || !mThreadsRun.load(); });
+        {
+            std::unique_lock<std::mutex> lock(mPendingWritesMutex);
+            mEventQueueWriteCV.wait(
+                    lock, [&] { return !mPendingWriteEvents.empty() || !mThreadsRun.load(); });
+        }
         if (mThreadsRun.load()) {
-            std::vector<Event>& pendingWriteEvents = mPendingWriteEventsQueue.front().first;
-            size_t numWakeupEvents = mPendingWriteEventsQueue.front().second;
-            size_t eventQueueSize = mEventQueue->getQuantumCount();
-            size_t numToWrite = std::min(pendingWriteEvents.size(), eventQueueSize);
-            lock.unlock();
+            // Write the events straight out of the pending write events queue, a partial write
+            // only pops the events written.
+            size_t numToWrite;
+            const Event* pendingWriteEvents =
+                    mPendingWriteEvents.front(mEventQueue->getQuantumCount(), &numToWrite);
             if (!mEventQueue->writeBlocking(
-                        pendingWriteEvents.data(), numToWrite,
+                        pendingWriteEvents, numToWrite,
                         static_cast<uint32_t>(EventQueueFlagBits::EVENTS_READ),
                         static_cast<uint32_t>(EventQueueFlagBits::READ_AND_PROCESS),
                         kPendingWriteTimeoutNs, mEventQueueFlag)) {
                 ALOGE("Dropping %zu events after blockingWrite failed.", numToWrite);
+                mNumDroppedEvents += numToWrite;
+                size_t numWakeupEvents = countNumWakeupEvents(pendingWriteEvents, numToWrite);
                 if (numWakeupEvents > 0) {
-                    if (pendingWriteEvents.size() > eventQueueSize) {
-                        decrementRefCountAndMaybeReleaseWakelock(
-                                countNumWakeupEvents(pendingWriteEvents, eventQueueSize));
-                    } else {
-                        decrementRefCountAndMaybeReleaseWakelock(numWakeupEvents);
-                    }
+                    decrementRefCountAndMaybeReleaseWakelock(numWakeupEvents);
                 }
             }
-            lock.lock();
-            mSizePendingWriteEventsQueue -= numToWrite;
-            if (pendingWriteEvents.size() > eventQueueSize) {
-                // TODO(b/143302327): Check if this erase operation is too inefficient. It will copy
-                // all the events ahead of it down to fill gap off array at front after the erase.
-                pendingWriteEvents.erase(pendingWriteEvents.begin(),
-                                         pendingWriteEvents.begin() + eventQueueSize);
-            } else {
-                mPendingWriteEventsQueue.pop();
-            }
+            mPendingWriteEvents.pop(numToWrite);
         }
     }
 }
@@ -662,7 +654,7 @@ void HalProxy::postEventsToMessageQueue(const std::vector<Event>& events, size_t
     if (wakelock.isLocked()) {
         incrementRefCountAndMaybeAcquireWakelock(numWakeupEvents);
     }
-    if (mPendingWriteEventsQueue.empty()) {
+    if (mPendingWriteEvents.empty()) {
         numToWrite = std::min(events.size(), mEventQueue->availableToWrite());
         if (numToWrite > 0) {
             if (mEventQueue->write(events.data(), numToWrite)) {
@@ -675,15 +667,21 @@ void HalProxy::postEventsToMessageQueue(const std::vector<Event>& events, size_t
         }
     }
     size_t numLeft = events.size() - numToWrite;
-    if (numToWrite < events.size() &&
-        mSizePendingWriteEventsQueue + numLeft <= kMaxSizePendingWriteEventsQueue) {
-        std::vector<Event> eventsLeft(events.begin() + numToWrite, events.end());
-        mPendingWriteEventsQueue.push({eventsLeft, numWakeupEvents});
-        mSizePendingWriteEventsQueue += numLeft;
-        mMostEventsObservedPendingWriteEventsQueue =
-                std::max(mMostEventsObservedPendingWriteEventsQueue, mSizePendingWriteEventsQueue);
-        mEventQueueWriteCV.notify_one();
+    if (numLeft == 0) {
+        return;
+    }
+    if (!mPendingWriteEvents.push(events.data() + numToWrite, numLeft)) {
+        mNumDroppedEvents += numLeft;
+        return;
     }
+    mMostEventsObservedPendingWriteEventsQueue =
+            std::max(mMostEventsObservedPendingWriteEventsQueue, mPendingWriteEvents.size());
+    {
+        // So that the background thread could not miss the notification between checking the
+        // queue and waiting.
+        std::lock_guard<std::mutex> pendingWritesLock(mPendingWritesMutex);
+    }
+    mEventQueueWriteCV.notify_one();
 }
 
 bool HalProxy::incrementRefCountAndMaybeAcquireWakelock(size_t delta,
@@ -741,7 +739,7 @@ bool HalProxy::isSubHalIndexValid(int32_t sensorHandle) {
     return extractSubHalIndex(sensorHandle) < mSubHalList.size();
 }
 
-size_t HalProxy::countNumWakeupEvents(const std::vector<Event>& events, size_t n) {
+size_t HalProxy::countNumWakeupEvents(const Event* events, size_t n) {
     size_t numWakeupEvents = 0;
     for (size_t i = 0; i < n; i++) {
         int32_t sensorHandle = events[i].sensorHandle;
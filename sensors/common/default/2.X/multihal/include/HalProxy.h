@@ -19,6 +19,7 @@
 #include "EventMessageQueueWrapper.h"
 #include "HalProxyCallback.h"
 #include "ISensorsCallbackWrapper.h"
+#include "RingBuffer.h"
 #include "SubHalWrapper.h"
 #include "V2_0/ScopedWakelock.h"
 #include "V2_0/SubHal.h"
@@ -37,9 +38,7 @@
 #include <condition_variable>
 #include <map>
 #include <mutex>
-#include <queue>
 #include <thread>
-#include <utility>
 
 namespace android {
 namespace hardware {
@@ -201,24 +200,38 @@ class HalProxy : public V2_0::implementation::IScopedWakelockRefCounter,
     //! The bit mask used to get the subhal index from a sensor handle.
     static constexpr int32_t kSensorHandleSubHalIndexMask = 0xFF000000;
 
+    //! The max number of events allowed in the pending write events queue
+    static constexpr size_t kMaxSizePendingWriteEventsQueue = 100000;
+
+    //! The number of events the pending write events queue allocates storage for at a time
+    static constexpr size_t kPendingWriteEventsBlockSize = 1000;
+
     /**
-     * A FIFO queue of pairs of vector of events and the number of wakeup events in that vector
-     * which are waiting to be written to the events fmq in the background thread.
+     * A FIFO ring buffer of the events waiting to be written to the events fmq in the background
+     * thread. Events are pushed with mEventQueueWriteMutex held, and written to the fmq straight
+     * out of the buffer by the background thread, which pops them once the write is done.
      */
-    std::queue<std::pair<std::vector<Event>, size_t>> mPendingWriteEventsQueue;
+    RingBuffer<Event> mPendingWriteEvents{kMaxSizePendingWriteEventsQueue,
+                                          kPendingWriteEventsBlockSize};
 
     //! The most events observed on the pending write events queue for debug purposes.
     size_t mMostEventsObservedPendingWriteEventsQueue = 0;
 
-    //! The max number of events allowed in the pending write events queue
-    static constexpr size_t kMaxSizePendingWriteEventsQueue = 100000;
-
-    //! The number of events in the pending write events queue
-    size_t mSizePendingWriteEventsQueue = 0;
+    //! The number of events dropped because the pending write events queue was full or the
+    //! blocking write to the fmq failed.
+    std::atomic<uint64_t> mNumDroppedEvents = 0;
 
-    //! The mutex protecting writing to the fmq and the pending events queue
+    /**
+     * The mutex serializing the subhal threads writing to the fmq and pushing to the pending write
+     * events queue. The background thread does not take it, as it only writes to the fmq while
+     * the pending write events queue is not empty, and the subhal threads only write to the fmq
+     * while it is empty.
+     */
     std::mutex mEventQueueWriteMutex;
 
+    //! The mutex the background thread waits on for pending write events.
+    std::mutex mPendingWritesMutex;
+
     //! The condition variable waiting on pending write events to stack up
     std::condition_variable mEventQueueWriteCV;
 
@@ -357,14 +370,14 @@ class HalProxy : public V2_0::implementation::IScopedWakelockRefCounter,
     bool isSubHalIndexValid(int32_t sensorHandle);
 
     /**
-     * Count the number of wakeup events in the first n events of the vector.
+     * Count the number of wakeup events in the first n events of the array.
      *
-     * @param events The vector of Event objects.
+     * @param events The array of Event objects.
      * @param n The end index not inclusive of events to consider.
      *
      * @return The number of wakeup events of the considered events.
      */
-    size_t countNumWakeupEvents(const std::vector<Event>& events, size_t n);
+    size_t countNumWakeupEvents(const Event* events, size_t n);
 
     /*
      * Clear out the subhal index bytes from a sensorHandle.
@@ -0,0 +1,139 @@
+/*
+ * Copyright (C) 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+namespace android {
+namespace hardware {
+namespace sensors {
+namespace V2_1 {
+namespace implementation {
+
+/**
+ * A fixed capacity FIFO ring buffer for one producer and one consumer, which may run on different
+ * threads. Multiple producers must serialize their pushes with their own lock.
+ *
+ * The storage is allocated in blocks of blockSize items the first time the producer reaches them,
+ * so a large capacity only costs memory once it is actually used. Items are never moved once they
+ * are pushed, the consumer reads them in place and pops them once it is done with them.
+ */
+template <typename T>
+class RingBuffer {
+  public:
+    RingBuffer(size_t capacity, size_t blockSize)
+        : mCapacity(capacity),
+          mBlockSize(blockSize),
+          mBlocks((capacity + blockSize - 1) / blockSize) {}
+
+    size_t capacity() const { return mCapacity; }
+
+    //! The number of items in the buffer, may be stale by the time it returns.
+    size_t size() const {
+        // Load the head first so that the size could never be negative.
+        size_t head = mHead.load(std::memory_order_acquire);
+        return mTail.load(std::memory_order_acquire) - head;
+    }
+
+    bool empty() const { return size() == 0; }
+
+    /**
+     * Pushes all the items to the back of the buffer. Only called by the producer.
+     *
+     * @return false, without pushing any of the items, if there is not enough room for all of them.
+     */
+    bool push(const T* items, size_t count) {
+        size_t tail = mTail.load(std::memory_order_relaxed);
+        if (count > mCapacity - (tail - mHead.load(std::memory_order_acquire))) {
+            return false;
+        }
+        for (size_t copied = 0; copied < count;) {
+            size_t slot = (tail + copied) % mCapacity;
+            size_t n = std::min(count - copied, contiguousSlotsFrom(slot));
+            std::unique_ptr<T[]>& block = mBlocks[slot / mBlockSize];
+            if (block == nullptr) {
+                block = std::make_unique<T[]>(mBlockSize);
+            }
+            std::copy(items + copied, items + copied + n, block.get() + slot % mBlockSize);
+            copied += n;
+        }
+        mTail.store(tail + count, std::memory_order_release);
+        return true;
+    }
+
+    /**
+     * Gets the longest run of up to maxCount items at the front of the buffer that is contiguous
+     * in memory. Only called by the consumer.
+     *
+     * @param maxCount The maximum number of items to get.
+     * @param count The number of items returned, 0 if the buffer is empty.
+     *
+     * @return A pointer to the first item, valid until the items are popped.
+     */
+    const T* front(size_t maxCount, size_t* count) const {
+        size_t head = mHead.load(std::memory_order_relaxed);
+        size_t available = mTail.load(std::memory_order_acquire) - head;
+        if (available == 0 || maxCount == 0) {
+            *count = 0;
+            return nullptr;
+        }
+        size_t slot = head % mCapacity;
+        *count = std::min({available, maxCount, contiguousSlotsFrom(slot)});
+        return mBlocks[slot / mBlockSize].get() + slot % mBlockSize;
+    }
+
+    //! Pops count items from the front of the buffer. Only called by the consumer.
+    void pop(size_t count) {
+        mHead.store(mHead.load(std::memory_order_relaxed) + count, std::memory_order_release);
+    }
+
+    //! Drops all the items and frees the storage. Neither the producer nor the consumer may run.
+    void clear() {
+        mHead.store(0, std::memory_order_relaxed);
+        mTail.store(0, std::memory_order_relaxed);
+        for (auto& block : mBlocks) {
+            block.reset();
+        }
+    }
+
+  private:
+    const size_t mCapacity;
+    const size_t mBlockSize;
+
+    //! The storage blocks, allocated by the producer before the items in them are published.
+    std::vector<std::unique_ptr<T[]>> mBlocks;
+
+    //! The number of items ever popped, only written by the consumer.
+    std::atomic<size_t> mHead = 0;
+
+    //! The number of items ever pushed, only written by the producer.
+    std::atomic<size_t> mTail = 0;
+
+    size_t contiguousSlotsFrom(size_t slot) const {
+        return std::min(mBlockSize - slot % mBlockSize, mCapacity - slot);
+    }
+};
+
+}  // namespace implementation
+}  // namespace V2_1
+}  // namespace sensors
+}  // namespace hardware
+}  // namespace android
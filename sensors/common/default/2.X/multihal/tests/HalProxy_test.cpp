@@ -25,7 +25,9 @@
 #include "V2_0/ScopedWakelock.h"
 #include "convertV2_1.h"
 
+#include <algorithm>
 #include <chrono>
+#include <memory>
 #include <set>
 #include <thread>
 #include <vector>
@@ -827,6 +829,100 @@ TEST(HalProxyTest, PostEventsMultipleSubhalsThreadedV2_1) {
     EXPECT_EQ(eventQueue->availableToRead(), kNumEvents * 2);
 }
 
+TEST(HalProxyTest, PostEventsDroppedWhenPendingQueueFull) {
+    constexpr size_t kQueueSize = 5;
+    // TODO: Make this constant linked to same limit in HalProxy.h
+    constexpr size_t kMaxPendingQueueSize = 100000;
+    constexpr size_t kNumDroppedEvents = 10;
+    AllSensorsSubHal<SensorsSubHalV2_0> subhal;
+    std::vector<ISensorsSubHal*> subHals{&subhal};
+
+    std::unique_ptr<EventMessageQueueV2_0> eventQueue = makeEventFMQ(kQueueSize);
+    std::unique_ptr<WakeupMessageQueue> wakeLockQueue = makeWakelockFMQ(kQueueSize);
+    ::android::sp<ISensorsCallbackV2_0> callback = new SensorsCallback();
+    EventFlag* eventQueueFlag;
+    EventFlag::createEventFlag(eventQueue->getEventFlagWord(), &eventQueueFlag);
+    HalProxy proxy(subHals);
+    proxy.initialize(*eventQueue->getDesc(), *wakeLockQueue->getDesc(), callback);
+
+    // Fill the FMQ and the pending queue, then post events that do not fit anymore
+    std::vector<EventV1_0> events = makeMultipleAccelerometerEvents(kQueueSize);
+    subhal.postEvents(convertToNewEvents(events), false);
+    events = makeMultipleAccelerometerEvents(kMaxPendingQueueSize);
+    subhal.postEvents(convertToNewEvents(events), false);
+    events = makeMultipleAccelerometerEvents(kNumDroppedEvents);
+    subhal.postEvents(convertToNewEvents(events), false);
+
+    for (size_t i = 0; i < kMaxPendingQueueSize + kQueueSize; i += kQueueSize) {
+        ASSERT_TRUE(readEventsOutOfQueue(kQueueSize, eventQueue, eventQueueFlag));
+    }
+
+    // The events posted while the pending queue was full should have been dropped
+    EXPECT_FALSE(readEventsOutOfQueue(1, eventQueue, eventQueueFlag));
+}
+
+TEST(HalProxyTest, PostEventsBurstsFromMultipleSubhalsThreaded) {
+    constexpr size_t kQueueSize = 128;
+    constexpr size_t kNumSubHals = 4;
+    constexpr size_t kNumBursts = 50;
+    constexpr size_t kBurstSize = 500;
+    // Fits in the pending queue even if the FMQ is never read, so no event should be dropped
+    constexpr size_t kNumEvents = kNumSubHals * kNumBursts * kBurstSize;
+    constexpr auto kTimeout = std::chrono::seconds(10);
+    std::vector<std::unique_ptr<AllSensorsSubHal<SensorsSubHalV2_0>>> subHalObjects;
+    std::vector<ISensorsSubHal*> subHals;
+    for (size_t i = 0; i < kNumSubHals; i++) {
+        subHalObjects.push_back(std::make_unique<AllSensorsSubHal<SensorsSubHalV2_0>>());
+        subHals.push_back(subHalObjects.back().get());
+    }
+
+    std::unique_ptr<EventMessageQueueV2_0> eventQueue = makeEventFMQ(kQueueSize);
+    std::unique_ptr<WakeupMessageQueue> wakeLockQueue = makeWakelockFMQ(kQueueSize);
+    ::android::sp<ISensorsCallbackV2_0> callback = new SensorsCallback();
+    EventFlag* eventQueueFlag;
+    EventFlag::createEventFlag(eventQueue->getEventFlagWord(), &eventQueueFlag);
+    HalProxy proxy(subHals);
+    proxy.initialize(*eventQueue->getDesc(), *wakeLockQueue->getDesc(), callback);
+
+    auto start = std::chrono::steady_clock::now();
+    size_t numEventsRead = 0;
+    std::thread reader([&] {
+        std::vector<EventV1_0> events(kQueueSize);
+        while (numEventsRead < kNumEvents && std::chrono::steady_clock::now() - start < kTimeout) {
+            size_t numToRead = eventQueue->availableToRead();
+            if (numToRead == 0) {
+                std::this_thread::sleep_for(std::chrono::microseconds(50));
+                continue;
+            }
+            ASSERT_TRUE(eventQueue->read(events.data(), numToRead));
+            eventQueueFlag->wake(static_cast<uint32_t>(EventQueueFlagBits::EVENTS_READ));
+            numEventsRead += numToRead;
+        }
+    });
+
+    std::vector<std::thread> writers;
+    std::vector<EventV1_0> burst = makeMultipleAccelerometerEvents(kBurstSize);
+    for (auto& subHal : subHalObjects) {
+        writers.emplace_back([&subHal, &burst] {
+            for (size_t i = 0; i < kNumBursts; i++) {
+                subHal->postEvents(convertToNewEvents(burst), false /* wakeup */);
+            }
+        });
+    }
+    for (auto& writer : writers) {
+        writer.join();
+    }
+    reader.join();
+    auto elapsedMs = std::chrono::duration_cast<std::chrono::milliseconds>(
+                             std::chrono::steady_clock::now() - start)
+                             .count();
+
+    RecordProperty("events_per_second", static_cast<int>(numEventsRead * 1000 /
+                                                          std::max<int64_t>(elapsedMs, 1)));
+    RecordProperty("dropped_events", static_cast<int>(kNumEvents - numEventsRead));
+    EXPECT_EQ(numEventsRead, kNumEvents);
+}
+
 // Helper implementations follow
 void testSensorsListFromProxyAndSubHal(const std::vector<SensorInfo>& proxySensorsList,
                                        const std::vector<SensorInfo>& subHalSensorsList) {
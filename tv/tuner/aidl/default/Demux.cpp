@@ -21,6 +21,7 @@
 #include <aidl/android/hardware/tv/tuner/Result.h>
 
 #include <utils/Log.h>
+#include <algorithm>
 #include "Demux.h"
 
 namespace aidl {
@@ -178,6 +179,11 @@ Demux::~Demux() {
     }
     mPlaybackFilterIds.clear();
     mRecordFilterIds.clear();
+    {
+        std::lock_guard<std::mutex> lock(mPlaybackFiltersByTpidLock);
+        mPlaybackFiltersByTpid.clear();
+        mPlaybackFilterTpids.clear();
+    }
     mFilters.clear();
     mLastUsedFilterId = -1;
     mTuner->removeDemux(mDemuxId);
@@ -260,6 +266,10 @@ Demux::~Demux() {
     if (mDvrPlayback != nullptr) {
         mDvrPlayback->removePlaybackFilter(filterId);
     }
+    {
+        std::lock_guard<std::mutex> lock(mPlaybackFiltersByTpidLock);
+        removeFilterTpidLocked(filterId);
+    }
     mPlaybackFilterIds.erase(filterId);
     mRecordFilterIds.erase(filterId);
     mFilters.erase(filterId);
@@ -267,20 +277,37 @@ Demux::~Demux() {
     return ::ndk::ScopedAStatus::ok();
 }
 
-void Demux::startBroadcastTsFilter(vector<int8_t> data) {
-    set<int64_t>::iterator it;
-    uint16_t pid = ((data[1] & 0x1f) << 8) | ((data[2] & 0xff));
+void Demux::startBroadcastTsFilter(const PacketSlice& data) {
+    uint16_t pid = getTsPacketPid(data);
     if (DEBUG_DEMUX) {
         ALOGW("[Demux] start ts filter pid: %d", pid);
     }
-    for (it = mPlaybackFilterIds.begin(); it != mPlaybackFilterIds.end(); it++) {
-        if (pid == mFilters[*it]->getTpid()) {
-            mFilters[*it]->updateFilterOutput(data);
+    std::lock_guard<std::mutex> lock(mPlaybackFiltersByTpidLock);
+    auto it = mPlaybackFiltersByTpid.find(pid);
+    if (it == mPlaybackFiltersByTpid.end()) {
+        return;
+    }
+    for (const auto& filter : it->second) {
+        filter->updateFilterOutput(data);
+    }
+}
+
+void Demux::startBroadcastTsFilters(const vector<PacketSlice>& packets) {
+    // Only called on the input thread, so the PID scratch buffer does not need a lock.
+    parseTsPacketPids(packets, &mPacketPids);
+    std::lock_guard<std::mutex> lock(mPlaybackFiltersByTpidLock);
+    for (size_t i = 0; i < packets.size(); i++) {
+        auto it = mPlaybackFiltersByTpid.find(mPacketPids[i]);
+        if (it == mPlaybackFiltersByTpid.end()) {
+            continue;
+        }
+        for (const auto& filter : it->second) {
+            filter->updateFilterOutput(packets[i]);
         }
     }
 }
 
-void Demux::sendFrontendInputToRecord(vector<int8_t> data) {
+void Demux::sendFrontendInputToRecord(const PacketSlice& data) {
     set<int64_t>::iterator it;
     if (DEBUG_DEMUX) {
         ALOGW("[Demux] update record filter output");
@@ -290,7 +317,7 @@ void Demux::sendFrontendInputToRecord(vector<int8_t> data) {
     }
 }
 
-void Demux::sendFrontendInputToRecord(vector<int8_t> data, uint16_t pid, uint64_t pts) {
+void Demux::sendFrontendInputToRecord(const PacketSlice& data, uint16_t pid, uint64_t pts) {
     sendFrontendInputToRecord(data);
     set<int64_t>::iterator it;
     for (it = mRecordFilterIds.begin(); it != mRecordFilterIds.end(); it++) {
@@ -329,11 +356,11 @@ bool Demux::startRecordFilterDispatcher() {
     return mFilters[filterId]->startFilterHandler();
 }
 
-void Demux::updateFilterOutput(int64_t filterId, vector<int8_t> data) {
+void Demux::updateFilterOutput(int64_t filterId, const PacketSlice& data) {
     mFilters[filterId]->updateFilterOutput(data);
 }
 
-void Demux::updateMediaFilterOutput(int64_t filterId, vector<int8_t> data, uint64_t pts) {
+void Demux::updateMediaFilterOutput(int64_t filterId, const PacketSlice& data, uint64_t pts) {
     updateFilterOutput(filterId, data);
     mFilters[filterId]->updatePts(pts);
 }
@@ -342,6 +369,34 @@ uint16_t Demux::getFilterTpid(int64_t filterId) {
     return mFilters[filterId]->getTpid();
 }
 
+void Demux::setFilterTpid(int64_t filterId, uint16_t tpid) {
+    if (mPlaybackFilterIds.find(filterId) == mPlaybackFilterIds.end()) {
+        // Record filters get all the input, they are not dispatched by PID.
+        return;
+    }
+    std::lock_guard<std::mutex> lock(mPlaybackFiltersByTpidLock);
+    removeFilterTpidLocked(filterId);
+    mPlaybackFilterTpids[filterId] = tpid;
+    mPlaybackFiltersByTpid[tpid].push_back(mFilters[filterId]);
+}
+
+void Demux::removeFilterTpidLocked(int64_t filterId) {
+    auto tpidIt = mPlaybackFilterTpids.find(filterId);
+    if (tpidIt == mPlaybackFilterTpids.end()) {
+        return;
+    }
+    auto filtersIt = mPlaybackFiltersByTpid.find(tpidIt->second);
+    if (filtersIt != mPlaybackFiltersByTpid.end()) {
+        vector<std::shared_ptr<Filter>>& filters = filtersIt->second;
+        filters.erase(std::remove(filters.begin(), filters.end(), mFilters[filterId]),
+                      filters.end());
+        if (filters.empty()) {
+            mPlaybackFiltersByTpid.erase(filtersIt);
+        }
+    }
+    mPlaybackFilterTpids.erase(tpidIt);
+}
+
 void Demux::startFrontendInputLoop() {
     ALOGD("[Demux] start frontend on demux");
     // Stop current Frontend thread loop first, in case the user starts a new
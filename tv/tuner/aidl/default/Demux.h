@@ -23,10 +23,12 @@
 #include <atomic>
 #include <set>
 #include <thread>
+#include <unordered_map>
 
 #include "Dvr.h"
 #include "Filter.h"
 #include "Frontend.h"
+#include "PacketBuffer.h"
 #include "TimeFilter.h"
 #include "Tuner.h"
 
@@ -79,9 +81,10 @@ class Demux : public BnDemux {
     bool attachRecordFilter(int64_t filterId);
     bool detachRecordFilter(int64_t filterId);
     ::ndk::ScopedAStatus startFilterHandler(int64_t filterId);
-    void updateFilterOutput(int64_t filterId, vector<int8_t> data);
-    void updateMediaFilterOutput(int64_t filterId, vector<int8_t> data, uint64_t pts);
+    void updateFilterOutput(int64_t filterId, const PacketSlice& data);
+    void updateMediaFilterOutput(int64_t filterId, const PacketSlice& data, uint64_t pts);
     uint16_t getFilterTpid(int64_t filterId);
+    void setFilterTpid(int64_t filterId, uint16_t tpid);
     void setIsRecording(bool isRecording);
     bool isRecording();
     void startFrontendInputLoop();
@@ -92,10 +95,11 @@ class Demux : public BnDemux {
      * Note that recording filters are not included.
      */
     bool startBroadcastFilterDispatcher();
-    void startBroadcastTsFilter(vector<int8_t> data);
+    void startBroadcastTsFilter(const PacketSlice& data);
+    void startBroadcastTsFilters(const vector<PacketSlice>& packets);
 
-    void sendFrontendInputToRecord(vector<int8_t> data);
-    void sendFrontendInputToRecord(vector<int8_t> data, uint16_t pid, uint64_t pts);
+    void sendFrontendInputToRecord(const PacketSlice& data);
+    void sendFrontendInputToRecord(const PacketSlice& data, uint16_t pid, uint64_t pts);
     bool startRecordFilterDispatcher();
 
   private:
@@ -123,6 +127,7 @@ class Demux : public BnDemux {
      */
     void deleteEventFlag();
     bool readDataFromMQ();
+    void removeFilterTpidLocked(int64_t filterId);
 
     int32_t mDemuxId = -1;
     int32_t mCiCamId;
@@ -147,6 +152,22 @@ class Demux : public BnDemux {
      * The array number is the filter ID.
      */
     std::map<int64_t, std::shared_ptr<Filter>> mFilters;
+    /**
+     * The configured playback filters by their TS PID, so that an input packet could be
+     * dispatched without going through all the filters.
+     * Updated when a playback filter is configured or removed.
+     */
+    std::unordered_map<uint16_t, vector<std::shared_ptr<Filter>>> mPlaybackFiltersByTpid;
+    /**
+     * The PID each playback filter is indexed by in mPlaybackFiltersByTpid.
+     */
+    std::map<int64_t, uint16_t> mPlaybackFilterTpids;
+    /**
+     * Lock to protect the PID table, which is read on the input thread.
+     */
+    std::mutex mPlaybackFiltersByTpidLock;
+    // Scratch buffer for the PIDs of the packets being dispatched.
+    vector<uint16_t> mPacketPids;
 
     /**
      * Local reference to the opened Timer Filter instance.
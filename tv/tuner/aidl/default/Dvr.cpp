@@ -261,25 +261,48 @@ bool Dvr::readPlaybackFMQ(bool isVirtualFrontend, bool isRecording) {
     // Read playback data from the input FMQ
     size_t size = mDvrMQ->availableToRead();
     int64_t playbackPacketSize = mDvrSettings.get<DvrSettings::Tag::playback>().packetSize;
-    vector<int8_t> dataOutputBuffer;
-    dataOutputBuffer.resize(playbackPacketSize);
-    // Dispatch the packet to the PID matching filter output buffer
-    for (int i = 0; i < size / playbackPacketSize; i++) {
-        if (!mDvrMQ->read(dataOutputBuffer.data(), playbackPacketSize)) {
-            return false;
-        }
-        if (isVirtualFrontend) {
-            if (isRecording) {
-                mDemux->sendFrontendInputToRecord(dataOutputBuffer);
-            } else {
-                mDemux->startBroadcastTsFilter(dataOutputBuffer);
-            }
+    size_t packetCount = size / playbackPacketSize;
+    if (packetCount == 0) {
+        return true;
+    }
+
+    // Dispatch the packets to the PID matching filter output buffer directly from the FMQ memory.
+    // Only a packet wrapping around the end of the FMQ ring buffer is copied.
+    size_t readSize = packetCount * playbackPacketSize;
+    DvrMQ::MemTransaction tx;
+    if (!mDvrMQ->beginRead(readSize, &tx)) {
+        return false;
+    }
+    const auto& firstRegion = tx.getFirstRegion();
+    const auto& secondRegion = tx.getSecondRegion();
+    mPlaybackPackets.clear();
+    for (size_t offset = 0; offset < readSize; offset += playbackPacketSize) {
+        if (offset + playbackPacketSize <= firstRegion.getLength()) {
+            mPlaybackPackets.emplace_back(firstRegion.getAddress() + offset, playbackPacketSize);
+        } else if (offset >= firstRegion.getLength()) {
+            mPlaybackPackets.emplace_back(
+                    secondRegion.getAddress() + offset - firstRegion.getLength(),
+                    playbackPacketSize);
         } else {
-            startTpidFilter(dataOutputBuffer);
+            mWrappedPacketBuffer.resize(playbackPacketSize);
+            if (!tx.copyFrom(mWrappedPacketBuffer.data(), offset, playbackPacketSize)) {
+                return false;
+            }
+            mPlaybackPackets.emplace_back(mWrappedPacketBuffer);
         }
     }
 
-    return true;
+    if (isVirtualFrontend && isRecording) {
+        for (const auto& packet : mPlaybackPackets) {
+            mDemux->sendFrontendInputToRecord(packet);
+        }
+    } else {
+        // The playback filters of the Dvr are the playback filters of the Demux, so the packets
+        // are dispatched by PID through the Demux in both the frontend and the playback cases.
+        mDemux->startBroadcastTsFilters(mPlaybackPackets);
+    }
+
+    return mDvrMQ->commitRead(readSize);
 }
 
 bool Dvr::processEsDataOnPlayback(bool isVirtualFrontend, bool isRecording) {
@@ -370,13 +393,11 @@ bool Dvr::processEsDataOnPlayback(bool isVirtualFrontend, bool isRecording) {
     }
 
     // Read es raw data from the FMQ per meta data built previously
-    vector<int8_t> frameData;
     map<int64_t, std::shared_ptr<IFilter>>::iterator it;
     int pid = 0;
     for (int i = 0; i < totalFrames; i++) {
-        frameData.resize(esMeta[i].len);
+        PacketSlice frameData(dataOutputBuffer.data() + esMeta[i].startIndex, esMeta[i].len);
         pid = esMeta[i].isAudio ? audioPid : videoPid;
-        memcpy(frameData.data(), dataOutputBuffer.data() + esMeta[i].startIndex, esMeta[i].len);
         // Send to the media filters or record filters
         if (!isRecording) {
             for (it = mFilters.begin(); it != mFilters.end(); it++) {
@@ -389,7 +410,6 @@ bool Dvr::processEsDataOnPlayback(bool isVirtualFrontend, bool isRecording) {
             mDemux->sendFrontendInputToRecord(frameData, pid, static_cast<uint64_t>(esMeta[i].pts));
         }
         startFilterDispatcher(isVirtualFrontend, isRecording);
-        frameData.clear();
     }
 
     return true;
@@ -402,19 +422,6 @@ void Dvr::getMetaDataValue(int& index, int8_t* dataOutputBuffer, int& value) {
     }
 }
 
-void Dvr::startTpidFilter(vector<int8_t> data) {
-    map<int64_t, std::shared_ptr<IFilter>>::iterator it;
-    for (it = mFilters.begin(); it != mFilters.end(); it++) {
-        uint16_t pid = ((data[1] & 0x1f) << 8) | ((data[2] & 0xff));
-        if (DEBUG_DVR) {
-            ALOGW("[Dvr] start ts filter pid: %d", pid);
-        }
-        if (pid == mDemux->getFilterTpid(it->first)) {
-            mDemux->updateFilterOutput(it->first, data);
-        }
-    }
-}
-
 bool Dvr::startFilterDispatcher(bool isVirtualFrontend, bool isRecording) {
     if (isVirtualFrontend) {
         if (isRecording) {
@@ -26,6 +26,7 @@
 #include <thread>
 #include "Demux.h"
 #include "Frontend.h"
+#include "PacketBuffer.h"
 #include "Tuner.h"
 
 using namespace std;
@@ -106,14 +107,13 @@ class Dvr : public BnDvr {
                                              int64_t highThreshold, int64_t lowThreshold);
     RecordStatus checkRecordStatusChange(uint32_t availableToWrite, uint32_t availableToRead,
                                          int64_t highThreshold, int64_t lowThreshold);
-    /**
-     * A dispatcher to read and dispatch input data to all the started filters.
-     * Each filter handler handles the data filtering/output writing/filterEvent updating.
-     */
-    void startTpidFilter(vector<int8_t> data);
     void playbackThreadLoop();
 
     unique_ptr<DvrMQ> mDvrMQ;
+    // Holds a playback packet that wraps around the end of the FMQ ring buffer.
+    vector<int8_t> mWrappedPacketBuffer;
+    // The packets of the current playback FMQ read.
+    vector<PacketSlice> mPlaybackPackets;
     EventFlag* mDvrEventFlag;
     /**
      * Demux callbacks used on filter events or IO buffer status
@@ -305,6 +305,7 @@ Filter::~Filter() {
     switch (mType.mainType) {
         case DemuxFilterMainType::TS:
             mTpid = in_settings.get<DemuxFilterSettings::Tag::ts>().tpid;
+            mDemux->setFilterTpid(mFilterId, mTpid);
             break;
         case DemuxFilterMainType::MMTP:
             break;
@@ -361,8 +362,18 @@ Filter::~Filter() {
 ::ndk::ScopedAStatus Filter::stop() {
     ALOGV("%s", __FUNCTION__);
 
-    mFilterThreadRunning = false;
+    {
+        // Hold the lock so that the thread could not miss the notification between checking
+        // mFilterThreadRunning and waiting.
+        std::lock_guard<std::mutex> lock(mFilterEventsLock);
+        mFilterThreadRunning = false;
+    }
+    mFilterEventsCv.notify_all();
     if (mFilterThread.joinable()) {
+        if (mIsUsingFMQ && mFilterEventsFlag != nullptr) {
+            // Stop waiting for the data to be consumed.
+            mFilterEventsFlag->wake(static_cast<uint32_t>(DemuxQueueNotifyBits::DATA_CONSUMED));
+        }
         mFilterThread.join();
     }
 
@@ -564,89 +575,76 @@ void Filter::filterThreadLoop() {
 
     ALOGD("[Filter] filter %" PRIu64 " threadLoop start.", mFilterId);
 
+    if (!mCallbackScheduler.hasCallbackRegistered()) {
+        ALOGD("[Filter] filter callback is not configured yet.");
+        mFilterThreadRunning = false;
+        return;
+    }
+
     // For the first time of filter output, implementation needs to send the filter
     // Event Callback without waiting for the DATA_CONSUMED to init the process.
+    bool isFirstOutput = true;
     while (mFilterThreadRunning) {
-        std::unique_lock<std::mutex> lock(mFilterEventsLock);
-        if (mFilterEvents.size() == 0) {
-            lock.unlock();
-            if (DEBUG_FILTER) {
-                ALOGD("[Filter] wait for filter data output.");
-            }
-            usleep(1000 * 1000);
-            continue;
+        {
+            std::unique_lock<std::mutex> lock(mFilterEventsLock);
+            mFilterEventsCv.wait(
+                    lock, [this] { return !mFilterEvents.empty() || !mFilterThreadRunning; });
         }
 
-        // After successfully write, send a callback and wait for the read to be done
-        if (mCallbackScheduler.hasCallbackRegistered()) {
-            if (mConfigured) {
-                auto startEvent =
-                        DemuxFilterEvent::make<DemuxFilterEvent::Tag::startId>(mStartId++);
-                mCallbackScheduler.onFilterEvent(std::move(startEvent));
-                mConfigured = false;
-            }
-
-            // lock is still being held
-            for (auto&& event : mFilterEvents) {
-                mCallbackScheduler.onFilterEvent(std::move(event));
+        // After the previous write, wait for the read to be done before sending more events.
+        while (!isFirstOutput && mFilterThreadRunning && mIsUsingFMQ) {
+            uint32_t efState = 0;
+            ::android::status_t status = mFilterEventsFlag->wait(
+                    static_cast<uint32_t>(DemuxQueueNotifyBits::DATA_CONSUMED), &efState,
+                    WAIT_TIMEOUT, true /* retry on spurious wake */);
+            if (status != ::android::OK) {
+                ALOGD("[Filter] wait for data consumed");
+                continue;
             }
-        } else {
-            ALOGD("[Filter] filter callback is not configured yet.");
-            mFilterThreadRunning = false;
-            return;
+            break;
+        }
+        if (!mFilterThreadRunning) {
+            break;
         }
 
-        mFilterEvents.clear();
-        mFilterStatus = DemuxFilterStatus::DATA_READY;
-        mCallbackScheduler.onFilterStatus(mFilterStatus);
-        break;
-    }
+        if (!isFirstOutput) {
+            maySendFilterStatusCallback();
+        }
 
-    while (mFilterThreadRunning) {
-        uint32_t efState = 0;
-        // We do not wait for the last round of written data to be read to finish the thread
-        // because the VTS can verify the reading itself.
-        for (int i = 0; i < SECTION_WRITE_COUNT; i++) {
-            if (!mFilterThreadRunning) {
-                break;
-            }
-            while (mFilterThreadRunning && mIsUsingFMQ) {
-                ::android::status_t status = mFilterEventsFlag->wait(
-                        static_cast<uint32_t>(DemuxQueueNotifyBits::DATA_CONSUMED), &efState,
-                        WAIT_TIMEOUT, true /* retry on spurious wake */);
-                if (status != ::android::OK) {
-                    ALOGD("[Filter] wait for data consumed");
-                    continue;
-                }
-                break;
-            }
+        // Take all the events produced so far, including the ones produced while waiting for the
+        // data to be consumed.
+        vector<DemuxFilterEvent> events;
+        {
+            std::lock_guard<std::mutex> lock(mFilterEventsLock);
+            events.swap(mFilterEvents);
+        }
 
-            maySendFilterStatusCallback();
+        if (isFirstOutput && mConfigured) {
+            auto startEvent = DemuxFilterEvent::make<DemuxFilterEvent::Tag::startId>(mStartId++);
+            mCallbackScheduler.onFilterEvent(std::move(startEvent));
+            mConfigured = false;
+        }
+        for (auto&& event : events) {
+            mCallbackScheduler.onFilterEvent(std::move(event));
+        }
 
-            while (mFilterThreadRunning) {
-                std::lock_guard<std::mutex> lock(mFilterEventsLock);
-                if (mFilterEvents.size() == 0) {
-                    continue;
-                }
-                // After successfully write, send a callback and wait for the read to be done
-                for (auto&& event : mFilterEvents) {
-                    mCallbackScheduler.onFilterEvent(std::move(event));
-                }
-                mFilterEvents.clear();
-                break;
-            }
-            // We do not wait for the last read to be done
-            // VTS can verify the read result itself.
-            if (i == SECTION_WRITE_COUNT - 1) {
-                ALOGD("[Filter] filter %" PRIu64 " writing done. Ending thread", mFilterId);
-                break;
-            }
+        if (isFirstOutput) {
+            mFilterStatus = DemuxFilterStatus::DATA_READY;
+            mCallbackScheduler.onFilterStatus(mFilterStatus);
+            isFirstOutput = false;
         }
-        break;
     }
     ALOGD("[Filter] filter thread ended.");
 }
 
+void Filter::pushFilterEvent(DemuxFilterEvent&& event) {
+    {
+        std::lock_guard<std::mutex> lock(mFilterEventsLock);
+        mFilterEvents.push_back(std::move(event));
+    }
+    mFilterEventsCv.notify_one();
+}
+
 void Filter::freeSharedAvHandle() {
     if (!mIsMediaFilter) {
         return;
@@ -701,7 +699,7 @@ uint16_t Filter::getTpid() {
     return mTpid;
 }
 
-void Filter::updateFilterOutput(vector<int8_t>& data) {
+void Filter::updateFilterOutput(const PacketSlice& data) {
     std::lock_guard<std::mutex> lock(mFilterOutputLock);
     mFilterOutput.insert(mFilterOutput.end(), data.begin(), data.end());
 }
@@ -711,7 +709,7 @@ void Filter::updatePts(uint64_t pts) {
     mPts = pts;
 }
 
-void Filter::updateRecordOutput(vector<int8_t>& data) {
+void Filter::updateRecordOutput(const PacketSlice& data) {
     std::lock_guard<std::mutex> lock(mRecordFilterOutputLock);
     mRecordFilterOutput.insert(mRecordFilterOutput.end(), data.begin(), data.end());
 }
@@ -834,10 +832,7 @@ void Filter::updateRecordOutput(vector<int8_t>& data) {
             ALOGD("[Filter] assembled pes data length %d", pesEvent.dataLength);
         }
 
-        {
-            std::lock_guard<std::mutex> lock(mFilterEventsLock);
-            mFilterEvents.push_back(DemuxFilterEvent::make<DemuxFilterEvent::Tag::pes>(pesEvent));
-        }
+        pushFilterEvent(DemuxFilterEvent::make<DemuxFilterEvent::Tag::pes>(pesEvent));
 
         mPesOutput.clear();
     }
@@ -941,11 +936,7 @@ void Filter::updateRecordOutput(vector<int8_t>& data) {
             .firstMbInSlice = 0,  // random address
     };
 
-    {
-        std::lock_guard<std::mutex> lock(mFilterEventsLock);
-        mFilterEvents.push_back(
-                DemuxFilterEvent::make<DemuxFilterEvent::Tag::tsRecord>(recordEvent));
-    }
+    pushFilterEvent(DemuxFilterEvent::make<DemuxFilterEvent::Tag::tsRecord>(recordEvent));
 
     mRecordFilterOutput.clear();
     return ::ndk::ScopedAStatus::ok();
@@ -976,10 +967,7 @@ bool Filter::writeSectionsAndCreateEvent(vector<int8_t>& data) {
             .dataLength = static_cast<int32_t>(data.size()),
     };
 
-    {
-        std::lock_guard<std::mutex> lock(mFilterEventsLock);
-        mFilterEvents.push_back(DemuxFilterEvent::make<DemuxFilterEvent::Tag::section>(secEvent));
-    }
+    pushFilterEvent(DemuxFilterEvent::make<DemuxFilterEvent::Tag::section>(secEvent));
 
     return true;
 }
@@ -1079,10 +1067,7 @@ native_handle_t* Filter::createNativeHandle(int fd) {
         mPts = 0;
     }
 
-    {
-        std::lock_guard<std::mutex> lock(mFilterEventsLock);
-        mFilterEvents.push_back(std::move(event));
-    }
+    pushFilterEvent(std::move(event));
 
     // Clear and log
     native_handle_close(nativeHandle);
@@ -1123,10 +1108,7 @@ native_handle_t* Filter::createNativeHandle(int fd) {
         mPts = 0;
     }
 
-    {
-        std::lock_guard<std::mutex> lock(mFilterEventsLock);
-        mFilterEvents.push_back(std::move(event));
-    }
+    pushFilterEvent(std::move(event));
 
     mSharedAvMemOffset += output.size();
 
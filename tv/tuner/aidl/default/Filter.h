@@ -34,6 +34,7 @@
 #include "Demux.h"
 #include "Dvr.h"
 #include "Frontend.h"
+#include "PacketBuffer.h"
 
 using namespace std;
 
@@ -135,8 +136,8 @@ class Filter : public BnFilter {
      */
     bool createFilterMQ();
     uint16_t getTpid();
-    void updateFilterOutput(vector<int8_t>& data);
-    void updateRecordOutput(vector<int8_t>& data);
+    void updateFilterOutput(const PacketSlice& data);
+    void updateRecordOutput(const PacketSlice& data);
     void updatePts(uint64_t pts);
     ::ndk::ScopedAStatus startFilterHandler();
     ::ndk::ScopedAStatus startRecordFilterHandler();
@@ -172,7 +173,7 @@ class Filter : public BnFilter {
     int64_t mPts = 0;
     unique_ptr<FilterMQ> mFilterMQ;
     bool mIsUsingFMQ = false;
-    EventFlag* mFilterEventsFlag;
+    EventFlag* mFilterEventsFlag = nullptr;
     vector<DemuxFilterEvent> mFilterEvents;
 
     // Thread handlers
@@ -185,12 +186,6 @@ class Filter : public BnFilter {
      */
     std::atomic<bool> mFilterThreadRunning;
 
-    /**
-     * How many times a filter should write
-     * TODO make this dynamic/random/can take as a parameter
-     */
-    const uint16_t SECTION_WRITE_COUNT = 10;
-
     bool DEBUG_FILTER = false;
 
     /**
@@ -220,6 +215,10 @@ class Filter : public BnFilter {
     bool startFilterDispatcher();
     static void* __threadLoopFilter(void* user);
     void filterThreadLoop();
+    /**
+     * Queues a filter event and wakes up the filter thread to send it.
+     */
+    void pushFilterEvent(DemuxFilterEvent&& event);
 
     int createAvIonFd(int size);
     uint8_t* getIonBuffer(int fd, int size);
@@ -249,6 +248,10 @@ class Filter : public BnFilter {
      */
     // TODO make each filter separate event lock
     std::mutex mFilterEventsLock;
+    /**
+     * Notified when a filter event is queued or the filter thread is stopped
+     */
+    std::condition_variable mFilterEventsCv;
     /**
      * Lock to protect writes to the input status
      */
@@ -0,0 +1,77 @@
+/*
+ * Copyright 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+namespace aidl {
+namespace android {
+namespace hardware {
+namespace tv {
+namespace tuner {
+
+/**
+ * A non-owning view over a contiguous run of input data, e.g. one TS packet in the playback FMQ
+ * or one ES frame in the playback buffer.
+ *
+ * It is used to pass the input data from the Dvr through the Demux to the filters without copying
+ * it. The underlying data must stay valid until the call it is passed to returns. Filters that
+ * need to keep the data copy it into their own output buffer.
+ */
+class PacketSlice {
+  public:
+    PacketSlice(const int8_t* data, size_t size) : mData(data), mSize(size) {}
+    // Implicit, so that a vector could be passed wherever a slice is expected.
+    PacketSlice(const std::vector<int8_t>& data) : mData(data.data()), mSize(data.size()) {}
+
+    const int8_t* data() const { return mData; }
+    size_t size() const { return mSize; }
+    bool empty() const { return mSize == 0; }
+    const int8_t* begin() const { return mData; }
+    const int8_t* end() const { return mData + mSize; }
+    int8_t operator[](size_t index) const { return mData[index]; }
+
+  private:
+    const int8_t* mData;
+    size_t mSize;
+};
+
+inline uint16_t getTsPacketPid(const PacketSlice& packet) {
+    return ((packet[1] & 0x1f) << 8) | (packet[2] & 0xff);
+}
+
+/**
+ * Parses the PIDs out of the headers of a batch of TS packets.
+ *
+ * The headers of the whole batch are parsed in one pass before any of the packets is copied to
+ * the filters, which keeps the loop tight enough for the compiler to unroll.
+ */
+inline void parseTsPacketPids(const std::vector<PacketSlice>& packets,
+                              std::vector<uint16_t>* pids) {
+    pids->resize(packets.size());
+    for (size_t i = 0; i < packets.size(); i++) {
+        (*pids)[i] = getTsPacketPid(packets[i]);
+    }
+}
+
+}  // namespace tuner
+}  // namespace tv
+}  // namespace hardware
+}  // namespace android
+}  // namespace aidl
@@ -0,0 +1,128 @@
+/*
+ * Copyright 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Benchmarks for dispatching the Demux input packets to the filters by PID.
+
+#include <aidl/android/hardware/tv/tuner/BnFilterCallback.h>
+#include <benchmark/benchmark.h>
+
+#include <memory>
+#include <vector>
+
+#include "Demux.h"
+#include "Filter.h"
+#include "Tuner.h"
+
+namespace aidl {
+namespace android {
+namespace hardware {
+namespace tv {
+namespace tuner {
+
+namespace {
+
+using ::benchmark::Counter;
+using ::benchmark::State;
+
+constexpr int32_t FILTER_BUFFER_SIZE = 0x100000;
+constexpr int TS_PACKET_SIZE = 188;
+constexpr int32_t FIRST_PID = 0x100;
+constexpr size_t PACKETS_PER_BATCH = 64;
+// How many batches to dispatch before draining the filter outputs.
+constexpr int64_t BATCHES_PER_DRAIN = 256;
+
+class NoOpFilterCallback : public BnFilterCallback {
+  public:
+    ::ndk::ScopedAStatus onFilterEvent(const std::vector<DemuxFilterEvent>& /*events*/) override {
+        return ::ndk::ScopedAStatus::ok();
+    }
+
+    ::ndk::ScopedAStatus onFilterStatus(DemuxFilterStatus /*status*/) override {
+        return ::ndk::ScopedAStatus::ok();
+    }
+};
+
+// Sends batches of TS packets to 'state.range(0)' configured PES filters, the packet PIDs going
+// round robin over the filters. The packets have no PES header, so draining the filter outputs
+// only drops the data.
+void BM_DispatchTsPackets(State& state) {
+    const int filterCount = state.range(0);
+    auto tuner = ::ndk::SharedRefBase::make<Tuner>();
+    tuner->init();
+    std::vector<int32_t> demuxIds;
+    std::shared_ptr<IDemux> demuxInterface;
+    tuner->openDemux(&demuxIds, &demuxInterface);
+    auto demux = std::static_pointer_cast<Demux>(demuxInterface);
+
+    std::vector<std::shared_ptr<IFilter>> filters;
+    DemuxFilterType type;
+    type.mainType = DemuxFilterMainType::TS;
+    type.subType.set<DemuxFilterSubType::Tag::tsFilterType>(DemuxTsFilterType::PES);
+    for (int i = 0; i < filterCount; i++) {
+        std::shared_ptr<IFilter> filter;
+        if (!demux->openFilter(type, FILTER_BUFFER_SIZE,
+                               ::ndk::SharedRefBase::make<NoOpFilterCallback>(), &filter)
+                     .isOk()) {
+            state.SkipWithError("failed to open filter");
+            return;
+        }
+        DemuxTsFilterSettings tsSettings;
+        tsSettings.tpid = FIRST_PID + i;
+        DemuxFilterSettings settings;
+        settings.set<DemuxFilterSettings::Tag::ts>(tsSettings);
+        filter->configure(settings);
+        filters.push_back(filter);
+    }
+
+    std::vector<int8_t> data(PACKETS_PER_BATCH * TS_PACKET_SIZE, 0);
+    std::vector<PacketSlice> packets;
+    for (size_t i = 0; i < PACKETS_PER_BATCH; i++) {
+        int8_t* packet = data.data() + i * TS_PACKET_SIZE;
+        int32_t pid = FIRST_PID + i % filterCount;
+        packet[0] = 0x47;
+        packet[1] = static_cast<int8_t>((pid >> 8) & 0x1f);
+        packet[2] = static_cast<int8_t>(pid & 0xff);
+        packets.emplace_back(packet, TS_PACKET_SIZE);
+    }
+
+    int64_t batches = 0;
+    for (auto _ : state) {
+        demux->startBroadcastTsFilters(packets);
+        if (++batches % BATCHES_PER_DRAIN == 0) {
+            state.PauseTiming();
+            demux->startBroadcastFilterDispatcher();
+            state.ResumeTiming();
+        }
+    }
+
+    state.counters["packets_per_second"] =
+            Counter(state.iterations() * PACKETS_PER_BATCH, Counter::kIsRate);
+
+    for (auto& filter : filters) {
+        filter->close();
+    }
+    demux->close();
+}
+
+BENCHMARK(BM_DispatchTsPackets)->RangeMultiplier(4)->Range(1, 1024);
+
+}  // namespace
+
+}  // namespace tuner
+}  // namespace tv
+}  // namespace hardware
+}  // namespace android
+}  // namespace aidl
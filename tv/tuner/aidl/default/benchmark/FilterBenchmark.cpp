@@ -0,0 +1,211 @@
+/*
+ * Copyright 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Benchmarks for the latency from the Demux input to the IFilterCallback::onFilterEvent callback.
+
+#include <aidl/android/hardware/tv/tuner/BnFilterCallback.h>
+#include <aidl/android/hardware/tv/tuner/DemuxQueueNotifyBits.h>
+#include <benchmark/benchmark.h>
+#include <utils/SystemClock.h>
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "Demux.h"
+#include "Filter.h"
+#include "Tuner.h"
+
+namespace aidl {
+namespace android {
+namespace hardware {
+namespace tv {
+namespace tuner {
+
+namespace {
+
+using ::android::elapsedRealtimeNano;
+using ::benchmark::Counter;
+using ::benchmark::State;
+
+constexpr int32_t FILTER_BUFFER_SIZE = 0x100000;
+constexpr int TS_PACKET_SIZE = 188;
+constexpr int32_t FIRST_PID = 0x100;
+constexpr auto EVENT_TIMEOUT = std::chrono::seconds(1);
+
+// Counts the section events received by all the filters.
+class SectionEventCounter {
+  public:
+    void onSectionEvent() {
+        {
+            std::lock_guard<std::mutex> lock(mLock);
+            mCount++;
+            mTotalLatencyInNano += elapsedRealtimeNano() - mInputTimestamp;
+        }
+        mCv.notify_all();
+    }
+
+    void setInputTimestamp(int64_t timestamp) {
+        std::lock_guard<std::mutex> lock(mLock);
+        mInputTimestamp = timestamp;
+    }
+
+    bool waitForCount(int64_t count) {
+        std::unique_lock<std::mutex> lock(mLock);
+        return mCv.wait_for(lock, EVENT_TIMEOUT, [this, count] { return mCount >= count; });
+    }
+
+    int64_t getTotalLatencyInNano() {
+        std::lock_guard<std::mutex> lock(mLock);
+        return mTotalLatencyInNano;
+    }
+
+  private:
+    std::mutex mLock;
+    std::condition_variable mCv;
+    int64_t mCount = 0;
+    int64_t mInputTimestamp = 0;
+    int64_t mTotalLatencyInNano = 0;
+};
+
+// Reads the section data out of the filter FMQ and notifies the filter, like the framework does.
+class SectionFilterCallback : public BnFilterCallback {
+  public:
+    explicit SectionFilterCallback(SectionEventCounter* counter) : mCounter(counter) {}
+
+    ~SectionFilterCallback() {
+        if (mEventFlag != nullptr) {
+            EventFlag::deleteEventFlag(&mEventFlag);
+        }
+    }
+
+    bool init(const std::shared_ptr<IFilter>& filter) {
+        MQDescriptor<int8_t, SynchronizedReadWrite> desc;
+        if (!filter->getQueueDesc(&desc).isOk()) {
+            return false;
+        }
+        mFilterMQ = std::make_unique<FilterMQ>(desc, /*resetPointers=*/true);
+        return mFilterMQ->isValid() &&
+               EventFlag::createEventFlag(mFilterMQ->getEventFlagWord(), &mEventFlag) ==
+                       ::android::OK;
+    }
+
+    ::ndk::ScopedAStatus onFilterEvent(const std::vector<DemuxFilterEvent>& events) override {
+        for (const auto& event : events) {
+            if (event.getTag() != DemuxFilterEvent::Tag::section) {
+                continue;
+            }
+            int32_t dataLength = event.get<DemuxFilterEvent::Tag::section>().dataLength;
+            mBuffer.resize(dataLength);
+            mFilterMQ->read(mBuffer.data(), dataLength);
+            mEventFlag->wake(static_cast<uint32_t>(DemuxQueueNotifyBits::DATA_CONSUMED));
+            mCounter->onSectionEvent();
+        }
+        return ::ndk::ScopedAStatus::ok();
+    }
+
+    ::ndk::ScopedAStatus onFilterStatus(DemuxFilterStatus /*status*/) override {
+        return ::ndk::ScopedAStatus::ok();
+    }
+
+  private:
+    SectionEventCounter* mCounter;
+    std::unique_ptr<FilterMQ> mFilterMQ;
+    EventFlag* mEventFlag = nullptr;
+    std::vector<int8_t> mBuffer;
+};
+
+std::vector<int8_t> createTsPacket(int32_t pid) {
+    std::vector<int8_t> packet(TS_PACKET_SIZE, 0);
+    packet[0] = 0x47;
+    packet[1] = static_cast<int8_t>((pid >> 8) & 0x1f);
+    packet[2] = static_cast<int8_t>(pid & 0xff);
+    return packet;
+}
+
+// Sends one TS packet to each of the 'state.range(0)' started section filters through the Demux,
+// and measures until all the filters have delivered the section event.
+void BM_DemuxInputToFilterEvent(State& state) {
+    const int filterCount = state.range(0);
+    auto tuner = ::ndk::SharedRefBase::make<Tuner>();
+    tuner->init();
+    std::vector<int32_t> demuxIds;
+    std::shared_ptr<IDemux> demuxInterface;
+    tuner->openDemux(&demuxIds, &demuxInterface);
+    auto demux = std::static_pointer_cast<Demux>(demuxInterface);
+
+    SectionEventCounter counter;
+    std::vector<std::shared_ptr<IFilter>> filters;
+    std::vector<std::vector<int8_t>> packets;
+    DemuxFilterType type;
+    type.mainType = DemuxFilterMainType::TS;
+    type.subType.set<DemuxFilterSubType::Tag::tsFilterType>(DemuxTsFilterType::SECTION);
+    for (int i = 0; i < filterCount; i++) {
+        auto callback = ::ndk::SharedRefBase::make<SectionFilterCallback>(&counter);
+        std::shared_ptr<IFilter> filter;
+        if (!demux->openFilter(type, FILTER_BUFFER_SIZE, callback, &filter).isOk() ||
+            !callback->init(filter)) {
+            state.SkipWithError("failed to open filter");
+            return;
+        }
+        DemuxTsFilterSettings tsSettings;
+        tsSettings.tpid = FIRST_PID + i;
+        DemuxFilterSettings settings;
+        settings.set<DemuxFilterSettings::Tag::ts>(tsSettings);
+        filter->configure(settings);
+        filter->start();
+        filters.push_back(filter);
+        packets.push_back(createTsPacket(FIRST_PID + i));
+    }
+
+    int64_t expectedCount = 0;
+    for (auto _ : state) {
+        counter.setInputTimestamp(elapsedRealtimeNano());
+        for (auto& packet : packets) {
+            demux->startBroadcastTsFilter(packet);
+        }
+        demux->startBroadcastFilterDispatcher();
+        expectedCount += filterCount;
+        if (!counter.waitForCount(expectedCount)) {
+            state.SkipWithError("timed out waiting for the filter events");
+            break;
+        }
+    }
+
+    state.counters["avg_event_latency_us"] =
+            Counter(static_cast<double>(counter.getTotalLatencyInNano()) / 1000 /
+                    std::max<int64_t>(expectedCount, 1));
+
+    for (auto& filter : filters) {
+        filter->close();
+    }
+    demux->close();
+}
+
+BENCHMARK(BM_DemuxInputToFilterEvent)->Arg(1)->Arg(8)->Arg(32)->UseRealTime();
+
+}  // namespace
+
+}  // namespace tuner
+}  // namespace tv
+}  // namespace hardware
+}  // namespace android
+}  // namespace aidl
+
+BENCHMARK_MAIN();
@@ -17,6 +17,7 @@
 #ifndef HIDL_CALLBACK_UTIL_H_
 #define HIDL_CALLBACK_UTIL_H_
 
+#include <mutex>
 #include <set>
 
 #include <hidl/HidlSupport.h>
@@ -57,6 +58,9 @@ namespace hidl_callback_util {
 template <typename CallbackType>
 // Provides a class to manage callbacks for the various HIDL interfaces and
 // handle the death of the process hosting each callback.
+// Thread safe: callbacks are added on the HIDL thread, iterated on the legacy
+// HAL event loop thread and removed on the hwbinder thread delivering the death
+// notification.
 class HidlCallbackHandler {
   public:
     HidlCallbackHandler()
@@ -69,6 +73,7 @@ class HidlCallbackHandler {
         // (callback proxy's raw pointer) to track the death of individual
         // clients.
         uint64_t cookie = reinterpret_cast<uint64_t>(cb.get());
+        std::lock_guard<std::mutex> lock(mutex_);
         for (const auto& s : cb_set_) {
             if (interfacesEqual(cb, s)) {
                 LOG(ERROR) << "Duplicate death notification registration";
@@ -83,11 +88,17 @@ class HidlCallbackHandler {
         return true;
     }
 
-    const std::set<android::sp<CallbackType>>& getCallbacks() { return cb_set_; }
+    // Returns a snapshot, so that the callbacks can be invoked without holding
+    // the lock.
+    std::set<android::sp<CallbackType>> getCallbacks() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return cb_set_;
+    }
 
     // Death notification for callbacks.
     void onObjectDeath(uint64_t cookie) {
         CallbackType* cb = reinterpret_cast<CallbackType*>(cookie);
+        std::lock_guard<std::mutex> lock(mutex_);
         const auto& iter = cb_set_.find(cb);
         if (iter == cb_set_.end()) {
             LOG(ERROR) << "Unknown callback death notification received";
@@ -98,15 +109,20 @@ class HidlCallbackHandler {
     }
 
     void invalidate() {
-        for (const sp<CallbackType>& cb : cb_set_) {
+        std::set<sp<CallbackType>> cb_set;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            cb_set.swap(cb_set_);
+        }
+        for (const sp<CallbackType>& cb : cb_set) {
             if (!cb->unlinkToDeath(death_handler_)) {
                 LOG(ERROR) << "Failed to deregister death notification";
             }
         }
-        cb_set_.clear();
     }
 
   private:
+    std::mutex mutex_;
     std::set<sp<CallbackType>> cb_set_;
     sp<HidlDeathHandler<CallbackType>> death_handler_;
 
@@ -19,14 +19,17 @@
 
 #include <mutex>
 
-// Utility that provides a global lock to synchronize access between
-// the HIDL thread and the legacy HAL's event loop.
+// Utility that provides the global lock serializing the chip level HIDL
+// methods. See THREADING.README.
 namespace android {
 namespace hardware {
 namespace wifi {
 namespace V1_6 {
 namespace implementation {
 namespace hidl_sync_util {
+// Lock serializing the HIDL methods of IWifi and IWifiChip, which start and
+// stop the legacy HAL and create and remove the interfaces. Also held by the
+// legacy HAL event loop thread while it completes a stop.
 std::unique_lock<std::recursive_mutex> acquireGlobalLock();
 }  // namespace hidl_sync_util
 }  // namespace implementation
@@ -0,0 +1,298 @@
+/*
+ * Copyright (C) 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <atomic>
+#include <thread>
+
+#include <android-base/logging.h>
+#include <android-base/macros.h>
+#include <gmock/gmock.h>
+
+#undef NAN  // This is weird, NAN is defined in bionic/libc/include/math.h:38
+#include "wifi_legacy_hal.h"
+#include "wifi_legacy_hal_stubs.h"
+#include "wifi_nan_iface.h"
+#include "wifi_sta_iface.h"
+
+#include "mock_interface_tool.h"
+#include "mock_wifi_iface_util.h"
+
+using testing::_;
+using testing::InvokeWithoutArgs;
+using testing::NiceMock;
+using testing::Test;
+
+namespace {
+constexpr char kStaIfaceName[] = "mockWlan0";
+constexpr char kNanIfaceName[] = "mockWlan1";
+constexpr uint32_t kCmdId = 1;
+constexpr int kIterations = 1000;
+
+// Handlers the legacy HAL passes to the stubbed function table, used to inject
+// events as the driver would. Captured once, before any event is injected.
+std::atomic<bool> g_scan_handler_captured;
+wifi_scan_result_handler g_scan_handler;
+std::atomic<bool> g_nan_handler_captured;
+NanCallbackHandler g_nan_handler;
+// Number of background scan stops that reached the driver.
+std::atomic<int> g_stop_gscan_calls;
+// While set, fetching the cached scan results blocks, holding the event loop
+// thread in the middle of a gscan event.
+std::atomic<bool> g_block_cached_results;
+std::atomic<bool> g_fetching_cached_results;
+}  // namespace
+
+namespace android {
+namespace hardware {
+namespace wifi {
+namespace V1_6 {
+namespace implementation {
+
+class MockStaIfaceEventCallback : public V1_0::IWifiStaIfaceEventCallback {
+  public:
+    MockStaIfaceEventCallback() = default;
+
+    MOCK_METHOD1(onBackgroundScanFailure, Return<void>(uint32_t));
+    MOCK_METHOD3(onBackgroundFullScanResult,
+                 Return<void>(uint32_t, uint32_t, const V1_0::StaScanResult&));
+    MOCK_METHOD2(onBackgroundScanResults,
+                 Return<void>(uint32_t, const hidl_vec<V1_0::StaScanData>&));
+    MOCK_METHOD3(onRssiThresholdBreached,
+                 Return<void>(uint32_t, const hidl_array<uint8_t, 6>&, int32_t));
+};
+
+class MockNanIfaceEventCallback_1_0 : public V1_0::IWifiNanIfaceEventCallback {
+  public:
+    MockNanIfaceEventCallback_1_0() = default;
+
+    MOCK_METHOD3(notifyCapabilitiesResponse,
+                 Return<void>(uint16_t, const V1_0::WifiNanStatus&, const V1_0::NanCapabilities&));
+    MOCK_METHOD2(notifyEnableResponse, Return<void>(uint16_t, const V1_0::WifiNanStatus&));
+    MOCK_METHOD2(notifyConfigResponse, Return<void>(uint16_t, const V1_0::WifiNanStatus&));
+    MOCK_METHOD2(notifyDisableResponse, Return<void>(uint16_t, const V1_0::WifiNanStatus&));
+    MOCK_METHOD3(notifyStartPublishResponse,
+                 Return<void>(uint16_t, const V1_0::WifiNanStatus&, uint8_t));
+    MOCK_METHOD2(notifyStopPublishResponse, Return<void>(uint16_t, const V1_0::WifiNanStatus&));
+    MOCK_METHOD3(notifyStartSubscribeResponse,
+                 Return<void>(uint16_t, const V1_0::WifiNanStatus&, uint8_t));
+    MOCK_METHOD2(notifyStopSubscribeResponse, Return<void>(uint16_t, const V1_0::WifiNanStatus&));
+    MOCK_METHOD2(notifyTransmitFollowupResponse,
+                 Return<void>(uint16_t, const V1_0::WifiNanStatus&));
+    MOCK_METHOD2(notifyCreateDataInterfaceResponse,
+                 Return<void>(uint16_t, const V1_0::WifiNanStatus&));
+    MOCK_METHOD2(notifyDeleteDataInterfaceResponse,
+                 Return<void>(uint16_t, const V1_0::WifiNanStatus&));
+    MOCK_METHOD3(notifyInitiateDataPathResponse,
+                 Return<void>(uint16_t, const V1_0::WifiNanStatus&, uint32_t));
+    MOCK_METHOD2(notifyRespondToDataPathIndicationResponse,
+                 Return<void>(uint16_t, const V1_0::WifiNanStatus&));
+    MOCK_METHOD2(notifyTerminateDataPathResponse,
+                 Return<void>(uint16_t, const V1_0::WifiNanStatus&));
+    MOCK_METHOD1(eventClusterEvent, Return<void>(const V1_0::NanClusterEventInd&));
+    MOCK_METHOD1(eventDisabled, Return<void>(const V1_0::WifiNanStatus&));
+    MOCK_METHOD2(eventPublishTerminated, Return<void>(uint8_t, const V1_0::WifiNanStatus&));
+    MOCK_METHOD2(eventSubscribeTerminated, Return<void>(uint8_t, const V1_0::WifiNanStatus&));
+    MOCK_METHOD1(eventMatch, Return<void>(const V1_0::NanMatchInd&));
+    MOCK_METHOD2(eventMatchExpired, Return<void>(uint8_t, uint32_t));
+    MOCK_METHOD1(eventFollowupReceived, Return<void>(const V1_0::NanFollowupReceivedInd&));
+    MOCK_METHOD2(eventTransmitFollowup, Return<void>(uint16_t, const V1_0::WifiNanStatus&));
+    MOCK_METHOD1(eventDataPathRequest, Return<void>(const V1_0::NanDataPathRequestInd&));
+    MOCK_METHOD1(eventDataPathConfirm, Return<void>(const V1_0::NanDataPathConfirmInd&));
+    MOCK_METHOD1(eventDataPathTerminated, Return<void>(uint32_t));
+};
+
+// Runs HIDL methods of a STA and a NAN iface on several threads while scan and
+// NAN events are injected through the legacy HAL function table, as the legacy
+// HAL event loop thread would.
+class WifiLegacyHalStressTest : public Test {
+  protected:
+    void SetUp() override {
+        ASSERT_TRUE(legacy_hal::initHalFuncTableWithStubs(&fn_));
+        fn_.wifi_start_gscan = [](wifi_request_id, wifi_interface_handle, wifi_scan_cmd_params,
+                                  wifi_scan_result_handler handler) {
+            if (!g_scan_handler_captured.exchange(true)) {
+                g_scan_handler = handler;
+            }
+            return WIFI_SUCCESS;
+        };
+        fn_.wifi_stop_gscan = [](wifi_request_id, wifi_interface_handle) {
+            g_stop_gscan_calls++;
+            return WIFI_SUCCESS;
+        };
+        fn_.wifi_get_cached_gscan_results = [](wifi_interface_handle, byte, int,
+                                               wifi_cached_scan_results*, int* num) {
+            g_fetching_cached_results = true;
+            while (g_block_cached_results) {
+                std::this_thread::yield();
+            }
+            g_fetching_cached_results = false;
+            *num = 0;
+            return WIFI_ERROR_NOT_SUPPORTED;
+        };
+        fn_.wifi_nan_register_handler = [](wifi_interface_handle, NanCallbackHandler handlers) {
+            if (!g_nan_handler_captured.exchange(true)) {
+                g_nan_handler = handlers;
+            }
+            return WIFI_SUCCESS;
+        };
+        legacy_hal_ = std::make_shared<legacy_hal::WifiLegacyHal>(iface_tool_, fn_, true);
+        iface_util_ = std::make_shared<NiceMock<iface_util::MockWifiIfaceUtil>>(iface_tool_,
+                                                                                legacy_hal_);
+        sta_iface_ = new WifiStaIface(kStaIfaceName, legacy_hal_, iface_util_);
+        nan_iface_ = new WifiNanIface(kNanIfaceName, false, legacy_hal_, iface_util_);
+
+        ON_CALL(*sta_event_callback_, onBackgroundFullScanResult(_, _, _))
+                .WillByDefault(InvokeWithoutArgs([this]() {
+                    full_scan_results_++;
+                    return Void();
+                }));
+        ON_CALL(*nan_event_callback_, eventDisabled(_)).WillByDefault(InvokeWithoutArgs([this]() {
+            nan_disabled_events_++;
+            return Void();
+        }));
+        sta_iface_->registerEventCallback(sta_event_callback_, expectSuccess);
+        nan_iface_->registerEventCallback(nan_event_callback_, expectSuccess);
+    }
+
+    void TearDown() override {
+        sta_iface_->stopBackgroundScan(kCmdId, [](const WifiStatus&) {});
+        sta_iface_->invalidate();
+        nan_iface_->invalidate();
+    }
+
+    static void expectSuccess(const WifiStatus& status) {
+        EXPECT_EQ(WifiStatusCode::SUCCESS, status.code);
+    }
+
+    void startBackgroundScan() {
+        sta_iface_->startBackgroundScan(kCmdId, {}, [](const WifiStatus&) {});
+    }
+
+    // Stops the background scan, expecting it to be running.
+    void expectStopBackgroundScanReachesDriver() {
+        const int stop_gscan_calls = g_stop_gscan_calls;
+        sta_iface_->stopBackgroundScan(kCmdId, expectSuccess);
+        EXPECT_EQ(stop_gscan_calls + 1, g_stop_gscan_calls);
+    }
+
+    void injectFullScanResult() {
+        wifi_scan_result result = {};
+        g_scan_handler.on_full_scan_result(kCmdId, &result, 1);
+    }
+
+    void injectNanDisabled() {
+        NanDisabledInd event = {};
+        g_nan_handler.EventDisabled(&event);
+    }
+
+    legacy_hal::wifi_hal_fn fn_;
+    std::shared_ptr<NiceMock<wifi_system::MockInterfaceTool>> iface_tool_{
+            new NiceMock<wifi_system::MockInterfaceTool>};
+    std::shared_ptr<legacy_hal::WifiLegacyHal> legacy_hal_;
+    std::shared_ptr<NiceMock<iface_util::MockWifiIfaceUtil>> iface_util_;
+    sp<WifiStaIface> sta_iface_;
+    sp<WifiNanIface> nan_iface_;
+    sp<NiceMock<MockStaIfaceEventCallback>> sta_event_callback_{
+            new NiceMock<MockStaIfaceEventCallback>};
+    sp<NiceMock<MockNanIfaceEventCallback_1_0>> nan_event_callback_{
+            new NiceMock<MockNanIfaceEventCallback_1_0>};
+    std::atomic<int> full_scan_results_{0};
+    std::atomic<int> nan_disabled_events_{0};
+};
+
+TEST_F(WifiLegacyHalStressTest, EventsDeliveredDuringConcurrentHidlCalls) {
+    startBackgroundScan();
+    ASSERT_TRUE(g_scan_handler_captured);
+    ASSERT_TRUE(g_nan_handler_captured);
+    injectFullScanResult();
+    injectNanDisabled();
+    EXPECT_EQ(1, full_scan_results_);
+    EXPECT_EQ(1, nan_disabled_events_);
+
+    std::thread sta_hidl_thread([this]() {
+        for (int i = 0; i < kIterations; i++) {
+            sta_iface_->stopBackgroundScan(kCmdId, [](const WifiStatus&) {});
+            startBackgroundScan();
+            sta_iface_->registerEventCallback(sta_event_callback_, expectSuccess);
+        }
+    });
+    std::thread nan_hidl_thread([this]() {
+        for (int i = 0; i < kIterations; i++) {
+            nan_iface_->registerEventCallback(nan_event_callback_, expectSuccess);
+            nan_iface_->getName([](const WifiStatus& status, const hidl_string& name) {
+                EXPECT_EQ(WifiStatusCode::SUCCESS, status.code);
+                EXPECT_EQ(kNanIfaceName, std::string(name));
+            });
+        }
+    });
+    std::thread event_loop_thread([this]() {
+        for (int i = 0; i < kIterations; i++) {
+            injectFullScanResult();
+            // Fails to fetch the cached results from the stubbed legacy HAL,
+            // which ends the background scan from the event loop thread.
+            g_scan_handler.on_scan_event(kCmdId, WIFI_SCAN_RESULTS_AVAILABLE);
+            injectNanDisabled();
+        }
+    });
+    sta_hidl_thread.join();
+    nan_hidl_thread.join();
+    event_loop_thread.join();
+
+    // The NAN callbacks stay registered, so none of their events may be lost.
+    // Scan results are only delivered while a scan is running.
+    EXPECT_EQ(1 + kIterations, nan_disabled_events_);
+
+    // Events are still delivered once the HIDL calls are done.
+    const int full_scan_results = full_scan_results_;
+    sta_iface_->stopBackgroundScan(kCmdId, [](const WifiStatus&) {});
+    startBackgroundScan();
+    injectFullScanResult();
+    injectNanDisabled();
+    EXPECT_EQ(full_scan_results + 1, full_scan_results_);
+    EXPECT_EQ(kIterations + 2, nan_disabled_events_);
+
+    // The scan started last is still running.
+    expectStopBackgroundScanReachesDriver();
+}
+
+TEST_F(WifiLegacyHalStressTest, ScanFailureDoesNotEndScanStartedMeanwhile) {
+    startBackgroundScan();
+    ASSERT_TRUE(g_scan_handler_captured);
+
+    // The scan fails on the event loop thread, which is held until the HIDL
+    // thread has restarted the scan.
+    g_block_cached_results = true;
+    std::thread event_loop_thread(
+            []() { g_scan_handler.on_scan_event(kCmdId, WIFI_SCAN_RESULTS_AVAILABLE); });
+    while (!g_fetching_cached_results) {
+        std::this_thread::yield();
+    }
+    expectStopBackgroundScanReachesDriver();
+    startBackgroundScan();
+    g_block_cached_results = false;
+    event_loop_thread.join();
+
+    // The restarted scan still delivers its results and can be stopped.
+    const int full_scan_results = full_scan_results_;
+    injectFullScanResult();
+    EXPECT_EQ(full_scan_results + 1, full_scan_results_);
+    expectStopBackgroundScanReachesDriver();
+}
+}  // namespace implementation
+}  // namespace V1_6
+}  // namespace wifi
+}  // namespace hardware
+}  // namespace android
@@ -48,6 +48,10 @@ bool Wifi::isValid() {
     return true;
 }
 
+std::unique_lock<std::recursive_mutex> Wifi::acquireLock() {
+    return hidl_sync_util::acquireGlobalLock();
+}
+
 Return<void> Wifi::registerEventCallback(const sp<V1_0::IWifiEventCallback>& event_callback,
                                          registerEventCallback_cb hidl_status_cb) {
     return validateAndCall(this, WifiStatusCode::ERROR_UNKNOWN,
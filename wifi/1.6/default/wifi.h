@@ -26,6 +26,7 @@
 #include <android-base/macros.h>
 #include <utils/Looper.h>
 #include <functional>
+#include <mutex>
 
 #include "hidl_callback_util.h"
 #include "wifi_chip.h"
@@ -51,6 +52,8 @@ class Wifi : public V1_6::IWifi {
          const std::shared_ptr<feature_flags::WifiFeatureFlags> feature_flags);
 
     bool isValid();
+    // Returns the global lock, refer to |hidl_sync_util::acquireGlobalLock()|.
+    std::unique_lock<std::recursive_mutex> acquireLock();
 
     // HIDL methods exposed.
     Return<void> registerEventCallback(const sp<V1_0::IWifiEventCallback>& event_callback,
@@ -38,6 +38,7 @@ WifiApIface::WifiApIface(const std::string& ifname, const std::vector<std::strin
       is_valid_(true) {}
 
 void WifiApIface::invalidate() {
+    const auto lock = acquireLock();
     legacy_hal_.reset();
     is_valid_ = false;
 }
@@ -46,6 +47,10 @@ bool WifiApIface::isValid() {
     return is_valid_;
 }
 
+std::unique_lock<std::recursive_mutex> WifiApIface::acquireLock() {
+    return std::unique_lock<std::recursive_mutex>{lock_};
+}
+
 std::string WifiApIface::getName() {
     return ifname_;
 }
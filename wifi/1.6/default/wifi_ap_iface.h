@@ -17,6 +17,9 @@
 #ifndef WIFI_AP_IFACE_H_
 #define WIFI_AP_IFACE_H_
 
+#include <atomic>
+#include <mutex>
+
 #include <android-base/macros.h>
 #include <android/hardware/wifi/1.5/IWifiApIface.h>
 
@@ -41,6 +44,9 @@ class WifiApIface : public V1_5::IWifiApIface {
     // Refer to |WifiChip::invalidate()|.
     void invalidate();
     bool isValid();
+    // Returns the lock serializing the HIDL methods of this object. Refer to
+    // THREADING.README.
+    std::unique_lock<std::recursive_mutex> acquireLock();
     std::string getName();
     void removeInstance(std::string instance);
 
@@ -75,7 +81,8 @@ class WifiApIface : public V1_5::IWifiApIface {
     std::vector<std::string> instances_;
     std::weak_ptr<legacy_hal::WifiLegacyHal> legacy_hal_;
     std::weak_ptr<iface_util::WifiIfaceUtil> iface_util_;
-    bool is_valid_;
+    std::atomic<bool> is_valid_;
+    std::recursive_mutex lock_;
 
     DISALLOW_COPY_AND_ASSIGN(WifiApIface);
 };
@@ -395,6 +395,10 @@ bool WifiChip::isValid() {
     return is_valid_;
 }
 
+std::unique_lock<std::recursive_mutex> WifiChip::acquireLock() {
+    return hidl_sync_util::acquireGlobalLock();
+}
+
 std::set<sp<V1_4::IWifiChipEventCallback>> WifiChip::getEventCallbacks() {
     return event_cb_handler_.getCallbacks();
 }
@@ -1286,8 +1290,11 @@ WifiStatus WifiChip::startLoggingToDebugRingBufferInternal(
             getFirstActiveWlanIfaceName(), ring_name,
             static_cast<std::underlying_type<WifiDebugRingBufferVerboseLevel>::type>(verbose_level),
             max_interval_in_sec, min_data_size_in_bytes);
-    ringbuffer_map_.insert(
-            std::pair<std::string, Ringbuffer>(ring_name, Ringbuffer(kMaxBufferSizeBytes)));
+    {
+        std::unique_lock<std::mutex> lk(lock_t);
+        ringbuffer_map_.insert(
+                std::pair<std::string, Ringbuffer>(ring_name, Ringbuffer(kMaxBufferSizeBytes)));
+    }
     // if verbose logging enabled, turn up HAL daemon logging as well.
     if (verbose_level < WifiDebugRingBufferVerboseLevel::VERBOSE) {
         android::base::SetMinimumLogSeverity(android::base::DEBUG);
@@ -1633,6 +1640,8 @@ WifiStatus WifiChip::registerDebugRingBufferCallback() {
                 }
                 if (appendstatus == Ringbuffer::AppendStatus::FAIL_RING_BUFFER_CORRUPTED) {
                     LOG(ERROR) << "Ringname " << name << " is corrupted. Clear the ring buffer";
+                    // Serialize with the HIDL methods writing the files.
+                    const auto lock = hidl_sync_util::acquireGlobalLock();
                     shared_ptr_this->writeRingbufferFilesInternal();
                     return;
                 }
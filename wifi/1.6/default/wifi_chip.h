@@ -22,6 +22,7 @@
 // the macro is defined. Undefine NAN to work around it.
 #undef NAN
 
+#include <atomic>
 #include <list>
 #include <map>
 #include <mutex>
@@ -78,6 +79,8 @@ class WifiChip : public V1_6::IWifiChip {
     // marked valid before processing them.
     void invalidate();
     bool isValid();
+    // Returns the global lock, refer to |hidl_sync_util::acquireGlobalLock()|.
+    std::unique_lock<std::recursive_mutex> acquireLock();
     std::set<sp<V1_4::IWifiChipEventCallback>> getEventCallbacks();
 
     // HIDL methods exposed.
@@ -292,7 +295,7 @@ class WifiChip : public V1_6::IWifiChip {
     std::vector<sp<WifiStaIface>> sta_ifaces_;
     std::vector<sp<WifiRttController>> rtt_controllers_;
     std::map<std::string, Ringbuffer> ringbuffer_map_;
-    bool is_valid_;
+    std::atomic<bool> is_valid_;
     // Members pertaining to chip configuration.
     uint32_t current_mode_id_;
     std::mutex lock_t;
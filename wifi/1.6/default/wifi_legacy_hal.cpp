@@ -16,6 +16,9 @@
 
 #include <array>
 #include <chrono>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
 
 #include <android-base/logging.h>
 #include <cutils/properties.h>
@@ -58,9 +61,56 @@ namespace V1_6 {
 namespace implementation {
 namespace legacy_hal {
 
+// Holds the std::function invoked by an asynchronous "C" style callback. It is
+// set and reset on the HIDL thread while the legacy HAL event loop thread may be
+// invoking it, so the function is swapped atomically instead of being guarded by
+// the global lock: an invocation keeps the function it loaded alive until it
+// returns, even if the slot is reset or set again meanwhile.
+template <typename Signature>
+class CallbackSlot {
+  public:
+    using Function = std::function<Signature>;
+
+    CallbackSlot& operator=(Function function) {
+        std::shared_ptr<const Function> stored;
+        if (function) {
+            stored = std::make_shared<const Function>(std::move(function));
+        }
+        std::atomic_store(&function_, std::move(stored));
+        return *this;
+    }
+
+    CallbackSlot& operator=(std::nullptr_t) {
+        std::atomic_store(&function_, std::shared_ptr<const Function>());
+        return *this;
+    }
+
+    explicit operator bool() const { return load() != nullptr; }
+
+    std::shared_ptr<const Function> load() const { return std::atomic_load(&function_); }
+
+    // Resets the slot unless it was set again since |function| was loaded.
+    void resetIfUnchanged(std::shared_ptr<const Function> function) {
+        std::atomic_compare_exchange_strong(&function_, &function,
+                                            std::shared_ptr<const Function>());
+    }
+
+    // Does nothing if the slot is not set.
+    template <typename... Args>
+    void operator()(Args&&... args) const {
+        if (const auto function = load()) {
+            (*function)(std::forward<Args>(args)...);
+        }
+    }
+
+  private:
+    std::shared_ptr<const Function> function_;
+};
+
 // Legacy HAL functions accept "C" style function pointers, so use global
 // functions to pass to the legacy HAL function and store the corresponding
-// std::function methods to be invoked.
+// std::function methods to be invoked. The asynchronous ones are stored in a
+// |CallbackSlot|.
 //
 // Callback to be invoked once |stop| is complete
 std::function<void(wifi_handle handle)> on_stop_complete_internal_callback;
@@ -89,24 +139,25 @@ void onSyncFirmwareMemoryDump(char* buffer, int buffer_size) {
     }
 }
 
-// Callback to be invoked for Gscan events.
-std::function<void(wifi_request_id, wifi_scan_event)> on_gscan_event_internal_callback;
+// Callback to be invoked for Gscan events. Returns true if the event ends the
+// background scan.
+CallbackSlot<bool(wifi_request_id, wifi_scan_event)> on_gscan_event_internal_callback;
+// Callback to be invoked for Gscan full results.
+CallbackSlot<void(wifi_request_id, wifi_scan_result*, uint32_t)>
+        on_gscan_full_result_internal_callback;
 void onAsyncGscanEvent(wifi_request_id id, wifi_scan_event event) {
-    const auto lock = hidl_sync_util::acquireGlobalLock();
-    if (on_gscan_event_internal_callback) {
-        on_gscan_event_internal_callback(id, event);
+    const auto full_result_callback = on_gscan_full_result_internal_callback.load();
+    const auto event_callback = on_gscan_event_internal_callback.load();
+    if (event_callback && (*event_callback)(id, event)) {
+        // Keep the callbacks of a scan started again while the event was handled.
+        on_gscan_event_internal_callback.resetIfUnchanged(event_callback);
+        on_gscan_full_result_internal_callback.resetIfUnchanged(full_result_callback);
     }
 }
 
-// Callback to be invoked for Gscan full results.
-std::function<void(wifi_request_id, wifi_scan_result*, uint32_t)>
-        on_gscan_full_result_internal_callback;
 void onAsyncGscanFullResult(wifi_request_id id, wifi_scan_result* result,
                             uint32_t buckets_scanned) {
-    const auto lock = hidl_sync_util::acquireGlobalLock();
-    if (on_gscan_full_result_internal_callback) {
-        on_gscan_full_result_internal_callback(id, result, buckets_scanned);
-    }
+    on_gscan_full_result_internal_callback(id, result, buckets_scanned);
 }
 
 // Callback to be invoked for link layer stats results.
@@ -120,62 +171,46 @@ void onSyncLinkLayerStatsResult(wifi_request_id id, wifi_iface_stat* iface_stat,
 }
 
 // Callback to be invoked for rssi threshold breach.
-std::function<void((wifi_request_id, uint8_t*, int8_t))>
+CallbackSlot<void((wifi_request_id, uint8_t*, int8_t))>
         on_rssi_threshold_breached_internal_callback;
 void onAsyncRssiThresholdBreached(wifi_request_id id, uint8_t* bssid, int8_t rssi) {
-    const auto lock = hidl_sync_util::acquireGlobalLock();
-    if (on_rssi_threshold_breached_internal_callback) {
-        on_rssi_threshold_breached_internal_callback(id, bssid, rssi);
-    }
+    on_rssi_threshold_breached_internal_callback(id, bssid, rssi);
 }
 
 // Callback to be invoked for ring buffer data indication.
-std::function<void(char*, char*, int, wifi_ring_buffer_status*)>
+CallbackSlot<void(char*, char*, int, wifi_ring_buffer_status*)>
         on_ring_buffer_data_internal_callback;
 void onAsyncRingBufferData(char* ring_name, char* buffer, int buffer_size,
                            wifi_ring_buffer_status* status) {
-    const auto lock = hidl_sync_util::acquireGlobalLock();
-    if (on_ring_buffer_data_internal_callback) {
-        on_ring_buffer_data_internal_callback(ring_name, buffer, buffer_size, status);
-    }
+    on_ring_buffer_data_internal_callback(ring_name, buffer, buffer_size, status);
 }
 
 // Callback to be invoked for error alert indication.
-std::function<void(wifi_request_id, char*, int, int)> on_error_alert_internal_callback;
+CallbackSlot<void(wifi_request_id, char*, int, int)> on_error_alert_internal_callback;
 void onAsyncErrorAlert(wifi_request_id id, char* buffer, int buffer_size, int err_code) {
-    const auto lock = hidl_sync_util::acquireGlobalLock();
-    if (on_error_alert_internal_callback) {
-        on_error_alert_internal_callback(id, buffer, buffer_size, err_code);
-    }
+    on_error_alert_internal_callback(id, buffer, buffer_size, err_code);
 }
 
 // Callback to be invoked for radio mode change indication.
-std::function<void(wifi_request_id, uint32_t, wifi_mac_info*)>
+CallbackSlot<void(wifi_request_id, uint32_t, wifi_mac_info*)>
         on_radio_mode_change_internal_callback;
 void onAsyncRadioModeChange(wifi_request_id id, uint32_t num_macs, wifi_mac_info* mac_infos) {
-    const auto lock = hidl_sync_util::acquireGlobalLock();
-    if (on_radio_mode_change_internal_callback) {
-        on_radio_mode_change_internal_callback(id, num_macs, mac_infos);
-    }
+    on_radio_mode_change_internal_callback(id, num_macs, mac_infos);
 }
 
 // Callback to be invoked to report subsystem restart
-std::function<void(const char*)> on_subsystem_restart_internal_callback;
+CallbackSlot<void(const char*)> on_subsystem_restart_internal_callback;
 void onAsyncSubsystemRestart(const char* error) {
-    const auto lock = hidl_sync_util::acquireGlobalLock();
-    if (on_subsystem_restart_internal_callback) {
-        on_subsystem_restart_internal_callback(error);
-    }
+    on_subsystem_restart_internal_callback(error);
 }
 
 // Callback to be invoked for rtt results results.
-std::function<void(wifi_request_id, unsigned num_results, wifi_rtt_result* rtt_results[])>
+CallbackSlot<void(wifi_request_id, unsigned num_results, wifi_rtt_result* rtt_results[])>
         on_rtt_results_internal_callback;
 void onAsyncRttResults(wifi_request_id id, unsigned num_results, wifi_rtt_result* rtt_results[]) {
-    const auto lock = hidl_sync_util::acquireGlobalLock();
-    if (on_rtt_results_internal_callback) {
-        on_rtt_results_internal_callback(id, num_results, rtt_results);
-        on_rtt_results_internal_callback = nullptr;
+    if (const auto callback = on_rtt_results_internal_callback.load()) {
+        (*callback)(id, num_results, rtt_results);
+        on_rtt_results_internal_callback.resetIfUnchanged(callback);
     }
 }
 
@@ -183,187 +218,163 @@ void onAsyncRttResults(wifi_request_id id, unsigned num_results, wifi_rtt_result
 // NOTE: These have very little conversions to perform before invoking the user
 // callbacks.
 // So, handle all of them here directly to avoid adding an unnecessary layer.
-std::function<void(transaction_id, const NanResponseMsg&)> on_nan_notify_response_user_callback;
+CallbackSlot<void(transaction_id, const NanResponseMsg&)> on_nan_notify_response_user_callback;
 void onAysncNanNotifyResponse(transaction_id id, NanResponseMsg* msg) {
-    const auto lock = hidl_sync_util::acquireGlobalLock();
-    if (on_nan_notify_response_user_callback && msg) {
+    if (msg) {
         on_nan_notify_response_user_callback(id, *msg);
     }
 }
 
-std::function<void(const NanPublishRepliedInd&)> on_nan_event_publish_replied_user_callback;
+CallbackSlot<void(const NanPublishRepliedInd&)> on_nan_event_publish_replied_user_callback;
 void onAysncNanEventPublishReplied(NanPublishRepliedInd* /* event */) {
     LOG(ERROR) << "onAysncNanEventPublishReplied triggered";
 }
 
-std::function<void(const NanPublishTerminatedInd&)> on_nan_event_publish_terminated_user_callback;
+CallbackSlot<void(const NanPublishTerminatedInd&)> on_nan_event_publish_terminated_user_callback;
 void onAysncNanEventPublishTerminated(NanPublishTerminatedInd* event) {
-    const auto lock = hidl_sync_util::acquireGlobalLock();
-    if (on_nan_event_publish_terminated_user_callback && event) {
+    if (event) {
         on_nan_event_publish_terminated_user_callback(*event);
     }
 }
 
-std::function<void(const NanMatchInd&)> on_nan_event_match_user_callback;
+CallbackSlot<void(const NanMatchInd&)> on_nan_event_match_user_callback;
 void onAysncNanEventMatch(NanMatchInd* event) {
-    const auto lock = hidl_sync_util::acquireGlobalLock();
-    if (on_nan_event_match_user_callback && event) {
+    if (event) {
         on_nan_event_match_user_callback(*event);
     }
 }
 
-std::function<void(const NanMatchExpiredInd&)> on_nan_event_match_expired_user_callback;
+CallbackSlot<void(const NanMatchExpiredInd&)> on_nan_event_match_expired_user_callback;
 void onAysncNanEventMatchExpired(NanMatchExpiredInd* event) {
-    const auto lock = hidl_sync_util::acquireGlobalLock();
-    if (on_nan_event_match_expired_user_callback && event) {
+    if (event) {
         on_nan_event_match_expired_user_callback(*event);
     }
 }
 
-std::function<void(const NanSubscribeTerminatedInd&)>
+CallbackSlot<void(const NanSubscribeTerminatedInd&)>
         on_nan_event_subscribe_terminated_user_callback;
 void onAysncNanEventSubscribeTerminated(NanSubscribeTerminatedInd* event) {
-    const auto lock = hidl_sync_util::acquireGlobalLock();
-    if (on_nan_event_subscribe_terminated_user_callback && event) {
+    if (event) {
         on_nan_event_subscribe_terminated_user_callback(*event);
     }
 }
 
-std::function<void(const NanFollowupInd&)> on_nan_event_followup_user_callback;
+CallbackSlot<void(const NanFollowupInd&)> on_nan_event_followup_user_callback;
 void onAysncNanEventFollowup(NanFollowupInd* event) {
-    const auto lock = hidl_sync_util::acquireGlobalLock();
-    if (on_nan_event_followup_user_callback && event) {
+    if (event) {
         on_nan_event_followup_user_callback(*event);
     }
 }
 
-std::function<void(const NanDiscEngEventInd&)> on_nan_event_disc_eng_event_user_callback;
+CallbackSlot<void(const NanDiscEngEventInd&)> on_nan_event_disc_eng_event_user_callback;
 void onAysncNanEventDiscEngEvent(NanDiscEngEventInd* event) {
-    const auto lock = hidl_sync_util::acquireGlobalLock();
-    if (on_nan_event_disc_eng_event_user_callback && event) {
+    if (event) {
         on_nan_event_disc_eng_event_user_callback(*event);
     }
 }
 
-std::function<void(const NanDisabledInd&)> on_nan_event_disabled_user_callback;
+CallbackSlot<void(const NanDisabledInd&)> on_nan_event_disabled_user_callback;
 void onAysncNanEventDisabled(NanDisabledInd* event) {
-    const auto lock = hidl_sync_util::acquireGlobalLock();
-    if (on_nan_event_disabled_user_callback && event) {
+    if (event) {
         on_nan_event_disabled_user_callback(*event);
     }
 }
 
-std::function<void(const NanTCAInd&)> on_nan_event_tca_user_callback;
+CallbackSlot<void(const NanTCAInd&)> on_nan_event_tca_user_callback;
 void onAysncNanEventTca(NanTCAInd* event) {
-    const auto lock = hidl_sync_util::acquireGlobalLock();
-    if (on_nan_event_tca_user_callback && event) {
+    if (event) {
         on_nan_event_tca_user_callback(*event);
     }
 }
 
-std::function<void(const NanBeaconSdfPayloadInd&)> on_nan_event_beacon_sdf_payload_user_callback;
+CallbackSlot<void(const NanBeaconSdfPayloadInd&)> on_nan_event_beacon_sdf_payload_user_callback;
 void onAysncNanEventBeaconSdfPayload(NanBeaconSdfPayloadInd* event) {
-    const auto lock = hidl_sync_util::acquireGlobalLock();
-    if (on_nan_event_beacon_sdf_payload_user_callback && event) {
+    if (event) {
         on_nan_event_beacon_sdf_payload_user_callback(*event);
     }
 }
 
-std::function<void(const NanDataPathRequestInd&)> on_nan_event_data_path_request_user_callback;
+CallbackSlot<void(const NanDataPathRequestInd&)> on_nan_event_data_path_request_user_callback;
 void onAysncNanEventDataPathRequest(NanDataPathRequestInd* event) {
-    const auto lock = hidl_sync_util::acquireGlobalLock();
-    if (on_nan_event_data_path_request_user_callback && event) {
+    if (event) {
         on_nan_event_data_path_request_user_callback(*event);
     }
 }
-std::function<void(const NanDataPathConfirmInd&)> on_nan_event_data_path_confirm_user_callback;
+CallbackSlot<void(const NanDataPathConfirmInd&)> on_nan_event_data_path_confirm_user_callback;
 void onAysncNanEventDataPathConfirm(NanDataPathConfirmInd* event) {
-    const auto lock = hidl_sync_util::acquireGlobalLock();
-    if (on_nan_event_data_path_confirm_user_callback && event) {
+    if (event) {
         on_nan_event_data_path_confirm_user_callback(*event);
     }
 }
 
-std::function<void(const NanDataPathEndInd&)> on_nan_event_data_path_end_user_callback;
+CallbackSlot<void(const NanDataPathEndInd&)> on_nan_event_data_path_end_user_callback;
 void onAysncNanEventDataPathEnd(NanDataPathEndInd* event) {
-    const auto lock = hidl_sync_util::acquireGlobalLock();
-    if (on_nan_event_data_path_end_user_callback && event) {
+    if (event) {
         on_nan_event_data_path_end_user_callback(*event);
     }
 }
 
-std::function<void(const NanTransmitFollowupInd&)> on_nan_event_transmit_follow_up_user_callback;
+CallbackSlot<void(const NanTransmitFollowupInd&)> on_nan_event_transmit_follow_up_user_callback;
 void onAysncNanEventTransmitFollowUp(NanTransmitFollowupInd* event) {
-    const auto lock = hidl_sync_util::acquireGlobalLock();
-    if (on_nan_event_transmit_follow_up_user_callback && event) {
+    if (event) {
         on_nan_event_transmit_follow_up_user_callback(*event);
     }
 }
 
-std::function<void(const NanRangeRequestInd&)> on_nan_event_range_request_user_callback;
+CallbackSlot<void(const NanRangeRequestInd&)> on_nan_event_range_request_user_callback;
 void onAysncNanEventRangeRequest(NanRangeRequestInd* event) {
-    const auto lock = hidl_sync_util::acquireGlobalLock();
-    if (on_nan_event_range_request_user_callback && event) {
+    if (event) {
         on_nan_event_range_request_user_callback(*event);
     }
 }
 
-std::function<void(const NanRangeReportInd&)> on_nan_event_range_report_user_callback;
+CallbackSlot<void(const NanRangeReportInd&)> on_nan_event_range_report_user_callback;
 void onAysncNanEventRangeReport(NanRangeReportInd* event) {
-    const auto lock = hidl_sync_util::acquireGlobalLock();
-    if (on_nan_event_range_report_user_callback && event) {
+    if (event) {
         on_nan_event_range_report_user_callback(*event);
     }
 }
 
-std::function<void(const NanDataPathScheduleUpdateInd&)> on_nan_event_schedule_update_user_callback;
+CallbackSlot<void(const NanDataPathScheduleUpdateInd&)> on_nan_event_schedule_update_user_callback;
 void onAsyncNanEventScheduleUpdate(NanDataPathScheduleUpdateInd* event) {
-    const auto lock = hidl_sync_util::acquireGlobalLock();
-    if (on_nan_event_schedule_update_user_callback && event) {
+    if (event) {
         on_nan_event_schedule_update_user_callback(*event);
     }
 }
 
 // Callbacks for the various TWT operations.
-std::function<void(const TwtSetupResponse&)> on_twt_event_setup_response_callback;
+CallbackSlot<void(const TwtSetupResponse&)> on_twt_event_setup_response_callback;
 void onAsyncTwtEventSetupResponse(TwtSetupResponse* event) {
-    const auto lock = hidl_sync_util::acquireGlobalLock();
-    if (on_twt_event_setup_response_callback && event) {
+    if (event) {
         on_twt_event_setup_response_callback(*event);
     }
 }
 
-std::function<void(const TwtTeardownCompletion&)> on_twt_event_teardown_completion_callback;
+CallbackSlot<void(const TwtTeardownCompletion&)> on_twt_event_teardown_completion_callback;
 void onAsyncTwtEventTeardownCompletion(TwtTeardownCompletion* event) {
-    const auto lock = hidl_sync_util::acquireGlobalLock();
-    if (on_twt_event_teardown_completion_callback && event) {
+    if (event) {
         on_twt_event_teardown_completion_callback(*event);
     }
 }
 
-std::function<void(const TwtInfoFrameReceived&)> on_twt_event_info_frame_received_callback;
+CallbackSlot<void(const TwtInfoFrameReceived&)> on_twt_event_info_frame_received_callback;
 void onAsyncTwtEventInfoFrameReceived(TwtInfoFrameReceived* event) {
-    const auto lock = hidl_sync_util::acquireGlobalLock();
-    if (on_twt_event_info_frame_received_callback && event) {
+    if (event) {
         on_twt_event_info_frame_received_callback(*event);
     }
 }
 
-std::function<void(const TwtDeviceNotify&)> on_twt_event_device_notify_callback;
+CallbackSlot<void(const TwtDeviceNotify&)> on_twt_event_device_notify_callback;
 void onAsyncTwtEventDeviceNotify(TwtDeviceNotify* event) {
-    const auto lock = hidl_sync_util::acquireGlobalLock();
-    if (on_twt_event_device_notify_callback && event) {
+    if (event) {
         on_twt_event_device_notify_callback(*event);
     }
 }
 
 // Callback to report current CHRE NAN state
-std::function<void(chre_nan_rtt_state)> on_chre_nan_rtt_internal_callback;
+CallbackSlot<void(chre_nan_rtt_state)> on_chre_nan_rtt_internal_callback;
 void onAsyncChreNanRttState(chre_nan_rtt_state state) {
-    const auto lock = hidl_sync_util::acquireGlobalLock();
-    if (on_chre_nan_rtt_internal_callback) {
-        on_chre_nan_rtt_internal_callback(state);
-    }
+    on_chre_nan_rtt_internal_callback(state);
 }
 
 // End of the free-standing "C" style callbacks.
@@ -590,7 +601,7 @@ wifi_error WifiLegacyHal::startGscan(
                 std::tie(status, cached_scan_results) = getGscanCachedResults(iface_name);
                 if (status == WIFI_SUCCESS) {
                     on_results_user_callback(id, cached_scan_results);
-                    return;
+                    return false;
                 }
                 FALLTHROUGH_INTENDED;
             }
@@ -598,11 +609,10 @@ wifi_error WifiLegacyHal::startGscan(
             // results should trigger a background scan failure.
             case WIFI_SCAN_FAILED:
                 on_failure_user_callback(id);
-                on_gscan_event_internal_callback = nullptr;
-                on_gscan_full_result_internal_callback = nullptr;
-                return;
+                return true;
         }
         LOG(FATAL) << "Unexpected gscan event received: " << event;
+        return false;
     };
 
     on_gscan_full_result_internal_callback = [on_full_result_user_callback](
@@ -1346,7 +1356,7 @@ wifi_error WifiLegacyHal::retrieveIfaceHandles() {
         LOG(ERROR) << "Failed to enumerate interface handles";
         return status;
     }
-    iface_name_to_handle_.clear();
+    std::map<std::string, wifi_interface_handle> iface_name_to_handle;
     for (int i = 0; i < num_iface_handles; ++i) {
         std::array<char, IFNAMSIZ> iface_name_arr = {};
         status = global_func_table_.wifi_get_iface_name(iface_handles[i], iface_name_arr.data(),
@@ -1359,12 +1369,15 @@ wifi_error WifiLegacyHal::retrieveIfaceHandles() {
         // API does not return a size.
         std::string iface_name(iface_name_arr.data());
         LOG(INFO) << "Adding interface handle for " << iface_name;
-        iface_name_to_handle_[iface_name] = iface_handles[i];
+        iface_name_to_handle[iface_name] = iface_handles[i];
     }
+    std::unique_lock<std::shared_mutex> lock(iface_handles_lock_);
+    iface_name_to_handle_.swap(iface_name_to_handle);
     return WIFI_SUCCESS;
 }
 
 wifi_interface_handle WifiLegacyHal::getIfaceHandle(const std::string& iface_name) {
+    std::shared_lock<std::shared_mutex> lock(iface_handles_lock_);
     const auto iface_handle_iter = iface_name_to_handle_.find(iface_name);
     if (iface_handle_iter == iface_name_to_handle_.end()) {
         LOG(ERROR) << "Unknown iface name: " << iface_name;
@@ -1591,7 +1604,10 @@ wifi_error WifiLegacyHal::enableWifiTxPowerLimits(const std::string& iface_name,
 
 void WifiLegacyHal::invalidate() {
     global_handle_ = nullptr;
-    iface_name_to_handle_.clear();
+    {
+        std::unique_lock<std::shared_mutex> lock(iface_handles_lock_);
+        iface_name_to_handle_.clear();
+    }
     on_driver_memory_dump_internal_callback = nullptr;
     on_firmware_memory_dump_internal_callback = nullptr;
     on_gscan_event_internal_callback = nullptr;
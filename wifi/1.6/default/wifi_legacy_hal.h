@@ -20,6 +20,7 @@
 #include <condition_variable>
 #include <functional>
 #include <map>
+#include <shared_mutex>
 #include <thread>
 #include <vector>
 
@@ -705,7 +706,10 @@ class WifiLegacyHal {
     // Opaque handle to be used for all global operations.
     wifi_handle global_handle_;
     // Map of interface name to handle that is to be used for all interface
-    // specific operations.
+    // specific operations. Looked up by the HIDL methods of every interface
+    // and by the legacy HAL event loop thread, so it is guarded by a
+    // reader-writer lock that is only held exclusively to replace or clear it.
+    std::shared_mutex iface_handles_lock_;
     std::map<std::string, wifi_interface_handle> iface_name_to_handle_;
     // Flag to indicate if we have initiated the cleanup of legacy HAL.
     std::atomic<bool> awaiting_event_loop_termination_;
@@ -471,6 +471,7 @@ WifiNanIface::WifiNanIface(const std::string& ifname, bool is_dedicated_iface,
 }
 
 void WifiNanIface::invalidate() {
+    const auto lock = acquireLock();
     if (!isValid()) {
         return;
     }
@@ -494,6 +495,10 @@ bool WifiNanIface::isValid() {
     return is_valid_;
 }
 
+std::unique_lock<std::recursive_mutex> WifiNanIface::acquireLock() {
+    return std::unique_lock<std::recursive_mutex>{lock_};
+}
+
 std::string WifiNanIface::getName() {
     return ifname_;
 }
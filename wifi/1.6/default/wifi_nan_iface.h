@@ -17,6 +17,9 @@
 #ifndef WIFI_NAN_IFACE_H_
 #define WIFI_NAN_IFACE_H_
 
+#include <atomic>
+#include <mutex>
+
 #include <android-base/macros.h>
 #include <android/hardware/wifi/1.6/IWifiNanIface.h>
 #include <android/hardware/wifi/1.6/IWifiNanIfaceEventCallback.h>
@@ -46,6 +49,9 @@ class WifiNanIface : public V1_6::IWifiNanIface {
     // Refer to |WifiChip::invalidate()|.
     void invalidate();
     bool isValid();
+    // Returns the lock serializing the HIDL methods of this object. Refer to
+    // THREADING.README.
+    std::unique_lock<std::recursive_mutex> acquireLock();
     std::string getName();
 
     // HIDL methods exposed.
@@ -190,7 +196,8 @@ class WifiNanIface : public V1_6::IWifiNanIface {
     bool is_dedicated_iface_;
     std::weak_ptr<legacy_hal::WifiLegacyHal> legacy_hal_;
     std::weak_ptr<iface_util::WifiIfaceUtil> iface_util_;
-    bool is_valid_;
+    std::atomic<bool> is_valid_;
+    std::recursive_mutex lock_;
     hidl_callback_util::HidlCallbackHandler<V1_0::IWifiNanIfaceEventCallback> event_cb_handler_;
     hidl_callback_util::HidlCallbackHandler<V1_2::IWifiNanIfaceEventCallback> event_cb_handler_1_2_;
     hidl_callback_util::HidlCallbackHandler<V1_5::IWifiNanIfaceEventCallback> event_cb_handler_1_5_;
@@ -32,6 +32,7 @@ WifiP2pIface::WifiP2pIface(const std::string& ifname,
     : ifname_(ifname), legacy_hal_(legacy_hal), is_valid_(true) {}
 
 void WifiP2pIface::invalidate() {
+    const auto lock = acquireLock();
     legacy_hal_.reset();
     is_valid_ = false;
 }
@@ -40,6 +41,10 @@ bool WifiP2pIface::isValid() {
     return is_valid_;
 }
 
+std::unique_lock<std::recursive_mutex> WifiP2pIface::acquireLock() {
+    return std::unique_lock<std::recursive_mutex>{lock_};
+}
+
 std::string WifiP2pIface::getName() {
     return ifname_;
 }
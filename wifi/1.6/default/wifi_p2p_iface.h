@@ -17,6 +17,9 @@
 #ifndef WIFI_P2P_IFACE_H_
 #define WIFI_P2P_IFACE_H_
 
+#include <atomic>
+#include <mutex>
+
 #include <android-base/macros.h>
 #include <android/hardware/wifi/1.0/IWifiP2pIface.h>
 
@@ -39,6 +42,9 @@ class WifiP2pIface : public V1_0::IWifiP2pIface {
     // Refer to |WifiChip::invalidate()|.
     void invalidate();
     bool isValid();
+    // Returns the lock serializing the HIDL methods of this object. Refer to
+    // THREADING.README.
+    std::unique_lock<std::recursive_mutex> acquireLock();
     std::string getName();
 
     // HIDL methods exposed.
@@ -52,7 +58,8 @@ class WifiP2pIface : public V1_0::IWifiP2pIface {
 
     std::string ifname_;
     std::weak_ptr<legacy_hal::WifiLegacyHal> legacy_hal_;
-    bool is_valid_;
+    std::atomic<bool> is_valid_;
+    std::recursive_mutex lock_;
 
     DISALLOW_COPY_AND_ASSIGN(WifiP2pIface);
 };
@@ -34,8 +34,12 @@ WifiRttController::WifiRttController(const std::string& iface_name,
     : ifname_(iface_name), bound_iface_(bound_iface), legacy_hal_(legacy_hal), is_valid_(true) {}
 
 void WifiRttController::invalidate() {
+    const auto lock = acquireLock();
     legacy_hal_.reset();
-    event_callbacks_.clear();
+    {
+        std::lock_guard<std::mutex> callbacks_lock(event_callbacks_lock_);
+        event_callbacks_.clear();
+    }
     is_valid_ = false;
 }
 
@@ -43,7 +47,12 @@ bool WifiRttController::isValid() {
     return is_valid_;
 }
 
+std::unique_lock<std::recursive_mutex> WifiRttController::acquireLock() {
+    return std::unique_lock<std::recursive_mutex>{lock_};
+}
+
 std::vector<sp<V1_6::IWifiRttControllerEventCallback>> WifiRttController::getEventCallbacks() {
+    std::lock_guard<std::mutex> lock(event_callbacks_lock_);
     return event_callbacks_;
 }
 
@@ -290,6 +299,7 @@ WifiStatus WifiRttController::enableResponderInternal_1_4(
 WifiStatus WifiRttController::registerEventCallbackInternal_1_6(
         const sp<V1_6::IWifiRttControllerEventCallback>& callback) {
     // TODO(b/31632518): remove the callback when the client is destroyed
+    std::lock_guard<std::mutex> lock(event_callbacks_lock_);
     event_callbacks_.emplace_back(callback);
     return createWifiStatus(WifiStatusCode::SUCCESS);
 }
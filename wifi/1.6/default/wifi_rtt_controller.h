@@ -17,6 +17,9 @@
 #ifndef WIFI_RTT_CONTROLLER_H_
 #define WIFI_RTT_CONTROLLER_H_
 
+#include <atomic>
+#include <mutex>
+
 #include <android-base/macros.h>
 #include <android/hardware/wifi/1.0/IWifiIface.h>
 #include <android/hardware/wifi/1.6/IWifiRttController.h>
@@ -40,6 +43,9 @@ class WifiRttController : public V1_6::IWifiRttController {
     // Refer to |WifiChip::invalidate()|.
     void invalidate();
     bool isValid();
+    // Returns the lock serializing the HIDL methods of this object. Refer to
+    // THREADING.README.
+    std::unique_lock<std::recursive_mutex> acquireLock();
     std::vector<sp<V1_6::IWifiRttControllerEventCallback>> getEventCallbacks();
     std::string getIfaceName();
 
@@ -123,8 +129,12 @@ class WifiRttController : public V1_6::IWifiRttController {
     std::string ifname_;
     sp<IWifiIface> bound_iface_;
     std::weak_ptr<legacy_hal::WifiLegacyHal> legacy_hal_;
+    // Guards |event_callbacks_|, which are iterated on the legacy HAL event
+    // loop thread.
+    std::mutex event_callbacks_lock_;
     std::vector<sp<V1_6::IWifiRttControllerEventCallback>> event_callbacks_;
-    bool is_valid_;
+    std::atomic<bool> is_valid_;
+    std::recursive_mutex lock_;
 
     DISALLOW_COPY_AND_ASSIGN(WifiRttController);
 };
@@ -40,6 +40,7 @@ WifiStaIface::WifiStaIface(const std::string& ifname,
 }
 
 void WifiStaIface::invalidate() {
+    const auto lock = acquireLock();
     legacy_hal_.reset();
     event_cb_handler_.invalidate();
     is_valid_ = false;
@@ -49,6 +50,10 @@ bool WifiStaIface::isValid() {
     return is_valid_;
 }
 
+std::unique_lock<std::recursive_mutex> WifiStaIface::acquireLock() {
+    return std::unique_lock<std::recursive_mutex>{lock_};
+}
+
 std::string WifiStaIface::getName() {
     return ifname_;
 }
@@ -17,6 +17,9 @@
 #ifndef WIFI_STA_IFACE_H_
 #define WIFI_STA_IFACE_H_
 
+#include <atomic>
+#include <mutex>
+
 #include <android-base/macros.h>
 #include <android/hardware/wifi/1.0/IWifiStaIfaceEventCallback.h>
 #include <android/hardware/wifi/1.6/IWifiStaIface.h>
@@ -43,6 +46,9 @@ class WifiStaIface : public V1_6::IWifiStaIface {
     // Refer to |WifiChip::invalidate()|.
     void invalidate();
     bool isValid();
+    // Returns the lock serializing the HIDL methods of this object. Refer to
+    // THREADING.README.
+    std::unique_lock<std::recursive_mutex> acquireLock();
     std::set<sp<IWifiStaIfaceEventCallback>> getEventCallbacks();
     std::string getName();
 
@@ -142,7 +148,8 @@ class WifiStaIface : public V1_6::IWifiStaIface {
     std::string ifname_;
     std::weak_ptr<legacy_hal::WifiLegacyHal> legacy_hal_;
     std::weak_ptr<iface_util::WifiIfaceUtil> iface_util_;
-    bool is_valid_;
+    std::atomic<bool> is_valid_;
+    std::recursive_mutex lock_;
     hidl_callback_util::HidlCallbackHandler<IWifiStaIfaceEventCallback> event_cb_handler_;
 
     DISALLOW_COPY_AND_ASSIGN(WifiStaIface);